@@ -0,0 +1,370 @@
+/*
+ * Microbenchmarks of the hot paths of the library, one component at a time, so a regression can
+ * be tracked down to the component that caused it:
+ * - decoding of text hashes: scalar, SIMD and the implementation selected at runtime,
+ * - SHA-1 digests of passwords: scalar and the implementation selected at runtime,
+ * - btree_node::place_for() and btree_node::contains() for different orders,
+ * - original_file_reader reading a memory_storage,
+ * - handing buffers over between the threads of buffers_queue,
+ * - building a tree with btree_sorted_keys_inserter, which is dominated by its rebalancing,
+ * - btree lookups of a tree kept in a memory_storage, for different orders and format versions.
+ * Everything happens in memory, so no file system nor page cache is involved.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "btree.hpp"
+#include "btree_bulk_loader.hpp"
+#include "btree_node.hpp"
+#include "btree_sorted_keys_inserter.hpp"
+#include "buffers_queue.hpp"
+#include "memory_storage.hpp"
+#include "original_file_reader.hpp"
+#include "sha1_digest.hpp"
+#include "sha1_utils.hpp"
+#include "text_sha1_decoder.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+using okon::test::memory_storage;
+
+std::vector<okon::sha1_t> make_hashes(std::size_t count, uint64_t seed)
+{
+  std::mt19937_64 generator{ seed };
+
+  std::vector<okon::sha1_t> hashes(count);
+  for (auto& hash : hashes) {
+    for (auto& byte : hash) {
+      byte = static_cast<uint8_t>(generator());
+    }
+  }
+  return hashes;
+}
+
+std::vector<okon::sha1_t> make_sorted_hashes(std::size_t count, uint64_t seed)
+{
+  auto hashes = make_hashes(count, seed);
+  std::sort(hashes.begin(), hashes.end());
+  return hashes;
+}
+
+// Text hashes, one per line, like in the original file.
+std::string make_text_hashes(std::size_t count)
+{
+  std::string text;
+  for (const auto& hash : make_hashes(count, /*seed=*/0u)) {
+    text += okon::binary_sha1_to_string(hash);
+    text += ":1\n";
+  }
+  return text;
+}
+
+constexpr auto k_text_line_length{ 43u };
+constexpr auto k_text_hashes_count{ 4096u };
+
+std::vector<const char*> text_hash_pointers(const std::string& text)
+{
+  std::vector<const char*> pointers(k_text_hashes_count);
+  for (auto i = 0u; i < pointers.size(); ++i) {
+    pointers[i] = text.data() + i * k_text_line_length;
+  }
+  return pointers;
+}
+
+void BM_TextSha1ToBinary_Scalar(benchmark::State& state)
+{
+  // Followed by the padding read by the SIMD decoder.
+  const auto text = make_text_hashes(k_text_hashes_count) + std::string(64u, '0');
+  const auto texts = text_hash_pointers(text);
+
+  for (auto _ : state) {
+    for (const auto* hash_text : texts) {
+      benchmark::DoNotOptimize(okon::details::string_sha1_to_binary(hash_text));
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * texts.size());
+}
+
+#ifdef OKON_USE_SIMD
+void BM_TextSha1ToBinary_Simd(benchmark::State& state)
+{
+  // Followed by the padding read by the SIMD decoder.
+  const auto text = make_text_hashes(k_text_hashes_count) + std::string(64u, '0');
+  const auto texts = text_hash_pointers(text);
+
+  for (auto _ : state) {
+    for (const auto* hash_text : texts) {
+      benchmark::DoNotOptimize(okon::details::simd_string_sha1_to_binary(hash_text));
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * texts.size());
+}
+#endif
+
+void BM_TextSha1sToBinary_Dispatched(benchmark::State& state)
+{
+  const auto text = make_text_hashes(k_text_hashes_count);
+  const auto texts = text_hash_pointers(text);
+  std::vector<okon::sha1_t> sha1s(texts.size());
+
+  for (auto _ : state) {
+    okon::text_sha1s_to_binary(texts.data(), texts.size(), sha1s.data());
+    benchmark::DoNotOptimize(sha1s.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * texts.size());
+  state.SetLabel(okon::text_sha1_decoder_name());
+}
+
+// Passwords of a typical length, that fit in one block.
+std::vector<std::string> make_passwords(std::size_t count)
+{
+  std::mt19937_64 generator{ count };
+
+  std::vector<std::string> passwords(count);
+  for (auto& password : passwords) {
+    password.resize(8u + generator() % 8u);
+    for (auto& c : password) {
+      c = static_cast<char>('!' + generator() % 94u);
+    }
+  }
+  return passwords;
+}
+
+void BM_Sha1Digest_Scalar(benchmark::State& state)
+{
+  const auto passwords = make_passwords(1024u);
+
+  for (auto _ : state) {
+    for (const auto& password : passwords) {
+      benchmark::DoNotOptimize(okon::details::sha1_digest_with(
+        &okon::details::sha1_compress_scalar, password.data(), password.size()));
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * passwords.size());
+}
+
+void BM_Sha1Digest_Dispatched(benchmark::State& state)
+{
+  const auto passwords = make_passwords(1024u);
+
+  for (auto _ : state) {
+    for (const auto& password : passwords) {
+      benchmark::DoNotOptimize(okon::sha1_digest(password.data(), password.size()));
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * passwords.size());
+  state.SetLabel(okon::sha1_digest_name());
+}
+
+// Full node of the given order and queries, half of them are keys of the node.
+std::pair<okon::btree_node, std::vector<okon::sha1_t>> make_node_and_queries(
+  okon::btree_node::order_t order)
+{
+  okon::btree_node node{ order, okon::btree_node::k_unused_pointer };
+  for (const auto& key : make_sorted_hashes(order, /*seed=*/0u)) {
+    node.push_back(key);
+  }
+
+  auto queries = make_hashes(1024u, /*seed=*/1u);
+  for (auto i = 0u; i < queries.size(); i += 2u) {
+    queries[i] = node.keys[i % order];
+  }
+
+  return { std::move(node), std::move(queries) };
+}
+
+void BM_BtreeNode_PlaceFor(benchmark::State& state)
+{
+  const auto [node, queries] =
+    make_node_and_queries(static_cast<okon::btree_node::order_t>(state.range(0)));
+
+  for (auto _ : state) {
+    for (const auto& query : queries) {
+      benchmark::DoNotOptimize(node.place_for(query));
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * queries.size());
+}
+
+void BM_BtreeNode_Contains(benchmark::State& state)
+{
+  const auto [node, queries] =
+    make_node_and_queries(static_cast<okon::btree_node::order_t>(state.range(0)));
+
+  for (auto _ : state) {
+    for (const auto& query : queries) {
+      benchmark::DoNotOptimize(node.contains(query));
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * queries.size());
+}
+
+void BM_OriginalFileReader(benchmark::State& state)
+{
+  const auto buffer_size = static_cast<unsigned>(state.range(0));
+  constexpr auto k_number_of_buffers{ 4u };
+
+  const auto text = make_text_hashes(1u << 16u);
+  memory_storage storage{};
+  storage.m_storage.assign(text.begin(), text.end());
+
+  for (auto _ : state) {
+    storage.seek_in(0u);
+    okon::original_file_reader<memory_storage> reader{
+      storage, buffer_size + okon::k_text_sha1_length_for_simd, buffer_size, k_number_of_buffers
+    };
+
+    while (const auto sha1 = reader.next_sha1()) {
+      benchmark::DoNotOptimize(sha1->data());
+    }
+  }
+
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+
+void BM_BuffersQueue_Handoff(benchmark::State& state)
+{
+  const auto number_of_buffers = static_cast<unsigned>(state.range(0));
+  constexpr auto k_buffer_size{ 4096u };
+  constexpr auto k_handoffs_count{ 1u << 14u };
+
+  for (auto _ : state) {
+    okon::buffers_queue queue{ k_buffer_size, number_of_buffers };
+
+    std::thread storing_thread{ [&queue] {
+      for (auto i = 0u; i < k_handoffs_count; ++i) {
+        const auto index = queue.take_for_data_storing();
+        if (!index) {
+          return;
+        }
+        queue.access_buffer(*index)[0] = static_cast<uint8_t>(i);
+        queue.data_storing_ready();
+      }
+      queue.notify_no_more_data();
+    } };
+
+    while (const auto index = queue.take_for_processing()) {
+      benchmark::DoNotOptimize(queue.access_buffer(*index)[0]);
+      queue.processing_ready();
+    }
+
+    storing_thread.join();
+  }
+
+  state.SetItemsProcessed(state.iterations() * k_handoffs_count);
+}
+
+void BM_BtreeSortedKeysInserter(benchmark::State& state)
+{
+  const auto order = static_cast<okon::btree_node::order_t>(state.range(0));
+  constexpr auto k_keys_count{ 1u << 14u };
+
+  const auto keys = make_sorted_hashes(k_keys_count, /*seed=*/0u);
+
+  for (auto _ : state) {
+    memory_storage storage{};
+    okon::btree_sorted_keys_inserter inserter{ storage, order };
+    for (const auto& key : keys) {
+      inserter.insert_sorted(key);
+    }
+    inserter.finalize_inserting();
+    benchmark::DoNotOptimize(storage.m_storage.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+void BM_Btree_Contains(benchmark::State& state)
+{
+  const auto order = static_cast<okon::btree_node::order_t>(state.range(0));
+  const auto version = static_cast<okon::btree_format_version>(state.range(1));
+  constexpr auto k_keys_count{ 1u << 18u };
+
+  const auto keys = make_sorted_hashes(k_keys_count, /*seed=*/0u);
+  memory_storage storage{};
+  {
+    okon::btree_bulk_loader loader{ storage, order, k_keys_count, version };
+    for (const auto& key : keys) {
+      loader.insert_sorted(key);
+    }
+    loader.finalize_inserting();
+  }
+
+  okon::btree tree{ storage };
+
+  // Every other query is a key of the tree.
+  auto queries = make_hashes(4096u, /*seed=*/1u);
+  for (auto i = 0u; i < queries.size(); i += 2u) {
+    queries[i] = keys[i * (k_keys_count / queries.size())];
+  }
+
+  for (auto _ : state) {
+    for (const auto& query : queries) {
+      benchmark::DoNotOptimize(tree.contains(query));
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * queries.size());
+  state.counters["storage_bytes"] = static_cast<double>(storage.total_size());
+}
+
+void orders(benchmark::internal::Benchmark* benchmark)
+{
+  for (auto order = 4; order <= 4096; order *= 4) {
+    benchmark->Arg(order);
+  }
+}
+
+void orders_and_versions(benchmark::internal::Benchmark* benchmark)
+{
+  for (const auto version : { okon::btree_format_version::v1, okon::btree_format_version::v2,
+                              okon::btree_format_version::v3 }) {
+    for (auto order = 16; order <= 4096; order *= 4) {
+      benchmark->Args({ order, static_cast<int>(version) });
+    }
+  }
+}
+}
+
+BENCHMARK(BM_TextSha1ToBinary_Scalar);
+#ifdef OKON_USE_SIMD
+BENCHMARK(BM_TextSha1ToBinary_Simd);
+#endif
+BENCHMARK(BM_TextSha1sToBinary_Dispatched);
+
+BENCHMARK(BM_Sha1Digest_Scalar);
+BENCHMARK(BM_Sha1Digest_Dispatched);
+
+BENCHMARK(BM_BtreeNode_PlaceFor)->Apply(orders)->ArgName("order");
+BENCHMARK(BM_BtreeNode_Contains)->Apply(orders)->ArgName("order");
+
+BENCHMARK(BM_OriginalFileReader)
+  ->RangeMultiplier(4)
+  ->Range(16 * 1024, 4 * 1024 * 1024)
+  ->ArgName("buffer_size")
+  ->UseRealTime();
+
+BENCHMARK(BM_BuffersQueue_Handoff)
+  ->RangeMultiplier(2)
+  ->Range(2, 16)
+  ->ArgName("buffers")
+  ->UseRealTime();
+
+BENCHMARK(BM_BtreeSortedKeysInserter)->Arg(64)->Arg(256)->Arg(1024)->ArgName("order");
+
+BENCHMARK(BM_Btree_Contains)->Apply(orders_and_versions)->ArgNames({ "order", "version" });
+
+BENCHMARK_MAIN();
@@ -0,0 +1,121 @@
+/*
+ * Compares lookups in B-trees of different node sizes, see btree_node_size of
+ * okon_prepare_options. Files are prepared once, from random hashes, and looked up with a warm
+ * page cache. Half of the looked up hashes are in the file.
+ * For lookups with a cold cache, prepare a file with the chosen node size and pass it to the
+ * okon_btree_benchmark target.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <okon/okon.h>
+
+#include "sha1_utils.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+constexpr auto k_hashes_count{ 1u << 20u };
+
+std::vector<okon::sha1_t> make_hashes(std::size_t count, uint64_t seed)
+{
+  std::mt19937_64 generator{ seed };
+
+  std::vector<okon::sha1_t> hashes(count);
+  for (auto& hash : hashes) {
+    for (auto& byte : hash) {
+      byte = static_cast<uint8_t>(generator());
+    }
+  }
+  return hashes;
+}
+
+std::filesystem::path working_directory()
+{
+  const auto path = std::filesystem::temp_directory_path() / "okon_node_size_benchmark";
+  std::filesystem::create_directories(path);
+  return path;
+}
+
+// Prepared files, by format and node size. Prepared on the first use.
+const std::string& prepared_file(okon_format format, unsigned node_size)
+{
+  static std::map<std::pair<okon_format, unsigned>, std::string> files;
+
+  auto& path = files[{ format, node_size }];
+  if (!path.empty()) {
+    return path;
+  }
+
+  const auto wd = working_directory();
+  const auto input_path = (wd / "input.txt").string();
+  if (!std::filesystem::exists(input_path)) {
+    std::ofstream input{ input_path };
+    for (const auto& hash : make_hashes(k_hashes_count, /*seed=*/0u)) {
+      input << okon::binary_sha1_to_string(hash) << ":1\n";
+    }
+  }
+
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.format = format;
+  options.btree_node_size = node_size;
+
+  path = (wd / ("prepared_" + std::to_string(format) + "_" + std::to_string(node_size))).string();
+  const auto wd_path = wd.string() + '/';
+  okon_prepare_ex(input_path.c_str(), wd_path.c_str(), path.c_str(), &options);
+  return path;
+}
+
+void BM_Lookup(benchmark::State& state)
+{
+  const auto format = static_cast<okon_format>(state.range(0));
+  const auto node_size = static_cast<unsigned>(state.range(1));
+  const auto& path = prepared_file(format, node_size);
+
+  auto* handle = okon_open(path.c_str());
+  if (!handle) {
+    state.SkipWithError("couldn't open the prepared file");
+    return;
+  }
+
+  // Every other query is a hash of the file.
+  auto queries = make_hashes(k_hashes_count / 2u, /*seed=*/1u);
+  const auto prepared = make_hashes(k_hashes_count, /*seed=*/0u);
+  for (auto i = 0u; i < queries.size(); i += 2u) {
+    queries[i] = prepared[i * 2u];
+  }
+
+  std::size_t next{ 0u };
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(okon_handle_exists_binary(handle, queries[next].data()));
+    next = next + 1u == queries.size() ? 0u : next + 1u;
+  }
+
+  state.SetItemsProcessed(state.iterations());
+  state.counters["file_bytes"] = static_cast<double>(std::filesystem::file_size(path));
+
+  okon_close(handle);
+}
+
+void node_sizes(benchmark::internal::Benchmark* benchmark)
+{
+  for (const auto format : { okon_format_btree_v2, okon_format_btree_v3, okon_format_btree_v4 }) {
+    // 0 is the default: order 1024 for v2 and v3, 16 KiB for v4.
+    benchmark->Args({ format, 0 });
+    for (auto node_size = 512; node_size <= 64 * 1024; node_size *= 2) {
+      benchmark->Args({ format, node_size });
+    }
+  }
+}
+}
+
+BENCHMARK(BM_Lookup)->Apply(node_sizes)->ArgNames({ "format", "node_size" });
+
+BENCHMARK_MAIN();
@@ -0,0 +1,70 @@
+/*
+ * Compares sorting engines for intermediate files of the preparer: std::sort with a memcmp
+ * predicate, as the preparer used to do, and radix_sort_sha1().
+ * Keys share the first byte, like hashes in one intermediate file.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "sha1_radix_sort.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+std::vector<okon::sha1_t> make_intermediate_file_keys(std::size_t count)
+{
+  std::mt19937_64 generator{ count };
+
+  std::vector<okon::sha1_t> keys(count);
+  for (auto& key : keys) {
+    for (auto& byte : key) {
+      byte = static_cast<uint8_t>(generator());
+    }
+    key[0] = 0xABu;
+  }
+  return keys;
+}
+
+void BM_StdSort(benchmark::State& state)
+{
+  const auto keys = make_intermediate_file_keys(static_cast<std::size_t>(state.range(0)));
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto to_sort = keys;
+    state.ResumeTiming();
+
+    std::sort(to_sort.begin(), to_sort.end(),
+              [](const okon::sha1_t& lhs, const okon::sha1_t& rhs) {
+                return std::memcmp(lhs.data(), rhs.data(), sizeof(okon::sha1_t)) < 0;
+              });
+    benchmark::DoNotOptimize(to_sort.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_RadixSort(benchmark::State& state)
+{
+  const auto keys = make_intermediate_file_keys(static_cast<std::size_t>(state.range(0)));
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto to_sort = keys;
+    state.ResumeTiming();
+
+    okon::radix_sort_sha1(to_sort.data(), to_sort.size(), /*first_byte=*/1u);
+    benchmark::DoNotOptimize(to_sort.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+}
+
+BENCHMARK(BM_StdSort)->RangeMultiplier(8)->Range(1 << 12, 1 << 21)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_RadixSort)->RangeMultiplier(8)->Range(1 << 12, 1 << 21)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,446 @@
+/*
+ * Replays lookups against a prepared file opened once, like a service answering queries does: with
+ * a warm page cache, from many threads, and with a configurable mix of hits and misses. Reports
+ * queries per second and a histogram of latencies, so hardware can be sized from the numbers.
+ *
+ * Usage: okon_throughput_benchmark [--db <prepared file>] [--keys <count>] [--queries <count>]
+ *                                  [--threads <count>] [--batch <size>] [--hit-ratio <0..1>]
+ *                                  [--distribution uniform|zipf] [--zipf-exponent <s>]
+ *                                  [--pool <count>] [--warmup <passes>] [--seed <seed>]
+ *
+ * Without --db, a file of `--keys` random hashes is prepared in the system temporary directory.
+ * Queries are drawn from `--pool` hashes of the file and `--pool` hashes that are not in it. With
+ * the Zipf distribution, the k-th hash of a pool is drawn with probability proportional to
+ * 1 / k^s, so a few hashes are queried most of the time. With a batch size greater than 1, queries
+ * are looked up with okon_exists_batch() and latencies are of whole batches.
+ */
+
+#include <okon/okon.h>
+
+#include "sha1_utils.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+using steady_clock_t = std::chrono::steady_clock;
+
+enum class distribution
+{
+  uniform,
+  zipf
+};
+
+struct options
+{
+  std::string db_path;
+  unsigned long long keys_count{ 1u << 20u };
+  unsigned long long queries_count{ 1u << 22u };
+  unsigned threads{ 1u };
+  unsigned batch_size{ 1u };
+  double hit_ratio{ 0.5 };
+  distribution query_distribution{ distribution::uniform };
+  double zipf_exponent{ 1.0 };
+  unsigned pool_size{ 1u << 16u };
+  unsigned warmup_passes{ 1u };
+  unsigned long long seed{ 0u };
+};
+
+template <typename T>
+std::optional<T> parse_number(std::string_view text)
+{
+  T value{};
+  const auto end = text.data() + text.size();
+  const auto [ptr, ec] = std::from_chars(text.data(), end, value);
+  if (ec != std::errc{} || ptr != end) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+// std::from_chars() for floating point numbers isn't available in every standard library.
+std::optional<double> parse_double(std::string_view text)
+{
+  const std::string str{ text };
+  char* end{ nullptr };
+  const auto value = std::strtod(str.c_str(), &end);
+  if (str.empty() || end != str.c_str() + str.size()) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+std::optional<options> parse_options(int argc, const char* argv[])
+{
+  options result;
+
+  for (auto i = 1; i < argc; i += 2) {
+    const std::string_view name{ argv[i] };
+    if (i + 1 >= argc) {
+      std::cerr << "expected value after: " << name << '\n';
+      return std::nullopt;
+    }
+    const std::string_view value{ argv[i + 1] };
+
+    auto is_valid = true;
+    const auto set = [&is_valid](auto& field, auto parsed) {
+      if (parsed) {
+        field = *parsed;
+      } else {
+        is_valid = false;
+      }
+    };
+
+    if (name == "--db") {
+      result.db_path = value;
+    } else if (name == "--keys") {
+      set(result.keys_count, parse_number<unsigned long long>(value));
+    } else if (name == "--queries") {
+      set(result.queries_count, parse_number<unsigned long long>(value));
+    } else if (name == "--threads") {
+      set(result.threads, parse_number<unsigned>(value));
+    } else if (name == "--batch") {
+      set(result.batch_size, parse_number<unsigned>(value));
+    } else if (name == "--hit-ratio") {
+      set(result.hit_ratio, parse_double(value));
+    } else if (name == "--distribution") {
+      if (value == "uniform") {
+        result.query_distribution = distribution::uniform;
+      } else if (value == "zipf") {
+        result.query_distribution = distribution::zipf;
+      } else {
+        is_valid = false;
+      }
+    } else if (name == "--zipf-exponent") {
+      set(result.zipf_exponent, parse_double(value));
+    } else if (name == "--pool") {
+      set(result.pool_size, parse_number<unsigned>(value));
+    } else if (name == "--warmup") {
+      set(result.warmup_passes, parse_number<unsigned>(value));
+    } else if (name == "--seed") {
+      set(result.seed, parse_number<unsigned long long>(value));
+    } else {
+      std::cerr << "unknown argument: " << name << '\n';
+      return std::nullopt;
+    }
+
+    if (!is_valid) {
+      std::cerr << "invalid value of " << name << ": " << value << '\n';
+      return std::nullopt;
+    }
+  }
+
+  if (result.threads == 0u || result.batch_size == 0u || result.pool_size == 0u ||
+      result.hit_ratio < 0.0 || result.hit_ratio > 1.0 || result.zipf_exponent <= 0.0) {
+    std::cerr << "invalid options\n";
+    return std::nullopt;
+  }
+
+  return result;
+}
+
+okon::sha1_t random_sha1(std::mt19937_64& generator)
+{
+  okon::sha1_t sha1;
+  for (auto& byte : sha1) {
+    byte = static_cast<uint8_t>(generator());
+  }
+  return sha1;
+}
+
+std::optional<std::string> prepare_random_file(const options& opts)
+{
+  const auto wd = std::filesystem::temp_directory_path() / "okon_throughput_benchmark";
+  std::filesystem::create_directories(wd);
+
+  const auto path = (wd / ("prepared_" + std::to_string(opts.keys_count))).string();
+  if (std::filesystem::exists(path)) {
+    return path;
+  }
+
+  std::cerr << "preparing " << opts.keys_count << " random hashes in " << path << '\n';
+
+  const auto input_path = (wd / "input.txt").string();
+  {
+    std::ofstream input{ input_path };
+    std::mt19937_64 generator{ opts.keys_count };
+    for (auto i = 0ull; i < opts.keys_count; ++i) {
+      input << okon::binary_sha1_to_string(random_sha1(generator)) << ":1\n";
+    }
+  }
+
+  const auto wd_path = wd.string() + '/';
+  const auto result = okon_prepare_ex(input_path.c_str(), wd_path.c_str(), path.c_str(), nullptr);
+  std::filesystem::remove(input_path);
+  if (result != okon_prepare_result_success) {
+    std::cerr << "couldn't prepare the file\n";
+    return std::nullopt;
+  }
+  return path;
+}
+
+int store_first(void* user_data, const void* sha1)
+{
+  auto& found = *static_cast<std::optional<okon::sha1_t>*>(user_data);
+  found.emplace();
+  std::copy_n(static_cast<const uint8_t*>(sha1), found->size(), found->begin());
+  return 0;
+}
+
+// Hashes of the file, spread over the key space: for every random hash, the first hash of the file
+// that starts with the longest prefix of the random hash.
+std::vector<okon::sha1_t> sample_hits(okon_handle* handle, unsigned count,
+                                      std::mt19937_64& generator)
+{
+  std::vector<okon::sha1_t> hits;
+  hits.reserve(count);
+
+  while (hits.size() < count) {
+    const auto text = okon::binary_sha1_to_string(random_sha1(generator));
+    for (auto prefix_length = 8u;; --prefix_length) {
+      std::optional<okon::sha1_t> found;
+      const auto result = okon_range(handle, text.data(), prefix_length, &store_first, &found);
+      if (result != okon_range_result_success) {
+        return {};
+      }
+      if (found) {
+        hits.push_back(*found);
+        break;
+      }
+      if (prefix_length == 0u) {
+        // The file is empty.
+        return {};
+      }
+    }
+  }
+
+  return hits;
+}
+
+std::vector<okon::sha1_t> sample_misses(okon_handle* handle, unsigned count,
+                                        std::mt19937_64& generator)
+{
+  std::vector<okon::sha1_t> misses;
+  misses.reserve(count);
+
+  while (misses.size() < count) {
+    const auto sha1 = random_sha1(generator);
+    if (okon_handle_exists_binary(handle, sha1.data()) == okon_exists_result_doesnt_exist) {
+      misses.push_back(sha1);
+    }
+  }
+  return misses;
+}
+
+// Draws indices of a pool of hashes.
+class index_sampler
+{
+public:
+  explicit index_sampler(const options& opts)
+    : m_uniform{ 0u, opts.pool_size - 1u }
+  {
+    if (opts.query_distribution == distribution::zipf) {
+      m_zipf_cdf.resize(opts.pool_size);
+      auto sum = 0.0;
+      for (auto k = 0u; k < opts.pool_size; ++k) {
+        sum += 1.0 / std::pow(k + 1.0, opts.zipf_exponent);
+        m_zipf_cdf[k] = sum;
+      }
+      for (auto& value : m_zipf_cdf) {
+        value /= sum;
+      }
+    }
+  }
+
+  unsigned next(std::mt19937_64& generator)
+  {
+    if (m_zipf_cdf.empty()) {
+      return m_uniform(generator);
+    }
+
+    const auto found = std::lower_bound(m_zipf_cdf.begin(), m_zipf_cdf.end(), m_real(generator));
+    return static_cast<unsigned>(
+      std::min<std::ptrdiff_t>(found - m_zipf_cdf.begin(), m_zipf_cdf.size() - 1u));
+  }
+
+private:
+  std::uniform_int_distribution<unsigned> m_uniform;
+  std::uniform_real_distribution<double> m_real{ 0.0, 1.0 };
+  std::vector<double> m_zipf_cdf;
+};
+
+struct thread_result
+{
+  std::vector<uint64_t> latencies_ns;
+  unsigned long long found{ 0u };
+};
+
+void replay(okon_handle* handle, const std::vector<okon::sha1_t>& queries, unsigned batch_size,
+            bool measure, thread_result& result)
+{
+  std::vector<uint8_t> results(batch_size);
+
+  for (std::size_t first = 0u; first < queries.size(); first += batch_size) {
+    const auto count = std::min<std::size_t>(batch_size, queries.size() - first);
+
+    const auto start = steady_clock_t::now();
+    if (count == 1u) {
+      results[0] = okon_handle_exists_binary(handle, queries[first].data()) ==
+        okon_exists_result_exists;
+    } else {
+      okon_exists_batch(handle, queries[first].data(), count, results.data());
+    }
+    const auto end = steady_clock_t::now();
+
+    if (measure) {
+      result.latencies_ns.push_back(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()));
+      result.found += std::count(results.begin(), results.begin() + count, 1u);
+    }
+  }
+}
+
+double percentile(const std::vector<uint64_t>& sorted, double p)
+{
+  const auto index = static_cast<std::size_t>(std::ceil(p * sorted.size()));
+  return static_cast<double>(sorted[std::clamp<std::size_t>(index, 1u, sorted.size()) - 1u]) /
+    1000.0;
+}
+
+// Prints counts of latencies in power of two buckets of nanoseconds.
+void print_histogram(const std::vector<uint64_t>& sorted)
+{
+  std::printf("latency histogram:\n");
+
+  auto it = sorted.begin();
+  for (uint64_t upper = 1u; it != sorted.end(); upper *= 2u) {
+    const auto bucket_end = std::upper_bound(it, sorted.end(), upper);
+    const auto count = bucket_end - it;
+    if (count > 0) {
+      std::printf("  <= %12.3f us: %10td (%6.2f%%)\n", upper / 1000.0, count,
+                  100.0 * static_cast<double>(count) / static_cast<double>(sorted.size()));
+    }
+    it = bucket_end;
+  }
+}
+}
+
+int main(int argc, const char* argv[])
+{
+  const auto opts = parse_options(argc, argv);
+  if (!opts) {
+    return 1;
+  }
+
+  auto path = opts->db_path;
+  if (path.empty()) {
+    const auto prepared = prepare_random_file(*opts);
+    if (!prepared) {
+      return 1;
+    }
+    path = *prepared;
+  }
+
+  auto* handle = okon_open(path.c_str());
+  if (!handle) {
+    std::cerr << "couldn't open " << path << '\n';
+    return 1;
+  }
+
+  std::mt19937_64 generator{ opts->seed };
+  const auto hits = sample_hits(handle, opts->pool_size, generator);
+  if (hits.empty()) {
+    std::cerr << "couldn't sample hashes of the file, it's empty or doesn't store the hashes\n";
+    okon_close(handle);
+    return 1;
+  }
+  const auto misses = sample_misses(handle, opts->pool_size, generator);
+
+  // Every thread gets its own queries, so threads don't share the generators.
+  std::vector<std::vector<okon::sha1_t>> queries(opts->threads);
+  unsigned long long expected_hits{ 0u };
+  {
+    index_sampler sampler{ *opts };
+    std::bernoulli_distribution is_hit{ opts->hit_ratio };
+    for (auto i = 0ull; i < opts->queries_count; ++i) {
+      const auto hit = is_hit(generator);
+      expected_hits += hit;
+      const auto& pool = hit ? hits : misses;
+      queries[i % opts->threads].push_back(pool[sampler.next(generator)]);
+    }
+  }
+
+  std::vector<thread_result> results(opts->threads);
+  std::atomic<unsigned> ready{ 0u };
+  std::atomic<bool> go{ false };
+  std::vector<std::thread> threads;
+
+  for (auto t = 0u; t < opts->threads; ++t) {
+    threads.emplace_back([&, t] {
+      results[t].latencies_ns.reserve(queries[t].size() / opts->batch_size + 1u);
+      for (auto pass = 0u; pass < opts->warmup_passes; ++pass) {
+        replay(handle, queries[t], opts->batch_size, /*measure=*/false, results[t]);
+      }
+
+      ++ready;
+      while (!go.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+
+      replay(handle, queries[t], opts->batch_size, /*measure=*/true, results[t]);
+    });
+  }
+
+  while (ready.load() != opts->threads) {
+    std::this_thread::yield();
+  }
+  const auto start = steady_clock_t::now();
+  go.store(true, std::memory_order_release);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  const auto seconds = std::chrono::duration<double>(steady_clock_t::now() - start).count();
+
+  okon_close(handle);
+
+  std::vector<uint64_t> latencies;
+  unsigned long long found{ 0u };
+  for (const auto& result : results) {
+    latencies.insert(latencies.end(), result.latencies_ns.begin(), result.latencies_ns.end());
+    found += result.found;
+  }
+  if (latencies.empty()) {
+    std::cerr << "no queries\n";
+    return 1;
+  }
+  std::sort(latencies.begin(), latencies.end());
+
+  std::printf("file: %s\n", path.c_str());
+  std::printf("queries: %llu, threads: %u, batch: %u, hit ratio: %.3f, distribution: %s\n",
+              opts->queries_count, opts->threads, opts->batch_size, opts->hit_ratio,
+              opts->query_distribution == distribution::zipf ? "zipf" : "uniform");
+  std::printf("found: %llu, expected: %llu\n", found, expected_hits);
+  std::printf("time: %.3f s, QPS: %.0f\n", seconds,
+              static_cast<double>(opts->queries_count) / seconds);
+  std::printf("latency of %s (us): p50 %.3f, p99 %.3f, p999 %.3f, max %.3f\n",
+              opts->batch_size == 1u ? "a lookup" : "a batch", percentile(latencies, 0.5),
+              percentile(latencies, 0.99), percentile(latencies, 0.999),
+              static_cast<double>(latencies.back()) / 1000.0);
+  print_histogram(latencies);
+
+  return found == expected_hits ? 0 : 1;
+}
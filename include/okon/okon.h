@@ -1,5 +1,17 @@
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
+
+/** Size of the hashes in bytes, set when okon is built: 20 for SHA-1 hashes (the default), 16 for
+ * NTLM ones. Binary hashes passed to and returned from okon are of this size and text ones are of
+ * twice as many hex digits. The size is stored in prepared files, so files of another size can't be
+ * opened. Wherever the functions below say SHA-1, it's NTLM if OKON_KEY_SIZE is 16.
+ */
+#ifndef OKON_KEY_SIZE
+#  define OKON_KEY_SIZE 20
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -11,7 +23,21 @@ enum okon_prepare_result
   okon_prepare_result_could_not_open_intermediate_files, //!< Issue while creating intermediate
                                                          //!< files.
   okon_prepare_result_could_not_open_output,             //!< Issue while creating output file.
-  okon_prepare_result_unspecified_failure                //!< Unspecified failure occurred
+  okon_prepare_result_unspecified_failure,               //!< Unspecified failure occurred
+  okon_prepare_result_could_not_open_prepared_file,      //!< Issue while opening file prepared
+                                                         //!< earlier, e.g. in okon_merge(), or
+                                                         //!< the file doesn't store hashes.
+  okon_prepare_result_counts_not_supported,              //!< Counts were requested for a format
+                                                         //!< that can't store them, i.e. any
+                                                         //!< but okon_format_static_tree and
+                                                         //!< okon_format_flat_sorted.
+  okon_prepare_result_compression_not_supported,         //!< Input is compressed in a way that
+                                                         //!< this build can't decompress.
+  okon_prepare_result_invalid_options,                   //!< Options are out of their ranges,
+                                                         //!< e.g. btree_node_size.
+  okon_prepare_result_could_not_read_input_file          //!< Issue while reading input file,
+                                                         //!< e.g. a disk error or corrupt
+                                                         //!< compressed data.
 };
 
 enum okon_prepare_progress_special_value
@@ -30,14 +56,55 @@ enum okon_prepare_progress_special_value
  */
 typedef void (*okon_prepare_progress_callback_t)(void* user_data, int progress);
 
+enum okon_prepare_phase
+{
+  okon_prepare_phase_parse, //!< Input is parsed and hashes are split between intermediate files.
+  okon_prepare_phase_sort,  //!< Intermediate files are sorted.
+  okon_prepare_phase_write  //!< Sorted hashes are written to the output. Overlaps with sorting.
+};
+
+/** Progress of one phase of the preparation. */
+typedef struct okon_prepare_phase_progress
+{
+  okon_prepare_phase phase;
+
+  /** The progress value from 0 to 100, or okon_prepare_progress_special_value_unknown if the size
+   * of the phase is not known, e.g. while the input is read from a pipe or decompressed. */
+  int progress;
+
+  /** Number of hashes processed in the phase so far. */
+  unsigned long long hashes;
+
+  /** Number of bytes processed in the phase so far: of the input text while parsing, of binary
+   * hashes while sorting and writing. */
+  unsigned long long bytes;
+
+  /** Throughput since the start of the phase. */
+  double hashes_per_second;
+  double bytes_per_second;
+} okon_prepare_phase_progress;
+
+/** Phase progress callback function type.
+ *
+ * @param user_data Pointer to user data. It will be passed in every callback call.
+ * @param progress Progress of the phase. Valid only during the call.
+ */
+typedef void (*okon_prepare_phase_progress_callback_t)(
+  void* user_data, const okon_prepare_phase_progress* progress);
+
 /** Prepares file based on input database.
- * Truncates 00-FF files in @param working_directory.
- * Truncates @param output_processed_file_path file.
- * The function does not delete intermediate files. User needs to do it on their own.
+ * Truncates 00-FF files (and counts file, if counts are stored) in @param working_directory.
+ * Truncates @param output_processed_file_path file and removes its filter, if any.
+ * The function does not delete intermediate files. User needs to do it on their own. They are
+ * reused only to resume a failed preparation, see okon_prepare_options::checkpoint_interval.
  *
- * @param input_db_file_path Path to text file with hashes:count.
+ * @param input_db_file_path Path to text file with hashes:count, or "-" to read the standard input.
+ * Pipes and other files that are not regular files, e.g. /dev/fd/N, are read as a stream. Files
+ * ending with .gz or .xz are decompressed, see okon_prepare_options::input_compression.
  * @param working_directory Directory where intermediate files are going to be created.
- * @param output_processed_file_path Path to file where output data should be written to.
+ * @param output_processed_file_path Path to file where output data should be written to. It's
+ * written in okon_format_btree_v1, readable by all versions of okon, unless the library is built
+ * for keys other than SHA-1 hashes, see OKON_KEY_SIZE. Use okon_prepare_ex() for other formats.
  * @param progress_callback Callback function to report progress. Optional parameter.
  * @param progress_callback_user_data Pointer to user data to be passed to progress callback
  * function. If @param progress_callback is NULL, this parameter is not used.
@@ -47,6 +114,210 @@ okon_prepare_result okon_prepare(const char* input_db_file_path, const char* wor
                                  okon_prepare_progress_callback_t progress_callback,
                                  void* progress_callback_user_data);
 
+enum okon_format
+{
+  okon_format_btree_v1,     //!< The original B-tree layout, readable by all versions of okon.
+                            //!< It stores SHA-1 hashes only, see OKON_KEY_SIZE.
+  okon_format_btree_v2,     //!< B-tree with dense arrays of 8-byte key prefixes in nodes, kept
+                            //!< apart from the rest of keys. Lookups touch fewer cache lines.
+  okon_format_static_tree,  //!< Pointer-free static search tree over the sorted keys. Smaller
+                            //!< than the B-tree and faster to search, but can't be modified.
+  okon_format_flat_sorted,  //!< Sorted keys with a directory of key ranges, searched with
+                            //!< interpolation search. The smallest format, about one read per
+                            //!< lookup on cold storage.
+  okon_format_bloom_filter, //!< Bloom filter of the hashes only, of filter_bits_per_key bits
+                            //!< per hash (12 if it's 0). A fraction of hashes that are not in
+                            //!< the input is reported as existing, see filter_bits_per_key. The
+                            //!< hashes themselves can't be read back, e.g. by okon_range().
+  okon_format_btree_v3,     //!< okon_format_btree_v2 with leaves that don't store pointers. About
+                            //!< a sixth smaller, so more of the tree fits in memory. Merges into
+                            //!< it write the output hashes twice.
+  okon_format_btree_v4      //!< B-tree of 16 KiB nodes that store the common prefix of their
+                            //!< hashes once, packed with as many hashes as fit. Nodes are
+                            //!< searched without decompressing them.
+};
+
+enum okon_input_compression
+{
+  okon_input_compression_detect, //!< Detected based on the extension: .gz or .xz.
+  okon_input_compression_none,   //!< Input is plain text.
+  okon_input_compression_gzip,   //!< Input is a gzip stream. Requires a build with zlib.
+  okon_input_compression_xz      //!< Input is an xz stream. Requires a build with liblzma.
+};
+
+/** Time and work of one phase of the preparation. */
+typedef struct okon_prepare_phase_stats
+{
+  double wall_seconds;
+
+  /** CPU time of all the threads of the process while the phase lasted. Sorting and writing
+   * overlap, so they share it. */
+  double cpu_seconds;
+
+  /** Numbers of hashes and bytes processed in the phase, like in okon_prepare_phase_progress. */
+  uint64_t hashes;
+  uint64_t bytes;
+
+  double hashes_per_second;
+} okon_prepare_phase_stats;
+
+/** Profile of a preparation, e.g. to find out whether it's bound by the input, the disk of the
+ * working directory or the CPU. Filled by okon_prepare_ex() and okon_merge() when they succeed, if
+ * okon_prepare_options::stats is set. */
+typedef struct okon_prepare_stats
+{
+  /** Indexed by okon_prepare_phase. */
+  okon_prepare_phase_stats phases[3];
+
+  /** Of the whole preparation, including writing of the filter. */
+  double wall_seconds;
+  double cpu_seconds;
+
+  /** Bytes of the input text, after decompression. */
+  uint64_t input_bytes_read;
+
+  /** Bytes of hashes that didn't fit okon_prepare_options::memory_budget, written to the
+   * intermediate files and read back to be sorted. */
+  uint64_t intermediate_bytes_written;
+  uint64_t intermediate_bytes_read;
+
+  /** Bytes of the output files: the output, or the shards and their manifest, and filters. */
+  uint64_t output_bytes_written;
+
+  /** Time the thread reading the input waited for a free buffer. If it's long, the parsing is the
+   * bottleneck, e.g. more threads can help. */
+  double reader_stall_seconds;
+
+  /** Time the parsing waited for the input. If it's long, reading of the input is the bottleneck,
+   * e.g. the disk or the decompression. */
+  double parser_stall_seconds;
+
+  /** Time of finishing the output after its last hash, e.g. rebalancing of a B-tree that a file
+   * was merged into, and of writing the filter. */
+  double finalize_seconds;
+} okon_prepare_stats;
+
+/** Options for okon_prepare_ex() function. Initialize them with okon_prepare_options_init(). */
+typedef struct okon_prepare_options
+{
+  /** Callback function to report progress. Optional, can be NULL. */
+  okon_prepare_progress_callback_t progress_callback;
+
+  /** Pointer to user data to be passed to progress callback functions. */
+  void* progress_callback_user_data;
+
+  /** Callback function to report progress and throughput of every phase. Called when the progress
+   * of a phase changes, and at least every 250ms while the phase advances. Callbacks are called
+   * from different threads, but never at the same time. Optional, can be NULL. */
+  okon_prepare_phase_progress_callback_t phase_progress_callback;
+
+  /** Format of the output file. Files in any format can be opened with okon_open() of this
+   * version. okon_prepare_options_init() sets okon_format_btree_v2, which versions of okon before
+   * okon_prepare_ex() can't open. Set okon_format_btree_v1 for files that they read. */
+  okon_format format;
+
+  /** Number of threads used to parse the input and to sort the intermediate files. 0 means the
+   * number of hardware threads. */
+  unsigned threads;
+
+  /** Number of bytes of binary hashes (OKON_KEY_SIZE bytes each) that may be kept in memory
+   * instead of being written to the intermediate files. If all the hashes fit, no intermediate files
+   * are created. Otherwise, only hashes of the intermediate files that didn't fit are written to the
+   * working directory. 0 means that all hashes go through the intermediate files. */
+  unsigned long long memory_budget;
+
+  /** If non-zero, the count of every hash, from its hash:count line, is stored in the output and
+   * can be read with okon_lookup_count(). Counts are a feature of okon_format_static_tree and
+   * okon_format_flat_sorted only, the B-tree formats, including the default one, can't store
+   * them and okon_prepare_result_counts_not_supported is returned for them. Counts are stored in
+   * an array after all the keys, so lookups of presence aren't slower. */
+  int with_counts;
+
+  /** If non-zero, a Bloom filter of about this many bits per hash is written next to the output,
+   * to output_processed_file_path + ".filter". okon_open() uses it automatically, so most lookups
+   * of hashes that are not in the file are answered by the filter alone, in memory. 8 bits per
+   * hash let through about 2.5% of such lookups, 12 bits about 0.5%. 0 means no filter.
+   * With okon_format_bloom_filter, it's the size of the output itself. */
+  unsigned filter_bits_per_key;
+
+  /** Number of bytes of the input file read at once. 0 means 1 MiB. */
+  unsigned input_chunk_size;
+
+  /** Number of chunks of the input file that can be read ahead of the parsing. 0 means twice the
+   * number of threads, but at least four. */
+  unsigned input_buffers_count;
+
+  /** Compression of the input file. The input is decompressed while it's read, so e.g. the
+   * database can be streamed from an archive without writing it to disk first. 7z archives can be
+   * piped from 7z's standard output to "-" input. */
+  okon_input_compression input_compression;
+
+  /** Size in bytes of a node of the B-tree formats, a power of two from 512 to 1 MiB. Nodes are
+   * aligned to it in the file, so a node never straddles e.g. a page if it's the page size. Small
+   * nodes suit random reads from SSDs, e.g. 4096 for NVMe drives, big ones suit HDDs. The order of
+   * the tree is the biggest one whose leaves fit, inner nodes of okon_format_btree_v3 take a few
+   * node sizes. okon_format_btree_v1 files can't store the alignment, so only the order is derived
+   * from it. 0 means the default: order 1024 and unaligned nodes, or aligned 16 KiB nodes for
+   * okon_format_btree_v4. */
+  unsigned btree_node_size;
+
+  /** If greater than 1, the output is split by the first byte of the hashes into this many shards,
+   * at most 256. Every shard is a file prepared in `format`, with its own filter if
+   * filter_bits_per_key is set: output_processed_file_path + ".shard0", ".shard1" and so on. A
+   * small manifest of the shards is written to output_processed_file_path, so okon_open() of it
+   * opens all the shards and routes every lookup to its shard. Shards are found relative to the
+   * manifest, so they can be moved to other disks and replaced by symbolic links, or opened one by
+   * one, e.g. on different machines. Not supported by okon_format_bloom_filter. 0 means a single
+   * output file. */
+  unsigned shards_count;
+
+  /** If non-zero, progress of the preparation is saved to "checkpoint" in the working directory:
+   * every this many bytes of the parsed input, after the parsing and after every shard. If the
+   * preparation fails, e.g. because the working directory got full or the process was killed, the
+   * next preparation of the same, unmodified input file into the same output with the same options
+   * and working directory resumes from the checkpoint. Input parsed before it isn't read again,
+   * and shards written before it aren't written again. Hashes are always written to the
+   * intermediate files then, memory_budget is ignored. The checkpoint is removed when the
+   * preparation succeeds. Inputs that are not regular files, e.g. "-", are never checkpointed.
+   * 0 means no checkpoints. */
+  unsigned long long checkpoint_interval;
+
+  /** If set, a profile of the preparation is stored here when it succeeds. Measuring it is cheap,
+   * hot loops don't read the clock. Optional, can be NULL. */
+  okon_prepare_stats* stats;
+} okon_prepare_options;
+
+/** Initializes @param options with the default values. okon_prepare() uses these values. */
+void okon_prepare_options_init(okon_prepare_options* options);
+
+/** Same as okon_prepare(), but configured by @param options.
+ *
+ * @param options Prepare options. If NULL, the default options are used.
+ */
+okon_prepare_result okon_prepare_ex(const char* input_db_file_path, const char* working_directory,
+                                    const char* output_processed_file_path,
+                                    const okon_prepare_options* options);
+
+/** Prepares file with hashes of a previously prepared file and hashes of a text file, e.g. hashes
+ * added in a newer version of the database. Only @param delta_db_file_path is parsed and sorted,
+ * hashes of @param prepared_file_path are read in order and merged into the output.
+ * Hashes present in both files are written once. If counts are stored, their counts are summed.
+ *
+ * @param prepared_file_path Path to a file prepared by okon_prepare() function, in any format
+ * except okon_format_bloom_filter.
+ * @param delta_db_file_path Path to text file with hashes:count, read like input of okon_prepare().
+ * @param working_directory Directory where intermediate files are going to be created.
+ * @param output_processed_file_path Path to file where output data should be written to. Must be
+ * different from @param prepared_file_path and from its filter, and its filter must be different
+ * from them too, otherwise okon_prepare_result_invalid_options is returned.
+ * @param options Prepare options, the output is written in @param options format. If NULL, the
+ * default options are used.
+ */
+okon_prepare_result okon_merge(const char* prepared_file_path, const char* delta_db_file_path,
+                               const char* working_directory,
+                               const char* output_processed_file_path,
+                               const okon_prepare_options* options);
+
 enum okon_exists_result
 {
   okon_exists_result_doesnt_exist,         //!< Hash was not found.
@@ -69,6 +340,262 @@ okon_exists_result okon_exists_text(const char* sha1, const char* prepared_file_
  */
 okon_exists_result okon_exists_binary(const void* sha1, const char* processed_file_path);
 
+/** Opaque handle to a prepared file. Keeps the file open between lookups.
+ *
+ * Lookups through a handle are thread-safe. okon_close() must not be called while other threads
+ * still use the handle.
+ */
+typedef struct okon_handle okon_handle;
+
+/** Opens a file prepared by okon_prepare() function for multiple lookups.
+ *
+ * @param prepared_file_path Path to a file prepared by okon_prepare() function.
+ * @return Handle to the opened file or NULL if the file could not be opened. The handle needs to
+ * be closed with okon_close().
+ */
+okon_handle* okon_open(const char* prepared_file_path);
+
+/** Called for every tree node visited by the lookups of a handle opened with tracing, see
+ * okon_open_options::trace_callback. Called from the threads doing the lookups, possibly from many
+ * of them at the same time.
+ *
+ * @param user_data okon_open_options::trace_user_data.
+ * @param level Level of the node, 0 being the root.
+ * @param node_pointer Index of the node in the file.
+ * @param is_pinned 1 if the node is pinned in memory (see okon_open_options::pinned_levels), 0 if
+ * it's read from the file.
+ */
+typedef void (*okon_node_trace_callback_t)(void* user_data, unsigned level, uint32_t node_pointer,
+                                           int is_pinned);
+
+/** Options for okon_open_ex() function. Initialize them with okon_open_options_init(). */
+typedef struct okon_open_options
+{
+  /** Number of the upper tree levels (starting from the root) that are loaded into memory while
+   * opening the file. Lookups don't touch the file for nodes on these levels. 0 disables pinning.
+   */
+  unsigned pinned_levels;
+
+  /** Maximum number of bytes used by the pinned levels. Nodes are loaded level by level, till
+   * the budget is exhausted. 0 means no limit.
+   */
+  unsigned long long pinned_bytes_budget;
+
+  /** Number of worker threads used by okon_exists_batch(). 0 means hardware concurrency. Threads
+   * are started on the first batch that is big enough to be split between them.
+   */
+  unsigned threads;
+
+  /** Number of worker threads that answer okon_exists_async() lookups. 0 means two. Threads are
+   * started on the first asynchronous lookup.
+   */
+  unsigned async_threads;
+
+  /** Non-zero enables counters of the lookups, read with okon_handle_stats(). Counting costs a few
+   * atomic additions per visited node and two clock reads per okon_handle_exists_binary() call.
+   */
+  int collect_stats;
+
+  /** If not NULL, called for every tree node visited by the lookups. Enables the counters too.
+   * Only B-trees have nodes, lookups of other formats are counted but not traced.
+   */
+  okon_node_trace_callback_t trace_callback;
+
+  /** Passed to trace_callback. */
+  void* trace_user_data;
+
+  /** Non-zero copies the file, its filter and its shards into memory while opening, instead of
+   * mapping them. Lookups are then plain memory reads that never wait for the disk, and the copy is
+   * backed by huge pages, so they need few TLB entries. The file has to fit in memory, otherwise
+   * it's not opened. Pages are allocated on the NUMA node of the thread calling okon_open_ex(), so
+   * to have a copy local to every node, open a handle per node from a thread running on it and
+   * look up through the local handle.
+   */
+  int resident;
+
+  /** Size of the reserved huge pages (see MAP_HUGETLB in mmap(2)) the resident copy is kept in,
+   * e.g. 2 MiB or 1 GiB, if the system has enough free ones. 0, or if they're not available, means
+   * transparent huge pages. Ignored unless resident is set.
+   */
+  unsigned long long huge_page_size;
+} okon_open_options;
+
+/** Initializes @param options with the default values. okon_open() uses these values. */
+void okon_open_options_init(okon_open_options* options);
+
+/** Opens a file prepared by okon_prepare() function for multiple lookups.
+ *
+ * @param prepared_file_path Path to a file prepared by okon_prepare() function.
+ * @param options Open options. If NULL, the default options are used.
+ * @return Handle to the opened file or NULL if the file could not be opened. The handle needs to
+ * be closed with okon_close().
+ */
+okon_handle* okon_open_ex(const char* prepared_file_path, const okon_open_options* options);
+
+/** Closes a handle opened by okon_open() or okon_open_ex() function.
+ *
+ * @param handle Handle to close. If NULL, the function does nothing.
+ */
+void okon_close(okon_handle* handle);
+
+/** Checks whether given hash exists in a file opened with okon_open().
+ *
+ * @param handle Handle returned by okon_open().
+ * @param sha1 Text based hash. The behavior is undefined if (sha1 + 39) is not accessible.
+ */
+okon_exists_result okon_handle_exists_text(okon_handle* handle, const char* sha1);
+
+/** Checks whether given hash exists in a file opened with okon_open().
+ *
+ * @param handle Handle returned by okon_open().
+ * @param sha1 Binary based hash. The behavior is undefined if ((const uint8_t*)sha1 + 19) is not
+ * accessible.
+ */
+okon_exists_result okon_handle_exists_binary(okon_handle* handle, const void* sha1);
+
+/** Checks whether given hashes exist in a file opened with okon_open().
+ * Lookups are done together: hashes are sorted and the tree is descended level by level, so a node
+ * shared by many hashes is read only once. Big batches are split by key ranges between the handle's
+ * worker threads (see okon_open_options::threads).
+ *
+ * @param handle Handle returned by okon_open().
+ * @param sha1s Array of @param count binary hashes, OKON_KEY_SIZE bytes each.
+ * @param count Number of hashes.
+ * @param results Array of @param count bytes. results[i] is set to 1 if i-th hash exists and to 0
+ * otherwise.
+ */
+void okon_exists_batch(okon_handle* handle, const void* sha1s, size_t count, uint8_t* results);
+
+/** Checks whether SHA-1 of a password exists in a file opened with okon_open(). The password is
+ * hashed by okon, with the SHA extensions of the CPU if it has them, and looked up in the binary
+ * form, so the hash doesn't need to be converted to text and back. If OKON_KEY_SIZE is 16, the NTLM
+ * hash is looked up: MD4 of the password converted from UTF-8 to UTF-16LE.
+ *
+ * @param handle Handle returned by okon_open().
+ * @param password Bytes of the password, as they were hashed for the database, e.g. UTF-8. Doesn't
+ * need to be null-terminated.
+ * @param password_length Number of bytes of @param password.
+ */
+okon_exists_result okon_exists_password(okon_handle* handle, const char* password,
+                                        size_t password_length);
+
+/** Checks whether SHA-1 of given passwords exist in a file opened with okon_open(). Passwords are
+ * hashed, then looked up together like in okon_exists_batch().
+ *
+ * @param handle Handle returned by okon_open().
+ * @param passwords Array of @param count passwords, see okon_exists_password().
+ * @param password_lengths Array of @param count numbers of bytes of the passwords.
+ * @param count Number of passwords.
+ * @param results Array of @param count bytes. results[i] is set to 1 if SHA-1 of i-th password
+ * exists and to 0 otherwise.
+ */
+void okon_exists_passwords_batch(okon_handle* handle, const char* const* passwords,
+                                 const size_t* password_lengths, size_t count, uint8_t* results);
+
+/** Asynchronous lookup callback function type.
+ *
+ * @param user_data Pointer to user data passed to okon_exists_async().
+ * @param result okon_exists_result_exists or okon_exists_result_doesnt_exist.
+ */
+typedef void (*okon_exists_callback_t)(void* user_data, okon_exists_result result);
+
+/** Checks whether given hash exists in a file opened with okon_open(), without waiting for the
+ * result. The lookup is answered by one of the handle's asynchronous workers (see
+ * okon_open_options::async_threads), which calls @param callback. Lookups submitted while the
+ * workers are busy are answered together, like in okon_exists_batch(), so many lookups can be in
+ * flight at once, and a thread waiting for the file blocks only a worker.
+ *
+ * okon_close() waits till callbacks of all the submitted lookups are called. See okon_async.hpp
+ * for a C++20 coroutine interface.
+ *
+ * @param handle Handle returned by okon_open().
+ * @param sha1 Binary based hash, copied before the function returns. The behavior is undefined if
+ * ((const uint8_t*)sha1 + 19) is not accessible.
+ * @param callback Function called with the result, from a worker thread. It may submit more
+ * lookups, but must not close the handle.
+ * @param user_data Pointer passed to @param callback.
+ */
+void okon_exists_async(okon_handle* handle, const void* sha1, okon_exists_callback_t callback,
+                       void* user_data);
+
+/** Number of levels counted by okon_lookup_stats. Deeper levels are counted as the last one. */
+#define OKON_LOOKUP_STATS_LEVELS 16
+
+/** Number of buckets of okon_lookup_stats::latency_histogram. */
+#define OKON_LOOKUP_STATS_LATENCY_BUCKETS 32
+
+/** Counters of the lookups of a handle, filled by okon_handle_stats(). */
+typedef struct okon_lookup_stats
+{
+  /** All lookups, single ones, batched ones and asynchronous ones. */
+  unsigned long long lookups;
+  unsigned long long hits;
+  unsigned long long misses;
+
+  /** Nodes read from the file, per level, 0 being the root. */
+  unsigned long long node_reads[OKON_LOOKUP_STATS_LEVELS];
+
+  /** Nodes found in the pinned levels instead of being read from the file, per level. */
+  unsigned long long pinned_node_reads[OKON_LOOKUP_STATS_LEVELS];
+
+  /** Bytes of the nodes read from the file. */
+  unsigned long long bytes_read;
+
+  /** Latencies of okon_handle_exists_binary(), okon_handle_exists_text() and
+   * okon_exists_password() calls. Bucket i counts calls that took from 2^i to 2^(i+1)
+   * nanoseconds, the first one also the shorter calls and the last one also the longer ones.
+   */
+  unsigned long long latency_histogram[OKON_LOOKUP_STATS_LATENCY_BUCKETS];
+} okon_lookup_stats;
+
+/** Reads the counters of the lookups of a handle opened with okon_open_options::collect_stats or
+ * okon_open_options::trace_callback. Counters are updated concurrently by other threads, so they
+ * may be slightly out of sync with each other.
+ *
+ * @return 1 if @param stats was filled, 0 if the handle doesn't collect the counters.
+ */
+int okon_handle_stats(okon_handle* handle, okon_lookup_stats* stats);
+
+/** Returns number of occurrences of the hash in the breaches, from the hash:count line of the
+ * input, or 0 if the hash is not in @param handle. Files prepared without counts, e.g. all the
+ * B-tree files, give 1 for every hash they contain. The count is read from the array of counts
+ * at the index of the found hash, which is one read more than okon_handle_exists_text().
+ *
+ * @param sha1 Text based hash. The behavior is undefined if (sha1 + 39) is not accessible.
+ */
+uint32_t okon_lookup_count(okon_handle* handle, const char* sha1);
+
+enum okon_range_result
+{
+  okon_range_result_success,        //!< All hashes in the range have been passed to the callback,
+                                    //!< or the callback stopped the query.
+  okon_range_result_invalid_prefix, //!< Prefix is too long or contains non-hex characters.
+  okon_range_result_keys_not_stored //!< File doesn't store the hashes, e.g. it's a Bloom filter.
+};
+
+/** Range query callback function type.
+ *
+ * @param user_data Pointer to user data passed to okon_range().
+ * @param sha1 Binary hash (OKON_KEY_SIZE bytes) from the range. Valid only during the call.
+ * @return Non-zero to get the next hash, 0 to stop the query.
+ */
+typedef int (*okon_range_callback_t)(void* user_data, const void* sha1);
+
+/** Calls @param callback for every hash in @param handle starting with @param prefix, in ascending
+ * order. The first matching hash is found with a single lookup, the next ones are read
+ * sequentially. It's a k-anonymity query, like the range endpoint of the Pwned Passwords API, when
+ * used with a 5 characters long prefix.
+ *
+ * @param prefix Text prefix of the hashes, e.g. "21BD1". Case insensitive. Doesn't need to be null
+ * terminated.
+ * @param prefix_length Number of characters of @param prefix, from 0 to 2 * OKON_KEY_SIZE. With 0,
+ * all the hashes are passed to the callback.
+ * @param callback Function called for every hash in the range.
+ * @param user_data Pointer passed to every @param callback call.
+ */
+okon_range_result okon_range(okon_handle* handle, const char* prefix, size_t prefix_length,
+                             okon_range_callback_t callback, void* user_data);
+
 #ifdef __cplusplus
 }
 #endif
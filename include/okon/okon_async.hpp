@@ -0,0 +1,67 @@
+#pragma once
+
+#include <okon/okon.h>
+
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+
+#  include <coroutine>
+#  include <cstring>
+
+namespace okon {
+/** Awaitable lookup of a hash in a file opened with okon_open(), based on okon_exists_async().
+ *
+ * `co_await okon::exists_async(handle, sha1)` suspends the coroutine till the lookup is answered
+ * and gives its okon_exists_result. The coroutine is resumed on one of the handle's asynchronous
+ * workers, so it should hand itself back to its event loop before doing long work.
+ */
+class exists_awaitable
+{
+public:
+  /** @param sha1 Binary hash, OKON_KEY_SIZE bytes, copied by the constructor. */
+  exists_awaitable(okon_handle* handle, const void* sha1)
+    : m_handle{ handle }
+  {
+    std::memcpy(m_sha1, sha1, sizeof(m_sha1));
+  }
+
+  bool await_ready() const noexcept
+  {
+    return false;
+  }
+
+  void await_suspend(std::coroutine_handle<> coroutine)
+  {
+    m_coroutine = coroutine;
+
+    // The coroutine may be resumed, and this object destroyed, before the call returns.
+    okon_exists_async(m_handle, m_sha1, &exists_awaitable::resume, this);
+  }
+
+  okon_exists_result await_resume() const noexcept
+  {
+    return m_result;
+  }
+
+private:
+  static void resume(void* user_data, okon_exists_result result)
+  {
+    auto* const self = static_cast<exists_awaitable*>(user_data);
+    self->m_result = result;
+    self->m_coroutine.resume();
+  }
+
+private:
+  okon_handle* m_handle;
+  unsigned char m_sha1[OKON_KEY_SIZE];
+  std::coroutine_handle<> m_coroutine;
+  okon_exists_result m_result{ okon_exists_result_doesnt_exist };
+};
+
+/** See exists_awaitable. */
+inline exists_awaitable exists_async(okon_handle* handle, const void* sha1)
+{
+  return exists_awaitable{ handle, sha1 };
+}
+}
+
+#endif
@@ -0,0 +1,87 @@
+#include "async_lookup_queue.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+namespace okon {
+async_lookup_queue::async_lookup_queue(unsigned threads_count, sorted_lookup_t lookup)
+  : m_threads_count{ threads_count == 0u ? 2u : threads_count }
+  , m_lookup{ std::move(lookup) }
+{
+}
+
+async_lookup_queue::~async_lookup_queue()
+{
+  {
+    std::lock_guard lock{ m_mtx };
+    m_stopping = true;
+  }
+  m_cv.notify_all();
+
+  // Workers leave once there's nothing pending.
+  for (auto& thread : m_threads) {
+    thread.join();
+  }
+}
+
+void async_lookup_queue::submit(const sha1_t& sha1, okon_exists_callback_t callback,
+                                void* user_data)
+{
+  {
+    std::lock_guard lock{ m_mtx };
+    if (m_threads.empty()) {
+      m_threads.reserve(m_threads_count);
+      for (auto i = 0u; i < m_threads_count; ++i) {
+        m_threads.emplace_back([this] { worker(); });
+      }
+    }
+
+    m_pending.push_back({ sha1, callback, user_data });
+  }
+  m_cv.notify_one();
+}
+
+void async_lookup_queue::worker()
+{
+  std::vector<lookup_request> requests;
+  std::vector<sha1_t> keys;
+  std::vector<std::size_t> queries;
+  std::vector<uint8_t> results;
+
+  while (true) {
+    {
+      std::unique_lock lock{ m_mtx };
+      m_cv.wait(lock, [this] { return m_stopping || !m_pending.empty(); });
+      if (m_pending.empty()) {
+        return;
+      }
+
+      // The oldest ones are taken, so none waits for longer than the ones submitted after it. The
+      // rest is left to the other workers.
+      const auto count = std::min(m_pending.size(), k_max_batch_size);
+      const auto last = m_pending.begin() + static_cast<std::ptrdiff_t>(count);
+      requests.assign(std::make_move_iterator(m_pending.begin()), std::make_move_iterator(last));
+      m_pending.erase(m_pending.begin(), last);
+    }
+
+    keys.clear();
+    for (const auto& request : requests) {
+      keys.push_back(request.sha1);
+    }
+
+    queries.resize(keys.size());
+    std::iota(queries.begin(), queries.end(), std::size_t{ 0u });
+    std::sort(queries.begin(), queries.end(),
+              [&keys](std::size_t lhs, std::size_t rhs) { return keys[lhs] < keys[rhs]; });
+
+    results.resize(keys.size());
+    m_lookup(keys.data(), queries.data(), queries.size(), results.data());
+
+    for (auto i = 0u; i < requests.size(); ++i) {
+      const auto result = results[i] != 0u ? okon_exists_result_exists
+                                            : okon_exists_result_doesnt_exist;
+      requests[i].callback(requests[i].user_data, result);
+    }
+  }
+}
+}
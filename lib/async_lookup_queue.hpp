@@ -0,0 +1,63 @@
+#pragma once
+
+#include <okon/okon.h>
+
+#include "sha1_utils.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace okon {
+// Answers lookups submitted from any thread on its own worker threads, and reports results
+// through callbacks. Lookups submitted while the workers are busy wait together and are answered
+// as one sorted batch, so a couple of threads keep up with many lookups in flight, and lookups
+// sharing nodes read them once.
+class async_lookup_queue
+{
+public:
+  // Same as batch_query_engine::sorted_lookup_t.
+  using sorted_lookup_t = std::function<void(const sha1_t* keys, const std::size_t* sorted_queries,
+                                             std::size_t count, uint8_t* results)>;
+
+  // At most this many waiting lookups are taken by a worker at once.
+  static constexpr std::size_t k_max_batch_size{ 4096u };
+
+  // `threads_count` equal to 0 means two threads. Threads are started on the first lookup.
+  explicit async_lookup_queue(unsigned threads_count, sorted_lookup_t lookup);
+
+  // Waits till all the submitted lookups are answered.
+  ~async_lookup_queue();
+
+  async_lookup_queue(const async_lookup_queue&) = delete;
+  async_lookup_queue& operator=(const async_lookup_queue&) = delete;
+
+  // `callback` is called from one of the worker threads, and may submit more lookups.
+  void submit(const sha1_t& sha1, okon_exists_callback_t callback, void* user_data);
+
+private:
+  struct lookup_request
+  {
+    sha1_t sha1;
+    okon_exists_callback_t callback;
+    void* user_data;
+  };
+
+  void worker();
+
+private:
+  unsigned m_threads_count;
+  sorted_lookup_t m_lookup;
+
+  std::mutex m_mtx;
+  std::condition_variable m_cv;
+  // Oldest lookups first, they're answered in the order of submitting.
+  std::deque<lookup_request> m_pending;
+  std::vector<std::thread> m_threads;
+  bool m_stopping{ false };
+};
+}
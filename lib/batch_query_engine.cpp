@@ -0,0 +1,75 @@
+#include "batch_query_engine.hpp"
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <vector>
+
+namespace {
+constexpr auto k_min_queries_per_thread{ 4096u };
+}
+
+namespace okon {
+batch_query_engine::batch_query_engine(unsigned threads_count)
+  : m_threads_count{ resolve_threads_count(threads_count) }
+{
+}
+
+void batch_query_engine::run(const sha1_t* keys, std::size_t count, uint8_t* results,
+                             const sorted_lookup_t& lookup)
+{
+  const auto sort_queries = [keys](std::vector<std::size_t>& queries) {
+    std::sort(std::begin(queries), std::end(queries),
+              [keys](std::size_t lhs, std::size_t rhs) { return keys[lhs] < keys[rhs]; });
+  };
+
+  const auto chunks_count =
+    std::min<std::size_t>(m_threads_count, count / k_min_queries_per_thread);
+
+  if (chunks_count <= 1u) {
+    std::vector<std::size_t> queries(count);
+    std::iota(std::begin(queries), std::end(queries), std::size_t{ 0u });
+    sort_queries(queries);
+    lookup(keys, queries.data(), queries.size(), results);
+    return;
+  }
+
+  // SHA-1 values are uniformly distributed, so ranges of the first byte give balanced chunks,
+  // disjoint in the key space.
+  std::array<std::size_t, 256u> first_byte_histogram{};
+  for (std::size_t i = 0u; i < count; ++i) {
+    ++first_byte_histogram[keys[i][0]];
+  }
+
+  std::array<unsigned, 256u> chunk_of_first_byte{};
+  std::vector<std::size_t> chunk_sizes(chunks_count, 0u);
+  std::size_t accumulated{ 0u };
+  for (auto byte = 0u; byte < 256u; ++byte) {
+    const auto chunk = std::min<std::size_t>(accumulated * chunks_count / count, chunks_count - 1u);
+    chunk_of_first_byte[byte] = static_cast<unsigned>(chunk);
+    chunk_sizes[chunk] += first_byte_histogram[byte];
+    accumulated += first_byte_histogram[byte];
+  }
+
+  std::vector<std::vector<std::size_t>> chunks(chunks_count);
+  for (auto i = 0u; i < chunks_count; ++i) {
+    chunks[i].reserve(chunk_sizes[i]);
+  }
+  for (std::size_t i = 0u; i < count; ++i) {
+    chunks[chunk_of_first_byte[keys[i][0]]].push_back(i);
+  }
+
+  pool().parallel_for(chunks_count, [&](std::size_t chunk_index) {
+    auto& queries = chunks[chunk_index];
+    sort_queries(queries);
+    lookup(keys, queries.data(), queries.size(), results);
+  });
+}
+
+thread_pool& batch_query_engine::pool()
+{
+  std::call_once(m_pool_created,
+                 [this] { m_pool = std::make_unique<thread_pool>(m_threads_count); });
+  return *m_pool;
+}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "sha1_utils.hpp"
+#include "thread_pool.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace okon {
+// Splits a batch of lookups into ranges of the key space and runs them on a worker pool. Every
+// worker sorts its own range and passes it to the sorted lookup function, so queries sharing
+// subtrees stay on the same thread.
+class batch_query_engine
+{
+public:
+  // Looks up keys[sorted_queries[0]], ..., keys[sorted_queries[count - 1]]. Queries are sorted by
+  // their keys. Result of keys[q] has to be written to results[q].
+  using sorted_lookup_t = std::function<void(const sha1_t* keys, const std::size_t* sorted_queries,
+                                             std::size_t count, uint8_t* results)>;
+
+  // `threads_count` equal to 0 means hardware concurrency. The worker pool is created lazily, on
+  // the first batch big enough to be split.
+  explicit batch_query_engine(unsigned threads_count);
+
+  void run(const sha1_t* keys, std::size_t count, uint8_t* results,
+           const sorted_lookup_t& lookup);
+
+private:
+  thread_pool& pool();
+
+private:
+  unsigned m_threads_count;
+  std::once_flag m_pool_created;
+  std::unique_ptr<thread_pool> m_pool;
+};
+}
@@ -0,0 +1,173 @@
+#include "blocked_bloom_filter.hpp"
+
+#include "sha1_search.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace okon {
+namespace {
+constexpr auto k_block_words{ blocked_bloom_filter::k_block_size / sizeof(uint64_t) };
+constexpr auto k_bit_index_bits{ 9u };
+constexpr uint32_t k_max_bits_per_block_key{ 16u };
+
+static_assert(blocked_bloom_filter::k_block_bits == 1u << k_bit_index_bits);
+
+// High 64 bits of `value` * `range`, that is `value` scaled from [0, 2^64) to [0, range).
+uint64_t scale(uint64_t value, uint64_t range)
+{
+#if defined(__SIZEOF_INT128__)
+  return static_cast<uint64_t>((static_cast<unsigned __int128>(value) * range) >> 64u);
+#else
+  const auto value_high = value >> 32u;
+  const auto value_low = value & 0xFFFFFFFFu;
+  const auto range_high = range >> 32u;
+  const auto range_low = range & 0xFFFFFFFFu;
+
+  const auto low_low = value_low * range_low;
+  const auto high_low = value_high * range_low;
+  const auto low_high = value_low * range_high;
+  const auto middle = (low_low >> 32u) + (high_low & 0xFFFFFFFFu) + (low_high & 0xFFFFFFFFu);
+  return value_high * range_high + (high_low >> 32u) + (low_high >> 32u) + (middle >> 32u);
+#endif
+}
+
+uint64_t block_index(const sha1_t& sha1, uint64_t blocks_count)
+{
+  return scale(details::sha1_prefix(sha1), blocks_count);
+}
+
+// Calls `f` with the index of every bit of `sha1` in its block. Bits are generated by double
+// hashing from the last twelve bytes of the key. Shorter keys have only eight bytes that don't
+// select the block, so the step of the hashing is taken from the bytes selecting it. Their low bits
+// hardly affect the block.
+template <typename F>
+void for_each_bit(const sha1_t& sha1, uint32_t bits_per_block_key, F&& f)
+{
+  uint64_t first;
+  uint64_t second;
+  std::memcpy(&first, sha1.data() + 8u, sizeof(first));
+  if constexpr (sizeof(sha1_t) >= 8u + 12u) {
+    std::memcpy(&second, sha1.data() + 12u, sizeof(second));
+  } else {
+    std::memcpy(&second, sha1.data(), sizeof(second));
+  }
+  second |= 1u;
+
+  for (auto i = 0u; i < bits_per_block_key; ++i) {
+    f(static_cast<uint32_t>(first >> (64u - k_bit_index_bits)));
+    first += second;
+  }
+}
+
+template <typename T>
+T read_value(const uint8_t*& in)
+{
+  T value;
+  std::memcpy(&value, in, sizeof(value));
+  in += sizeof(value);
+  return value;
+}
+}
+
+std::optional<blocked_bloom_filter> blocked_bloom_filter::from_memory(const uint8_t* data,
+                                                                      uint64_t size)
+{
+  if (data == nullptr || size < k_extended_header_size) {
+    return std::nullopt;
+  }
+
+  const auto* in = data;
+  const auto marker = read_value<uint32_t>(in);
+  const auto format = read_value<uint32_t>(in);
+  if (marker != k_extended_header_marker ||
+      format != static_cast<uint32_t>(file_format::blocked_bloom_filter) ||
+      read_key_size(data) != k_key_size) {
+    return std::nullopt;
+  }
+
+  blocked_bloom_filter filter;
+  filter.m_blocks_count = read_value<uint64_t>(in);
+  filter.m_bits_per_block_key = read_value<uint32_t>(in);
+  read_value<uint32_t>(in);
+  filter.m_keys_count = read_value<uint64_t>(in);
+  filter.m_prepared_file_size = read_value<uint64_t>(in);
+  filter.m_blocks = data + k_extended_header_size;
+
+  if (filter.m_blocks_count == 0u ||
+      size - k_extended_header_size < filter.m_blocks_count * k_block_size) {
+    return std::nullopt;
+  }
+
+  return filter;
+}
+
+bool blocked_bloom_filter::may_contain(const sha1_t& sha1) const
+{
+  const auto* block = m_blocks + block_index(sha1, m_blocks_count) * k_block_size;
+
+  auto all_set = true;
+  for_each_bit(sha1, m_bits_per_block_key, [block, &all_set](uint32_t bit) {
+    uint64_t word;
+    std::memcpy(&word, block + (bit / 64u) * sizeof(word), sizeof(word));
+    all_set = all_set && (word & (uint64_t{ 1u } << (bit % 64u))) != 0u;
+  });
+
+  return all_set;
+}
+
+uint64_t blocked_bloom_filter::keys_count() const
+{
+  return m_keys_count;
+}
+
+uint64_t blocked_bloom_filter::prepared_file_size() const
+{
+  return m_prepared_file_size;
+}
+
+blocked_bloom_filter_builder::blocked_bloom_filter_builder(uint64_t keys_count,
+                                                           uint32_t bits_per_key,
+                                                           uint64_t prepared_file_size)
+  : m_prepared_file_size{ prepared_file_size }
+  , m_blocks_count{ std::max<uint64_t>(
+      1u, (keys_count * bits_per_key + blocked_bloom_filter::k_block_bits - 1u) /
+        blocked_bloom_filter::k_block_bits) }
+  , m_bits_per_block_key{ std::clamp<uint32_t>(
+      static_cast<uint32_t>(std::lround(bits_per_key * std::log(2.0))), 1u,
+      k_max_bits_per_block_key) }
+  , m_blocks(m_blocks_count * k_block_words, 0u)
+{
+}
+
+void blocked_bloom_filter_builder::add(const sha1_t& sha1)
+{
+  auto* const block = m_blocks.data() + block_index(sha1, m_blocks_count) * k_block_words;
+  for_each_bit(sha1, m_bits_per_block_key,
+               [block](uint32_t bit) { block[bit / 64u] |= uint64_t{ 1u } << (bit % 64u); });
+
+  ++m_keys_count;
+}
+
+std::vector<uint8_t> blocked_bloom_filter_builder::header() const
+{
+  std::vector<uint8_t> header(k_extended_header_size, uint8_t{ 0u });
+  auto* out = header.data();
+
+  const auto append = [&out](const auto& value) {
+    std::memcpy(out, &value, sizeof(value));
+    out += sizeof(value);
+  };
+
+  append(k_extended_header_marker);
+  append(static_cast<uint32_t>(file_format::blocked_bloom_filter));
+  append(m_blocks_count);
+  append(m_bits_per_block_key);
+  append(uint32_t{ 0u });
+  append(m_keys_count);
+  append(m_prepared_file_size);
+  write_key_size(header.data(), k_key_size);
+
+  return header;
+}
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "file_format.hpp"
+#include "sha1_utils.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace okon {
+// Bloom filter split into blocks of one cache line. All bits of a key are set in one block, so a
+// lookup touches a single cache line. SHA-1 values are uniformly distributed, so bytes of the key
+// are used as the hashes: the first eight bytes select the block, the rest select bits inside it.
+// Because the block is selected by the leading bytes of the key, keys inserted in ascending order
+// fill the blocks in order too.
+//
+// File layout:
+// header | blocks[blocks_count]
+// header: k_extended_header_marker | file_format::blocked_bloom_filter | blocks_count (64-bit) |
+//         bits_per_block_key | zeros (32-bit) | keys_count (64-bit) | prepared_file_size (64-bit) |
+//         zeros till key_size | key_size (32-bit)
+// bits_per_block_key: number of bits set in a block for every key.
+// prepared_file_size: size of the prepared file the filter has been built for, 0 if the filter is
+//                     a standalone file.
+class blocked_bloom_filter
+{
+public:
+  static constexpr uint64_t k_block_size{ 64u };
+  static constexpr uint32_t k_block_bits{ k_block_size * 8u };
+
+  // Returns std::nullopt if `data` doesn't contain a valid filter.
+  static std::optional<blocked_bloom_filter> from_memory(const uint8_t* data, uint64_t size);
+
+  // False means that `sha1` hasn't been added to the filter. True means it probably has been.
+  bool may_contain(const sha1_t& sha1) const;
+
+  uint64_t keys_count() const;
+  uint64_t prepared_file_size() const;
+
+private:
+  blocked_bloom_filter() = default;
+
+private:
+  const uint8_t* m_blocks{ nullptr };
+  uint64_t m_blocks_count{ 0u };
+  uint32_t m_bits_per_block_key{ 0u };
+  uint64_t m_keys_count{ 0u };
+  uint64_t m_prepared_file_size{ 0u };
+};
+
+// Builds a blocked_bloom_filter in memory. It takes about `bits_per_key` bits per key. With 8 bits
+// per key every 40th missing key is reported as present, with 12 bits every 200th one.
+class blocked_bloom_filter_builder
+{
+public:
+  explicit blocked_bloom_filter_builder(uint64_t keys_count, uint32_t bits_per_key,
+                                        uint64_t prepared_file_size = 0u);
+
+  void add(const sha1_t& sha1);
+
+  template <typename DataStorage>
+  void write(DataStorage& storage) const;
+
+private:
+  std::vector<uint8_t> header() const;
+
+private:
+  uint64_t m_keys_count{ 0u };
+  uint64_t m_prepared_file_size;
+  uint64_t m_blocks_count;
+  uint32_t m_bits_per_block_key;
+  std::vector<uint64_t> m_blocks;
+};
+
+// Path of the filter of a prepared file, that is used automatically by okon_open().
+inline std::string filter_file_path(std::string_view prepared_file_path)
+{
+  return std::string{ prepared_file_path } + ".filter";
+}
+
+template <typename DataStorage>
+void blocked_bloom_filter_builder::write(DataStorage& storage) const
+{
+  const auto header_bytes = header();
+  storage.seek_out(0u);
+  storage.write(header_bytes.data(), header_bytes.size());
+  storage.write(m_blocks.data(), m_blocks.size() * sizeof(uint64_t));
+}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "blocked_bloom_filter.hpp"
+#include "sha1_utils.hpp"
+
+namespace okon {
+// Writes keys as a standalone blocked_bloom_filter. The filter is sized up front, so the number of
+// keys has to be known. It might be greater than the number of inserted keys, then the filter has
+// a lower false positive rate than `bits_per_key` gives.
+template <typename DataStorage>
+class blocked_bloom_filter_writer
+{
+public:
+  explicit blocked_bloom_filter_writer(DataStorage& storage, uint64_t keys_count,
+                                       uint32_t bits_per_key)
+    : m_storage{ storage }
+    , m_builder{ keys_count, bits_per_key }
+  {
+  }
+
+  void insert_sorted(const sha1_t& sha1)
+  {
+    m_builder.add(sha1);
+  }
+
+  void finalize_inserting()
+  {
+    m_builder.write(m_storage);
+  }
+
+private:
+  DataStorage& m_storage;
+  blocked_bloom_filter_builder m_builder;
+};
+}
@@ -1,9 +1,21 @@
 #pragma once
 
 #include "btree_base.hpp"
+#include "btree_fixed_order_node.hpp"
 #include "btree_node.hpp"
+#include "btree_pinned_nodes.hpp"
+#include "lookup_stats.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <numeric>
+#include <vector>
 
 namespace okon {
+template <typename DataStorage>
+class btree_keys_reader;
+
 template <typename DataStorage>
 class btree : public btree_base<DataStorage>
 {
@@ -12,44 +24,290 @@ public:
 
   bool contains(const sha1_t& sha1) const;
 
+  // Looks up `count` keys at once. results[i] is set to 1 if keys[i] is found, 0 otherwise.
+  // Keys are descended level by level in sorted order, so every node is read at most once.
+  void contains_batch(const sha1_t* keys, std::size_t count, uint8_t* results) const;
+
+  // Same as contains_batch(), but looks up keys[sorted_queries[i]] for i in [0, count). The queries
+  // have to be sorted by their keys. Safe to call concurrently if the storage has direct access.
+  void contains_sorted_batch(const sha1_t* keys, const std::size_t* sorted_queries,
+                             std::size_t count, uint8_t* results) const;
+
+  // Copies nodes of the upper `levels` levels into memory, root first, till `bytes_budget` is
+  // exhausted. Lookups read pinned nodes from memory instead of the storage.
+  void pin_levels(unsigned levels,
+                  uint64_t bytes_budget = std::numeric_limits<uint64_t>::max());
+  uint64_t pinned_size_in_bytes() const;
+
+  // Lookups report the nodes they visit to `stats`, if it's not nullptr. `stats` has to outlive
+  // the lookups.
+  void observe(lookup_stats* stats);
+
 private:
-  bool contains(const btree_node& node, const sha1_t& sha1) const;
-  btree_node read_root() const;
+  friend class btree_keys_reader<DataStorage>;
+
+  btree_node_view node_view(btree_node::pointer_t ptr) const;
+
+  // contains() for trees of btree_fixed_order_node, without the stats.
+  template <btree_node::order_t Order>
+  bool contains_in_fixed_order(const sha1_t& sha1) const;
+
+  // Selects contains_in_fixed_order() of the tree's order, if it's one of `Orders`.
+  template <btree_node::order_t... Orders>
+  void select_fixed_order_contains();
+
+  // Same as node_view(), for lookups. The node is on `level`, 0 being the root.
+  btree_node_view visit_node(btree_node::pointer_t ptr, unsigned level) const;
+
+  // Asks the storage to read the nodes ahead, all at once.
+  void will_need(const std::vector<btree_node::pointer_t>& ptrs) const;
+
+private:
+  btree_pinned_nodes m_pinned;
+  lookup_stats* m_stats{ nullptr };
+
+  using contains_t = bool (btree::*)(const sha1_t&) const;
+  contains_t m_fixed_order_contains{ nullptr };
 };
 
 template <typename DataStorage>
 btree<DataStorage>::btree(DataStorage& storage)
   : btree_base<DataStorage>{ storage }
 {
+  // The default order and the orders of 4 KiB nodes of v2 and v3 of SHA-1 keys, see
+  // btree_node_layout::max_order_for_size(). Other trees use the generic lookups.
+  const auto version = this->version();
+  if (version == btree_format_version::v2 || version == btree_format_version::v3) {
+    select_fixed_order_contains<64u, 170u, 204u, 256u, 1024u>();
+  }
 }
 
 template <typename DataStorage>
 bool btree<DataStorage>::contains(const sha1_t& sha1) const
 {
-  const auto node = read_root();
-  return contains(node, sha1);
+  if (m_fixed_order_contains && !m_stats) {
+    return (this->*m_fixed_order_contains)(sha1);
+  }
+
+  auto level = 0u;
+  auto node = visit_node(this->root_ptr(), level);
+
+  while (true) {
+    const auto place = node.place_for(sha1);
+    if (place < node.keys_count() && node.key(place) == sha1) {
+      return true;
+    }
+
+    if (node.is_leaf()) {
+      return false;
+    }
+
+    node = visit_node(node.pointer(place), ++level);
+  }
+}
+
+template <typename DataStorage>
+void btree<DataStorage>::contains_batch(const sha1_t* keys, std::size_t count,
+                                        uint8_t* results) const
+{
+  std::vector<std::size_t> queries(count);
+  std::iota(std::begin(queries), std::end(queries), std::size_t{ 0u });
+  std::sort(std::begin(queries), std::end(queries),
+            [keys](std::size_t lhs, std::size_t rhs) { return keys[lhs] < keys[rhs]; });
+
+  contains_sorted_batch(keys, queries.data(), queries.size(), results);
+}
+
+template <typename DataStorage>
+void btree<DataStorage>::contains_sorted_batch(const sha1_t* keys,
+                                               const std::size_t* sorted_queries,
+                                               std::size_t count, uint8_t* results) const
+{
+  struct node_queries
+  {
+    btree_node::pointer_t node_ptr;
+    std::size_t begin;
+    std::size_t end;
+  };
+
+  std::vector<std::size_t> queries(sorted_queries, sorted_queries + count);
+  std::vector<node_queries> level{ { this->root_ptr(), 0u, count } };
+  std::vector<node_queries> next_level;
+  std::vector<std::size_t> next_queries;
+  next_queries.reserve(count);
+
+  for (auto depth = 0u; !level.empty(); ++depth) {
+    next_level.clear();
+    next_queries.clear();
+
+    for (const auto& [node_ptr, begin, end] : level) {
+      const auto node = visit_node(node_ptr, depth);
+
+      for (auto i = begin; i < end; ++i) {
+        const auto query = queries[i];
+        const auto& key = keys[query];
+
+        const auto place = node.place_for(key);
+        if (place < node.keys_count() && node.key(place) == key) {
+          results[query] = 1u;
+          continue;
+        }
+
+        if (node.is_leaf()) {
+          results[query] = 0u;
+          continue;
+        }
+
+        // Queries are sorted, so the ones going to the same child are next to each other.
+        const auto child_ptr = node.pointer(place);
+        if (next_level.empty() || next_level.back().node_ptr != child_ptr) {
+          next_level.push_back({ child_ptr, next_queries.size(), next_queries.size() });
+
+          // The child is fetched while the rest of the level is searched. Without direct access,
+          // reading the child would invalidate the current node.
+          if constexpr (storage_reader<DataStorage>::has_direct_access()) {
+            const auto child = node_view(child_ptr);
+            child.layout().prefetch(child.data());
+          }
+        }
+
+        next_queries.push_back(query);
+        ++next_level.back().end;
+      }
+    }
+
+    std::swap(level, next_level);
+    std::swap(queries, next_queries);
+  }
+}
+
+template <typename DataStorage>
+void btree<DataStorage>::pin_levels(unsigned levels, uint64_t bytes_budget)
+{
+  const auto node_size = this->layout().size();
+  btree_pinned_nodes pinned{ node_size };
+  uint64_t pinned_bytes{ 0u };
+
+  std::vector<btree_node::pointer_t> current_level{ this->root_ptr() };
+  std::vector<btree_node::pointer_t> next_level;
+
+  for (auto level = 0u; level < levels && !current_level.empty(); ++level) {
+    next_level.clear();
+    will_need(current_level);
+
+    for (const auto ptr : current_level) {
+      if (pinned_bytes + node_size > bytes_budget) {
+        break;
+      }
+
+      const auto node = this->read_node_view(ptr);
+      pinned.add(ptr, node.data(), node.layout().size());
+      pinned_bytes += node_size;
+
+      if (!node.is_leaf()) {
+        for (auto i = 0u; i <= node.keys_count(); ++i) {
+          next_level.push_back(node.pointer(i));
+        }
+      }
+    }
+
+    std::swap(current_level, next_level);
+  }
+
+  pinned.finalize();
+  m_pinned = std::move(pinned);
+}
+
+template <typename DataStorage>
+uint64_t btree<DataStorage>::pinned_size_in_bytes() const
+{
+  return m_pinned.size_in_bytes();
+}
+
+template <typename DataStorage>
+void btree<DataStorage>::observe(lookup_stats* stats)
+{
+  m_stats = stats;
+}
+
+template <typename DataStorage>
+btree_node_view btree<DataStorage>::node_view(btree_node::pointer_t ptr) const
+{
+  if (const auto pinned = m_pinned.find(ptr)) {
+    return btree_node_view{ pinned, this->layout_of(ptr) };
+  }
+
+  return this->read_node_view(ptr);
 }
 
 template <typename DataStorage>
-bool btree<DataStorage>::contains(const btree_node& node, const sha1_t& sha1) const
+template <btree_node::order_t Order>
+bool btree<DataStorage>::contains_in_fixed_order(const sha1_t& sha1) const
 {
-  if (node.contains(sha1)) {
-    return true;
+  auto ptr = this->root_ptr();
+
+  while (true) {
+    const btree_fixed_order_node<Order> node{ node_view(ptr).data() };
+
+    bool found{ false };
+    const auto place = node.place_for(sha1, found);
+    if (found) {
+      return true;
+    }
+
+    if (node.is_leaf()) {
+      return false;
+    }
+
+    ptr = node.pointer(place);
   }
+}
 
-  if (node.is_leaf) {
-    return false;
+template <typename DataStorage>
+template <btree_node::order_t... Orders>
+void btree<DataStorage>::select_fixed_order_contains()
+{
+  const auto select = [this](btree_node::order_t order, contains_t contains) {
+    if (this->order() == order) {
+      m_fixed_order_contains = contains;
+    }
+  };
+
+  (select(Orders, &btree::contains_in_fixed_order<Orders>), ...);
+}
+
+template <typename DataStorage>
+btree_node_view btree<DataStorage>::visit_node(btree_node::pointer_t ptr, unsigned level) const
+{
+  if (!m_stats) {
+    return node_view(ptr);
+  }
+
+  const auto& layout = this->layout_of(ptr);
+  if (const auto pinned = m_pinned.find(ptr)) {
+    m_stats->add_node_read(level, ptr, /*is_pinned=*/true, layout.size());
+    return btree_node_view{ pinned, layout };
   }
 
-  const auto place = node.place_for(sha1);
-  const auto next_node_ptr = node.pointers[place];
-  const auto next_node = this->read_node(next_node_ptr);
-  return contains(next_node, sha1);
+  m_stats->add_node_read(level, ptr, /*is_pinned=*/false, layout.size());
+  return this->read_node_view(ptr);
 }
 
 template <typename DataStorage>
-btree_node btree<DataStorage>::read_root() const
+void btree<DataStorage>::will_need(const std::vector<btree_node::pointer_t>& ptrs) const
 {
-  return this->read_node(this->root_ptr());
+  // Nodes of a level are usually next to each other, so neighbouring ones are advised together.
+  uint64_t begin{ 0u };
+  uint64_t end{ 0u };
+  for (const auto ptr : ptrs) {
+    const auto offset = this->node_offset(ptr);
+    if (offset != end) {
+      this->reader().advise(begin, end - begin, access_pattern::will_need);
+      begin = offset;
+    }
+    end = offset + this->node_stride(ptr);
+  }
+
+  this->reader().advise(begin, end - begin, access_pattern::will_need);
 }
 }
@@ -1,16 +1,36 @@
 #pragma once
 
 #include "btree_node.hpp"
+#include "btree_node_layout.hpp"
+#include "btree_node_view.hpp"
+#include "file_format.hpp"
+#include "storage_reader.hpp"
 
+#include <algorithm>
+#include <cassert>
 #include <cmath>
+#include <cstring>
+#include <vector>
 
 namespace okon {
-
+// File header (see file_format.hpp):
+// v1: order | root_ptr
+// v2, v4: k_extended_header_marker | version | order | root_ptr | 0 | node_alignment | zeros till
+//         key_size | key_size (32-bit)
+// v3: k_extended_header_marker | version | order | root_ptr | first_leaf_ptr | node_alignment |
+//     zeros till key_size | key_size (32-bit)
+// In v3, nodes of pointers less than first_leaf_ptr are inner nodes, the rest are leaves.
+// If node_alignment is not 0, the tree starts at a multiple of it, right after the header, and
+// every node is padded to a multiple of it. So, e.g. nodes of the page size don't straddle pages.
+// v1 files can't store it, their nodes are never padded. key_size is 0 for SHA-1 keys, v1 files
+// can store SHA-1 keys only.
 template <typename DataStorage>
 class btree_base
 {
 public:
-  explicit btree_base(DataStorage& storage, btree_node::order_t order);
+  explicit btree_base(DataStorage& storage, btree_node::order_t order,
+                      btree_format_version version = btree_format_version::v1,
+                      uint32_t node_alignment = 0u);
   explicit btree_base(DataStorage& storage);
 
 protected:
@@ -18,96 +38,260 @@ protected:
                       btree_node::pointer_t root_ptr);
 
   btree_node read_node(btree_node::pointer_t ptr) const;
+  // Same as above, but reads into an existing node of the tree's order, reusing its buffers.
+  void read_node(btree_node::pointer_t ptr, btree_node& node) const;
+  btree_node_view read_node_view(btree_node::pointer_t ptr) const;
+  const storage_reader<DataStorage>& reader() const;
   void write_node(const btree_node& node) const;
 
   void set_root_ptr(btree_node::pointer_t ptr);
   btree_node::pointer_t root_ptr() const;
-  constexpr uint64_t tree_offset() const;
+
+  // Only formats with compact leaves store it. Has to be set before the first leaf is written.
+  void set_first_leaf_ptr(btree_node::pointer_t ptr);
+  bool has_compact_leaves() const;
+
+  uint64_t tree_offset() const;
   uint64_t node_offset(btree_node::pointer_t ptr) const;
+
+  // Bytes that the node takes in the storage, its size and the padding.
+  uint64_t node_stride(btree_node::pointer_t ptr) const;
   btree_node::order_t order() const;
+  btree_format_version version() const;
+
+  // Layout of the inner nodes. Nodes of other layouts are not bigger.
+  const btree_node_layout& layout() const;
+  const btree_node_layout& layout_of(btree_node::pointer_t ptr) const;
 
   unsigned expected_min_number_of_keys(const btree_node& node) const;
 
+private:
+  uint64_t root_ptr_offset() const;
+  uint64_t first_leaf_ptr_offset() const;
+  uint64_t node_alignment_offset() const;
+  uint64_t aligned(uint64_t size) const;
+
+  static std::vector<uint8_t> empty_leaf(const btree_node_layout& layout,
+                                         const btree_node_layout& leaf_layout);
+
 private:
   DataStorage& m_storage;
   btree_node::order_t m_order{};
   btree_node::pointer_t m_root_ptr{ 0u };
+  btree_node::pointer_t m_first_leaf_ptr{ 0u };
+  btree_format_version m_version{ btree_format_version::v1 };
+  uint32_t m_node_alignment{ 0u };
+  btree_node_layout m_layout;
+  btree_node_layout m_leaf_layout;
+  storage_reader<DataStorage> m_reader;
+
+  // Used to encode nodes.
+  mutable std::vector<uint8_t> m_node_buffer;
+
+  // Empty leaf in every layout of the tree, viewed instead of nodes past the end of the storage.
+  std::vector<uint8_t> m_empty_leaf;
 };
 
 template <typename DataStorage>
-btree_base<DataStorage>::btree_base(DataStorage& storage, btree_node::order_t order)
+btree_base<DataStorage>::btree_base(DataStorage& storage, btree_node::order_t order,
+                                    btree_format_version version, uint32_t node_alignment)
   : m_storage{ storage }
   , m_order{ order }
+  , m_version{ version }
+  , m_node_alignment{ node_alignment }
+  , m_layout{ version, order }
+  , m_leaf_layout{ version, order, /*is_leaf_layout=*/true }
+  , m_reader{ storage }
+  , m_empty_leaf{ empty_leaf(m_layout, m_leaf_layout) }
 {
   m_storage.seek_out(0u);
-  m_storage.write(&m_order, sizeof(m_order));
+
+  if (m_version == btree_format_version::v1) {
+    assert(m_node_alignment == 0u && "v1 nodes can't be aligned");
+    assert(k_key_size == k_sha1_key_size && "v1 files can't store the key size");
+    m_storage.write(&m_order, sizeof(m_order));
+    return;
+  }
+
+  std::vector<uint8_t> header(k_extended_header_size, 0u);
+  const uint32_t fields[] = { k_extended_header_marker, static_cast<uint32_t>(m_version), m_order,
+                              m_root_ptr, m_first_leaf_ptr, m_node_alignment };
+  std::memcpy(header.data(), fields, sizeof(fields));
+  write_key_size(header.data(), k_key_size);
+  m_storage.write(header.data(), header.size());
 }
 
 template <typename DataStorage>
 btree_base<DataStorage>::btree_base(DataStorage& storage)
   : m_storage{ storage }
+  , m_layout{ btree_format_version::v1, 0u }
+  , m_leaf_layout{ btree_format_version::v1, 0u }
+  , m_reader{ storage }
 {
   m_storage.seek_in(0u);
   m_storage.read(&m_order, sizeof(m_order));
+
+  if (m_order == k_extended_header_marker) {
+    uint32_t version{};
+    m_storage.read(&version, sizeof(version));
+    m_storage.read(&m_order, sizeof(m_order));
+    m_version = static_cast<btree_format_version>(version);
+  }
+
   m_storage.read(&m_root_ptr, sizeof(m_root_ptr));
+  if (has_compact_leaves()) {
+    m_storage.read(&m_first_leaf_ptr, sizeof(m_first_leaf_ptr));
+  }
+  if (m_version != btree_format_version::v1) {
+    m_storage.seek_in(node_alignment_offset());
+    m_storage.read(&m_node_alignment, sizeof(m_node_alignment));
+  }
+
+  m_layout = btree_node_layout{ m_version, m_order };
+  m_leaf_layout = btree_node_layout{ m_version, m_order, /*is_leaf_layout=*/true };
+
+  m_empty_leaf = empty_leaf(m_layout, m_leaf_layout);
 }
 
 template <typename DataStorage>
 void btree_base<DataStorage>::set_root_ptr(btree_node::pointer_t ptr)
 {
   m_root_ptr = ptr;
-  constexpr auto root_ptr_offset = sizeof(m_order);
-  m_storage.seek_out(root_ptr_offset);
+  m_storage.seek_out(root_ptr_offset());
   m_storage.write(&m_root_ptr, sizeof(btree_node::pointer_t));
 }
 
 template <typename DataStorage>
-btree_node btree_base<DataStorage>::read_node(btree_node::pointer_t ptr) const
+void btree_base<DataStorage>::set_first_leaf_ptr(btree_node::pointer_t ptr)
+{
+  if (!has_compact_leaves()) {
+    return;
+  }
+
+  m_first_leaf_ptr = ptr;
+  m_storage.seek_out(first_leaf_ptr_offset());
+  m_storage.write(&m_first_leaf_ptr, sizeof(btree_node::pointer_t));
+}
+
+template <typename DataStorage>
+bool btree_base<DataStorage>::has_compact_leaves() const
 {
-  const auto pointers_size = btree_node::binary_pointers_size(this->order());
-  const auto keys_size = btree_node::binary_keys_size(this->order());
-  const uint64_t offset = node_offset(ptr);
+  return m_version == btree_format_version::v3;
+}
 
+template <typename DataStorage>
+btree_node btree_base<DataStorage>::read_node(btree_node::pointer_t ptr) const
+{
   btree_node node{ this->order(), btree_node::k_unused_pointer };
+  read_node(ptr, node);
+  return node;
+}
 
-  m_storage.seek_in(offset);
-  m_storage.read(&node.is_leaf, sizeof(node.is_leaf));
-  m_storage.read(&node.keys_count, sizeof(node.keys_count));
-  m_storage.read(&node.pointers[0], pointers_size);
-  m_storage.read(&node.keys[0], keys_size);
-  m_storage.read(&node.parent_pointer, sizeof(node.parent_pointer));
+template <typename DataStorage>
+void btree_base<DataStorage>::read_node(btree_node::pointer_t ptr, btree_node& node) const
+{
+  const auto view = read_node_view(ptr);
+  layout_of(ptr).decode(view.data(), node);
 
   node.this_pointer = ptr;
+}
 
-  return node;
+template <typename DataStorage>
+btree_node_view btree_base<DataStorage>::read_node_view(btree_node::pointer_t ptr) const
+{
+  const auto& layout = layout_of(ptr);
+  const auto offset = node_offset(ptr);
+
+  // A pointer of a corrupt file may point anywhere. Lookups find nothing there, instead of reading
+  // past the end of the file.
+  if (!m_reader.contains(offset, layout.size())) {
+    return btree_node_view{ m_empty_leaf.data(), layout };
+  }
+
+  return btree_node_view{ m_reader.read(offset, layout.size()), layout };
+}
+
+template <typename DataStorage>
+const storage_reader<DataStorage>& btree_base<DataStorage>::reader() const
+{
+  return m_reader;
 }
 
 template <typename DataStorage>
 void btree_base<DataStorage>::write_node(const okon::btree_node& node) const
 {
-  const auto pointers_size = btree_node::binary_pointers_size(m_order);
-  const auto keys_size = btree_node::binary_keys_size(m_order);
-  const uint64_t offset = node_offset(node.this_pointer);
+  const auto& layout = layout_of(node.this_pointer);
+  m_node_buffer.resize(node_stride(node.this_pointer));
+  layout.encode(node, m_node_buffer.data());
+
+  // Padding is written too, so nodes written in order are contiguous in the storage.
+  std::fill(m_node_buffer.begin() + layout.size(), m_node_buffer.end(), uint8_t{ 0u });
+
+  m_storage.seek_out(node_offset(node.this_pointer));
+  m_storage.write(m_node_buffer.data(), m_node_buffer.size());
+}
+
+template <typename DataStorage>
+uint64_t btree_base<DataStorage>::tree_offset() const
+{
+  return m_version == btree_format_version::v1 ? sizeof(m_order) + sizeof(m_root_ptr)
+                                               : aligned(k_extended_header_size);
+}
+
+template <typename DataStorage>
+uint64_t btree_base<DataStorage>::root_ptr_offset() const
+{
+  return m_version == btree_format_version::v1 ? sizeof(m_order) : 3u * sizeof(uint32_t);
+}
 
-  m_storage.seek_out(offset);
+template <typename DataStorage>
+uint64_t btree_base<DataStorage>::first_leaf_ptr_offset() const
+{
+  return 4u * sizeof(uint32_t);
+}
 
-  m_storage.write(&node.is_leaf, sizeof(node.is_leaf));
-  m_storage.write(&node.keys_count, sizeof(node.keys_count));
-  m_storage.write(node.pointers.data(), pointers_size);
-  m_storage.write(node.keys.data(), keys_size);
-  m_storage.write(&node.parent_pointer, sizeof(node.parent_pointer));
+template <typename DataStorage>
+uint64_t btree_base<DataStorage>::node_alignment_offset() const
+{
+  return 5u * sizeof(uint32_t);
 }
 
 template <typename DataStorage>
-constexpr uint64_t btree_base<DataStorage>::tree_offset() const
+uint64_t btree_base<DataStorage>::aligned(uint64_t size) const
 {
-  return sizeof(m_order) + sizeof(m_root_ptr);
+  if (m_node_alignment == 0u) {
+    return size;
+  }
+
+  return (size + m_node_alignment - 1u) / m_node_alignment * m_node_alignment;
+}
+
+template <typename DataStorage>
+std::vector<uint8_t> btree_base<DataStorage>::empty_leaf(const btree_node_layout& layout,
+                                                         const btree_node_layout& leaf_layout)
+{
+  // All the layouts start with is_leaf, followed by keys_count, zeros are an empty node.
+  std::vector<uint8_t> leaf(std::max(layout.size(), leaf_layout.size()), 0u);
+  leaf[0] = 1u;
+  return leaf;
 }
 
 template <typename DataStorage>
 uint64_t btree_base<DataStorage>::node_offset(btree_node::pointer_t ptr) const
 {
-  return tree_offset() + uint64_t{ btree_node::binary_size(m_order) } * uint64_t{ ptr };
+  const auto inner_stride = aligned(m_layout.size());
+  if (!has_compact_leaves() || ptr < m_first_leaf_ptr) {
+    return tree_offset() + inner_stride * uint64_t{ ptr };
+  }
+
+  return tree_offset() + inner_stride * uint64_t{ m_first_leaf_ptr } +
+    aligned(m_leaf_layout.size()) * uint64_t{ ptr - m_first_leaf_ptr };
+}
+
+template <typename DataStorage>
+uint64_t btree_base<DataStorage>::node_stride(btree_node::pointer_t ptr) const
+{
+  return aligned(layout_of(ptr).size());
 }
 
 template <typename DataStorage>
@@ -116,6 +300,24 @@ uint32_t btree_base<DataStorage>::order() const
   return m_order;
 }
 
+template <typename DataStorage>
+btree_format_version btree_base<DataStorage>::version() const
+{
+  return m_version;
+}
+
+template <typename DataStorage>
+const btree_node_layout& btree_base<DataStorage>::layout() const
+{
+  return m_layout;
+}
+
+template <typename DataStorage>
+const btree_node_layout& btree_base<DataStorage>::layout_of(btree_node::pointer_t ptr) const
+{
+  return has_compact_leaves() && ptr >= m_first_leaf_ptr ? m_leaf_layout : m_layout;
+}
+
 template <typename DataStorage>
 btree_node::pointer_t btree_base<DataStorage>::root_ptr() const
 {
@@ -0,0 +1,205 @@
+#pragma once
+
+#include "btree_base.hpp"
+#include "sha1_utils.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+namespace okon {
+
+// Writes a B-tree of sorted keys whose number is known up front. The shape of the tree is computed
+// before the first key: the fewest nodes that fit the keys on every level, with keys (or
+// children) spread evenly between the nodes of a level. So, unlike btree_sorted_keys_inserter, no
+// node is underfull and no rebalancing pass is needed.
+//
+// Nodes are numbered level by level, starting from the root. Nodes of a level are completed in
+// that order, so every node is written once and every level is written sequentially, through a
+// buffer. Leaves get the greatest pointers, so they can be written in a compact layout, see
+// btree_format_version::v3.
+template <typename DataStorage>
+class btree_bulk_loader : public btree_base<DataStorage>
+{
+public:
+  explicit btree_bulk_loader(DataStorage& storage, btree_node::order_t order, uint64_t keys_count,
+                             btree_format_version version = btree_format_version::v1,
+                             uint32_t node_alignment = 0u);
+
+  // Exactly `keys_count` keys must be inserted.
+  void insert_sorted(const sha1_t& sha1);
+  void finalize_inserting();
+
+private:
+  // Nodes of one level of the tree. Level 0 are the leaves.
+  struct level
+  {
+    explicit level(btree_node::order_t order)
+      : node{ order, btree_node::k_unused_pointer }
+    {
+    }
+
+    uint64_t nodes_count{ 0u };
+
+    // Keys of all the nodes for leaves, children of all the nodes for internal nodes.
+    uint64_t items_count{ 0u };
+
+    btree_node::pointer_t first_pointer{ 0u };
+
+    // Node of the level that is being filled, and the number of its keys or children.
+    btree_node node;
+    uint64_t node_index{ 0u };
+    uint64_t node_items_count{ 0u };
+
+    // Encoded nodes of the level, that are not written yet.
+    std::vector<uint8_t> buffer;
+    btree_node::pointer_t buffer_first_pointer{ 0u };
+  };
+
+  bool is_node_complete(const level& l, bool is_leaf) const;
+  void start_node(unsigned level_index, uint64_t node_index);
+  void complete_node(unsigned level_index);
+  void flush(level& l);
+
+private:
+  DataStorage& m_storage;
+  std::vector<level> m_levels;
+};
+
+template <typename DataStorage>
+btree_bulk_loader<DataStorage>::btree_bulk_loader(DataStorage& storage, btree_node::order_t order,
+                                                  uint64_t keys_count,
+                                                  btree_format_version version,
+                                                  uint32_t node_alignment)
+  : btree_base<DataStorage>{ storage, order, version, node_alignment }
+  , m_storage{ storage }
+{
+  const uint64_t max_children{ order + 1u };
+
+  // Leaves take all the keys, except one separator between every two neighbouring leaves.
+  auto nodes_count = std::max<uint64_t>(1u, (keys_count + max_children) / max_children);
+  auto& leaves = m_levels.emplace_back(order);
+  leaves.nodes_count = nodes_count;
+  leaves.items_count = keys_count + 1u - nodes_count;
+
+  while (nodes_count > 1u) {
+    const auto children_count = nodes_count;
+    nodes_count = (children_count + max_children - 1u) / max_children;
+
+    auto& l = m_levels.emplace_back(order);
+    l.nodes_count = nodes_count;
+    l.items_count = children_count;
+  }
+
+  // The root gets pointer 0.
+  btree_node::pointer_t first_pointer{ 0u };
+  for (auto it = m_levels.rbegin(); it != m_levels.rend(); ++it) {
+    it->first_pointer = first_pointer;
+    first_pointer += static_cast<btree_node::pointer_t>(it->nodes_count);
+  }
+
+  this->set_first_leaf_ptr(m_levels.front().first_pointer);
+
+  for (auto i = static_cast<unsigned>(m_levels.size()); i > 0u; --i) {
+    start_node(i - 1u, 0u);
+  }
+}
+
+template <typename DataStorage>
+void btree_bulk_loader<DataStorage>::insert_sorted(const sha1_t& sha1)
+{
+  // The key goes to the lowest node that still needs keys. Complete nodes below it are written,
+  // the key separates them from their next siblings.
+  auto level_index = 0u;
+  while (is_node_complete(m_levels[level_index], level_index == 0u)) {
+    complete_node(level_index);
+    ++level_index;
+    assert(level_index < m_levels.size() && "more keys than declared");
+  }
+
+  m_levels[level_index].node.push_back(sha1);
+
+  while (level_index > 0u) {
+    --level_index;
+    start_node(level_index, m_levels[level_index].node_index + 1u);
+  }
+}
+
+template <typename DataStorage>
+void btree_bulk_loader<DataStorage>::finalize_inserting()
+{
+  for (auto i = 0u; i < m_levels.size(); ++i) {
+    assert(is_node_complete(m_levels[i], i == 0u) && "fewer keys than declared");
+    complete_node(i);
+    flush(m_levels[i]);
+  }
+
+  this->set_root_ptr(m_levels.back().first_pointer);
+}
+
+template <typename DataStorage>
+bool btree_bulk_loader<DataStorage>::is_node_complete(const level& l, bool is_leaf) const
+{
+  const auto keys_count = is_leaf ? l.node_items_count : l.node_items_count - 1u;
+  return l.node.keys_count == keys_count;
+}
+
+template <typename DataStorage>
+void btree_bulk_loader<DataStorage>::start_node(unsigned level_index, uint64_t node_index)
+{
+  auto& l = m_levels[level_index];
+  l.node_index = node_index;
+
+  // Every node gets the same number of items, the first ones one more if it doesn't divide.
+  l.node_items_count =
+    l.items_count / l.nodes_count + (node_index < l.items_count % l.nodes_count ? 1u : 0u);
+
+  auto& node = l.node;
+  node.keys_count = 0u;
+  node.is_leaf = level_index == 0u;
+  node.this_pointer = l.first_pointer + static_cast<btree_node::pointer_t>(node_index);
+  std::fill(node.pointers.begin(), node.pointers.end(), btree_node::k_unused_pointer);
+  node.parent_pointer = btree_node::k_unused_pointer;
+
+  if (level_index + 1u < m_levels.size()) {
+    auto& parent = m_levels[level_index + 1u].node;
+    parent.pointers[parent.keys_count] = node.this_pointer;
+    node.parent_pointer = parent.this_pointer;
+  }
+}
+
+template <typename DataStorage>
+void btree_bulk_loader<DataStorage>::complete_node(unsigned level_index)
+{
+  // Big enough to write to the storage rarely, small enough to keep all the levels in memory.
+  constexpr auto k_buffer_size{ 1024u * 1024u };
+
+  auto& l = m_levels[level_index];
+  if (l.buffer.empty()) {
+    l.buffer_first_pointer = l.node.this_pointer;
+  }
+
+  const auto& layout = this->layout_of(l.node.this_pointer);
+  const auto offset = l.buffer.size();
+  // Padding of the node, if any, is zeroed by resize().
+  l.buffer.resize(offset + this->node_stride(l.node.this_pointer));
+  layout.encode(l.node, l.buffer.data() + offset);
+
+  if (l.buffer.size() >= k_buffer_size) {
+    flush(l);
+  }
+}
+
+template <typename DataStorage>
+void btree_bulk_loader<DataStorage>::flush(level& l)
+{
+  if (l.buffer.empty()) {
+    return;
+  }
+
+  m_storage.seek_out(this->node_offset(l.buffer_first_pointer));
+  m_storage.write(l.buffer.data(), l.buffer.size());
+  l.buffer.clear();
+}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "btree_node.hpp"
+#include "sha1_search.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace okon {
+// Node of btree_format_version::v2 or v3 of an order known at compile time, in its binary form. In
+// both formats keys are placed the same way in inner nodes and leaves, see btree_node_layout, so
+// offsets of all the fields are constants and the search over the keys is unrolled.
+template <btree_node::order_t Order>
+class btree_fixed_order_node
+{
+public:
+  static constexpr uint64_t k_keys_count_offset{ sizeof(uint32_t) };
+  static constexpr uint64_t k_prefixes_offset{ k_keys_count_offset + sizeof(uint32_t) };
+  static constexpr uint64_t k_suffixes_offset{ k_prefixes_offset +
+                                               uint64_t{ Order } * k_sha1_prefix_size };
+
+  // Only inner nodes of v3 have pointers.
+  static constexpr uint64_t k_pointers_offset{ k_suffixes_offset +
+                                               uint64_t{ Order } * k_sha1_suffix_size };
+
+  explicit btree_fixed_order_node(const uint8_t* data)
+    : m_data{ data }
+  {
+  }
+
+  bool is_leaf() const
+  {
+    return m_data[0] != 0u;
+  }
+
+  uint32_t keys_count() const
+  {
+    uint32_t count;
+    std::memcpy(&count, m_data + k_keys_count_offset, sizeof(count));
+
+    // Nodes of a corrupt file may have more keys than fit in them, see btree_node_layout.
+    return std::min(count, uint32_t{ Order });
+  }
+
+  btree_node::pointer_t pointer(uint32_t index) const
+  {
+    btree_node::pointer_t ptr;
+    std::memcpy(&ptr, m_data + k_pointers_offset + index * sizeof(ptr), sizeof(ptr));
+    return ptr;
+  }
+
+  // Index of the first key not less than `sha1`. Sets `found` if that key is `sha1`.
+  uint32_t place_for(const sha1_t& sha1, bool& found) const
+  {
+    const details::split_sha1_keys keys{ m_data + k_prefixes_offset, m_data + k_suffixes_offset };
+    const auto count = keys_count();
+    const auto place = details::lower_bound_sha1_in_capacity<Order>(keys, count, sha1);
+
+    found = place < count && keys.prefix(place) == details::sha1_prefix(sha1) &&
+      std::memcmp(keys.suffix(place), sha1.data() + k_sha1_prefix_size, k_sha1_suffix_size) == 0;
+    return place;
+  }
+
+private:
+  const uint8_t* m_data;
+};
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "btree.hpp"
+#include "btree_node_view.hpp"
+#include "sha1_utils.hpp"
+#include "storage_reader.hpp"
+
+#include <optional>
+#include <vector>
+
+namespace okon {
+// Reads keys of a btree in ascending order. Keeps the path from the root to the current node, so
+// every node is read once.
+template <typename DataStorage>
+class btree_keys_reader
+{
+public:
+  explicit btree_keys_reader(const btree<DataStorage>& tree);
+
+  // Starts from the first key not less than `first`, found with a single descent.
+  explicit btree_keys_reader(const btree<DataStorage>& tree, const sha1_t& first);
+
+  std::optional<sha1_t> next();
+
+  // Btrees don't store counts, every key occurs once.
+  uint32_t count() const
+  {
+    return 1u;
+  }
+
+private:
+  struct path_node
+  {
+    btree_node_view view;
+
+    // Index of the next key to return from this node. For an inner node, its child with the same
+    // index is being read now.
+    uint32_t position{ 0u };
+
+    // Without direct access to the storage, views are valid only till the next read.
+    std::vector<uint8_t> copy;
+  };
+
+  void descend_to_leftmost_leaf(btree_node::pointer_t ptr);
+  void descend_to_lower_bound(btree_node::pointer_t ptr, const sha1_t& first);
+  void push_node(btree_node::pointer_t ptr);
+
+private:
+  const btree<DataStorage>& m_tree;
+  std::vector<path_node> m_path;
+};
+
+template <typename DataStorage>
+btree_keys_reader<DataStorage>::btree_keys_reader(const btree<DataStorage>& tree)
+  : m_tree{ tree }
+{
+  descend_to_leftmost_leaf(m_tree.root_ptr());
+}
+
+template <typename DataStorage>
+btree_keys_reader<DataStorage>::btree_keys_reader(const btree<DataStorage>& tree,
+                                                  const sha1_t& first)
+  : m_tree{ tree }
+{
+  descend_to_lower_bound(m_tree.root_ptr(), first);
+}
+
+template <typename DataStorage>
+std::optional<sha1_t> btree_keys_reader<DataStorage>::next()
+{
+  while (!m_path.empty()) {
+    auto& node = m_path.back();
+
+    if (node.position == node.view.keys_count()) {
+      m_path.pop_back();
+      continue;
+    }
+
+    const auto key = node.view.key(node.position);
+    ++node.position;
+
+    if (!node.view.is_leaf()) {
+      descend_to_leftmost_leaf(node.view.pointer(node.position));
+    }
+
+    return key;
+  }
+
+  return std::nullopt;
+}
+
+template <typename DataStorage>
+void btree_keys_reader<DataStorage>::descend_to_leftmost_leaf(btree_node::pointer_t ptr)
+{
+  push_node(ptr);
+
+  while (!m_path.back().view.is_leaf()) {
+    push_node(m_path.back().view.pointer(0u));
+  }
+}
+
+template <typename DataStorage>
+void btree_keys_reader<DataStorage>::descend_to_lower_bound(btree_node::pointer_t ptr,
+                                                            const sha1_t& first)
+{
+  while (true) {
+    push_node(ptr);
+
+    auto& node = m_path.back();
+    node.position = node.view.place_for(first);
+
+    // Keys of the child at `position` are less than its key equal to `first`, so there is no
+    // need to read it.
+    const auto found =
+      node.position < node.view.keys_count() && node.view.key(node.position) == first;
+    if (found || node.view.is_leaf()) {
+      return;
+    }
+
+    ptr = node.view.pointer(node.position);
+  }
+}
+
+template <typename DataStorage>
+void btree_keys_reader<DataStorage>::push_node(btree_node::pointer_t ptr)
+{
+  const auto view = m_tree.node_view(ptr);
+
+  if constexpr (storage_reader<DataStorage>::has_direct_access()) {
+    m_path.push_back(path_node{ view, 0u, {} });
+  } else {
+    const auto& layout = view.layout();
+    std::vector<uint8_t> copy(view.data(), view.data() + layout.size());
+    const auto* data = copy.data();
+    m_path.push_back(path_node{ btree_node_view{ data, layout }, 0u, std::move(copy) });
+  }
+}
+}
@@ -1,5 +1,7 @@
 #include "btree_node.hpp"
 
+#include "sha1_search.hpp"
+
 #include <algorithm>
 
 namespace okon {
@@ -10,6 +12,16 @@ btree_node::btree_node(uint32_t order, pointer_t parent_ptr)
 {
 }
 
+void btree_node::reset(pointer_t parent_ptr)
+{
+  is_leaf = false;
+  keys_count = 0u;
+  std::fill(pointers.begin(), pointers.end(), k_unused_pointer);
+  std::fill(keys.begin(), keys.end(), sha1_t{});
+  parent_pointer = parent_ptr;
+  this_pointer = {};
+}
+
 uint64_t btree_node::binary_size(uint32_t order)
 {
   return sizeof(is_leaf) + sizeof(keys_count) + binary_pointers_size(order) +
@@ -55,9 +67,7 @@ uint32_t btree_node::order() const
 
 uint32_t btree_node::place_for(const sha1_t& sha1) const
 {
-  const auto keys_end = std::next(std::cbegin(keys), keys_count);
-  const auto found = std::lower_bound(std::cbegin(keys), keys_end, sha1);
-  return std::distance(std::cbegin(keys), found);
+  return lower_bound_sha1(keys.data(), keys_count, sha1);
 }
 
 bool btree_node::is_full() const
@@ -67,14 +77,8 @@ bool btree_node::is_full() const
 
 bool btree_node::contains(const sha1_t& sha1) const
 {
-  const auto keys_end = std::next(std::cbegin(keys), keys_count);
-  const auto found = std::lower_bound(std::cbegin(keys), keys_end, sha1);
-
-  if (found == std::cend(keys)) {
-    return false;
-  }
-
-  return *found == sha1;
+  const auto place = place_for(sha1);
+  return place < keys_count && keys[place] == sha1;
 }
 
 btree_node::pointer_t btree_node::rightmost_pointer() const
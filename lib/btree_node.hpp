@@ -18,6 +18,9 @@ public:
 
   explicit btree_node(order_t order, pointer_t parent_ptr);
 
+  // Clears the node as if it was constructed again, keeping its buffers.
+  void reset(pointer_t parent_ptr);
+
   static uint64_t binary_size(order_t order);
   static uint64_t binary_pointers_size(order_t order);
   static uint64_t binary_keys_size(order_t order);
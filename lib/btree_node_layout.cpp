@@ -0,0 +1,365 @@
+#include "btree_node_layout.hpp"
+
+#include "memory_hints.hpp"
+#include "sha1_search.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+// is_leaf, prefix_length, padding and keys_count, followed by the prefix.
+constexpr uint64_t k_prefix_truncated_keys_count_offset{ 4u };
+constexpr uint64_t k_prefix_truncated_prefix_offset{ 8u };
+constexpr uint64_t k_prefix_truncated_suffixes_offset{ k_prefix_truncated_prefix_offset +
+                                                       sizeof(okon::sha1_t) };
+
+uint32_t common_prefix_length(const okon::sha1_t& lhs, const okon::sha1_t& rhs)
+{
+  const auto mismatch = std::mismatch(lhs.begin(), lhs.end(), rhs.begin());
+  return static_cast<uint32_t>(std::distance(lhs.begin(), mismatch.first));
+}
+}
+
+namespace okon {
+btree_node_layout::btree_node_layout(btree_format_version version, btree_node::order_t order,
+                                     bool is_leaf_layout)
+  : m_version{ version }
+  , m_order{ order }
+  , m_has_pointers{ version != btree_format_version::v3 || !is_leaf_layout }
+{
+  if (is_prefix_truncated()) {
+    m_is_leaf_size = sizeof(uint8_t);
+    m_keys_count_offset = k_prefix_truncated_keys_count_offset;
+    m_keys_offset = k_prefix_truncated_suffixes_offset;
+    m_suffixes_offset = 0u;
+    m_pointers_offset = 0u;
+    m_parent_pointer_offset = 0u;
+
+    // Nodes always have room for the fields before the keys, even if the order of a corrupt file
+    // is too small for them.
+    m_size = std::max<uint64_t>(order, k_prefix_truncated_suffixes_offset);
+    return;
+  }
+
+  const auto pointers_size = btree_node::binary_pointers_size(order);
+
+  if (!m_has_pointers) {
+    m_is_leaf_size = sizeof(uint32_t);
+    m_keys_count_offset = m_is_leaf_size;
+    m_keys_offset = m_keys_count_offset + sizeof(uint32_t);
+    m_suffixes_offset = m_keys_offset + uint64_t{ order } * k_sha1_prefix_size;
+    m_pointers_offset = 0u;
+    m_parent_pointer_offset = 0u;
+    m_size = m_suffixes_offset + uint64_t{ order } * k_sha1_suffix_size;
+    return;
+  }
+
+  if (version == btree_format_version::v1) {
+    m_is_leaf_size = sizeof(bool);
+    m_keys_count_offset = m_is_leaf_size;
+    m_pointers_offset = m_keys_count_offset + sizeof(uint32_t);
+    m_keys_offset = m_pointers_offset + pointers_size;
+    m_suffixes_offset = 0u;
+    m_parent_pointer_offset = m_keys_offset + btree_node::binary_keys_size(order);
+  } else {
+    m_is_leaf_size = sizeof(uint32_t);
+    m_keys_count_offset = m_is_leaf_size;
+    m_keys_offset = m_keys_count_offset + sizeof(uint32_t);
+    m_suffixes_offset = m_keys_offset + uint64_t{ order } * k_sha1_prefix_size;
+    m_pointers_offset = m_suffixes_offset + uint64_t{ order } * k_sha1_suffix_size;
+    m_parent_pointer_offset = m_pointers_offset + pointers_size;
+  }
+
+  m_size = m_parent_pointer_offset + sizeof(btree_node::pointer_t);
+}
+
+uint64_t btree_node_layout::prefix_truncated_size(uint32_t keys_count, uint32_t prefix_length,
+                                                 bool is_leaf)
+{
+  const auto pointers_count = is_leaf ? 0u : uint64_t{ keys_count } + 1u;
+  return k_prefix_truncated_suffixes_offset +
+    uint64_t{ keys_count } * (sizeof(sha1_t) - prefix_length) +
+    pointers_count * sizeof(btree_node::pointer_t);
+}
+
+btree_node::order_t btree_node_layout::max_order_for_size(btree_format_version version,
+                                                          uint64_t node_size)
+{
+  if (version == btree_format_version::v4) {
+    return static_cast<btree_node::order_t>(node_size);
+  }
+
+  // Every key takes more than 20 bytes, so the order is not bigger than that.
+  auto order = static_cast<btree_node::order_t>(node_size / sizeof(sha1_t));
+  while (order > 0u &&
+         btree_node_layout{ version, order, /*is_leaf_layout=*/true }.size() > node_size) {
+    --order;
+  }
+  return order;
+}
+
+btree_format_version btree_node_layout::version() const
+{
+  return m_version;
+}
+
+btree_node::order_t btree_node_layout::order() const
+{
+  return m_order;
+}
+
+uint64_t btree_node_layout::size() const
+{
+  return m_size;
+}
+
+bool btree_node_layout::is_leaf(const uint8_t* data) const
+{
+  return data[0] != 0u;
+}
+
+uint32_t btree_node_layout::keys_count(const uint8_t* data) const
+{
+  uint32_t count;
+  std::memcpy(&count, data + m_keys_count_offset, sizeof(count));
+
+  // Nodes of a corrupt file may have more keys than fit in them. Only the ones that fit are read.
+  return std::min(count, max_keys_count(data));
+}
+
+btree_node::pointer_t btree_node_layout::pointer(const uint8_t* data, uint32_t index) const
+{
+  if (!m_has_pointers) {
+    return btree_node::k_unused_pointer;
+  }
+
+  auto pointers_offset = m_pointers_offset;
+  if (is_prefix_truncated()) {
+    if (is_leaf(data)) {
+      return btree_node::k_unused_pointer;
+    }
+
+    pointers_offset = static_cast<uint64_t>(suffix(data, keys_count(data)) - data);
+  }
+
+  btree_node::pointer_t ptr;
+  std::memcpy(&ptr, data + pointers_offset + index * sizeof(btree_node::pointer_t), sizeof(ptr));
+  return ptr;
+}
+
+sha1_t btree_node_layout::key(const uint8_t* data, uint32_t index) const
+{
+  sha1_t sha1;
+
+  if (m_version == btree_format_version::v1) {
+    std::memcpy(sha1.data(), data + m_keys_offset + index * sizeof(sha1_t), sizeof(sha1_t));
+    return sha1;
+  }
+
+  if (is_prefix_truncated()) {
+    const auto length = prefix_length(data);
+    std::memcpy(sha1.data(), data + k_prefix_truncated_prefix_offset, length);
+    std::memcpy(sha1.data() + length, suffix(data, index), sizeof(sha1_t) - length);
+    return sha1;
+  }
+
+  uint64_t prefix;
+  std::memcpy(&prefix, data + m_keys_offset + index * k_sha1_prefix_size, sizeof(prefix));
+  for (auto i = 0u; i < k_sha1_prefix_size; ++i) {
+    sha1[i] = static_cast<uint8_t>(prefix >> (8u * (k_sha1_prefix_size - 1u - i)));
+  }
+
+  std::memcpy(sha1.data() + k_sha1_prefix_size,
+              data + m_suffixes_offset + index * k_sha1_suffix_size, k_sha1_suffix_size);
+  return sha1;
+}
+
+uint32_t btree_node_layout::place_for(const uint8_t* data, const sha1_t& sha1) const
+{
+  if (m_version == btree_format_version::v1) {
+    // sha1_t is a byte array, so it has no alignment requirements.
+    const auto keys = reinterpret_cast<const sha1_t*>(data + m_keys_offset);
+    return lower_bound_sha1(keys, keys_count(data), sha1);
+  }
+
+  if (is_prefix_truncated()) {
+    return prefix_truncated_place_for(data, sha1);
+  }
+
+  return lower_bound_split_sha1(data + m_keys_offset, data + m_suffixes_offset, keys_count(data),
+                                sha1);
+}
+
+void btree_node_layout::prefetch(const uint8_t* data) const
+{
+  details::prefetch(data);
+
+  // The binary search starts in the middle of the keys, it's where a full node has them.
+  const auto middle = m_order / 2u;
+  if (is_prefix_truncated()) {
+    details::prefetch(data + m_size / 2u);
+  } else if (m_version == btree_format_version::v1) {
+    details::prefetch(data + m_keys_offset + middle * sizeof(sha1_t));
+  } else {
+    details::prefetch(data + m_keys_offset + middle * k_sha1_prefix_size);
+  }
+}
+
+void btree_node_layout::encode(const btree_node& node, uint8_t* data) const
+{
+  std::memset(data, 0, m_size);
+
+  if (is_prefix_truncated()) {
+    // Keys are sorted, so all of them share the common prefix of the first and the last one.
+    const auto count = node.keys_count;
+    const auto length = count > 0u ? common_prefix_length(node.keys[0], node.keys[count - 1u]) : 0u;
+
+    data[0] = node.is_leaf ? 1u : 0u;
+    data[1] = static_cast<uint8_t>(length);
+    std::memcpy(data + k_prefix_truncated_keys_count_offset, &count, sizeof(count));
+    if (count > 0u) {
+      std::memcpy(data + k_prefix_truncated_prefix_offset, node.keys[0].data(), length);
+    }
+
+    auto* out = data + k_prefix_truncated_suffixes_offset;
+    for (auto i = 0u; i < count; ++i) {
+      std::memcpy(out, node.keys[i].data() + length, sizeof(sha1_t) - length);
+      out += sizeof(sha1_t) - length;
+    }
+
+    if (!node.is_leaf) {
+      std::memcpy(out, node.pointers.data(), (count + 1u) * sizeof(btree_node::pointer_t));
+    }
+    return;
+  }
+
+  data[0] = node.is_leaf ? 1u : 0u;
+  std::memcpy(data + m_keys_count_offset, &node.keys_count, sizeof(node.keys_count));
+  if (m_has_pointers) {
+    std::memcpy(data + m_pointers_offset, node.pointers.data(),
+                btree_node::binary_pointers_size(m_order));
+    std::memcpy(data + m_parent_pointer_offset, &node.parent_pointer, sizeof(node.parent_pointer));
+  }
+
+  if (m_version == btree_format_version::v1) {
+    std::memcpy(data + m_keys_offset, node.keys.data(), btree_node::binary_keys_size(m_order));
+    return;
+  }
+
+  for (auto i = 0u; i < m_order; ++i) {
+    const auto prefix = details::sha1_prefix(node.keys[i]);
+    std::memcpy(data + m_keys_offset + i * k_sha1_prefix_size, &prefix, sizeof(prefix));
+    std::memcpy(data + m_suffixes_offset + i * k_sha1_suffix_size,
+                node.keys[i].data() + k_sha1_prefix_size, k_sha1_suffix_size);
+  }
+}
+
+void btree_node_layout::decode(const uint8_t* data, btree_node& node) const
+{
+  node.is_leaf = is_leaf(data);
+  node.keys_count = keys_count(data);
+
+  if (is_prefix_truncated()) {
+    std::fill(node.pointers.begin(), node.pointers.end(), btree_node::k_unused_pointer);
+    node.parent_pointer = btree_node::k_unused_pointer;
+
+    for (auto i = 0u; i < node.keys_count; ++i) {
+      node.keys[i] = key(data, i);
+    }
+    if (!node.is_leaf) {
+      for (auto i = 0u; i <= node.keys_count; ++i) {
+        node.pointers[i] = pointer(data, i);
+      }
+    }
+    return;
+  }
+  if (m_has_pointers) {
+    std::memcpy(node.pointers.data(), data + m_pointers_offset,
+                btree_node::binary_pointers_size(m_order));
+    std::memcpy(&node.parent_pointer, data + m_parent_pointer_offset, sizeof(node.parent_pointer));
+  } else {
+    std::fill(node.pointers.begin(), node.pointers.end(), btree_node::k_unused_pointer);
+    node.parent_pointer = btree_node::k_unused_pointer;
+  }
+
+  if (m_version == btree_format_version::v1) {
+    std::memcpy(node.keys.data(), data + m_keys_offset, btree_node::binary_keys_size(m_order));
+    return;
+  }
+
+  for (auto i = 0u; i < m_order; ++i) {
+    node.keys[i] = key(data, i);
+  }
+}
+
+bool btree_node_layout::is_prefix_truncated() const
+{
+  return m_version == btree_format_version::v4;
+}
+
+uint32_t btree_node_layout::prefix_length(const uint8_t* data) const
+{
+  return std::min<uint32_t>(data[1], sizeof(sha1_t));
+}
+
+uint32_t btree_node_layout::max_keys_count(const uint8_t* data) const
+{
+  if (!is_prefix_truncated()) {
+    return m_order;
+  }
+
+  // Suffixes and pointers of the keys, and the last pointer of an inner node, follow the prefix.
+  const auto is_leaf_node = is_leaf(data);
+  const auto key_size = sizeof(sha1_t) - prefix_length(data) +
+    (is_leaf_node ? 0u : sizeof(btree_node::pointer_t));
+  const auto fixed_size =
+    k_prefix_truncated_suffixes_offset + (is_leaf_node ? 0u : sizeof(btree_node::pointer_t));
+  if (m_size < fixed_size) {
+    return 0u;
+  }
+
+  // Keys of a leaf equal to its prefix take no bytes. Decoded nodes have room for `order` keys.
+  const auto space = m_size - fixed_size;
+  if (key_size == 0u) {
+    return m_order;
+  }
+  return static_cast<uint32_t>(std::min<uint64_t>(m_order, space / key_size));
+}
+
+const uint8_t* btree_node_layout::suffix(const uint8_t* data, uint32_t index) const
+{
+  return data + k_prefix_truncated_suffixes_offset +
+    uint64_t{ index } * (sizeof(sha1_t) - prefix_length(data));
+}
+
+uint32_t btree_node_layout::prefix_truncated_place_for(const uint8_t* data,
+                                                       const sha1_t& sha1) const
+{
+  const auto count = keys_count(data);
+  const auto length = prefix_length(data);
+
+  // Keys that don't share the prefix are less or greater than all the keys of the node.
+  const auto prefix_order =
+    std::memcmp(sha1.data(), data + k_prefix_truncated_prefix_offset, length);
+  if (prefix_order != 0) {
+    return prefix_order < 0 ? 0u : count;
+  }
+
+  // Suffixes are compared in place, without rebuilding the keys.
+  const auto* const sha1_suffix = sha1.data() + length;
+  const auto suffix_size = sizeof(sha1_t) - length;
+
+  uint32_t begin{ 0u };
+  uint32_t end{ count };
+  while (begin < end) {
+    const auto middle = begin + (end - begin) / 2u;
+    if (std::memcmp(suffix(data, middle), sha1_suffix, suffix_size) < 0) {
+      begin = middle + 1u;
+    } else {
+      end = middle;
+    }
+  }
+
+  return begin;
+}
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "btree_node.hpp"
+
+#include <cstdint>
+
+namespace okon {
+enum class btree_format_version : uint32_t
+{
+  //! is_leaf | keys_count | pointers[order + 1] | keys[order] | parent_pointer
+  v1 = 1u,
+
+  //! is_leaf | keys_count | key_prefixes[order] | key_suffixes[order] | pointers[order + 1] |
+  //! parent_pointer
+  //! Keys are split into dense array of 8-byte prefixes, that is searched, and the remaining
+  //! 12-byte suffixes, that are touched only when a prefix matches. All fields are aligned.
+  v2 = 2u,
+
+  //! Inner nodes as in v2. Leaves: is_leaf | keys_count | key_prefixes[order] | key_suffixes[order]
+  //! Leaves have no pointers, so they're about a sixth smaller. All inner nodes are placed before
+  //! all the leaves. The value follows file_format, as the version is read as the file format.
+  v3 = 6u,
+
+  //! is_leaf (1 byte) | prefix_length (1 byte) | padding (2 bytes) | keys_count |
+  //! prefix[20] | key_suffixes[keys_count] | pointers[keys_count + 1], inner nodes only
+  //! Keys of a node share their first prefix_length bytes, which are stored once. Suffixes are
+  //! the remaining 20 - prefix_length bytes of the keys. Nodes are as big as `order` bytes and
+  //! take as many keys as fit, so the number of keys of a node depends on their common prefix.
+  v4 = 7u
+};
+
+// Describes where the fields of a node are placed in its binary form.
+class btree_node_layout
+{
+public:
+  // Layout of leaves may differ from the layout of inner nodes, see btree_format_version::v3.
+  explicit btree_node_layout(btree_format_version version, btree_node::order_t order,
+                             bool is_leaf_layout = false);
+
+  // Size of a btree_format_version::v4 node with `keys_count` keys that share `prefix_length`
+  // bytes.
+  static uint64_t prefix_truncated_size(uint32_t keys_count, uint32_t prefix_length,
+                                        bool is_leaf);
+
+  // The biggest order of `version` whose leaves are not bigger than `node_size`, or 0 if there's no
+  // such order. Only inner nodes of btree_format_version::v3 are bigger than leaves, and they're
+  // a small part of the tree. For btree_format_version::v4, the order is the node size itself.
+  static btree_node::order_t max_order_for_size(btree_format_version version, uint64_t node_size);
+
+  btree_format_version version() const;
+  btree_node::order_t order() const;
+  uint64_t size() const;
+
+  bool is_leaf(const uint8_t* data) const;
+  uint32_t keys_count(const uint8_t* data) const;
+  btree_node::pointer_t pointer(const uint8_t* data, uint32_t index) const;
+  sha1_t key(const uint8_t* data, uint32_t index) const;
+  uint32_t place_for(const uint8_t* data, const sha1_t& sha1) const;
+
+  // Starts fetching the parts of the node that a lookup reads first, see details::prefetch().
+  void prefetch(const uint8_t* data) const;
+
+  void encode(const btree_node& node, uint8_t* data) const;
+  void decode(const uint8_t* data, btree_node& node) const;
+
+private:
+  bool is_prefix_truncated() const;
+  uint32_t prefix_length(const uint8_t* data) const;
+  uint32_t max_keys_count(const uint8_t* data) const;
+  const uint8_t* suffix(const uint8_t* data, uint32_t index) const;
+  uint32_t prefix_truncated_place_for(const uint8_t* data, const sha1_t& sha1) const;
+
+private:
+  btree_format_version m_version;
+  btree_node::order_t m_order;
+  bool m_has_pointers;
+
+  uint64_t m_is_leaf_size;
+  uint64_t m_keys_count_offset;
+  uint64_t m_pointers_offset;
+  uint64_t m_keys_offset;
+  uint64_t m_suffixes_offset;
+  uint64_t m_parent_pointer_offset;
+  uint64_t m_size;
+};
+}
@@ -0,0 +1,37 @@
+#include "btree_node_pool.hpp"
+
+#include <utility>
+
+namespace okon {
+btree_node_pool::btree_node_pool(btree_node::order_t order)
+  : m_order{ order }
+{
+}
+
+btree_node btree_node_pool::take(btree_node::pointer_t parent_ptr)
+{
+  if (m_free_nodes.empty()) {
+    return btree_node{ m_order, parent_ptr };
+  }
+
+  auto node = take_for_overwrite();
+  node.reset(parent_ptr);
+  return node;
+}
+
+btree_node btree_node_pool::take_for_overwrite()
+{
+  if (m_free_nodes.empty()) {
+    return btree_node{ m_order, btree_node::k_unused_pointer };
+  }
+
+  auto node = std::move(m_free_nodes.back());
+  m_free_nodes.pop_back();
+  return node;
+}
+
+void btree_node_pool::release(btree_node node)
+{
+  m_free_nodes.push_back(std::move(node));
+}
+}
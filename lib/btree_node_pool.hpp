@@ -0,0 +1,28 @@
+#pragma once
+
+#include "btree_node.hpp"
+
+#include <vector>
+
+namespace okon {
+// Free list of nodes of one order. Nodes are handed out by value and given back with release(),
+// keeping their buffers, so after the first few nodes building and rebalancing a tree don't
+// allocate. A node not given back is just freed.
+class btree_node_pool
+{
+public:
+  explicit btree_node_pool(btree_node::order_t order);
+
+  // Returns a node as if constructed with btree_node{ order, parent_ptr }.
+  btree_node take(btree_node::pointer_t parent_ptr);
+
+  // Returns a node of arbitrary content, to be overwritten e.g. by btree_base::read_node().
+  btree_node take_for_overwrite();
+
+  void release(btree_node node);
+
+private:
+  btree_node::order_t m_order;
+  std::vector<btree_node> m_free_nodes;
+};
+}
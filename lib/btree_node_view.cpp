@@ -0,0 +1,50 @@
+#include "btree_node_view.hpp"
+
+namespace okon {
+btree_node_view::btree_node_view(const uint8_t* data, const btree_node_layout& layout)
+  : m_data{ data }
+  , m_layout{ &layout }
+{
+}
+
+const uint8_t* btree_node_view::data() const
+{
+  return m_data;
+}
+
+const btree_node_layout& btree_node_view::layout() const
+{
+  return *m_layout;
+}
+
+bool btree_node_view::is_leaf() const
+{
+  return m_layout->is_leaf(m_data);
+}
+
+uint32_t btree_node_view::keys_count() const
+{
+  return m_layout->keys_count(m_data);
+}
+
+btree_node::pointer_t btree_node_view::pointer(uint32_t index) const
+{
+  return m_layout->pointer(m_data, index);
+}
+
+sha1_t btree_node_view::key(uint32_t index) const
+{
+  return m_layout->key(m_data, index);
+}
+
+uint32_t btree_node_view::place_for(const sha1_t& sha1) const
+{
+  return m_layout->place_for(m_data, sha1);
+}
+
+bool btree_node_view::contains(const sha1_t& sha1) const
+{
+  const auto place = place_for(sha1);
+  return place < keys_count() && key(place) == sha1;
+}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "btree_node.hpp"
+#include "btree_node_layout.hpp"
+#include "sha1_utils.hpp"
+
+#include <cstdint>
+
+namespace okon {
+// Non-owning view of a node in its binary form, as written by btree_base::write_node. Keys and
+// pointers are read directly from the underlying bytes, so no copy of the node is made.
+class btree_node_view
+{
+public:
+  explicit btree_node_view(const uint8_t* data, const btree_node_layout& layout);
+
+  const uint8_t* data() const;
+  const btree_node_layout& layout() const;
+
+  bool is_leaf() const;
+  uint32_t keys_count() const;
+  btree_node::pointer_t pointer(uint32_t index) const;
+  sha1_t key(uint32_t index) const;
+
+  uint32_t place_for(const sha1_t& sha1) const;
+  bool contains(const sha1_t& sha1) const;
+
+private:
+  const uint8_t* m_data;
+  const btree_node_layout* m_layout;
+};
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "btree_base.hpp"
+#include "sha1_utils.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace okon {
+// Writes a B-tree of sorted keys in btree_format_version::v4, where keys of a node share their
+// common prefix. Every node takes as many keys as fit in `node_size` bytes, which depends on the
+// prefix, so the shape of the tree isn't known up front. Like in btree_sorted_keys_inserter, a
+// key that doesn't fit goes up to the parent, and a new node is started below it. Nodes get their
+// pointers when they're complete, so they are written once, sequentially, through a buffer, and
+// the root is written last. The number of keys doesn't need to be known up front.
+template <typename DataStorage>
+class btree_packing_loader : public btree_base<DataStorage>
+{
+public:
+  static constexpr btree_node::order_t k_default_node_size{ 16u * 1024u };
+
+  explicit btree_packing_loader(DataStorage& storage,
+                                btree_node::order_t node_size = k_default_node_size,
+                                uint32_t node_alignment = 0u);
+
+  void insert_sorted(const sha1_t& sha1);
+  void finalize_inserting();
+
+private:
+  // Node of one level, from the leaves up, that is being filled.
+  struct level
+  {
+    explicit level(btree_node::order_t node_size, bool is_leaf)
+      : node{ node_size, btree_node::k_unused_pointer }
+    {
+      node.is_leaf = is_leaf;
+    }
+
+    btree_node node;
+    uint32_t prefix_length{ 0u };
+  };
+
+  // Length of the common prefix of the keys of `l` and `sha1`.
+  uint32_t prefix_length_with(const level& l, const sha1_t& sha1) const;
+  bool fits(const level& l, const sha1_t& sha1) const;
+  void insert(unsigned level_index, const sha1_t& sha1);
+  void complete_node(unsigned level_index);
+  void flush();
+
+private:
+  DataStorage& m_storage;
+  btree_node::order_t m_node_size;
+
+  // At most this many keys fit in a node, when the keys differ only in one byte.
+  uint32_t m_max_keys_count;
+
+  std::vector<level> m_levels;
+  btree_node::pointer_t m_next_node_ptr{ 0u };
+
+  // Encoded nodes that are not written yet.
+  std::vector<uint8_t> m_buffer;
+  btree_node::pointer_t m_buffer_first_pointer{ 0u };
+};
+
+template <typename DataStorage>
+btree_packing_loader<DataStorage>::btree_packing_loader(DataStorage& storage,
+                                                        btree_node::order_t node_size,
+                                                        uint32_t node_alignment)
+  : btree_base<DataStorage>{ storage, node_size, btree_format_version::v4, node_alignment }
+  , m_storage{ storage }
+  , m_node_size{ node_size }
+  , m_max_keys_count{ static_cast<uint32_t>(
+      node_size - btree_node_layout::prefix_truncated_size(0u, 0u, /*is_leaf=*/true)) }
+{
+  m_levels.emplace_back(m_node_size, /*is_leaf=*/true);
+}
+
+template <typename DataStorage>
+void btree_packing_loader<DataStorage>::insert_sorted(const sha1_t& sha1)
+{
+  insert(0u, sha1);
+}
+
+template <typename DataStorage>
+void btree_packing_loader<DataStorage>::finalize_inserting()
+{
+  for (auto i = 0u; i < m_levels.size(); ++i) {
+    complete_node(i);
+  }
+  flush();
+
+  this->set_root_ptr(m_next_node_ptr - 1u);
+}
+
+template <typename DataStorage>
+uint32_t btree_packing_loader<DataStorage>::prefix_length_with(const level& l,
+                                                               const sha1_t& sha1) const
+{
+  const auto& first = l.node.keys[0];
+  if (l.node.keys_count == 0u) {
+    return static_cast<uint32_t>(sha1.size());
+  }
+
+  const auto mismatch = std::mismatch(first.begin(), first.end(), sha1.begin());
+  return std::min(l.prefix_length, static_cast<uint32_t>(mismatch.first - first.begin()));
+}
+
+template <typename DataStorage>
+bool btree_packing_loader<DataStorage>::fits(const level& l, const sha1_t& sha1) const
+{
+  const auto& node = l.node;
+  if (node.keys_count == 0u) {
+    return true;
+  }
+  if (node.keys_count == m_max_keys_count) {
+    return false;
+  }
+
+  const auto size = btree_node_layout::prefix_truncated_size(
+    node.keys_count + 1u, prefix_length_with(l, sha1), node.is_leaf);
+  return size <= m_node_size;
+}
+
+template <typename DataStorage>
+void btree_packing_loader<DataStorage>::insert(unsigned level_index, const sha1_t& sha1)
+{
+  if (!fits(m_levels[level_index], sha1)) {
+    if (level_index + 1u == m_levels.size()) {
+      m_levels.emplace_back(m_node_size, /*is_leaf=*/false);
+    }
+
+    // The key separates the complete node from the next one.
+    complete_node(level_index);
+    insert(level_index + 1u, sha1);
+    return;
+  }
+
+  auto& l = m_levels[level_index];
+  l.prefix_length = prefix_length_with(l, sha1);
+  l.node.push_back(sha1);
+}
+
+template <typename DataStorage>
+void btree_packing_loader<DataStorage>::complete_node(unsigned level_index)
+{
+  auto& node = m_levels[level_index].node;
+  node.this_pointer = m_next_node_ptr++;
+
+  if (m_buffer.empty()) {
+    m_buffer_first_pointer = node.this_pointer;
+  }
+
+  const auto& layout = this->layout();
+  const auto offset = m_buffer.size();
+  m_buffer.resize(offset + this->node_stride(node.this_pointer));
+  layout.encode(node, m_buffer.data() + offset);
+
+  // Big enough to write to the storage rarely.
+  constexpr auto k_buffer_size{ 4u * 1024u * 1024u };
+  if (m_buffer.size() >= k_buffer_size) {
+    flush();
+  }
+
+  if (level_index + 1u < m_levels.size()) {
+    auto& parent = m_levels[level_index + 1u].node;
+    parent.pointers[parent.keys_count] = node.this_pointer;
+  }
+
+  node.keys_count = 0u;
+  m_levels[level_index].prefix_length = 0u;
+}
+
+template <typename DataStorage>
+void btree_packing_loader<DataStorage>::flush()
+{
+  if (m_buffer.empty()) {
+    return;
+  }
+
+  m_storage.seek_out(this->node_offset(m_buffer_first_pointer));
+  m_storage.write(m_buffer.data(), m_buffer.size());
+  m_buffer.clear();
+}
+}
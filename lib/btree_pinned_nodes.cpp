@@ -0,0 +1,61 @@
+#include "btree_pinned_nodes.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+namespace okon {
+btree_pinned_nodes::btree_pinned_nodes(uint64_t node_size)
+  : m_node_size{ node_size }
+{
+}
+
+void btree_pinned_nodes::add(btree_node::pointer_t ptr, const uint8_t* node_data, uint64_t size)
+{
+  m_pointers.push_back(ptr);
+  m_data.insert(std::end(m_data), node_data, node_data + size);
+  m_data.resize(m_data.size() + (m_node_size - size), 0u);
+}
+
+void btree_pinned_nodes::finalize()
+{
+  // Nodes are added level by level, so their pointers are not sorted. Sort them (together with
+  // the data), so find() can binary search.
+  std::vector<unsigned> order(m_pointers.size());
+  std::iota(std::begin(order), std::end(order), 0u);
+  std::sort(std::begin(order), std::end(order),
+            [this](unsigned lhs, unsigned rhs) { return m_pointers[lhs] < m_pointers[rhs]; });
+
+  std::vector<btree_node::pointer_t> sorted_pointers(m_pointers.size());
+  std::vector<uint8_t> sorted_data(m_data.size());
+
+  for (auto i = 0u; i < order.size(); ++i) {
+    sorted_pointers[i] = m_pointers[order[i]];
+    std::memcpy(&sorted_data[i * m_node_size], &m_data[order[i] * m_node_size], m_node_size);
+  }
+
+  m_pointers = std::move(sorted_pointers);
+  m_data = std::move(sorted_data);
+}
+
+const uint8_t* btree_pinned_nodes::find(btree_node::pointer_t ptr) const
+{
+  const auto found = std::lower_bound(std::cbegin(m_pointers), std::cend(m_pointers), ptr);
+  if (found == std::cend(m_pointers) || *found != ptr) {
+    return nullptr;
+  }
+
+  const auto index = static_cast<uint64_t>(std::distance(std::cbegin(m_pointers), found));
+  return &m_data[index * m_node_size];
+}
+
+bool btree_pinned_nodes::empty() const
+{
+  return m_pointers.empty();
+}
+
+uint64_t btree_pinned_nodes::size_in_bytes() const
+{
+  return m_data.size();
+}
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "btree_node.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace okon {
+// Copies of binary nodes kept in one contiguous block of memory. Used to pin the upper levels of a
+// tree, so lookups don't need to touch the storage for them.
+class btree_pinned_nodes
+{
+public:
+  // `node_size` is the size of the biggest node.
+  explicit btree_pinned_nodes(uint64_t node_size = 0u);
+
+  // Nodes smaller than `node_size`, e.g. compact leaves, are padded with zeros.
+  void add(btree_node::pointer_t ptr, const uint8_t* node_data, uint64_t size);
+
+  // Has to be called after all nodes are added and before find().
+  void finalize();
+
+  // Returns pointer to the node's binary data or nullptr if the node is not pinned.
+  const uint8_t* find(btree_node::pointer_t ptr) const;
+
+  bool empty() const;
+  uint64_t size_in_bytes() const;
+
+private:
+  uint64_t m_node_size;
+  std::vector<btree_node::pointer_t> m_pointers;
+  std::vector<uint8_t> m_data;
+};
+}
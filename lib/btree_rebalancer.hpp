@@ -1,10 +1,11 @@
 #pragma once
 
 #include "btree_base.hpp"
+#include "btree_node_pool.hpp"
 #include "sha1_utils.hpp"
 
-#include <unordered_map>
-#include <unordered_set>
+#include <utility>
+#include <vector>
 
 namespace okon {
 
@@ -19,6 +20,10 @@ public:
 
 private:
   btree_node::pointer_t new_node_pointer();
+
+  // Nodes read or created on the way are taken from the pool and released when they're done with.
+  btree_node read_pooled_node(btree_node::pointer_t ptr);
+
   void create_nodes_to_fulfill_b_tree(btree_node& node, unsigned current_level);
   void rebalance_keys();
 
@@ -38,16 +43,18 @@ private:
   };
 
   keys_provider_path_part_data& current_key_providing_node();
+  void pop_key_providing_node();
 
 private:
   btree_node::pointer_t m_next_node_ptr;
   unsigned m_tree_height;
+  btree_node_pool m_node_pool;
 
-  std::unordered_set<btree_node::pointer_t> m_nodes_created_during_rebalancing;
-  std::unordered_map<btree_node::pointer_t, unsigned> m_keys_took_by_provider;
+  // Indexed by node pointers, which are dense, and grown with new_node_pointer().
+  std::vector<unsigned> m_keys_took_by_provider;
+  std::vector<bool> m_nodes_written_during_rebalancing;
 
   std::vector<keys_provider_path_part_data> m_current_key_providing_path;
-  std::unordered_set<btree_node::pointer_t> m_nodes_written_during_rebalancing;
 };
 
 template <typename DataStorage>
@@ -57,7 +64,11 @@ btree_rebalancer<DataStorage>::btree_rebalancer(DataStorage& storage,
   : btree_base<DataStorage>{ storage }
   , m_next_node_ptr{ next_node_ptr }
   , m_tree_height{ tree_height }
+  , m_node_pool{ this->order() }
+  , m_keys_took_by_provider(next_node_ptr, 0u)
+  , m_nodes_written_during_rebalancing(next_node_ptr, false)
 {
+  m_current_key_providing_path.reserve(tree_height);
 }
 
 template <typename DataStorage>
@@ -71,8 +82,9 @@ void btree_rebalancer<DataStorage>::rebalance()
   initialize_current_key_providing_path();
 
   {
-    auto root_node = this->read_node(this->root_ptr());
+    auto root_node = read_pooled_node(this->root_ptr());
     create_nodes_to_fulfill_b_tree(root_node, /*current_level=*/1u);
+    m_node_pool.release(std::move(root_node));
   }
 
   rebalance_keys();
@@ -91,8 +103,9 @@ void btree_rebalancer<DataStorage>::create_nodes_to_fulfill_b_tree(btree_node& n
 
   // Handle current rightmost child.
   if (!children_are_leafs && children_count > 0u) {
-    auto rightmost_child = this->read_node(node.rightmost_pointer());
+    auto rightmost_child = read_pooled_node(node.rightmost_pointer());
     create_nodes_to_fulfill_b_tree(rightmost_child, current_level + 1u);
+    m_node_pool.release(std::move(rightmost_child));
   }
 
   const auto expected_min_number_of_children = this->expected_min_number_of_keys(node) + 1u;
@@ -106,13 +119,11 @@ void btree_rebalancer<DataStorage>::create_nodes_to_fulfill_b_tree(btree_node& n
   // Create missing children.
   for (auto child_index = children_count; child_index < expected_min_number_of_children;
        ++child_index) {
-    auto child = btree_node{ this->order(), node.this_pointer };
+    auto child = m_node_pool.take(node.this_pointer);
     child.this_pointer = new_node_pointer();
     child.keys_count = 0u;
     child.is_leaf = children_are_leafs;
 
-    m_nodes_created_during_rebalancing.insert(child.this_pointer);
-
     node.pointers[child_index] = child.this_pointer;
 
     // If the child is leaf, just write it out. If not, handle the child's subtree.
@@ -121,6 +132,7 @@ void btree_rebalancer<DataStorage>::create_nodes_to_fulfill_b_tree(btree_node& n
     } else {
       create_nodes_to_fulfill_b_tree(child, current_level + 1u);
     }
+    m_node_pool.release(std::move(child));
   }
 
   this->write_node(node);
@@ -129,18 +141,28 @@ void btree_rebalancer<DataStorage>::create_nodes_to_fulfill_b_tree(btree_node& n
 template <typename DataStorage>
 btree_node::pointer_t btree_rebalancer<DataStorage>::new_node_pointer()
 {
+  m_keys_took_by_provider.push_back(0u);
+  m_nodes_written_during_rebalancing.push_back(false);
   return m_next_node_ptr++;
 }
 
+template <typename DataStorage>
+btree_node btree_rebalancer<DataStorage>::read_pooled_node(btree_node::pointer_t ptr)
+{
+  auto node = m_node_pool.take_for_overwrite();
+  this->read_node(ptr, node);
+  return node;
+}
+
 template <typename DataStorage>
 void btree_rebalancer<DataStorage>::rebalance_keys()
 {
-  auto root = this->read_node(this->root_ptr());
+  auto root = read_pooled_node(this->root_ptr());
   rebalance_keys_in_node(root);
+  m_node_pool.release(std::move(root));
 
   for (auto& node : m_current_key_providing_path) {
-    if (m_nodes_written_during_rebalancing.find(node.node.this_pointer) !=
-        std::cend(m_nodes_written_during_rebalancing)) {
+    if (m_nodes_written_during_rebalancing[node.node.this_pointer]) {
       continue;
     }
 
@@ -169,12 +191,13 @@ void btree_rebalancer<DataStorage>::rebalance_keys_in_node(btree_node& node)
   do {
     if (!children_are_leafs) {
       const auto child_ptr = node.pointers[key_index + 1u];
-      auto child = this->read_node(child_ptr);
+      auto child = read_pooled_node(child_ptr);
       if (child.is_leaf) {
         children_are_leafs = true;
       } else {
         rebalance_keys_in_node(child);
       }
+      m_node_pool.release(std::move(child));
     }
 
     const auto has_enough_keys =
@@ -193,15 +216,16 @@ void btree_rebalancer<DataStorage>::rebalance_keys_in_node(btree_node& node)
   if (!children_are_leafs && stopped_key_left_child_might_be_unbalanced) {
     const auto stopped_key_left_child_ptr_index = key_index + 1u;
     const auto child_ptr = node.pointers[stopped_key_left_child_ptr_index];
-    auto child = this->read_node(child_ptr);
+    auto child = read_pooled_node(child_ptr);
     rebalance_keys_in_node(child);
+    m_node_pool.release(std::move(child));
   }
 
   const auto needs_write_out =
     (key_index + 1 < static_cast<int>(number_of_keys_expected_after_rebalancing));
   if (needs_write_out) {
     node.keys_count = number_of_keys_expected_after_rebalancing;
-    m_nodes_written_during_rebalancing.insert(node.this_pointer);
+    m_nodes_written_during_rebalancing[node.this_pointer] = true;
     this->write_node(node);
   }
 }
@@ -210,11 +234,12 @@ template <typename DataStorage>
 void btree_rebalancer<DataStorage>::initialize_current_key_providing_path()
 {
   std::vector<btree_node> nodes_path;
+  nodes_path.reserve(m_tree_height);
 
   // Go to rightmost leaf node.
   auto ptr = this->root_ptr();
   while (true) {
-    auto node = this->read_node(ptr);
+    auto node = read_pooled_node(ptr);
     const auto is_leaf = node.is_leaf;
     ptr = node.rightmost_pointer();
     nodes_path.emplace_back(std::move(node));
@@ -226,6 +251,7 @@ void btree_rebalancer<DataStorage>::initialize_current_key_providing_path()
 
   // Omit all empty nodes in the path.
   while (!nodes_path.empty() && nodes_path.back().keys_count == 0u) {
+    m_node_pool.release(std::move(nodes_path.back()));
     nodes_path.pop_back();
   }
 
@@ -240,12 +266,7 @@ template <typename DataStorage>
 unsigned btree_rebalancer<DataStorage>::get_number_of_keys_taken_from_node_during_rebalance(
   const btree_node& node) const
 {
-  const auto found = m_keys_took_by_provider.find(node.this_pointer);
-  if (found == std::cend(m_keys_took_by_provider)) {
-    return 0u;
-  }
-
-  return found->second;
+  return m_keys_took_by_provider[node.this_pointer];
 }
 
 template <typename DataStorage>
@@ -266,7 +287,7 @@ sha1_t btree_rebalancer<DataStorage>::get_greatest_not_visited_key()
 
   const auto skip_empty_nodes_in_path = [this] {
     while (current_key_providing_node().node.keys_count == 0u) {
-      m_current_key_providing_path.pop_back();
+      pop_key_providing_node();
     }
   };
 
@@ -296,7 +317,7 @@ sha1_t btree_rebalancer<DataStorage>::get_greatest_not_visited_key()
     do {
       auto& cur = current_key_providing_node();
 
-      auto node = this->read_node(cur.node.pointers[cur.child_index]);
+      auto node = read_pooled_node(cur.node.pointers[cur.child_index]);
       is_leaf = node.is_leaf;
       const auto child_index = node.keys_count;
       keys_provider_path_part_data data{ std::move(node), child_index };
@@ -308,7 +329,7 @@ sha1_t btree_rebalancer<DataStorage>::get_greatest_not_visited_key()
 
   // Can not go to the left child (it does not exists). Go to the parent node.
   this->write_node(current.node);
-  m_current_key_providing_path.pop_back();
+  pop_key_providing_node();
 
   skip_empty_nodes_in_path();
 
@@ -321,4 +342,11 @@ btree_rebalancer<DataStorage>::current_key_providing_node()
 {
   return m_current_key_providing_path.back();
 }
+
+template <typename DataStorage>
+void btree_rebalancer<DataStorage>::pop_key_providing_node()
+{
+  m_node_pool.release(std::move(m_current_key_providing_path.back().node));
+  m_current_key_providing_path.pop_back();
+}
 }
@@ -1,9 +1,12 @@
 #pragma once
 
 #include "btree_base.hpp"
+#include "btree_node_pool.hpp"
 #include "btree_rebalancer.hpp"
 #include "sha1_utils.hpp"
 
+#include <cassert>
+#include <utility>
 #include <vector>
 
 namespace okon {
@@ -12,7 +15,9 @@ template <typename DataStorage>
 class btree_sorted_keys_inserter : public btree_base<DataStorage>
 {
 public:
-  explicit btree_sorted_keys_inserter(DataStorage& storage, btree_node::order_t order);
+  explicit btree_sorted_keys_inserter(DataStorage& storage, btree_node::order_t order,
+                                      btree_format_version version = btree_format_version::v1,
+                                      uint32_t node_alignment = 0u);
 
   void insert_sorted(const sha1_t& sha1);
   void finalize_inserting();
@@ -23,22 +28,31 @@ private:
   void split_root_and_grow(const sha1_t& sha1, unsigned level_from_leafs);
   void create_children_till_leaf(unsigned level_from_leafs);
   btree_node& current_node();
+  void pop_current_node();
 
 private:
   DataStorage& m_storage;
   btree_node::pointer_t m_next_node_ptr{ 0u };
+
+  // Nodes popped from the path are reused for the next ones.
+  btree_node_pool m_node_pool;
   std::vector<btree_node> m_current_path;
   unsigned m_tree_height;
 };
 
 template <typename DataStorage>
 btree_sorted_keys_inserter<DataStorage>::btree_sorted_keys_inserter(DataStorage& storage,
-                                                                    btree_node::order_t order)
-  : btree_base<DataStorage>{ storage, order }
+                                                                    btree_node::order_t order,
+                                                                    btree_format_version version,
+                                                                    uint32_t node_alignment)
+  : btree_base<DataStorage>{ storage, order, version, node_alignment }
   , m_storage{ storage }
+  , m_node_pool{ order }
   , m_tree_height{ 1u }
 {
-  auto& root = m_current_path.emplace_back(order, btree_node::k_unused_pointer);
+  assert(!this->has_compact_leaves() && "leaves have to follow inner nodes, see btree_bulk_loader");
+
+  auto& root = m_current_path.emplace_back(m_node_pool.take(btree_node::k_unused_pointer));
 
   root.this_pointer = new_node_pointer();
   root.is_leaf = true;
@@ -81,7 +95,7 @@ void btree_sorted_keys_inserter<DataStorage>::split_node(const sha1_t& sha1,
   } else {
 
     this->write_node(current_node());
-    m_current_path.pop_back();
+    pop_current_node();
 
     auto& parent_node = current_node();
     if (parent_node.is_full()) {
@@ -104,9 +118,9 @@ void btree_sorted_keys_inserter<DataStorage>::split_root_and_grow(const sha1_t&
 
   old_root.parent_pointer = new_root_ptr;
   this->write_node(old_root);
-  m_current_path.pop_back();
+  pop_current_node();
 
-  auto& new_root = m_current_path.emplace_back(this->order(), btree_node::k_unused_pointer);
+  auto& new_root = m_current_path.emplace_back(m_node_pool.take(btree_node::k_unused_pointer));
   new_root.insert(sha1);
   new_root.pointers[0] = old_root_ptr;
   new_root.this_pointer = new_root_ptr;
@@ -126,7 +140,7 @@ void btree_sorted_keys_inserter<DataStorage>::create_children_till_leaf(unsigned
   const auto parent_ptr = current_node().this_pointer;
   const auto parent_place_in_current_path = m_current_path.size() - 1u;
 
-  auto& node = m_current_path.emplace_back(this->order(), parent_ptr);
+  auto& node = m_current_path.emplace_back(m_node_pool.take(parent_ptr));
   node.this_pointer = new_node_pointer();
   node.keys_count = 0u;
   node.is_leaf = is_on_leaf_level;
@@ -146,4 +160,11 @@ btree_node& btree_sorted_keys_inserter<DataStorage>::current_node()
 {
   return m_current_path.back();
 }
+
+template <typename DataStorage>
+void btree_sorted_keys_inserter<DataStorage>::pop_current_node()
+{
+  m_node_pool.release(std::move(m_current_path.back()));
+  m_current_path.pop_back();
+}
 }
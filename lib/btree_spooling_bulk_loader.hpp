@@ -0,0 +1,103 @@
+#pragma once
+
+#include "btree_bulk_loader.hpp"
+#include "sha1_utils.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace okon {
+// Bulk-loads a B-tree from sorted keys whose number is not known up front, e.g. keys of a merge,
+// where keys present in both inputs are written once. Keys are written to `spool_storage` as they
+// come, and loaded into the tree by finalize_inserting(), once they're all counted. Writes the
+// keys twice, but produces the same tree as btree_bulk_loader, in any format.
+template <typename DataStorage>
+class btree_spooling_bulk_loader
+{
+public:
+  explicit btree_spooling_bulk_loader(DataStorage& storage, DataStorage& spool_storage,
+                                      btree_node::order_t order,
+                                      btree_format_version version = btree_format_version::v1,
+                                      uint32_t node_alignment = 0u);
+
+  void insert_sorted(const sha1_t& sha1);
+  void finalize_inserting();
+
+private:
+  void flush_keys_buffer();
+
+private:
+  static constexpr auto k_keys_buffer_size{ 1024u * 64u };
+
+  DataStorage& m_storage;
+  DataStorage& m_spool_storage;
+  btree_node::order_t m_order;
+  btree_format_version m_version;
+  uint32_t m_node_alignment;
+  uint64_t m_keys_count{ 0u };
+  std::vector<sha1_t> m_keys_buffer;
+};
+
+template <typename DataStorage>
+btree_spooling_bulk_loader<DataStorage>::btree_spooling_bulk_loader(DataStorage& storage,
+                                                                    DataStorage& spool_storage,
+                                                                    btree_node::order_t order,
+                                                                    btree_format_version version,
+                                                                    uint32_t node_alignment)
+  : m_storage{ storage }
+  , m_spool_storage{ spool_storage }
+  , m_order{ order }
+  , m_version{ version }
+  , m_node_alignment{ node_alignment }
+{
+  m_keys_buffer.reserve(k_keys_buffer_size);
+  m_spool_storage.seek_out(0u);
+}
+
+template <typename DataStorage>
+void btree_spooling_bulk_loader<DataStorage>::insert_sorted(const sha1_t& sha1)
+{
+  m_keys_buffer.push_back(sha1);
+  ++m_keys_count;
+
+  if (m_keys_buffer.size() == k_keys_buffer_size) {
+    flush_keys_buffer();
+  }
+}
+
+template <typename DataStorage>
+void btree_spooling_bulk_loader<DataStorage>::finalize_inserting()
+{
+  flush_keys_buffer();
+
+  btree_bulk_loader<DataStorage> loader{ m_storage, m_order, m_keys_count, m_version,
+                                         m_node_alignment };
+
+  m_spool_storage.seek_in(0u);
+  m_keys_buffer.resize(k_keys_buffer_size);
+
+  for (uint64_t loaded = 0u; loaded < m_keys_count;) {
+    const auto count = std::min<uint64_t>(k_keys_buffer_size, m_keys_count - loaded);
+    m_spool_storage.read(m_keys_buffer.data(), count * sizeof(sha1_t));
+
+    for (auto i = 0u; i < count; ++i) {
+      loader.insert_sorted(m_keys_buffer[i]);
+    }
+    loaded += count;
+  }
+
+  loader.finalize_inserting();
+}
+
+template <typename DataStorage>
+void btree_spooling_bulk_loader<DataStorage>::flush_keys_buffer()
+{
+  if (m_keys_buffer.empty()) {
+    return;
+  }
+
+  m_spool_storage.write(m_keys_buffer.data(), m_keys_buffer.size() * sizeof(sha1_t));
+  m_keys_buffer.clear();
+}
+}
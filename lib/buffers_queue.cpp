@@ -1,62 +1,129 @@
 #include "buffers_queue.hpp"
 
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#  include <immintrin.h>
+#endif
+
 namespace okon {
-buffers_queue::semaphore::semaphore(int count)
-  : m_count(count)
+namespace {
+// Checks of the awaited state before the thread is parked. A chunk is parsed in much longer time
+// than this, so spinning only helps when the other thread is just about to finish.
+constexpr auto k_spins_before_parking{ 1024u };
+
+void cpu_relax()
 {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+  _mm_pause();
+#endif
+}
 }
 
-void buffers_queue::semaphore::notify()
+template <typename Predicate>
+void buffers_queue::waiter::wait_until(Predicate is_ready)
 {
+  // The clock is read only when the thread has to wait, so the threads that keep up with each other
+  // don't pay for it.
+  if (is_ready()) {
+    return;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  const auto add_waited_time = [this, start] {
+    const auto waited = std::chrono::steady_clock::now() - start;
+    m_waited_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count(),
+                          std::memory_order_relaxed);
+  };
+
+  for (auto i = 0u; i < k_spins_before_parking; ++i) {
+    if (is_ready()) {
+      add_waited_time();
+      return;
+    }
+    cpu_relax();
+  }
+
   std::unique_lock<std::mutex> lock(m_mtx);
-  ++m_count;
-  m_cv.notify_one();
+  m_is_parked.store(true, std::memory_order_relaxed);
+
+  // Pairs with the fence in notify(). Either the notifying thread sees the flag, or this one sees
+  // the new state.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  while (!is_ready()) {
+    m_cv.wait(lock);
+  }
+
+  m_is_parked.store(false, std::memory_order_relaxed);
+  add_waited_time();
 }
 
-void buffers_queue::semaphore::wait()
+void buffers_queue::waiter::notify()
 {
-  std::unique_lock<std::mutex> lock(m_mtx);
-  while (m_count == 0) {
-    m_cv.wait(lock);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (!m_is_parked.load(std::memory_order_relaxed)) {
+    return;
   }
-  --m_count;
+
+  // Taking the lock makes sure that the parked thread is already waiting on the condition variable.
+  std::unique_lock<std::mutex> lock(m_mtx);
+  m_cv.notify_one();
+}
+
+std::chrono::nanoseconds buffers_queue::waiter::waited_time() const
+{
+  return std::chrono::nanoseconds{ m_waited_ns.load(std::memory_order_relaxed) };
 }
 
 buffers_queue::buffers_queue(unsigned buffer_size, unsigned number_of_buffers)
   : m_buffers{ number_of_buffers, std::vector<uint8_t>(buffer_size) }
-  , m_processing_semaphore{ static_cast<int>(number_of_buffers) }
 {
 }
 
-unsigned buffers_queue::take_for_data_storing()
+std::optional<unsigned> buffers_queue::take_for_data_storing()
 {
-  m_processing_semaphore.wait();
-  const auto index_to_return = m_write_buffer_index;
-  m_write_buffer_index = next_to(m_write_buffer_index);
-  return index_to_return;
+  // The buffer is free once the processing thread is done with the buffer stored a round ago.
+  const auto buffers_count = m_buffers.size();
+  m_storing_waiter.wait_until([this, buffers_count] {
+    return m_storing_position - m_processed_count.load(std::memory_order_acquire) <
+             buffers_count ||
+           m_is_stopped.load(std::memory_order_acquire);
+  });
+
+  if (m_is_stopped.load(std::memory_order_acquire)) {
+    return std::nullopt;
+  }
+
+  return index_of(m_storing_position);
 }
 
 void buffers_queue::data_storing_ready()
 {
-  m_storing_semaphore.notify();
+  ++m_storing_position;
+  m_stored_count.store(m_storing_position, std::memory_order_release);
+  m_processing_waiter.notify();
 }
 
 std::optional<unsigned> buffers_queue::take_for_processing()
 {
-  m_storing_semaphore.wait();
+  m_processing_waiter.wait_until([this] {
+    return m_stored_count.load(std::memory_order_acquire) > m_processing_position ||
+           !m_has_more_data.load(std::memory_order_acquire);
+  });
 
-  if (!m_has_more_data && next_to(m_process_buffer_index) == m_write_buffer_index) {
+  // No more data is signaled after the last buffer is stored, so the buffers stored before are
+  // still processed.
+  if (m_stored_count.load(std::memory_order_acquire) == m_processing_position) {
     return std::nullopt;
   }
 
-  const auto index_to_return = m_process_buffer_index;
-  m_process_buffer_index = next_to(m_process_buffer_index);
-  return index_to_return;
+  return index_of(m_processing_position++);
 }
 
 void buffers_queue::processing_ready()
 {
-  m_processing_semaphore.notify();
+  m_processed_count.store(m_processed_count.load(std::memory_order_relaxed) + 1u,
+                          std::memory_order_release);
+  m_storing_waiter.notify();
 }
 
 std::vector<uint8_t>& buffers_queue::access_buffer(unsigned buffer_index)
@@ -66,12 +133,28 @@ std::vector<uint8_t>& buffers_queue::access_buffer(unsigned buffer_index)
 
 void buffers_queue::notify_no_more_data()
 {
-  m_has_more_data = false;
-  m_storing_semaphore.notify();
+  m_has_more_data.store(false, std::memory_order_release);
+  m_processing_waiter.notify();
+}
+
+void buffers_queue::stop()
+{
+  m_is_stopped.store(true, std::memory_order_release);
+  m_storing_waiter.notify();
+}
+
+std::chrono::nanoseconds buffers_queue::storing_stall_time() const
+{
+  return m_storing_waiter.waited_time();
+}
+
+std::chrono::nanoseconds buffers_queue::processing_stall_time() const
+{
+  return m_processing_waiter.waited_time();
 }
 
-unsigned buffers_queue::next_to(unsigned val)
+unsigned buffers_queue::index_of(unsigned long long position) const
 {
-  return (val + 1u) % m_buffers.size();
+  return static_cast<unsigned>(position % m_buffers.size());
 }
 }
@@ -1,34 +1,51 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstddef>
 #include <cstdint>
 #include <mutex>
 #include <optional>
 #include <vector>
 
 namespace okon {
+// Ring of buffers passed from one storing thread to one processing thread. Both sides wait for
+// each other lock-free: they spin for a while and only then park, so as long as the threads keep
+// up with each other, no lock is taken.
 class buffers_queue
 {
 private:
-  class semaphore
+  // Size of a cache line, so indices written by different threads don't share one.
+  static constexpr std::size_t k_cache_line_size{ 64u };
+
+  // Place where one of the threads waits for the other one. The thread that changes the state
+  // notifies the other one only if it's parked.
+  class waiter
   {
   public:
-    explicit semaphore(int count = 0);
+    template <typename Predicate>
+    void wait_until(Predicate is_ready);
 
     void notify();
 
-    void wait();
+    // Total time spent in wait_until() when the state wasn't ready right away.
+    std::chrono::nanoseconds waited_time() const;
 
   private:
     std::mutex m_mtx;
     std::condition_variable m_cv;
-    int m_count;
+    std::atomic<bool> m_is_parked{ false };
+
+    // Written by the waiting thread only, atomic so it can be read while the thread runs.
+    std::atomic<std::chrono::nanoseconds::rep> m_waited_ns{ 0 };
   };
 
 public:
   explicit buffers_queue(unsigned buffer_size, unsigned number_of_buffers);
 
-  unsigned take_for_data_storing();
+  // Returns std::nullopt if the queue is stopped.
+  std::optional<unsigned> take_for_data_storing();
   void data_storing_ready();
 
   std::optional<unsigned> take_for_processing();
@@ -38,15 +55,35 @@ public:
 
   void notify_no_more_data();
 
+  // Makes the storing thread stop, e.g. when the processing is finished before all the data is
+  // stored. take_for_data_storing() returns std::nullopt then.
+  void stop();
+
+  // Time the storing thread waited for a free buffer, i.e. for the processing.
+  std::chrono::nanoseconds storing_stall_time() const;
+
+  // Time the processing thread waited for stored data.
+  std::chrono::nanoseconds processing_stall_time() const;
+
 private:
-  unsigned next_to(unsigned val);
+  unsigned index_of(unsigned long long position) const;
 
 private:
   std::vector<std::vector<uint8_t>> m_buffers;
-  semaphore m_storing_semaphore;
-  semaphore m_processing_semaphore;
-  unsigned m_write_buffer_index{ 0u };
-  unsigned m_process_buffer_index{ 0u };
-  bool m_has_more_data{ true };
+
+  // Positions are counters of buffers that passed a given point since the start. They only grow and
+  // every one of them is written by one thread.
+  alignas(k_cache_line_size) std::atomic<unsigned long long> m_stored_count{ 0u };
+  alignas(k_cache_line_size) std::atomic<unsigned long long> m_processed_count{ 0u };
+  alignas(k_cache_line_size) std::atomic<bool> m_has_more_data{ true };
+  std::atomic<bool> m_is_stopped{ false };
+
+  // Used by the storing thread only.
+  alignas(k_cache_line_size) unsigned long long m_storing_position{ 0u };
+  waiter m_storing_waiter;
+
+  // Used by the processing thread only.
+  alignas(k_cache_line_size) unsigned long long m_processing_position{ 0u };
+  waiter m_processing_waiter;
 };
 }
@@ -0,0 +1,459 @@
+#include "database.hpp"
+
+#include "btree.hpp"
+#include "btree_keys_reader.hpp"
+#include "file_format.hpp"
+#include "flat_sorted_file.hpp"
+#include "shards_manifest.hpp"
+#include "sorted_array_keys_reader.hpp"
+#include "static_tree.hpp"
+
+#include <array>
+#include <limits>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace okon {
+namespace {
+// Readers start from the first key not less than `first`, or from the first key if it's nullptr.
+std::unique_ptr<sorted_keys_reader> make_keys_reader(mmap_storage&,
+                                                     const btree<mmap_storage>& tree,
+                                                     const sha1_t* first)
+{
+  using reader_t = sorted_keys_reader_adapter<btree_keys_reader<mmap_storage>>;
+  return first ? std::make_unique<reader_t>(tree, *first) : std::make_unique<reader_t>(tree);
+}
+
+std::unique_ptr<sorted_keys_reader> make_keys_reader(mmap_storage& file,
+                                                     const static_tree<mmap_storage>& tree,
+                                                     const sha1_t* first)
+{
+  const auto& geometry = tree.geometry();
+  return std::make_unique<sorted_keys_reader_adapter<sorted_array_keys_reader<mmap_storage>>>(
+    file, geometry.keys_offset(), geometry.keys_count(), first ? tree.lower_bound(*first) : 0u,
+    geometry.has_counts() ? std::optional{ geometry.counts_offset() } : std::nullopt);
+}
+
+std::unique_ptr<sorted_keys_reader> make_keys_reader(mmap_storage& file,
+                                                     const flat_sorted_file<mmap_storage>& flat,
+                                                     const sha1_t* first)
+{
+  const auto& layout = flat.layout();
+  return std::make_unique<sorted_keys_reader_adapter<sorted_array_keys_reader<mmap_storage>>>(
+    file, layout.keys_offset(), layout.keys_count(), first ? flat.lower_bound(*first) : 0u,
+    layout.has_counts() ? std::optional{ layout.counts_offset() } : std::nullopt);
+}
+
+// Btrees don't store counts, every key occurs once.
+uint32_t key_count(const btree<mmap_storage>& tree, const sha1_t& sha1)
+{
+  return tree.contains(sha1) ? 1u : 0u;
+}
+
+template <typename Tree>
+uint32_t key_count(const Tree& tree, const sha1_t& sha1)
+{
+  return tree.count(sha1);
+}
+
+template <typename Tree>
+class tree_database final : public database
+{
+public:
+  explicit tree_database(mmap_storage& file)
+    : m_file{ file }
+    , m_tree{ file }
+  {
+  }
+
+  bool contains(const sha1_t& sha1) const override
+  {
+    return m_tree.contains(sha1);
+  }
+
+  uint32_t count(const sha1_t& sha1) const override
+  {
+    return key_count(m_tree, sha1);
+  }
+
+  void contains_sorted_batch(const sha1_t* keys, const std::size_t* sorted_queries,
+                             std::size_t count, uint8_t* results) const override
+  {
+    m_tree.contains_sorted_batch(keys, sorted_queries, count, results);
+  }
+
+  std::unique_ptr<sorted_keys_reader> read_keys() const override
+  {
+    return make_keys_reader(m_file, m_tree, nullptr);
+  }
+
+  std::unique_ptr<sorted_keys_reader> read_keys_from(const sha1_t& first) const override
+  {
+    return make_keys_reader(m_file, m_tree, &first);
+  }
+
+  void observe(lookup_stats& stats) override
+  {
+    if constexpr (std::is_same_v<Tree, btree<mmap_storage>>) {
+      m_tree.observe(&stats);
+    }
+  }
+
+  Tree& tree()
+  {
+    return m_tree;
+  }
+
+private:
+  mmap_storage& m_file;
+  Tree m_tree;
+};
+
+class filtered_database final : public database
+{
+public:
+  explicit filtered_database(std::unique_ptr<database> db, const blocked_bloom_filter& filter)
+    : m_db{ std::move(db) }
+    , m_filter{ filter }
+  {
+  }
+
+  bool contains(const sha1_t& sha1) const override
+  {
+    return m_filter.may_contain(sha1) && m_db->contains(sha1);
+  }
+
+  uint32_t count(const sha1_t& sha1) const override
+  {
+    return m_filter.may_contain(sha1) ? m_db->count(sha1) : 0u;
+  }
+
+  void contains_sorted_batch(const sha1_t* keys, const std::size_t* sorted_queries,
+                             std::size_t count, uint8_t* results) const override
+  {
+    // Only the queries that passed the filter go to the database, still sorted.
+    std::vector<std::size_t> candidates;
+    candidates.reserve(count);
+
+    for (std::size_t i = 0u; i < count; ++i) {
+      const auto query = sorted_queries[i];
+      if (m_filter.may_contain(keys[query])) {
+        candidates.push_back(query);
+      } else {
+        results[query] = 0u;
+      }
+    }
+
+    m_db->contains_sorted_batch(keys, candidates.data(), candidates.size(), results);
+  }
+
+  std::unique_ptr<sorted_keys_reader> read_keys() const override
+  {
+    return m_db->read_keys();
+  }
+
+  std::unique_ptr<sorted_keys_reader> read_keys_from(const sha1_t& first) const override
+  {
+    return m_db->read_keys_from(first);
+  }
+
+  void observe(lookup_stats& stats) override
+  {
+    m_db->observe(stats);
+  }
+
+private:
+  std::unique_ptr<database> m_db;
+  blocked_bloom_filter m_filter;
+};
+
+// Standalone filter. Keys rejected by the filter are not in the file, the rest probably are.
+class filter_only_database final : public database
+{
+public:
+  explicit filter_only_database(const blocked_bloom_filter& filter)
+    : m_filter{ filter }
+  {
+  }
+
+  bool contains(const sha1_t& sha1) const override
+  {
+    return m_filter.may_contain(sha1);
+  }
+
+  uint32_t count(const sha1_t& sha1) const override
+  {
+    return m_filter.may_contain(sha1) ? 1u : 0u;
+  }
+
+  void contains_sorted_batch(const sha1_t* keys, const std::size_t* sorted_queries,
+                             std::size_t count, uint8_t* results) const override
+  {
+    for (std::size_t i = 0u; i < count; ++i) {
+      const auto query = sorted_queries[i];
+      results[query] = m_filter.may_contain(keys[query]) ? 1u : 0u;
+    }
+  }
+
+  std::unique_ptr<sorted_keys_reader> read_keys() const override
+  {
+    return nullptr;
+  }
+
+  std::unique_ptr<sorted_keys_reader> read_keys_from(const sha1_t&) const override
+  {
+    return nullptr;
+  }
+
+private:
+  blocked_bloom_filter m_filter;
+};
+
+// Keys of consecutive shards, one shard after another.
+class sharded_keys_reader final : public sorted_keys_reader
+{
+public:
+  explicit sharded_keys_reader(const std::vector<std::unique_ptr<mapped_database>>& shards,
+                               std::size_t first_shard,
+                               std::unique_ptr<sorted_keys_reader> first_shard_reader)
+    : m_shards{ shards }
+    , m_shard{ first_shard }
+    , m_reader{ std::move(first_shard_reader) }
+  {
+  }
+
+  std::optional<sha1_t> next() override
+  {
+    while (m_reader) {
+      if (auto key = m_reader->next()) {
+        return key;
+      }
+
+      m_reader = ++m_shard < m_shards.size() ? m_shards[m_shard]->db->read_keys() : nullptr;
+    }
+
+    return std::nullopt;
+  }
+
+  uint32_t count() const override
+  {
+    return m_reader->count();
+  }
+
+private:
+  const std::vector<std::unique_ptr<mapped_database>>& m_shards;
+  std::size_t m_shard;
+  std::unique_ptr<sorted_keys_reader> m_reader;
+};
+
+// Database split into shards by the first byte of the keys, see shards_manifest. Every lookup
+// goes to one shard only.
+class sharded_database final : public database
+{
+public:
+  explicit sharded_database(std::vector<std::unique_ptr<mapped_database>> shards,
+                            const std::array<uint8_t, 256u>& shard_of_first_byte)
+    : m_shards{ std::move(shards) }
+    , m_shard_of_first_byte{ shard_of_first_byte }
+  {
+  }
+
+  bool contains(const sha1_t& sha1) const override
+  {
+    return shard_of(sha1).contains(sha1);
+  }
+
+  uint32_t count(const sha1_t& sha1) const override
+  {
+    return shard_of(sha1).count(sha1);
+  }
+
+  void contains_sorted_batch(const sha1_t* keys, const std::size_t* sorted_queries,
+                             std::size_t count, uint8_t* results) const override
+  {
+    // Sorted queries of a shard are next to each other, so every shard gets one sorted batch.
+    for (std::size_t begin = 0u; begin < count;) {
+      const auto shard = m_shard_of_first_byte[keys[sorted_queries[begin]][0]];
+      auto end = begin + 1u;
+      while (end < count && m_shard_of_first_byte[keys[sorted_queries[end]][0]] == shard) {
+        ++end;
+      }
+
+      m_shards[shard]->db->contains_sorted_batch(keys, sorted_queries + begin, end - begin,
+                                                 results);
+      begin = end;
+    }
+  }
+
+  std::unique_ptr<sorted_keys_reader> read_keys() const override
+  {
+    auto reader = m_shards.front()->db->read_keys();
+    if (!reader) {
+      return nullptr;
+    }
+
+    return std::make_unique<sharded_keys_reader>(m_shards, 0u, std::move(reader));
+  }
+
+  std::unique_ptr<sorted_keys_reader> read_keys_from(const sha1_t& first) const override
+  {
+    const auto shard = m_shard_of_first_byte[first[0]];
+    auto reader = m_shards[shard]->db->read_keys_from(first);
+    if (!reader) {
+      return nullptr;
+    }
+
+    return std::make_unique<sharded_keys_reader>(m_shards, shard, std::move(reader));
+  }
+
+  void observe(lookup_stats& stats) override
+  {
+    for (auto& shard : m_shards) {
+      shard->db->observe(stats);
+    }
+  }
+
+private:
+  const database& shard_of(const sha1_t& sha1) const
+  {
+    return *m_shards[m_shard_of_first_byte[sha1[0]]]->db;
+  }
+
+private:
+  std::vector<std::unique_ptr<mapped_database>> m_shards;
+  std::array<uint8_t, 256u> m_shard_of_first_byte;
+};
+
+residency residency_of(const okon_open_options& options)
+{
+  return residency{ options.resident != 0, uint64_t{ options.huge_page_size } };
+}
+
+std::unique_ptr<database> open_filter(mmap_storage& file)
+{
+  const auto filter = blocked_bloom_filter::from_memory(file.data(), file.size());
+  if (!filter) {
+    return nullptr;
+  }
+
+  return std::make_unique<filter_only_database>(*filter);
+}
+
+std::unique_ptr<database> open_btree(mmap_storage& file, const okon_open_options& options)
+{
+  auto db = std::make_unique<tree_database<btree<mmap_storage>>>(file);
+
+  if (options.pinned_levels > 0u) {
+    const auto budget = options.pinned_bytes_budget == 0u
+      ? std::numeric_limits<uint64_t>::max()
+      : uint64_t{ options.pinned_bytes_budget };
+    db->tree().pin_levels(options.pinned_levels, budget);
+  }
+
+  return db;
+}
+
+std::unique_ptr<database> open_shards(mmap_storage& file, std::string_view path,
+                                      const okon_open_options& options)
+{
+  const auto manifest = shards_manifest::from_memory(file.data(), file.size(), path);
+  if (!manifest) {
+    return nullptr;
+  }
+
+  std::vector<std::unique_ptr<mapped_database>> shards;
+  std::array<uint8_t, 256u> shard_of_first_byte{};
+  for (const auto& shard : manifest->shards()) {
+    for (auto byte = unsigned{ shard.first_byte }; byte <= shard.last_byte; ++byte) {
+      shard_of_first_byte[byte] = static_cast<uint8_t>(shards.size());
+    }
+
+    // A database is usable only with all of its shards.
+    auto mapped = std::make_unique<mapped_database>(shard.path, options);
+    if (!mapped->is_open()) {
+      return nullptr;
+    }
+    shards.push_back(std::move(mapped));
+  }
+
+  return std::make_unique<sharded_database>(std::move(shards), shard_of_first_byte);
+}
+}
+
+std::unique_ptr<database> open_database(mmap_storage& file, std::string_view path,
+                                        const okon_open_options& options)
+{
+  if (!file.is_open() || file.size() < sizeof(uint32_t)) {
+    return nullptr;
+  }
+
+  // A lookup reads a few scattered pages. Reading ahead of them would only evict pages that other
+  // lookups need.
+  file.advise(0u, file.size(), access_pattern::random);
+
+  const auto format = read_file_format(file);
+  // v1 files have no extended header, their keys are SHA-1 ones, see read_key_size(). Keys of the
+  // shards are checked when the shards are opened.
+  const auto has_extended_header = format != file_format::btree_v1;
+  if (format != file_format::shards_manifest &&
+      ((has_extended_header && file.size() < k_extended_header_size) ||
+       read_key_size(file) != k_key_size)) {
+    // Keys of another size than the one the library has been built for.
+    return nullptr;
+  }
+
+  switch (format) {
+    case file_format::btree_v1:
+    case file_format::btree_v2:
+    case file_format::btree_v3:
+    case file_format::btree_v4:
+      return open_btree(file, options);
+    case file_format::static_tree:
+      if (!static_tree<mmap_storage>::is_valid(file, file.size())) {
+        return nullptr;
+      }
+      // Internal layers of a static tree are small and dense, they don't need to be pinned.
+      return std::make_unique<tree_database<static_tree<mmap_storage>>>(file);
+    case file_format::flat_sorted:
+      if (!flat_sorted_file<mmap_storage>::is_valid(file, file.size())) {
+        return nullptr;
+      }
+      return std::make_unique<tree_database<flat_sorted_file<mmap_storage>>>(file);
+    case file_format::blocked_bloom_filter:
+      return open_filter(file);
+    case file_format::shards_manifest:
+      return open_shards(file, path, options);
+  }
+
+  return nullptr;
+}
+
+std::unique_ptr<database> filter_database(std::unique_ptr<database> db,
+                                          const blocked_bloom_filter& filter)
+{
+  return std::make_unique<filtered_database>(std::move(db), filter);
+}
+
+mapped_database::mapped_database(std::string_view path, const okon_open_options& options)
+  : file{ path, residency_of(options) }
+  , filter_file{ filter_file_path(path), residency_of(options) }
+  , db{ open_database(file, path, options) }
+{
+  // Every lookup reads one block of the filter.
+  filter_file.advise(0u, filter_file.size(), access_pattern::random);
+
+  const auto filter = blocked_bloom_filter::from_memory(filter_file.data(), filter_file.size());
+
+  // A filter of an older version of the prepared file would reject its new keys.
+  if (db && filter && filter->prepared_file_size() == file.size()) {
+    db = filter_database(std::move(db), *filter);
+  }
+}
+
+bool mapped_database::is_open() const
+{
+  return file.is_open() && db != nullptr;
+}
+}
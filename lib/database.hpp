@@ -0,0 +1,68 @@
+#pragma once
+
+#include <okon/okon.h>
+
+#include "blocked_bloom_filter.hpp"
+#include "lookup_stats.hpp"
+#include "mmap_storage.hpp"
+#include "sha1_utils.hpp"
+#include "sorted_keys_reader.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+
+namespace okon {
+// Lookups in a prepared file, independent of the format the file has been prepared in.
+class database
+{
+public:
+  virtual ~database() = default;
+
+  virtual bool contains(const sha1_t& sha1) const = 0;
+
+  // Returns number of occurrences of `sha1`, 0 if it's not in the file. Every key of a file
+  // prepared without counts occurs once.
+  virtual uint32_t count(const sha1_t& sha1) const = 0;
+
+  // See btree::contains_sorted_batch().
+  virtual void contains_sorted_batch(const sha1_t* keys, const std::size_t* sorted_queries,
+                                     std::size_t count, uint8_t* results) const = 0;
+
+  // Returns a reader of all the keys, in ascending order, or nullptr if the file doesn't store the
+  // keys, e.g. it's a filter.
+  virtual std::unique_ptr<sorted_keys_reader> read_keys() const = 0;
+
+  // Same as above, but starts from the first key not less than `first`.
+  virtual std::unique_ptr<sorted_keys_reader> read_keys_from(const sha1_t& first) const = 0;
+
+  // Lookups of B-trees report the nodes they visit to `stats`, see btree::observe(). Other
+  // formats don't visit nodes.
+  virtual void observe(lookup_stats&)
+  {
+  }
+};
+
+// Detects format of the mapped `file` and opens it. Returns nullptr if the format is unknown.
+// `path` is the path of the file, shards of a shards_manifest are opened relative to it.
+std::unique_ptr<database> open_database(mmap_storage& file, std::string_view path,
+                                        const okon_open_options& options);
+
+// Answers lookups of keys rejected by `filter` without touching `db`. The filter's memory has to
+// outlive the returned database.
+std::unique_ptr<database> filter_database(std::unique_ptr<database> db,
+                                          const blocked_bloom_filter& filter);
+
+// Prepared file mapped for lookups. If the file has a filter built for it, the filter is mapped
+// too and checked first.
+struct mapped_database
+{
+  explicit mapped_database(std::string_view path, const okon_open_options& options);
+
+  bool is_open() const;
+
+  mmap_storage file;
+  mmap_storage filter_file;
+  std::unique_ptr<database> db;
+};
+}
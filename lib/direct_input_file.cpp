@@ -0,0 +1,291 @@
+#include "direct_input_file.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+// Alignment of buffers, offsets and sizes of O_DIRECT reads. It's not smaller than the logical
+// block size of common devices.
+constexpr std::size_t k_direct_alignment{ 4096u };
+
+std::size_t align_up(std::size_t value, std::size_t alignment)
+{
+  return (value + alignment - 1u) / alignment * alignment;
+}
+}
+
+namespace okon {
+direct_input_file::direct_input_file(std::string_view path, std::size_t block_size,
+                                     unsigned blocks_in_flight)
+  : m_block_size{ align_up(std::max<std::size_t>(block_size, 1u), k_direct_alignment) }
+{
+  const std::string path_string{ path };
+
+#ifdef O_DIRECT
+  m_fd = ::open(path_string.c_str(), O_RDONLY | O_DIRECT);
+  m_is_direct = m_fd >= 0;
+#endif
+
+  // E.g. tmpfs doesn't support O_DIRECT at all.
+  if (m_fd < 0) {
+    m_fd = ::open(path_string.c_str(), O_RDONLY);
+  }
+
+  if (m_fd < 0) {
+    return;
+  }
+
+  struct stat file_stat;
+  if (::fstat(m_fd, &file_stat) == 0) {
+    m_size = static_cast<size_type_t>(file_stat.st_size);
+  }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+  if (!m_is_direct) {
+    ::posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  }
+#endif
+
+  m_blocks.resize(std::max(1u, blocks_in_flight));
+  for (auto& b : m_blocks) {
+    void* data{ nullptr };
+    if (::posix_memalign(&data, k_direct_alignment, m_block_size) != 0) {
+      release();
+      return;
+    }
+    b.data = static_cast<uint8_t*>(data);
+  }
+
+  for (auto& b : m_blocks) {
+    submit(b);
+  }
+}
+
+direct_input_file::~direct_input_file()
+{
+  release();
+}
+
+direct_input_file::size_type_t direct_input_file::read(void* ptr, size_type_t size)
+{
+  auto* const out = static_cast<uint8_t*>(ptr);
+  size_type_t read_size{ 0u };
+
+  while (read_size < size && !m_is_at_end && is_open()) {
+    auto& b = m_blocks[m_current_block];
+    wait_for(b);
+
+    // The data before the error isn't trusted either, e.g. a short read may be cut mid-line.
+    if (b.has_error) {
+      m_has_error = true;
+      m_is_at_end = true;
+      break;
+    }
+
+    // After a skip, a failed read may give less than the skipped part of the block.
+    b.consumed = std::min(b.consumed, b.size);
+    const auto size_to_copy = std::min(size - read_size, b.size - b.consumed);
+    std::memcpy(out + read_size, b.data + b.consumed, size_to_copy);
+    read_size += size_to_copy;
+    b.consumed += size_to_copy;
+
+    if (b.consumed < b.size) {
+      continue;
+    }
+
+    // Only the last block of the file is shorter.
+    if (b.size < m_block_size) {
+      m_is_at_end = true;
+      break;
+    }
+
+    drop_from_page_cache(b);
+    submit(b);
+    m_current_block = (m_current_block + 1u) % m_blocks.size();
+  }
+
+  return read_size;
+}
+
+direct_input_file::size_type_t direct_input_file::skip(size_type_t size)
+{
+  if (!is_open() || m_is_at_end) {
+    return 0u;
+  }
+
+  const auto& current = m_blocks[m_current_block];
+  const auto position = static_cast<size_type_t>(current.request.aio_offset) + current.consumed;
+  const auto target = std::max(position, std::min(m_size, position + size));
+
+  // Blocks are submitted again, so their reads in flight need to finish first.
+  for (auto& b : m_blocks) {
+    if (b.state == block_state::submitted) {
+      wait_for(b);
+    }
+  }
+
+  // O_DIRECT reads start at aligned offsets, the rest of the aligned part is consumed.
+  m_next_offset = target / k_direct_alignment * k_direct_alignment;
+  const auto consumed = target - m_next_offset;
+  for (auto i = 0u; i < m_blocks.size(); ++i) {
+    submit(m_blocks[(m_current_block + i) % m_blocks.size()]);
+  }
+  m_blocks[m_current_block].consumed = consumed;
+
+  return target - position;
+}
+
+bool direct_input_file::is_open() const
+{
+  return m_fd >= 0;
+}
+
+std::optional<direct_input_file::size_type_t> direct_input_file::size() const
+{
+  if (!is_open()) {
+    return std::nullopt;
+  }
+
+  return m_size;
+}
+
+bool direct_input_file::has_error() const
+{
+  return m_has_error;
+}
+
+bool direct_input_file::is_direct() const
+{
+  return m_is_direct;
+}
+
+void direct_input_file::submit(block& b)
+{
+  b.request = aiocb{};
+  b.request.aio_fildes = m_fd;
+  b.request.aio_buf = b.data;
+  b.request.aio_nbytes = m_block_size;
+  b.request.aio_offset = static_cast<off_t>(m_next_offset);
+  b.size = 0u;
+  b.consumed = 0u;
+  b.has_error = false;
+  m_next_offset += m_block_size;
+
+  b.state = ::aio_read(&b.request) == 0 ? block_state::submitted : block_state::pending;
+}
+
+void direct_input_file::wait_for(block& b)
+{
+  if (b.state == block_state::submitted) {
+    const aiocb* const requests[] = { &b.request };
+    while (::aio_error(&b.request) == EINPROGRESS) {
+      ::aio_suspend(requests, 1, nullptr);
+    }
+
+    const auto error = ::aio_error(&b.request);
+    const auto result = ::aio_return(&b.request);
+    b.state = block_state::ready;
+
+    if (error == 0) {
+      b.size = static_cast<size_type_t>(result);
+      return;
+    }
+
+    // The file system accepted O_DIRECT on open, but rejects the reads. The read is repeated
+    // without it, like the reads of the next blocks that are already in flight.
+    if (error == EINVAL && m_is_direct) {
+      disable_direct();
+      b.state = block_state::pending;
+    } else {
+      b.has_error = true;
+    }
+  }
+
+  if (b.state == block_state::pending) {
+    read_synchronously(b);
+  }
+}
+
+void direct_input_file::read_synchronously(block& b)
+{
+  b.size = 0u;
+  b.state = block_state::ready;
+
+  while (b.size < m_block_size) {
+    const auto result = ::pread(m_fd, b.data + b.size, m_block_size - b.size,
+                                b.request.aio_offset + static_cast<off_t>(b.size));
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+
+    // 0 is the end of the file.
+    if (result < 0) {
+      b.has_error = true;
+    }
+
+    if (result <= 0) {
+      return;
+    }
+
+    b.size += static_cast<size_type_t>(result);
+  }
+}
+
+void direct_input_file::disable_direct()
+{
+#ifdef O_DIRECT
+  const auto flags = ::fcntl(m_fd, F_GETFL);
+  if (flags >= 0) {
+    ::fcntl(m_fd, F_SETFL, flags & ~O_DIRECT);
+  }
+#endif
+  m_is_direct = false;
+}
+
+void direct_input_file::drop_from_page_cache(const block& b)
+{
+#ifdef POSIX_FADV_DONTNEED
+  if (!m_is_direct) {
+    ::posix_fadvise(m_fd, b.request.aio_offset, static_cast<off_t>(b.size), POSIX_FADV_DONTNEED);
+  }
+#else
+  static_cast<void>(b);
+#endif
+}
+
+void direct_input_file::release()
+{
+  // Reads still in flight write to the blocks, so they must finish before the blocks are freed.
+  for (auto& b : m_blocks) {
+    if (b.state != block_state::submitted) {
+      continue;
+    }
+
+    ::aio_cancel(m_fd, &b.request);
+
+    const aiocb* const requests[] = { &b.request };
+    while (::aio_error(&b.request) == EINPROGRESS) {
+      ::aio_suspend(requests, 1, nullptr);
+    }
+    ::aio_return(&b.request);
+    b.state = block_state::ready;
+  }
+
+  for (auto& b : m_blocks) {
+    std::free(b.data);
+  }
+  m_blocks.clear();
+
+  if (m_fd >= 0) {
+    ::close(m_fd);
+    m_fd = -1;
+  }
+}
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "input_stream.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include <aio.h>
+
+namespace okon {
+// Read-only storage for a single sequential pass over a big file, e.g. the input of the preparer.
+// A few big reads are kept in flight with POSIX AIO, so the disk works while the previous blocks
+// are parsed. Where supported, the file is read with O_DIRECT, bypassing the page cache, which
+// only gets polluted by a file read once. If the file system doesn't support it, the file is read
+// through the page cache, and the pages of the blocks already read are dropped from it.
+class direct_input_file : public input_stream
+{
+public:
+  static constexpr std::size_t k_default_block_size{ 4u * 1024u * 1024u };
+  static constexpr unsigned k_default_blocks_in_flight{ 4u };
+
+  // `block_size` is rounded up to a multiple of the alignment required by O_DIRECT.
+  explicit direct_input_file(std::string_view path,
+                             std::size_t block_size = k_default_block_size,
+                             unsigned blocks_in_flight = k_default_blocks_in_flight);
+  ~direct_input_file() override;
+
+  direct_input_file(const direct_input_file&) = delete;
+  direct_input_file& operator=(const direct_input_file&) = delete;
+
+  // Reads next `size` bytes of the file. Returns number of read bytes, less than `size` only at
+  // the end of the file or after a read error.
+  size_type_t read(void* ptr, size_type_t size) override;
+
+  bool is_open() const override;
+
+  // Reads of the skipped blocks, if any, are dropped and the blocks are read from the new offset,
+  // so e.g. skipping most of the file doesn't read it.
+  size_type_t skip(size_type_t size) override;
+
+  std::optional<size_type_t> size() const override;
+
+  // Whether a read of a block failed. Reads after the failed block give nothing.
+  bool has_error() const override;
+
+  // Whether the file is read with O_DIRECT.
+  bool is_direct() const;
+
+private:
+  enum class block_state
+  {
+    // Read is in flight.
+    submitted,
+
+    // Read couldn't be submitted, or was rejected by O_DIRECT. It's done synchronously, when the
+    // block is needed.
+    pending,
+
+    // Data is read.
+    ready
+  };
+
+  struct block
+  {
+    uint8_t* data{ nullptr };
+    aiocb request{};
+    block_state state{ block_state::ready };
+    size_type_t size{ 0u };
+    size_type_t consumed{ 0u };
+    bool has_error{ false };
+  };
+
+  void submit(block& b);
+  void wait_for(block& b);
+  void read_synchronously(block& b);
+  void disable_direct();
+  void drop_from_page_cache(const block& b);
+  void release();
+
+private:
+  int m_fd{ -1 };
+  bool m_is_direct{ false };
+  std::size_t m_block_size{ 0u };
+  std::vector<block> m_blocks;
+  unsigned m_current_block{ 0u };
+  size_type_t m_size{ 0u };
+  size_type_t m_next_offset{ 0u };
+  bool m_is_at_end{ false };
+  bool m_has_error{ false };
+};
+}
@@ -0,0 +1,57 @@
+#include "fd_input_stream.hpp"
+
+#include <cerrno>
+#include <cstddef>
+
+#include <unistd.h>
+
+namespace okon {
+fd_input_stream::fd_input_stream(int fd, bool owns_fd)
+  : m_fd{ fd }
+  , m_owns_fd{ owns_fd }
+{
+}
+
+fd_input_stream::~fd_input_stream()
+{
+  if (m_owns_fd && m_fd >= 0) {
+    ::close(m_fd);
+  }
+}
+
+fd_input_stream::size_type_t fd_input_stream::read(void* ptr, size_type_t size)
+{
+  auto* const out = static_cast<char*>(ptr);
+  size_type_t read_size{ 0u };
+
+  // A pipe gives as much as is written to it at once, so reads are repeated till `size` is read.
+  while (read_size < size && is_open()) {
+    const auto result = ::read(m_fd, out + read_size, static_cast<std::size_t>(size - read_size));
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (result < 0) {
+      m_has_error = true;
+    }
+
+    if (result <= 0) {
+      break;
+    }
+
+    read_size += static_cast<size_type_t>(result);
+  }
+
+  return read_size;
+}
+
+bool fd_input_stream::is_open() const
+{
+  return m_fd >= 0;
+}
+
+bool fd_input_stream::has_error() const
+{
+  return m_has_error;
+}
+}
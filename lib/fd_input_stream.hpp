@@ -0,0 +1,26 @@
+#pragma once
+
+#include "input_stream.hpp"
+
+namespace okon {
+// Stream of plain reads of a file descriptor, e.g. of a pipe.
+class fd_input_stream : public input_stream
+{
+public:
+  // If `owns_fd` is set, the descriptor is closed by the stream.
+  explicit fd_input_stream(int fd, bool owns_fd);
+  ~fd_input_stream() override;
+
+  fd_input_stream(const fd_input_stream&) = delete;
+  fd_input_stream& operator=(const fd_input_stream&) = delete;
+
+  size_type_t read(void* ptr, size_type_t size) override;
+  bool is_open() const override;
+  bool has_error() const override;
+
+private:
+  int m_fd;
+  bool m_owns_fd;
+  bool m_has_error{ false };
+};
+}
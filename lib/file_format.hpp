@@ -0,0 +1,73 @@
+#pragma once
+
+#include "sha1_utils.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+namespace okon {
+// Files prepared by the first version of okon start with the B-tree order, that is never 0. All
+// newer formats start with an extended header: k_extended_header_marker followed by the format.
+// The rest of the extended header is format-specific.
+enum class file_format : uint32_t
+{
+  btree_v1 = 1u,
+  btree_v2 = 2u,
+  static_tree = 3u,
+  flat_sorted = 4u,
+  blocked_bloom_filter = 5u,
+  btree_v3 = 6u,
+  btree_v4 = 7u,
+  shards_manifest = 8u
+};
+
+constexpr uint32_t k_extended_header_marker{ 0u };
+constexpr uint64_t k_extended_header_size{ 64u };
+
+// Size of the keys, see OKON_KEY_SIZE, is the last field of the extended header of every format of
+// keys. 0 stands for SHA-1 keys, so their files are the same as before the size was stored. Files
+// of btree_v1 have no extended header, their keys are SHA-1 hashes.
+constexpr uint64_t k_key_size_offset{ k_extended_header_size - sizeof(uint32_t) };
+
+inline void write_key_size(uint8_t* extended_header, uint32_t key_size)
+{
+  const auto stored = key_size == k_sha1_key_size ? 0u : key_size;
+  std::memcpy(extended_header + k_key_size_offset, &stored, sizeof(stored));
+}
+
+inline uint32_t read_key_size(const uint8_t* extended_header)
+{
+  uint32_t stored;
+  std::memcpy(&stored, extended_header + k_key_size_offset, sizeof(stored));
+  return stored == 0u ? k_sha1_key_size : stored;
+}
+
+template <typename DataStorage>
+file_format read_file_format(DataStorage& storage)
+{
+  uint32_t first_field{};
+  storage.seek_in(0u);
+  storage.read(&first_field, sizeof(first_field));
+
+  if (first_field != k_extended_header_marker) {
+    return file_format::btree_v1;
+  }
+
+  uint32_t format{};
+  storage.read(&format, sizeof(format));
+  return static_cast<file_format>(format);
+}
+
+template <typename DataStorage>
+uint32_t read_key_size(DataStorage& storage)
+{
+  if (read_file_format(storage) == file_format::btree_v1) {
+    return k_sha1_key_size;
+  }
+
+  uint32_t stored{};
+  storage.seek_in(k_key_size_offset);
+  storage.read(&stored, sizeof(stored));
+  return stored == 0u ? k_sha1_key_size : stored;
+}
+}
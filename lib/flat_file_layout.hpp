@@ -0,0 +1,90 @@
+#pragma once
+
+#include "file_format.hpp"
+#include "sha1_utils.hpp"
+
+#include <cstdint>
+
+namespace okon {
+// Layout of a flat sorted file. Keys are stored as one sorted array. Keys are uniformly
+// distributed, so a directory indexed by the leading directory_bits bits of a key narrows the
+// search to a small bucket, which is then searched with interpolation search.
+//
+// File layout:
+// header | directory[2^directory_bits + 1] | keys[keys_count] | counts[keys_count] if has_counts
+// header: k_extended_header_marker | file_format::flat_sorted | keys_count (64-bit) |
+//         directory_bits | has_counts | zeros till key_size | key_size (32-bit)
+// directory[b]: index of the first key with leading bits >= b, directory[2^directory_bits] is
+//               keys_count.
+// counts[i]: 32-bit number of occurrences of keys[i].
+class flat_file_layout
+{
+public:
+  static constexpr uint32_t k_default_directory_bits{ 16u };
+
+  explicit flat_file_layout(uint64_t keys_count,
+                            uint32_t directory_bits = k_default_directory_bits,
+                            bool has_counts = false)
+    : m_keys_count{ keys_count }
+    , m_directory_bits{ directory_bits }
+    , m_has_counts{ has_counts }
+  {
+  }
+
+  uint64_t keys_count() const
+  {
+    return m_keys_count;
+  }
+
+  uint32_t directory_bits() const
+  {
+    return m_directory_bits;
+  }
+
+  bool has_counts() const
+  {
+    return m_has_counts;
+  }
+
+  uint64_t buckets_count() const
+  {
+    return uint64_t{ 1u } << m_directory_bits;
+  }
+
+  // `prefix` is the big-endian value of the first eight bytes of a key.
+  uint64_t bucket(uint64_t prefix) const
+  {
+    return m_directory_bits == 0u ? 0u : prefix >> (64u - m_directory_bits);
+  }
+
+  uint64_t directory_offset() const
+  {
+    return k_extended_header_size;
+  }
+
+  uint64_t directory_entry_offset(uint64_t bucket) const
+  {
+    return directory_offset() + bucket * sizeof(uint64_t);
+  }
+
+  uint64_t keys_offset() const
+  {
+    return directory_entry_offset(buckets_count() + 1u);
+  }
+
+  uint64_t key_offset(uint64_t index) const
+  {
+    return keys_offset() + index * sizeof(sha1_t);
+  }
+
+  uint64_t counts_offset() const
+  {
+    return key_offset(m_keys_count);
+  }
+
+private:
+  uint64_t m_keys_count;
+  uint32_t m_directory_bits;
+  bool m_has_counts;
+};
+}
@@ -0,0 +1,209 @@
+#pragma once
+
+#include "flat_file_layout.hpp"
+#include "sha1_search.hpp"
+#include "sha1_utils.hpp"
+#include "storage_reader.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace okon {
+namespace details {
+// Buckets ranges of up to this size are binary searched instead of interpolated.
+constexpr auto k_interpolation_search_threshold{ 32u };
+
+template <typename DataStorage>
+flat_file_layout read_flat_file_layout(DataStorage& storage)
+{
+  uint32_t marker{};
+  uint32_t format{};
+  uint64_t keys_count{};
+  uint32_t directory_bits{};
+  uint32_t has_counts{};
+
+  storage.seek_in(0u);
+  storage.read(&marker, sizeof(marker));
+  storage.read(&format, sizeof(format));
+  storage.read(&keys_count, sizeof(keys_count));
+  storage.read(&directory_bits, sizeof(directory_bits));
+  storage.read(&has_counts, sizeof(has_counts));
+
+  return flat_file_layout{ keys_count, directory_bits, has_counts != 0u };
+}
+}
+
+// Reads files written by flat_sorted_file_writer. See flat_file_layout for the layout.
+template <typename DataStorage>
+class flat_sorted_file
+{
+public:
+  explicit flat_sorted_file(DataStorage& storage);
+
+  // Whether the header of `storage`, of `size` bytes, describes a file that fits in it. Header of
+  // a corrupt file may hold any values, e.g. a directory of 64 or more bits, that the layout can't
+  // be computed for.
+  static bool is_valid(DataStorage& storage, uint64_t size);
+
+  bool contains(const sha1_t& sha1) const;
+
+  // Returns number of occurrences of `sha1`, 0 if it's not in the file. Every key of a file
+  // without counts occurs once.
+  uint32_t count(const sha1_t& sha1) const;
+
+  // Returns index of the first key not less than `sha1`, keys_count() if there is no such key.
+  uint64_t lower_bound(const sha1_t& sha1) const;
+
+  // Looks up keys[sorted_queries[i]] for i in [0, count) and stores 1 or 0 in the corresponding
+  // results. Safe to call concurrently if the storage has direct access.
+  void contains_sorted_batch(const sha1_t* keys, const std::size_t* sorted_queries,
+                             std::size_t count, uint8_t* results) const;
+
+  const flat_file_layout& layout() const;
+
+private:
+  uint64_t directory_entry(uint64_t bucket) const;
+  sha1_t key(uint64_t index) const;
+
+private:
+  storage_reader<DataStorage> m_reader;
+  flat_file_layout m_layout;
+};
+
+template <typename DataStorage>
+flat_sorted_file<DataStorage>::flat_sorted_file(DataStorage& storage)
+  : m_reader{ storage }
+  , m_layout{ details::read_flat_file_layout(storage) }
+{
+}
+
+template <typename DataStorage>
+bool flat_sorted_file<DataStorage>::is_valid(DataStorage& storage, uint64_t size)
+{
+  const auto layout = details::read_flat_file_layout(storage);
+  if (layout.directory_bits() >= 64u ||
+      layout.buckets_count() >= size / sizeof(uint64_t) ||
+      layout.keys_count() > size / sizeof(sha1_t)) {
+    return false;
+  }
+
+  const auto counts_size = layout.has_counts() ? layout.keys_count() * sizeof(uint32_t) : 0u;
+  return layout.counts_offset() + counts_size <= size;
+}
+
+template <typename DataStorage>
+bool flat_sorted_file<DataStorage>::contains(const sha1_t& sha1) const
+{
+  const auto index = lower_bound(sha1);
+  return index < m_layout.keys_count() && key(index) == sha1;
+}
+
+template <typename DataStorage>
+uint32_t flat_sorted_file<DataStorage>::count(const sha1_t& sha1) const
+{
+  const auto index = lower_bound(sha1);
+  if (index == m_layout.keys_count() || key(index) != sha1) {
+    return 0u;
+  }
+
+  if (!m_layout.has_counts()) {
+    return 1u;
+  }
+
+  uint32_t count;
+  std::memcpy(&count,
+              m_reader.read(m_layout.counts_offset() + index * sizeof(uint32_t), sizeof(count)),
+              sizeof(count));
+  return count;
+}
+
+template <typename DataStorage>
+uint64_t flat_sorted_file<DataStorage>::lower_bound(const sha1_t& sha1) const
+{
+  const auto prefix = details::sha1_prefix(sha1);
+  const auto bucket = m_layout.bucket(prefix);
+
+  auto begin = directory_entry(bucket);
+  auto end = directory_entry(bucket + 1u);
+
+  // Interpolation search over key prefixes. Keys in [begin, end) are sorted, so their prefixes
+  // are sorted too; equal prefixes fall back to the binary search below.
+  while (end - begin > details::k_interpolation_search_threshold) {
+    const auto first_prefix = details::sha1_prefix(key(begin));
+    const auto last_prefix = details::sha1_prefix(key(end - 1u));
+
+    if (prefix < first_prefix) {
+      return begin;
+    }
+
+    if (prefix > last_prefix) {
+      return end;
+    }
+
+    if (first_prefix == last_prefix) {
+      break;
+    }
+
+    const auto fraction = static_cast<double>(prefix - first_prefix) /
+      static_cast<double>(last_prefix - first_prefix);
+    const auto position = std::min(
+      end - 1u, begin + static_cast<uint64_t>(fraction * static_cast<double>(end - 1u - begin)));
+
+    const auto probe = key(position);
+    const auto compare = std::memcmp(probe.data(), sha1.data(), sizeof(sha1_t));
+    if (compare == 0) {
+      return position;
+    }
+
+    if (compare < 0) {
+      begin = position + 1u;
+    } else {
+      end = position;
+    }
+  }
+
+  const auto count = static_cast<uint32_t>(end - begin);
+  const auto* keys = reinterpret_cast<const sha1_t*>(
+    m_reader.read(m_layout.key_offset(begin), count * sizeof(sha1_t)));
+
+  return begin + lower_bound_sha1(keys, count, sha1);
+}
+
+template <typename DataStorage>
+void flat_sorted_file<DataStorage>::contains_sorted_batch(const sha1_t* keys,
+                                                          const std::size_t* sorted_queries,
+                                                          std::size_t count,
+                                                          uint8_t* results) const
+{
+  // A lookup touches only a couple of keys in one bucket; sorted queries already visit the
+  // buckets in file order.
+  for (std::size_t i = 0u; i < count; ++i) {
+    const auto query = sorted_queries[i];
+    results[query] = contains(keys[query]) ? 1u : 0u;
+  }
+}
+
+template <typename DataStorage>
+const flat_file_layout& flat_sorted_file<DataStorage>::layout() const
+{
+  return m_layout;
+}
+
+template <typename DataStorage>
+uint64_t flat_sorted_file<DataStorage>::directory_entry(uint64_t bucket) const
+{
+  uint64_t entry;
+  std::memcpy(&entry, m_reader.read(m_layout.directory_entry_offset(bucket), sizeof(entry)),
+              sizeof(entry));
+  return entry;
+}
+
+template <typename DataStorage>
+sha1_t flat_sorted_file<DataStorage>::key(uint64_t index) const
+{
+  sha1_t result;
+  std::memcpy(result.data(), m_reader.read(m_layout.key_offset(index), sizeof(sha1_t)),
+              sizeof(sha1_t));
+  return result;
+}
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "file_format.hpp"
+#include "flat_file_layout.hpp"
+#include "key_counts.hpp"
+#include "sha1_search.hpp"
+#include "sha1_utils.hpp"
+
+#include <cstring>
+#include <optional>
+#include <vector>
+
+namespace okon {
+// Writes sorted keys as a flat sorted file. Keys are written as they come, right after the space
+// reserved for the directory. The directory and the header are written by finalize_inserting().
+// If `counts_scratch_storage` is given, the file has counts of the keys, see key_counts_writer.
+template <typename DataStorage>
+class flat_sorted_file_writer
+{
+public:
+  explicit flat_sorted_file_writer(
+    DataStorage& storage, uint32_t directory_bits = flat_file_layout::k_default_directory_bits,
+    DataStorage* counts_scratch_storage = nullptr);
+
+  void insert_sorted(const sha1_t& sha1);
+  void insert_sorted(const sha1_t& sha1, uint32_t count);
+  void finalize_inserting();
+
+private:
+  void flush_keys_buffer();
+  void write_directory();
+  void write_header();
+
+private:
+  static constexpr auto k_keys_buffer_size{ 1024u * 64u };
+
+  DataStorage& m_storage;
+  flat_file_layout m_layout;
+  uint64_t m_inserted_count{ 0u };
+  std::vector<sha1_t> m_keys_buffer;
+  std::optional<key_counts_writer<DataStorage>> m_counts;
+
+  // Number of keys in every bucket, turned into the directory when finalizing.
+  std::vector<uint64_t> m_buckets_sizes;
+};
+
+template <typename DataStorage>
+flat_sorted_file_writer<DataStorage>::flat_sorted_file_writer(DataStorage& storage,
+                                                              uint32_t directory_bits,
+                                                              DataStorage* counts_scratch_storage)
+  : m_storage{ storage }
+  , m_layout{ 0u, directory_bits, counts_scratch_storage != nullptr }
+  , m_buckets_sizes(m_layout.buckets_count(), 0u)
+{
+  m_keys_buffer.reserve(k_keys_buffer_size);
+  if (counts_scratch_storage) {
+    m_counts.emplace(*counts_scratch_storage);
+  }
+  m_storage.seek_out(m_layout.keys_offset());
+}
+
+template <typename DataStorage>
+void flat_sorted_file_writer<DataStorage>::insert_sorted(const sha1_t& sha1)
+{
+  ++m_buckets_sizes[m_layout.bucket(details::sha1_prefix(sha1))];
+
+  m_keys_buffer.push_back(sha1);
+  if (m_keys_buffer.size() == k_keys_buffer_size) {
+    flush_keys_buffer();
+  }
+
+  ++m_inserted_count;
+}
+
+template <typename DataStorage>
+void flat_sorted_file_writer<DataStorage>::insert_sorted(const sha1_t& sha1, uint32_t count)
+{
+  insert_sorted(sha1);
+  if (m_counts) {
+    m_counts->add(count);
+  }
+}
+
+template <typename DataStorage>
+void flat_sorted_file_writer<DataStorage>::finalize_inserting()
+{
+  flush_keys_buffer();
+  m_layout =
+    flat_file_layout{ m_inserted_count, m_layout.directory_bits(), m_layout.has_counts() };
+
+  if (m_counts) {
+    m_counts->append_to(m_storage, m_layout.counts_offset());
+  }
+
+  write_directory();
+  write_header();
+}
+
+template <typename DataStorage>
+void flat_sorted_file_writer<DataStorage>::flush_keys_buffer()
+{
+  if (m_keys_buffer.empty()) {
+    return;
+  }
+
+  m_storage.write(m_keys_buffer.data(), m_keys_buffer.size() * sizeof(sha1_t));
+  m_keys_buffer.clear();
+}
+
+template <typename DataStorage>
+void flat_sorted_file_writer<DataStorage>::write_directory()
+{
+  std::vector<uint64_t> directory;
+  directory.reserve(m_buckets_sizes.size() + 1u);
+
+  uint64_t first_key{ 0u };
+  for (const auto size : m_buckets_sizes) {
+    directory.push_back(first_key);
+    first_key += size;
+  }
+  directory.push_back(first_key);
+
+  m_storage.seek_out(m_layout.directory_offset());
+  m_storage.write(directory.data(), directory.size() * sizeof(uint64_t));
+}
+
+template <typename DataStorage>
+void flat_sorted_file_writer<DataStorage>::write_header()
+{
+  std::vector<uint8_t> header(k_extended_header_size, uint8_t{ 0u });
+  auto* out = header.data();
+
+  const auto append = [&out](const auto& value) {
+    std::memcpy(out, &value, sizeof(value));
+    out += sizeof(value);
+  };
+
+  append(k_extended_header_marker);
+  append(static_cast<uint32_t>(file_format::flat_sorted));
+  append(uint64_t{ m_layout.keys_count() });
+  append(m_layout.directory_bits());
+  append(uint32_t{ m_layout.has_counts() });
+  write_key_size(header.data(), k_key_size);
+
+  m_storage.seek_out(0u);
+  m_storage.write(header.data(), header.size());
+}
+}
@@ -51,6 +51,11 @@ public:
     return m_file.is_open();
   }
 
+  void flush()
+  {
+    m_file.flush();
+  }
+
 private:
   std::fstream m_file;
 };
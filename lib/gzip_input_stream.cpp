@@ -0,0 +1,88 @@
+#include "gzip_input_stream.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+constexpr auto k_compressed_chunk_size{ 1024u * 1024u };
+
+// Window bits of inflateInit2(): the biggest window, with automatic detection of gzip and zlib
+// headers.
+constexpr auto k_window_bits{ 15 + 32 };
+}
+
+namespace okon {
+gzip_input_stream::gzip_input_stream(std::unique_ptr<input_stream> source)
+  : m_source{ std::move(source) }
+  , m_input(k_compressed_chunk_size)
+{
+  m_is_initialized = ::inflateInit2(&m_stream, k_window_bits) == Z_OK;
+}
+
+gzip_input_stream::~gzip_input_stream()
+{
+  if (m_is_initialized) {
+    ::inflateEnd(&m_stream);
+  }
+}
+
+gzip_input_stream::size_type_t gzip_input_stream::read(void* ptr, size_type_t size)
+{
+  if (!is_open()) {
+    return 0u;
+  }
+
+  // uInt is 32-bit, so at most that much is decompressed at once.
+  const auto size_to_read =
+    static_cast<uInt>(std::min<size_type_t>(size, std::numeric_limits<uInt>::max()));
+  m_stream.next_out = static_cast<Bytef*>(ptr);
+  m_stream.avail_out = size_to_read;
+
+  while (m_stream.avail_out > 0u && !m_is_at_end) {
+    if (m_stream.avail_in == 0u && !read_source()) {
+      // Truncated input gives what was decompressed so far. Only an empty input has no member.
+      m_has_error = m_stream.total_in > 0u;
+      m_is_at_end = true;
+      break;
+    }
+
+    const auto result = ::inflate(&m_stream, Z_NO_FLUSH);
+    if (result == Z_STREAM_END) {
+      if (m_stream.avail_in == 0u && !read_source()) {
+        m_is_at_end = true;
+        break;
+      }
+
+      // Next gzip member follows.
+      ::inflateReset(&m_stream);
+      continue;
+    }
+
+    // E.g. Z_DATA_ERROR of corrupt data, or Z_MEM_ERROR.
+    if (result != Z_OK) {
+      m_has_error = true;
+      m_is_at_end = true;
+    }
+  }
+
+  return size_to_read - m_stream.avail_out;
+}
+
+bool gzip_input_stream::is_open() const
+{
+  return m_is_initialized && m_source->is_open();
+}
+
+bool gzip_input_stream::has_error() const
+{
+  return m_has_error || m_source->has_error();
+}
+
+bool gzip_input_stream::read_source()
+{
+  const auto read_size = m_source->read(m_input.data(), m_input.size());
+  m_stream.next_in = m_input.data();
+  m_stream.avail_in = static_cast<uInt>(read_size);
+  return read_size > 0u;
+}
+}
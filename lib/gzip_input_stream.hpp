@@ -0,0 +1,39 @@
+#pragma once
+
+#include "input_stream.hpp"
+
+#include <memory>
+#include <vector>
+
+#include <zlib.h>
+
+namespace okon {
+// Decompresses gzip, or zlib, data of another stream. Concatenated gzip members, e.g. written by
+// parallel compressors, are decompressed one after another.
+class gzip_input_stream : public input_stream
+{
+public:
+  explicit gzip_input_stream(std::unique_ptr<input_stream> source);
+  ~gzip_input_stream() override;
+
+  gzip_input_stream(const gzip_input_stream&) = delete;
+  gzip_input_stream& operator=(const gzip_input_stream&) = delete;
+
+  size_type_t read(void* ptr, size_type_t size) override;
+  bool is_open() const override;
+
+  // Whether the compressed data is corrupt or truncated, or the source has an error.
+  bool has_error() const override;
+
+private:
+  bool read_source();
+
+private:
+  std::unique_ptr<input_stream> m_source;
+  std::vector<uint8_t> m_input;
+  z_stream m_stream{};
+  bool m_is_initialized{ false };
+  bool m_is_at_end{ false };
+  bool m_has_error{ false };
+};
+}
@@ -0,0 +1,132 @@
+#include "input_stream.hpp"
+#include "direct_input_file.hpp"
+#include "fd_input_stream.hpp"
+
+#ifdef OKON_WITH_ZLIB
+#  include "gzip_input_stream.hpp"
+#endif
+
+#ifdef OKON_WITH_LZMA
+#  include "xz_input_stream.hpp"
+#endif
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+// Bytes read at once by the default skip().
+constexpr std::size_t k_skip_buffer_size{ 1024u * 1024u };
+
+bool ends_with(std::string_view text, std::string_view suffix)
+{
+  return text.size() >= suffix.size() && text.substr(text.size() - suffix.size()) == suffix;
+}
+
+std::unique_ptr<okon::input_stream> open_not_compressed(std::string_view path)
+{
+  if (path == okon::k_standard_input_path) {
+    return std::make_unique<okon::fd_input_stream>(STDIN_FILENO, /*owns_fd=*/false);
+  }
+
+  // Only regular files can be read at offsets, which direct_input_file needs.
+  const std::string path_string{ path };
+  struct stat file_stat
+  {
+  };
+  if (::stat(path_string.c_str(), &file_stat) == 0 && !S_ISREG(file_stat.st_mode)) {
+    return std::make_unique<okon::fd_input_stream>(::open(path_string.c_str(), O_RDONLY),
+                                                   /*owns_fd=*/true);
+  }
+
+  return std::make_unique<okon::direct_input_file>(path);
+}
+}
+
+namespace okon {
+input_stream::size_type_t input_stream::skip(size_type_t size)
+{
+  std::vector<char> buffer(std::min<size_type_t>(size, k_skip_buffer_size));
+  size_type_t skipped{ 0u };
+  while (skipped < size) {
+    const auto size_to_read = std::min<size_type_t>(size - skipped, buffer.size());
+    const auto read_size = read(buffer.data(), size_to_read);
+    skipped += read_size;
+    if (read_size < size_to_read) {
+      break;
+    }
+  }
+  return skipped;
+}
+
+input_compression resolve_input_compression(std::string_view path, input_compression compression)
+{
+  if (compression != input_compression::detect) {
+    return compression;
+  }
+
+  if (ends_with(path, ".gz")) {
+    return input_compression::gzip;
+  }
+
+  if (ends_with(path, ".xz")) {
+    return input_compression::xz;
+  }
+
+  return input_compression::none;
+}
+
+bool is_input_compression_supported(input_compression compression)
+{
+  switch (compression) {
+    case input_compression::detect:
+    case input_compression::none:
+      return true;
+    case input_compression::gzip:
+#ifdef OKON_WITH_ZLIB
+      return true;
+#else
+      return false;
+#endif
+    case input_compression::xz:
+#ifdef OKON_WITH_LZMA
+      return true;
+#else
+      return false;
+#endif
+  }
+
+  return false;
+}
+
+std::unique_ptr<input_stream> open_input_stream(std::string_view path,
+                                                input_compression compression)
+{
+  auto file = open_not_compressed(path);
+
+  switch (resolve_input_compression(path, compression)) {
+    case input_compression::gzip:
+#ifdef OKON_WITH_ZLIB
+      return std::make_unique<gzip_input_stream>(std::move(file));
+#else
+      break;
+#endif
+    case input_compression::xz:
+#ifdef OKON_WITH_LZMA
+      return std::make_unique<xz_input_stream>(std::move(file));
+#else
+      break;
+#endif
+    case input_compression::detect:
+    case input_compression::none:
+      return file;
+  }
+
+  // Compression is not supported by this build.
+  return std::make_unique<fd_input_stream>(-1, /*owns_fd=*/false);
+}
+}
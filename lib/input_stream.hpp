@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+namespace okon {
+// Sequential source of the text parsed by the preparer, e.g. a file, a pipe or a decompressor.
+class input_stream
+{
+public:
+  using size_type_t = uint64_t;
+
+  virtual ~input_stream() = default;
+
+  // Reads next `size` bytes. Returns number of read bytes, less than `size` only at the end of the
+  // stream or after an error.
+  virtual size_type_t read(void* ptr, size_type_t size) = 0;
+
+  virtual bool is_open() const = 0;
+
+  // Skips next `size` bytes, e.g. of the input parsed before a checkpoint. Returns number of
+  // skipped bytes, less than `size` only at the end of the stream or after an error. By default,
+  // the bytes are read and dropped.
+  virtual size_type_t skip(size_type_t size);
+
+  // Number of bytes of the whole stream, if it's known up front, e.g. of a regular file.
+  virtual std::optional<size_type_t> size() const
+  {
+    return std::nullopt;
+  }
+
+  // Whether a read failed, e.g. of a disk error or of corrupt compressed data. The stream ends
+  // at the error, so its end is not the end of the input.
+  virtual bool has_error() const
+  {
+    return false;
+  }
+};
+
+enum class input_compression
+{
+  // Compression is detected based on the extension of the path: .gz or .xz.
+  detect,
+  none,
+  gzip,
+  xz
+};
+
+// Path of the standard input.
+constexpr std::string_view k_standard_input_path{ "-" };
+
+// Resolves input_compression::detect based on `path`.
+input_compression resolve_input_compression(std::string_view path, input_compression compression);
+
+// Whether this build can decompress `compression`, other than input_compression::detect.
+bool is_input_compression_supported(input_compression compression);
+
+// Opens `path` for reading, or the standard input if it's k_standard_input_path. Regular files
+// are read with direct_input_file. Anything else, e.g. a pipe or /dev/fd/N, is read with plain
+// reads. The stream decompresses the data if `compression`, after resolving, isn't none. The
+// returned stream is not open if the file can't be opened or the compression is not supported.
+std::unique_ptr<input_stream> open_input_stream(std::string_view path,
+                                                input_compression compression);
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "sha1_utils.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace okon {
+// Key together with the number of its occurrences, e.g. in the breaches.
+struct counted_sha1
+{
+  sha1_t sha1;
+  uint32_t count;
+};
+
+// Helpers to handle sha1_t and counted_sha1 keys the same way. Plain keys occur once.
+inline const sha1_t& key_of(const sha1_t& sha1)
+{
+  return sha1;
+}
+
+inline const sha1_t& key_of(const counted_sha1& counted)
+{
+  return counted.sha1;
+}
+
+inline uint32_t count_of(const sha1_t&)
+{
+  return 1u;
+}
+
+inline uint32_t count_of(const counted_sha1& counted)
+{
+  return counted.count;
+}
+
+// Counts don't overflow, they stop at the maximal value.
+inline uint32_t add_counts(uint32_t lhs, uint32_t rhs)
+{
+  const auto sum = uint64_t{ lhs } + rhs;
+  return static_cast<uint32_t>(std::min<uint64_t>(sum, std::numeric_limits<uint32_t>::max()));
+}
+
+// Parses count of a `HASH:count` line. `begin` points the first character after the hash. A line
+// without a count counts once.
+inline uint32_t parse_count(const char* begin, const char* end)
+{
+  if (begin == end || *begin != ':') {
+    return 1u;
+  }
+
+  uint32_t count{ 0u };
+  for (const auto* current = begin + 1; current < end && *current >= '0' && *current <= '9';
+       ++current) {
+    const auto digit = static_cast<uint32_t>(*current - '0');
+    count = count > (std::numeric_limits<uint32_t>::max() - digit) / 10u
+      ? std::numeric_limits<uint32_t>::max()
+      : count * 10u + digit;
+  }
+
+  return count;
+}
+
+// Collects counts of the keys of a file while it's being written. Number of keys is known only
+// when all of them have been written, so counts are stored in a scratch storage and appended to
+// the file, after all the other data, by append_to().
+template <typename DataStorage>
+class key_counts_writer
+{
+public:
+  explicit key_counts_writer(DataStorage& scratch_storage)
+    : m_scratch_storage{ scratch_storage }
+  {
+    m_buffer.reserve(k_buffer_size);
+    m_scratch_storage.seek_out(0u);
+  }
+
+  void add(uint32_t count)
+  {
+    m_buffer.push_back(count);
+    if (m_buffer.size() == k_buffer_size) {
+      flush();
+    }
+  }
+
+  // Copies all the counts to `storage`, starting at `offset`.
+  void append_to(DataStorage& storage, uint64_t offset)
+  {
+    flush();
+
+    storage.seek_out(offset);
+    m_scratch_storage.seek_in(0u);
+
+    m_buffer.resize(k_buffer_size);
+    for (auto left = m_written_count; left > 0u;) {
+      const auto size = std::min<uint64_t>(left, k_buffer_size);
+      m_scratch_storage.read(m_buffer.data(), size * sizeof(uint32_t));
+      storage.write(m_buffer.data(), size * sizeof(uint32_t));
+      left -= size;
+    }
+    m_buffer.clear();
+  }
+
+private:
+  void flush()
+  {
+    if (m_buffer.empty()) {
+      return;
+    }
+
+    m_scratch_storage.write(m_buffer.data(), m_buffer.size() * sizeof(uint32_t));
+    m_written_count += m_buffer.size();
+    m_buffer.clear();
+  }
+
+private:
+  static constexpr auto k_buffer_size{ 1024u * 64u };
+
+  DataStorage& m_scratch_storage;
+  std::vector<uint32_t> m_buffer;
+  uint64_t m_written_count{ 0u };
+};
+}
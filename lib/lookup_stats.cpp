@@ -0,0 +1,71 @@
+#include "lookup_stats.hpp"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace okon {
+namespace {
+template <std::size_t N>
+std::array<uint64_t, N> load_all(const std::array<std::atomic<uint64_t>, N>& counters)
+{
+  std::array<uint64_t, N> values;
+  for (std::size_t i = 0u; i < N; ++i) {
+    values[i] = counters[i].load(std::memory_order_relaxed);
+  }
+  return values;
+}
+
+unsigned latency_bucket(std::chrono::nanoseconds latency)
+{
+  auto bucket = 0u;
+  for (auto ns = latency.count(); ns > 1; ns >>= 1) {
+    ++bucket;
+  }
+  return std::min(bucket, lookup_stats::k_latency_buckets_count - 1u);
+}
+}
+
+lookup_stats::lookup_stats(trace_callback_t trace_callback)
+  : m_trace_callback{ std::move(trace_callback) }
+{
+}
+
+void lookup_stats::add_lookups(uint64_t count, uint64_t hits)
+{
+  m_lookups.fetch_add(count, std::memory_order_relaxed);
+  m_hits.fetch_add(hits, std::memory_order_relaxed);
+}
+
+void lookup_stats::add_latency(std::chrono::nanoseconds latency)
+{
+  m_latencies[latency_bucket(latency)].fetch_add(1u, std::memory_order_relaxed);
+}
+
+void lookup_stats::add_node_read(unsigned level, btree_node::pointer_t ptr, bool is_pinned,
+                                 uint64_t bytes)
+{
+  const auto index = std::min(level, k_levels_count - 1u);
+  if (is_pinned) {
+    m_pinned_node_reads[index].fetch_add(1u, std::memory_order_relaxed);
+  } else {
+    m_node_reads[index].fetch_add(1u, std::memory_order_relaxed);
+    m_bytes_read.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  if (m_trace_callback) {
+    m_trace_callback(level, ptr, is_pinned);
+  }
+}
+
+lookup_stats::counters lookup_stats::read() const
+{
+  counters result;
+  result.lookups = m_lookups.load(std::memory_order_relaxed);
+  result.hits = m_hits.load(std::memory_order_relaxed);
+  result.node_reads = load_all(m_node_reads);
+  result.pinned_node_reads = load_all(m_pinned_node_reads);
+  result.bytes_read = m_bytes_read.load(std::memory_order_relaxed);
+  result.latencies = load_all(m_latencies);
+  return result;
+}
+}
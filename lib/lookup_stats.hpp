@@ -0,0 +1,61 @@
+#pragma once
+
+#include "btree_node.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+namespace okon {
+// Counters of the lookups of a handle, updated from any thread. B-tree lookups report every node
+// they visit, other formats count only the lookups. Kept apart from the trees, so they cost nothing
+// if they're not enabled.
+class lookup_stats
+{
+public:
+  // Called for every visited node: its level, 0 being the root, its pointer and whether it's
+  // pinned. May be called from many threads at once.
+  using trace_callback_t =
+    std::function<void(unsigned level, btree_node::pointer_t ptr, bool is_pinned)>;
+
+  // Deeper levels are counted as the last one.
+  static constexpr unsigned k_levels_count{ 16u };
+
+  // Bucket i counts lookups that took from 2^i to 2^(i+1) nanoseconds, the first one also the
+  // shorter ones and the last one also the longer ones.
+  static constexpr unsigned k_latency_buckets_count{ 32u };
+
+  struct counters
+  {
+    uint64_t lookups{ 0u };
+    uint64_t hits{ 0u };
+    std::array<uint64_t, k_levels_count> node_reads{};
+    std::array<uint64_t, k_levels_count> pinned_node_reads{};
+    uint64_t bytes_read{ 0u };
+    std::array<uint64_t, k_latency_buckets_count> latencies{};
+  };
+
+  explicit lookup_stats(trace_callback_t trace_callback = nullptr);
+
+  void add_lookups(uint64_t count, uint64_t hits);
+  void add_latency(std::chrono::nanoseconds latency);
+
+  // `bytes` is the size of the node, read from the storage if the node is not pinned.
+  void add_node_read(unsigned level, btree_node::pointer_t ptr, bool is_pinned, uint64_t bytes);
+
+  counters read() const;
+
+private:
+  using counter_t = std::atomic<uint64_t>;
+
+  trace_callback_t m_trace_callback;
+  counter_t m_lookups{ 0u };
+  counter_t m_hits{ 0u };
+  std::array<counter_t, k_levels_count> m_node_reads{};
+  std::array<counter_t, k_levels_count> m_pinned_node_reads{};
+  counter_t m_bytes_read{ 0u };
+  std::array<counter_t, k_latency_buckets_count> m_latencies{};
+};
+}
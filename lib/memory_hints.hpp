@@ -0,0 +1,24 @@
+#pragma once
+
+namespace okon {
+// How a range of a storage is going to be read. Storages that can't use it ignore it.
+enum class access_pattern
+{
+  normal,
+  random,
+  sequential,
+  will_need
+};
+
+namespace details {
+// Starts fetching the cache line of `address`, so it's in the cache when it's read later.
+inline void prefetch(const void* address)
+{
+#if defined(__GNUC__)
+  __builtin_prefetch(address);
+#else
+  (void)address;
+#endif
+}
+}
+}
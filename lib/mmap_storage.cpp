@@ -0,0 +1,236 @@
+#include "mmap_storage.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace okon {
+namespace {
+// Transparent huge pages are 2 MiB on the common architectures. Only ranges aligned to them can
+// be backed by them.
+constexpr uint64_t k_transparent_huge_page_size{ 2u * 1024u * 1024u };
+
+uint64_t round_up(uint64_t size, uint64_t alignment)
+{
+  return (size + alignment - 1u) / alignment * alignment;
+}
+
+void* map_anonymous(uint64_t size, int flags)
+{
+  void* mapped =
+    ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+  return mapped == MAP_FAILED ? nullptr : mapped;
+}
+
+// Returns null if there are no free reserved huge pages of `huge_page_size`.
+void* map_reserved_huge_pages(uint64_t size, uint64_t huge_page_size)
+{
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+  if (huge_page_size == 0u || (huge_page_size & (huge_page_size - 1u)) != 0u) {
+    return nullptr;
+  }
+
+  auto size_log2 = 0;
+  while ((uint64_t{ 1u } << size_log2) < huge_page_size) {
+    ++size_log2;
+  }
+
+  return map_anonymous(size, MAP_HUGETLB | (size_log2 << MAP_HUGE_SHIFT));
+#else
+  (void)size;
+  (void)huge_page_size;
+  return nullptr;
+#endif
+}
+
+// Memory aligned to transparent huge pages, with the kernel asked to back it by them.
+void* map_transparent_huge_pages(uint64_t size)
+{
+  // Mapped with a huge page more and trimmed to the aligned range.
+  auto* const mapped = static_cast<uint8_t*>(map_anonymous(size + k_transparent_huge_page_size, 0));
+  if (mapped == nullptr) {
+    return nullptr;
+  }
+
+  const auto address = reinterpret_cast<uintptr_t>(mapped);
+  auto* const aligned = mapped + (round_up(address, k_transparent_huge_page_size) - address);
+  if (aligned != mapped) {
+    ::munmap(mapped, aligned - mapped);
+  }
+  const auto tail = k_transparent_huge_page_size - (aligned - mapped);
+  if (tail > 0u) {
+    ::munmap(aligned + size, tail);
+  }
+
+#ifdef MADV_HUGEPAGE
+  // It's only a hint, the copy works with normal pages too.
+  ::madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+
+  return aligned;
+}
+
+bool read_whole_file(int fd, uint8_t* data, uint64_t size)
+{
+  // Single reads are limited to a bit less than 2 GiB anyway.
+  constexpr uint64_t k_max_read_size{ 1u << 30u };
+
+  uint64_t offset{ 0u };
+  while (offset < size) {
+    const auto read = ::pread(fd, data + offset, std::min(size - offset, k_max_read_size),
+                              static_cast<off_t>(offset));
+    if (read < 0 && errno == EINTR) {
+      continue;
+    }
+    if (read <= 0) {
+      return false;
+    }
+    offset += static_cast<uint64_t>(read);
+  }
+
+  return true;
+}
+}
+
+mmap_storage::mmap_storage(std::string_view path, const residency& residency)
+{
+  const auto fd = ::open(std::string{ path }.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+
+  struct stat file_stat
+  {
+  };
+  if (::fstat(fd, &file_stat) != 0) {
+    ::close(fd);
+    return;
+  }
+
+  m_size = static_cast<size_type_t>(file_stat.st_size);
+
+  // An empty file can not be mapped, but it's still a valid (empty) storage.
+  if (m_size > 0u && residency.resident) {
+    // Pages are taken from the NUMA node of the opening thread, the copy touches them first.
+    m_mapped_size = round_up(m_size, std::max(residency.huge_page_size, uint64_t{ 1u }));
+    auto* copy = map_reserved_huge_pages(m_mapped_size, residency.huge_page_size);
+    if (copy == nullptr) {
+      m_mapped_size = round_up(m_size, k_transparent_huge_page_size);
+      copy = map_transparent_huge_pages(m_mapped_size);
+    }
+
+    if (copy == nullptr || !read_whole_file(fd, static_cast<uint8_t*>(copy), m_size)) {
+      // Out of memory or the file can't be read. It's not opened rather than silently mapped.
+      if (copy != nullptr) {
+        ::munmap(copy, m_mapped_size);
+      }
+      ::close(fd);
+      m_size = 0u;
+      m_mapped_size = 0u;
+      return;
+    }
+
+    // Lookups only read it, a stray write crashes instead of corrupting the database.
+    ::mprotect(copy, m_mapped_size, PROT_READ);
+
+    m_data = static_cast<const uint8_t*>(copy);
+    m_is_resident = true;
+  } else if (m_size > 0u) {
+    void* mapped = ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+      ::close(fd);
+      m_size = 0u;
+      return;
+    }
+
+    m_data = static_cast<const uint8_t*>(mapped);
+    m_mapped_size = m_size;
+  }
+
+  // The mapping stays valid after closing the descriptor.
+  ::close(fd);
+  m_is_open = true;
+}
+
+mmap_storage::~mmap_storage()
+{
+  if (m_data != nullptr) {
+    ::munmap(const_cast<uint8_t*>(m_data), m_mapped_size);
+  }
+}
+
+mmap_storage::size_type_t mmap_storage::read(void* ptr, size_type_t size)
+{
+  const auto size_to_read = std::min(size, m_size - std::min(m_in_pos, m_size));
+  if (size_to_read > 0u) {
+    std::memcpy(ptr, m_data + m_in_pos, size_to_read);
+  }
+  m_in_pos += size_to_read;
+  return size_to_read;
+}
+
+void mmap_storage::seek_in(pos_type_t pos)
+{
+  m_in_pos = pos;
+}
+
+mmap_storage::pos_type_t mmap_storage::tell_in() const
+{
+  return m_in_pos;
+}
+
+bool mmap_storage::is_open() const
+{
+  return m_is_open;
+}
+
+const uint8_t* mmap_storage::data() const
+{
+  return m_data;
+}
+
+mmap_storage::size_type_t mmap_storage::size() const
+{
+  return m_size;
+}
+
+bool mmap_storage::is_resident() const
+{
+  return m_is_resident;
+}
+
+void mmap_storage::advise(pos_type_t offset, size_type_t size, access_pattern pattern) const
+{
+  if (m_data == nullptr || m_is_resident || size == 0u || offset >= m_size) {
+    return;
+  }
+
+  const auto advice = [pattern] {
+    switch (pattern) {
+      case access_pattern::random:
+        return MADV_RANDOM;
+      case access_pattern::sequential:
+        return MADV_SEQUENTIAL;
+      case access_pattern::will_need:
+        return MADV_WILLNEED;
+      case access_pattern::normal:
+        break;
+    }
+    return MADV_NORMAL;
+  }();
+
+  // The range has to start at a page boundary.
+  static const auto page_size = static_cast<pos_type_t>(::sysconf(_SC_PAGESIZE));
+  const auto begin = offset / page_size * page_size;
+  const auto end = offset + std::min(size, m_size - offset);
+
+  // It's only a hint, lookups work the same if it fails.
+  ::madvise(const_cast<uint8_t*>(m_data) + begin, end - begin, advice);
+}
+}
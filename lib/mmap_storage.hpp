@@ -0,0 +1,64 @@
+#pragma once
+
+#include "memory_hints.hpp"
+
+#include <cstdint>
+#include <string_view>
+
+namespace okon {
+// Where the bytes of a storage are kept.
+struct residency
+{
+  // Mapped files are read from the page cache when they're touched. Resident ones are copied into
+  // anonymous memory backed by huge pages while opening, so reads never fault on the file and
+  // need few TLB entries.
+  bool resident{ false };
+
+  // Size of the reserved huge pages (see MAP_HUGETLB) a resident file is copied into, e.g. 2 MiB or
+  // 1 GiB. If it's 0, or there are no free pages of that size, transparent huge pages are used.
+  uint64_t huge_page_size{ 0u };
+};
+
+// Read-only storage that maps the whole file into memory. Reads are plain memory copies served
+// from the page cache, or from the resident copy, and data() gives direct access to the bytes.
+class mmap_storage
+{
+public:
+  using size_type_t = uint64_t;
+  using pos_type_t = uint64_t;
+
+  explicit mmap_storage(std::string_view path, const residency& residency = {});
+  ~mmap_storage();
+
+  mmap_storage(const mmap_storage&) = delete;
+  mmap_storage& operator=(const mmap_storage&) = delete;
+
+  size_type_t read(void* ptr, size_type_t size);
+
+  void seek_in(pos_type_t pos);
+  pos_type_t tell_in() const;
+
+  bool is_open() const;
+
+  const uint8_t* data() const;
+  size_type_t size() const;
+
+  // Whether the bytes are a resident copy of the file.
+  bool is_resident() const;
+
+  // Passes the hint to the kernel, see madvise(2). Ranges past the end of the file are clamped.
+  // Resident copies are all in memory already, the hints are ignored.
+  void advise(pos_type_t offset, size_type_t size, access_pattern pattern) const;
+
+private:
+  const uint8_t* m_data{ nullptr };
+  size_type_t m_size{ 0u };
+
+  // Size of the mapping, the resident copy is rounded up to whole pages.
+  size_type_t m_mapped_size{ 0u };
+
+  pos_type_t m_in_pos{ 0u };
+  bool m_is_open{ false };
+  bool m_is_resident{ false };
+};
+}
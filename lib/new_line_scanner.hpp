@@ -0,0 +1,40 @@
+#pragma once
+
+#include "sha1_utils.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace okon {
+// Appends offsets of all '\n' characters of text [0, size) to `offsets`, in increasing order.
+// Nothing after `size` is read.
+inline void find_new_lines(const char* text, std::size_t size, std::vector<std::size_t>& offsets)
+{
+  std::size_t i{ 0u };
+
+#ifdef OKON_USE_SIMD
+  // Every 32 characters are compared at once. Bits of the comparison mask are offsets of the new
+  // lines in the block.
+  constexpr std::size_t block_size{ 32u };
+  const auto new_line = vcl::Vec32c{ '\n' };
+
+  for (; i + block_size <= size; i += block_size) {
+    vcl::Vec32c chars;
+    chars.load(text + i);
+
+    auto mask = vcl::to_bits(chars == new_line);
+    while (mask != 0u) {
+      offsets.push_back(i + vcl::bit_scan_forward(static_cast<uint32_t>(mask)));
+      mask &= mask - 1u;
+    }
+  }
+#endif
+
+  for (; i < size; ++i) {
+    if (text[i] == '\n') {
+      offsets.push_back(i);
+    }
+  }
+}
+}
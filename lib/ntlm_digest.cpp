@@ -0,0 +1,180 @@
+#include "ntlm_digest.hpp"
+
+#include <array>
+#include <cstring>
+#include <vector>
+
+namespace okon {
+namespace {
+constexpr std::size_t k_block_size{ 64u };
+constexpr char32_t k_replacement_character{ 0xFFFDu };
+
+uint32_t rotate_left(uint32_t value, unsigned bits)
+{
+  return (value << bits) | (value >> (32u - bits));
+}
+
+void md4_compress(uint32_t* state, const uint8_t* block)
+{
+  uint32_t x[16];
+  for (auto i = 0u; i < 16u; ++i) {
+    x[i] = uint32_t{ block[i * 4u] } | uint32_t{ block[i * 4u + 1u] } << 8u |
+      uint32_t{ block[i * 4u + 2u] } << 16u | uint32_t{ block[i * 4u + 3u] } << 24u;
+  }
+
+  auto a = state[0];
+  auto b = state[1];
+  auto c = state[2];
+  auto d = state[3];
+
+  // Every step updates one of the four words, the next step updates the previous one.
+  const auto step = [&a, &b, &c, &d](uint32_t f, uint32_t word, uint32_t constant, unsigned bits) {
+    const auto updated = rotate_left(a + f + word + constant, bits);
+    a = d;
+    d = c;
+    c = b;
+    b = updated;
+  };
+
+  static constexpr unsigned first_bits[4] = { 3u, 7u, 11u, 19u };
+  for (auto i = 0u; i < 16u; ++i) {
+    step((b & c) | (~b & d), x[i], 0u, first_bits[i % 4u]);
+  }
+
+  static constexpr unsigned second_bits[4] = { 3u, 5u, 9u, 13u };
+  for (auto i = 0u; i < 16u; ++i) {
+    step((b & c) | (b & d) | (c & d), x[i % 4u * 4u + i / 4u], 0x5A827999u, second_bits[i % 4u]);
+  }
+
+  static constexpr unsigned third_words[16] = { 0u, 8u, 4u, 12u, 2u, 10u, 6u, 14u,
+                                                1u, 9u, 5u, 13u, 3u, 11u, 7u, 15u };
+  static constexpr unsigned third_bits[4] = { 3u, 9u, 11u, 15u };
+  for (auto i = 0u; i < 16u; ++i) {
+    step(b ^ c ^ d, x[third_words[i]], 0x6ED9EBA1u, third_bits[i % 4u]);
+  }
+
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+}
+
+ntlm_digest_t md4_digest(const uint8_t* bytes, std::size_t size)
+{
+  uint32_t state[4] = { 0x67452301u, 0xEFCDAB89u, 0x98BADCFEu, 0x10325476u };
+
+  const auto full_blocks = size / k_block_size;
+  for (std::size_t i = 0u; i < full_blocks; ++i) {
+    md4_compress(state, bytes + i * k_block_size);
+  }
+
+  // The rest of the message, 0x80, zeros and the length in bits take one or two blocks.
+  std::array<uint8_t, 2u * k_block_size> tail{};
+  const auto rest = size % k_block_size;
+  std::memcpy(tail.data(), bytes + full_blocks * k_block_size, rest);
+  tail[rest] = 0x80u;
+
+  const auto tail_blocks = rest + 1u + sizeof(uint64_t) > k_block_size ? 2u : 1u;
+  const uint64_t bits = uint64_t{ size } * 8u;
+  for (auto i = 0u; i < sizeof(bits); ++i) {
+    tail[tail_blocks * k_block_size - sizeof(bits) + i] = static_cast<uint8_t>(bits >> (8u * i));
+  }
+  for (auto i = 0u; i < tail_blocks; ++i) {
+    md4_compress(state, tail.data() + i * k_block_size);
+  }
+
+  ntlm_digest_t digest;
+  for (auto i = 0u; i < 4u; ++i) {
+    for (auto j = 0u; j < 4u; ++j) {
+      digest[i * 4u + j] = static_cast<uint8_t>(state[i] >> (8u * j));
+    }
+  }
+  return digest;
+}
+
+// Decodes the code point starting at `text[0]` and returns the number of its bytes. Overlong
+// sequences, surrogates and code points above U+10FFFF are invalid.
+std::size_t decode_utf8(const uint8_t* text, std::size_t length, char32_t& code_point)
+{
+  code_point = k_replacement_character;
+
+  const auto lead = text[0];
+  if (lead < 0x80u) {
+    code_point = lead;
+    return 1u;
+  }
+
+  std::size_t size;
+  char32_t min;
+  if ((lead & 0xE0u) == 0xC0u) {
+    size = 2u;
+    min = 0x80u;
+    code_point = lead & 0x1Fu;
+  } else if ((lead & 0xF0u) == 0xE0u) {
+    size = 3u;
+    min = 0x800u;
+    code_point = lead & 0x0Fu;
+  } else if ((lead & 0xF8u) == 0xF0u) {
+    size = 4u;
+    min = 0x10000u;
+    code_point = lead & 0x07u;
+  } else {
+    code_point = k_replacement_character;
+    return 1u;
+  }
+
+  if (size > length) {
+    code_point = k_replacement_character;
+    return 1u;
+  }
+
+  for (auto i = 1u; i < size; ++i) {
+    if ((text[i] & 0xC0u) != 0x80u) {
+      code_point = k_replacement_character;
+      return 1u;
+    }
+    code_point = code_point << 6u | (text[i] & 0x3Fu);
+  }
+
+  const auto is_surrogate = code_point >= 0xD800u && code_point <= 0xDFFFu;
+  if (code_point < min || code_point > 0x10FFFFu || is_surrogate) {
+    code_point = k_replacement_character;
+    return 1u;
+  }
+
+  return size;
+}
+
+void append_utf16le(std::vector<uint8_t>& utf16, char32_t code_point)
+{
+  const auto append_unit = [&utf16](uint32_t unit) {
+    utf16.push_back(static_cast<uint8_t>(unit));
+    utf16.push_back(static_cast<uint8_t>(unit >> 8u));
+  };
+
+  if (code_point < 0x10000u) {
+    append_unit(code_point);
+    return;
+  }
+
+  const auto offset = code_point - 0x10000u;
+  append_unit(0xD800u + (offset >> 10u));
+  append_unit(0xDC00u + (offset & 0x3FFu));
+}
+}
+
+ntlm_digest_t ntlm_digest(const char* password, std::size_t length)
+{
+  const auto* const text = reinterpret_cast<const uint8_t*>(password);
+
+  std::vector<uint8_t> utf16;
+  utf16.reserve(2u * length);
+  for (std::size_t i = 0u; i < length;) {
+    char32_t code_point;
+    i += decode_utf8(text + i, length - i, code_point);
+    append_utf16le(utf16, code_point);
+  }
+
+  return md4_digest(utf16.data(), utf16.size());
+}
+}
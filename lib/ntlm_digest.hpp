@@ -0,0 +1,13 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace okon {
+using ntlm_digest_t = std::array<uint8_t, 16u>;
+
+// NTLM hash of a password: MD4 digest of its UTF-16LE encoding. The password is UTF-8, every byte
+// that isn't part of a valid sequence is encoded as U+FFFD.
+ntlm_digest_t ntlm_digest(const char* password, std::size_t length);
+}
@@ -1,45 +1,433 @@
 #include <okon/okon.h>
 
-#include "btree.hpp"
+#include "blocked_bloom_filter.hpp"
 #include "fstream_wrapper.hpp"
+#include "input_stream.hpp"
+#include "ntlm_digest.hpp"
+#include "okon_handle.hpp"
 #include "preparer.hpp"
+#include "sha1_digest.hpp"
+#include "sha1_prefix_range.hpp"
+#include "shards_manifest.hpp"
+#include "text_sha1_decoder.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+void okon_prepare_options_init(okon_prepare_options* options)
+{
+  options->progress_callback = nullptr;
+  options->progress_callback_user_data = nullptr;
+  options->phase_progress_callback = nullptr;
+  options->format = okon_format_btree_v2;
+  options->threads = 0u;
+  options->memory_budget = 0u;
+  options->with_counts = 0;
+  options->filter_bits_per_key = 0u;
+  options->input_chunk_size = 0u;
+  options->input_buffers_count = 0u;
+  options->input_compression = okon_input_compression_detect;
+  options->btree_node_size = 0u;
+  options->shards_count = 0u;
+  options->checkpoint_interval = 0u;
+  options->stats = nullptr;
+}
 
 okon_prepare_result okon_prepare(const char* input_db_file_path, const char* working_directory,
                                  const char* output_processed_file_path,
                                  okon_prepare_progress_callback_t user_progress_callback,
                                  void* progress_callback_user_data)
 {
-  std::ofstream{ output_processed_file_path };
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.progress_callback = user_progress_callback;
+  options.progress_callback_user_data = progress_callback_user_data;
+
+  // Readers of the versions before okon_prepare_ex() open v1 files only. Files of other key sizes
+  // are new, v1 can't store their size.
+  if (okon::k_key_size == okon::k_sha1_key_size) {
+    options.format = okon_format_btree_v1;
+  }
+
+  return okon_prepare_ex(input_db_file_path, working_directory, output_processed_file_path,
+                         &options);
+}
+
+namespace {
+template <typename Preparer>
+okon::preparer_result run_preparer(const char* input_db_file_path, const char* working_directory,
+                                   const char* output_processed_file_path,
+                                   typename Preparer::progress_callback_t progress_callback,
+                                   typename Preparer::phase_progress_callback_t
+                                     phase_progress_callback,
+                                   const okon::preparer_options& options,
+                                   unsigned long long& output_keys_count,
+                                   std::vector<okon::shard_info>& output_shards,
+                                   okon::prepare_stats& stats)
+{
+  Preparer preparer{ input_db_file_path, working_directory, output_processed_file_path,
+                     std::move(progress_callback), options, std::move(phase_progress_callback) };
+  const auto result = preparer.prepare();
+  output_keys_count = preparer.output_keys_count();
+  output_shards = preparer.output_shards();
+  stats = preparer.stats();
+  return result;
+}
+
+void store_stats(const okon::prepare_stats& stats, okon_prepare_stats& user_stats)
+{
+  // Phases of okon_prepare_phase are in the same order.
+  for (auto i = 0u; i < okon::k_prepare_phases_count; ++i) {
+    const auto& phase = stats.phases[i];
+    auto& user_phase = user_stats.phases[i];
+    user_phase.wall_seconds = phase.wall_seconds;
+    user_phase.cpu_seconds = phase.cpu_seconds;
+    user_phase.hashes = phase.keys;
+    user_phase.bytes = phase.bytes;
+    user_phase.hashes_per_second = phase.keys_per_second;
+  }
+
+  user_stats.wall_seconds = stats.wall_seconds;
+  user_stats.cpu_seconds = stats.cpu_seconds;
+  user_stats.input_bytes_read = stats.input_bytes_read;
+  user_stats.intermediate_bytes_written = stats.intermediate_bytes_written;
+  user_stats.intermediate_bytes_read = stats.intermediate_bytes_read;
+  user_stats.output_bytes_written = stats.output_bytes_written;
+  user_stats.reader_stall_seconds = stats.reader_stall_seconds;
+  user_stats.parser_stall_seconds = stats.parser_stall_seconds;
+  user_stats.finalize_seconds = stats.finalize_seconds;
+}
 
-  const auto progress_callback =
-    [user_progress_callback, progress_callback_user_data]() -> okon::preparer::progress_callback_t {
-    if (!user_progress_callback) {
+bool is_valid_btree_node_size(unsigned node_size)
+{
+  if (node_size == 0u) {
+    return true;
+  }
+
+  constexpr auto k_min_node_size{ 512u };
+  constexpr auto k_max_node_size{ 1024u * 1024u };
+  const auto is_power_of_two = (node_size & (node_size - 1u)) == 0u;
+  return is_power_of_two && node_size >= k_min_node_size && node_size <= k_max_node_size;
+}
+
+bool write_filter(const char* prepared_file_path, unsigned long long keys_count,
+                  unsigned bits_per_key)
+{
+  okon_open_options options;
+  okon_open_options_init(&options);
+  okon_handle prepared{ prepared_file_path, options };
+  if (!prepared.is_open()) {
+    return false;
+  }
+
+  // All the keys are read, unlike in lookups.
+  prepared.file.advise(0u, prepared.file.size(), okon::access_pattern::sequential);
+
+  okon::blocked_bloom_filter_builder builder{ keys_count, bits_per_key, prepared.file.size() };
+  const auto keys = prepared.db->read_keys();
+  while (const auto key = keys->next()) {
+    builder.add(*key);
+  }
+
+  okon::fstream_wrapper filter_file{ okon::filter_file_path(prepared_file_path),
+                                     std::ios::out | std::ios::trunc };
+  if (!filter_file.is_open()) {
+    return false;
+  }
+
+  builder.write(filter_file);
+  return true;
+}
+
+okon_prepare_result prepare(const char* input_db_file_path, const char* working_directory,
+                            const char* output_processed_file_path,
+                            const okon_prepare_options* user_options,
+                            const okon::database* merged_keys_database)
+{
+  okon_prepare_options default_options;
+  okon_prepare_options_init(&default_options);
+  const auto& options = user_options ? *user_options : default_options;
+
+  if (!is_valid_btree_node_size(options.btree_node_size) ||
+      options.shards_count > okon::shards_manifest::k_max_shards_count ||
+      (options.shards_count > 1u && options.format == okon_format_bloom_filter) ||
+      (options.format == okon_format_btree_v1 && okon::k_key_size != okon::k_sha1_key_size)) {
+    return okon_prepare_result::okon_prepare_result_invalid_options;
+  }
+
+  const auto progress_callback = [&options]() -> okon::preparer::progress_callback_t {
+    if (!options.progress_callback) {
       return [](int) {};
     }
 
-    return [user_progress_callback, progress_callback_user_data](int progress) {
+    return [user_progress_callback = options.progress_callback,
+            progress_callback_user_data = options.progress_callback_user_data](int progress) {
       user_progress_callback(progress_callback_user_data, progress);
     };
   }();
 
-  okon::preparer preparer{ input_db_file_path, working_directory, output_processed_file_path,
-                           progress_callback };
-  const auto result = preparer.prepare();
+  const auto phase_progress_callback =
+    [&options]() -> okon::prepare_progress_reporter::phase_progress_callback_t {
+    if (!options.phase_progress_callback) {
+      return nullptr;
+    }
+
+    return [user_phase_progress_callback = options.phase_progress_callback,
+            progress_callback_user_data =
+              options.progress_callback_user_data](const okon::prepare_phase_progress& progress) {
+      okon_prepare_phase_progress phase_progress;
+      switch (progress.phase) {
+        case okon::prepare_phase::parse:
+          phase_progress.phase = okon_prepare_phase_parse;
+          break;
+        case okon::prepare_phase::sort:
+          phase_progress.phase = okon_prepare_phase_sort;
+          break;
+        case okon::prepare_phase::write:
+          phase_progress.phase = okon_prepare_phase_write;
+          break;
+      }
+      phase_progress.progress = progress.progress;
+      phase_progress.hashes = progress.keys;
+      phase_progress.bytes = progress.bytes;
+      phase_progress.hashes_per_second = progress.keys_per_second;
+      phase_progress.bytes_per_second = progress.bytes_per_second;
+
+      user_phase_progress_callback(progress_callback_user_data, &phase_progress);
+    };
+  }();
+
+  okon::preparer_options preparer_options;
+  preparer_options.threads = options.threads;
+  preparer_options.memory_budget = options.memory_budget;
+  preparer_options.input_chunk_size = options.input_chunk_size;
+  preparer_options.btree_node_size = options.btree_node_size;
+  preparer_options.input_buffers_count = options.input_buffers_count;
+  preparer_options.shards_count = options.shards_count;
+  preparer_options.checkpoint_interval = options.checkpoint_interval;
+  const auto merged_keys =
+    merged_keys_database ? merged_keys_database->read_keys() : nullptr;
+  preparer_options.merged_keys = merged_keys.get();
+  switch (options.format) {
+    case okon_format_btree_v1:
+      preparer_options.format = okon::file_format::btree_v1;
+      break;
+    case okon_format_btree_v2:
+      preparer_options.format = okon::file_format::btree_v2;
+      break;
+    case okon_format_btree_v3:
+      preparer_options.format = okon::file_format::btree_v3;
+      break;
+    case okon_format_btree_v4:
+      preparer_options.format = okon::file_format::btree_v4;
+      break;
+    case okon_format_static_tree:
+      preparer_options.format = okon::file_format::static_tree;
+      break;
+    case okon_format_flat_sorted:
+      preparer_options.format = okon::file_format::flat_sorted;
+      break;
+    case okon_format_bloom_filter:
+      preparer_options.format = okon::file_format::blocked_bloom_filter;
+      break;
+  }
+
+  const auto is_filter = preparer_options.format == okon::file_format::blocked_bloom_filter;
+  if (is_filter && options.filter_bits_per_key > 0u) {
+    preparer_options.filter_bits_per_key = options.filter_bits_per_key;
+  }
+
+  switch (options.input_compression) {
+    case okon_input_compression_detect:
+      preparer_options.compression = okon::input_compression::detect;
+      break;
+    case okon_input_compression_none:
+      preparer_options.compression = okon::input_compression::none;
+      break;
+    case okon_input_compression_gzip:
+      preparer_options.compression = okon::input_compression::gzip;
+      break;
+    case okon_input_compression_xz:
+      preparer_options.compression = okon::input_compression::xz;
+      break;
+  }
+
+  const auto compression =
+    okon::resolve_input_compression(input_db_file_path, preparer_options.compression);
+  if (!okon::is_input_compression_supported(compression)) {
+    return okon_prepare_result::okon_prepare_result_compression_not_supported;
+  }
+
+  if (options.with_counts && preparer_options.format != okon::file_format::static_tree &&
+      preparer_options.format != okon::file_format::flat_sorted) {
+    return okon_prepare_result::okon_prepare_result_counts_not_supported;
+  }
+
+  if (merged_keys && is_filter) {
+    // The filter is sized up front, so keys to merge need to be counted first.
+    const auto merged_keys_counter = merged_keys_database->read_keys();
+    while (merged_keys_counter->next()) {
+      ++preparer_options.merged_keys_count;
+    }
+  }
+
+  std::ofstream{ output_processed_file_path };
+  std::remove(okon::filter_file_path(output_processed_file_path).c_str());
+  if (options.shards_count > 1u) {
+    const auto manifest =
+      okon::shards_manifest::split(output_processed_file_path, options.shards_count);
+    for (const auto& shard : manifest.shards()) {
+      std::remove(okon::filter_file_path(shard.path).c_str());
+    }
+  }
+
+  unsigned long long output_keys_count{ 0u };
+  std::vector<okon::shard_info> output_shards;
+  okon::prepare_stats stats;
+  const auto result = options.with_counts
+    ? run_preparer<okon::counting_preparer>(input_db_file_path, working_directory,
+                                            output_processed_file_path, progress_callback,
+                                            phase_progress_callback, preparer_options,
+                                            output_keys_count, output_shards, stats)
+    : run_preparer<okon::preparer>(input_db_file_path, working_directory,
+                                   output_processed_file_path, progress_callback,
+                                   phase_progress_callback, preparer_options, output_keys_count,
+                                   output_shards, stats);
+
+  if (result == okon::preparer_result::success && options.filter_bits_per_key > 0u && !is_filter) {
+    const auto start_time = std::chrono::steady_clock::now();
+    const auto start_cpu_seconds = okon::process_cpu_seconds();
+    // Every shard has its own filter, it's checked before the shard is touched.
+    if (output_shards.empty()) {
+      output_shards.push_back({ 0u, 0xffu, output_keys_count, output_processed_file_path });
+    }
+
+    for (const auto& shard : output_shards) {
+      if (!write_filter(shard.path.c_str(), shard.keys_count, options.filter_bits_per_key)) {
+        return okon_prepare_result_could_not_open_output;
+      }
+
+      std::error_code error;
+      const auto size = std::filesystem::file_size(okon::filter_file_path(shard.path), error);
+      if (!error) {
+        stats.output_bytes_written += size;
+      }
+    }
+
+    const auto seconds =
+      std::chrono::duration<double>{ std::chrono::steady_clock::now() - start_time }.count();
+    stats.finalize_seconds += seconds;
+    stats.wall_seconds += seconds;
+    stats.cpu_seconds += okon::process_cpu_seconds() - start_cpu_seconds;
+  }
+
+  if (result == okon::preparer_result::success && options.stats) {
+    store_stats(stats, *options.stats);
+  }
 
   switch (result) {
-    case okon::preparer::result ::success:
+    case okon::preparer_result ::success:
       return okon_prepare_result ::okon_prepare_result_success;
-    case okon::preparer::result ::could_not_open_input_file:
+    case okon::preparer_result ::could_not_open_input_file:
       return okon_prepare_result ::okon_prepare_result_could_not_open_input_file;
-    case okon::preparer::result ::could_not_open_intermediate_files:
+    case okon::preparer_result ::could_not_open_intermediate_files:
       return okon_prepare_result ::okon_prepare_result_could_not_open_intermediate_files;
-    case okon::preparer::result ::could_not_open_output:
+    case okon::preparer_result ::could_not_open_output:
       return okon_prepare_result ::okon_prepare_result_could_not_open_output;
+    case okon::preparer_result ::could_not_read_input_file:
+      return okon_prepare_result ::okon_prepare_result_could_not_read_input_file;
   }
 
   return okon_prepare_result ::okon_prepare_result_unspecified_failure;
 }
 
+okon_exists_result look_up(okon_handle& handle, const okon::sha1_t& sha1)
+{
+  if (!handle.stats) {
+    return handle.db->contains(sha1) ? okon_exists_result::okon_exists_result_exists
+                                     : okon_exists_result::okon_exists_result_doesnt_exist;
+  }
+
+  const auto start_time = std::chrono::steady_clock::now();
+  const auto exists = handle.db->contains(sha1);
+  handle.stats->add_latency(std::chrono::steady_clock::now() - start_time);
+  handle.stats->add_lookups(1u, exists ? 1u : 0u);
+
+  return exists ? okon_exists_result::okon_exists_result_exists
+                : okon_exists_result::okon_exists_result_doesnt_exist;
+}
+
+// Whether writing the output, or its filter, would overwrite the prepared file or its filter,
+// which are mapped and read while the output is written.
+bool overwrites_prepared_file(const char* prepared_file_path,
+                              const char* output_processed_file_path)
+{
+  const std::string prepared_paths[] = { prepared_file_path,
+                                         okon::filter_file_path(prepared_file_path) };
+  const std::string output_paths[] = { output_processed_file_path,
+                                       okon::filter_file_path(output_processed_file_path) };
+  for (const auto& prepared_path : prepared_paths) {
+    for (const auto& output_path : output_paths) {
+      // Files that don't exist yet, e.g. the output, set the error and aren't equivalent.
+      std::error_code error;
+      if (std::filesystem::equivalent(prepared_path, output_path, error)) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+// Key of a password, of the hash the library is built for.
+okon::sha1_t password_digest(const char* password, std::size_t password_length)
+{
+#if OKON_KEY_SIZE == 20
+  return okon::sha1_digest(password, password_length);
+#else
+  return okon::ntlm_digest(password, password_length);
+#endif
+}
+}
+
+okon_prepare_result okon_prepare_ex(const char* input_db_file_path, const char* working_directory,
+                                    const char* output_processed_file_path,
+                                    const okon_prepare_options* options)
+{
+  return prepare(input_db_file_path, working_directory, output_processed_file_path, options,
+                 /*merged_keys_database=*/nullptr);
+}
+
+okon_prepare_result okon_merge(const char* prepared_file_path, const char* delta_db_file_path,
+                               const char* working_directory,
+                               const char* output_processed_file_path,
+                               const okon_prepare_options* options)
+{
+  if (overwrites_prepared_file(prepared_file_path, output_processed_file_path)) {
+    return okon_prepare_result::okon_prepare_result_invalid_options;
+  }
+
+  okon_open_options open_options;
+  okon_open_options_init(&open_options);
+  okon_handle prepared{ prepared_file_path, open_options };
+
+  // Keys of a filter can't be read back, so there's nothing to merge.
+  if (!prepared.is_open() || !prepared.db->read_keys()) {
+    return okon_prepare_result::okon_prepare_result_could_not_open_prepared_file;
+  }
+
+  // All the keys are read, unlike in lookups.
+  prepared.file.advise(0u, prepared.file.size(), okon::access_pattern::sequential);
+
+  return prepare(delta_db_file_path, working_directory, output_processed_file_path, options,
+                 prepared.db.get());
+}
+
 okon_exists_result okon_exists_text(const char* sha1, const char* processed_file_path)
 {
   const auto sha1_bin = okon::text_sha1_to_binary(sha1);
@@ -48,18 +436,157 @@ okon_exists_result okon_exists_text(const char* sha1, const char* processed_file
 
 okon_exists_result okon_exists_binary(const void* sha1, const char* processed_file_path)
 {
-  okon::fstream_wrapper file{ processed_file_path,
-                              std::ios::in | std::ios::out | std::ios::binary };
+  okon_open_options options;
+  okon_open_options_init(&options);
+  okon_handle handle{ processed_file_path, options };
 
-  if (!file.is_open()) {
+  if (!handle.is_open()) {
     return okon_exists_result::okon_prepare_result_could_not_open_file;
   }
 
-  okon::btree tree{ file };
+  return okon_handle_exists_binary(&handle, sha1);
+}
+
+void okon_open_options_init(okon_open_options* options)
+{
+  options->pinned_levels = 0u;
+  options->pinned_bytes_budget = 0u;
+  options->threads = 0u;
+  options->async_threads = 0u;
+  options->collect_stats = 0;
+  options->trace_callback = nullptr;
+  options->trace_user_data = nullptr;
+  options->resident = 0;
+  options->huge_page_size = 0u;
+}
+
+okon_handle* okon_open(const char* prepared_file_path)
+{
+  return okon_open_ex(prepared_file_path, nullptr);
+}
+
+okon_handle* okon_open_ex(const char* prepared_file_path, const okon_open_options* options)
+{
+  okon_open_options default_options;
+  okon_open_options_init(&default_options);
+
+  auto handle =
+    std::make_unique<okon_handle>(prepared_file_path, options ? *options : default_options);
 
+  if (!handle->is_open()) {
+    return nullptr;
+  }
+
+  return handle.release();
+}
+
+void okon_close(okon_handle* handle)
+{
+  delete handle;
+}
+
+okon_exists_result okon_handle_exists_text(okon_handle* handle, const char* sha1)
+{
+  const auto sha1_bin = okon::text_sha1_to_binary(sha1);
+  return okon_handle_exists_binary(handle, sha1_bin.data());
+}
+
+okon_exists_result okon_handle_exists_binary(okon_handle* handle, const void* sha1)
+{
+  okon::sha1_t sha1_bin;
+  std::memcpy(&sha1_bin[0], sha1, sizeof(sha1_bin));
+
+  return look_up(*handle, sha1_bin);
+}
+
+int okon_handle_stats(okon_handle* handle, okon_lookup_stats* stats)
+{
+  if (!handle->stats) {
+    return 0;
+  }
+
+  static_assert(okon::lookup_stats::k_levels_count == OKON_LOOKUP_STATS_LEVELS);
+  static_assert(okon::lookup_stats::k_latency_buckets_count == OKON_LOOKUP_STATS_LATENCY_BUCKETS);
+
+  const auto counters = handle->stats->read();
+  stats->lookups = counters.lookups;
+  stats->hits = counters.hits;
+  stats->misses = counters.lookups - counters.hits;
+  std::copy(counters.node_reads.begin(), counters.node_reads.end(), stats->node_reads);
+  std::copy(counters.pinned_node_reads.begin(), counters.pinned_node_reads.end(),
+            stats->pinned_node_reads);
+  stats->bytes_read = counters.bytes_read;
+  std::copy(counters.latencies.begin(), counters.latencies.end(), stats->latency_histogram);
+  return 1;
+}
+
+uint32_t okon_lookup_count(okon_handle* handle, const char* sha1)
+{
+  return handle->db->count(okon::text_sha1_to_binary(sha1));
+}
+
+void okon_exists_batch(okon_handle* handle, const void* sha1s, size_t count, uint8_t* results)
+{
+  // sha1_t is an array of bytes, so the binary hashes can be used in place.
+  const auto keys = static_cast<const okon::sha1_t*>(sha1s);
+
+  const auto& db = *handle->db;
+  handle->batch_engine.run(keys, count, results,
+                           [&db](const okon::sha1_t* keys, const std::size_t* sorted_queries,
+                                 std::size_t count, uint8_t* results) {
+                             db.contains_sorted_batch(keys, sorted_queries, count, results);
+                           });
+  handle->count_batch(results, count);
+}
+
+okon_exists_result okon_exists_password(okon_handle* handle, const char* password,
+                                        size_t password_length)
+{
+  return look_up(*handle, password_digest(password, password_length));
+}
+
+void okon_exists_passwords_batch(okon_handle* handle, const char* const* passwords,
+                                 const size_t* password_lengths, size_t count, uint8_t* results)
+{
+  std::vector<okon::sha1_t> sha1s(count);
+#if OKON_KEY_SIZE == 20
+  okon::sha1_digests(reinterpret_cast<const void* const*>(passwords), password_lengths, count,
+                     sha1s.data());
+#else
+  for (std::size_t i = 0u; i < count; ++i) {
+    sha1s[i] = password_digest(passwords[i], password_lengths[i]);
+  }
+#endif
+  okon_exists_batch(handle, sha1s.data(), count, results);
+}
+
+void okon_exists_async(okon_handle* handle, const void* sha1, okon_exists_callback_t callback,
+                       void* user_data)
+{
   okon::sha1_t sha1_bin;
-  std::memcpy(&sha1_bin[0], sha1, 20u);
+  std::memcpy(&sha1_bin[0], sha1, sizeof(sha1_bin));
+
+  handle->async_lookups.submit(sha1_bin, callback, user_data);
+}
+
+okon_range_result okon_range(okon_handle* handle, const char* prefix, size_t prefix_length,
+                             okon_range_callback_t callback, void* user_data)
+{
+  const auto range = okon::sha1_prefix_range::from_text(prefix, prefix_length);
+  if (!range) {
+    return okon_range_result::okon_range_result_invalid_prefix;
+  }
+
+  const auto reader = handle->db->read_keys_from(range->first());
+  if (!reader) {
+    return okon_range_result::okon_range_result_keys_not_stored;
+  }
+
+  while (const auto sha1 = reader->next()) {
+    if (!range->contains(*sha1) || callback(user_data, sha1->data()) == 0) {
+      break;
+    }
+  }
 
-  return tree.contains(sha1_bin) ? okon_exists_result::okon_exists_result_exists
-                                 : okon_exists_result::okon_exists_result_doesnt_exist;
+  return okon_range_result::okon_range_result_success;
 }
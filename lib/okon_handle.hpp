@@ -0,0 +1,69 @@
+#pragma once
+
+#include <okon/okon.h>
+
+#include "async_lookup_queue.hpp"
+#include "batch_query_engine.hpp"
+#include "database.hpp"
+#include "lookup_stats.hpp"
+
+#include <memory>
+#include <string_view>
+
+// Definition of the opaque handle type declared in okon.h. The handle keeps the prepared file
+// mapped and the decoded header alive, so consecutive lookups don't need to reopen the file.
+// Lookups only read the mapped memory, so they can be done from many threads at the same time.
+struct okon_handle : okon::mapped_database
+{
+  explicit okon_handle(std::string_view prepared_file_path, const okon_open_options& options)
+    : okon::mapped_database{ prepared_file_path, options }
+    , stats{ make_stats(options) }
+    , batch_engine{ options.threads }
+    , async_lookups{ options.async_threads,
+                     [this](const okon::sha1_t* keys, const std::size_t* sorted_queries,
+                            std::size_t count, uint8_t* results) {
+                       db->contains_sorted_batch(keys, sorted_queries, count, results);
+                       count_batch(results, count);
+                     } }
+  {
+    if (stats && db) {
+      db->observe(*stats);
+    }
+  }
+
+  // Counts lookups of a batch, if the stats are collected.
+  void count_batch(const uint8_t* results, std::size_t count)
+  {
+    if (!stats) {
+      return;
+    }
+
+    uint64_t hits{ 0u };
+    for (std::size_t i = 0u; i < count; ++i) {
+      hits += results[i] != 0u;
+    }
+    stats->add_lookups(count, hits);
+  }
+
+  // Null if the stats are not collected.
+  std::unique_ptr<okon::lookup_stats> stats;
+
+  okon::batch_query_engine batch_engine;
+
+  // Destroyed first, so pending lookups are answered while the file is still open.
+  okon::async_lookup_queue async_lookups;
+
+private:
+  static std::unique_ptr<okon::lookup_stats> make_stats(const okon_open_options& options)
+  {
+    if (options.trace_callback) {
+      return std::make_unique<okon::lookup_stats>(
+        [callback = options.trace_callback, user_data = options.trace_user_data](
+          unsigned level, okon::btree_node::pointer_t ptr, bool is_pinned) {
+          callback(user_data, level, ptr, is_pinned ? 1 : 0);
+        });
+    }
+
+    return options.collect_stats ? std::make_unique<okon::lookup_stats>() : nullptr;
+  }
+};
@@ -4,6 +4,9 @@
 #include "sha1_utils.hpp"
 
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <fstream>
 #include <optional>
 #include <string_view>
@@ -25,10 +28,34 @@ public:
     start_reader_thread();
   }
 
+  // Stops reading and waits for the reader thread, so the storage can be destroyed right after
+  // the reader.
+  ~original_file_reader();
+
+  original_file_reader(const original_file_reader&) = delete;
+  original_file_reader& operator=(const original_file_reader&) = delete;
+
   std::optional<std::string_view> next_sha1();
 
+  // Replaces content of `lines` with the next part of the input, cut after the last new line of a
+  // read chunk, so no line is split between two parts. The text is followed by
+  // k_text_sha1_length_for_simd bytes of padding. Returns size of the text, 0 if there is no more
+  // input. Parts can be parsed independently, e.g. on different threads. Not to be mixed with
+  // next_sha1().
+  std::size_t next_lines(std::vector<char>& lines);
+
   bool is_open() const;
 
+  // Bytes read from the storage so far.
+  uint64_t bytes_read() const;
+
+  // Time the reader thread waited for the parsing to free a buffer. If it's long, the parsing is
+  // the bottleneck.
+  std::chrono::nanoseconds reading_stall_time() const;
+
+  // Time the parsing waited for the reader thread. If it's long, the reading is the bottleneck.
+  std::chrono::nanoseconds parsing_stall_time() const;
+
 private:
   std::optional<std::string_view> read_split_sha1();
   void read_chunk();
@@ -47,8 +74,18 @@ private:
   std::array<char, k_text_sha1_length_for_simd> m_backup_buffer{};
   bool m_need_to_read_and_advance_till_next_sha1{ false };
   bool m_has_more_input{ true };
+  std::vector<char> m_lines_carry;
+  std::atomic<uint64_t> m_bytes_read{ 0u };
+  std::thread m_reader_thread;
 };
 
+template <typename DataStorage>
+original_file_reader<DataStorage>::~original_file_reader()
+{
+  m_buffers.stop();
+  m_reader_thread.join();
+}
+
 template <typename DataStorage>
 std::optional<std::string_view> original_file_reader<DataStorage>::next_sha1()
 {
@@ -71,12 +108,59 @@ std::optional<std::string_view> original_file_reader<DataStorage>::next_sha1()
   return sha1_view;
 }
 
+template <typename DataStorage>
+std::size_t original_file_reader<DataStorage>::next_lines(std::vector<char>& lines)
+{
+  lines.assign(m_lines_carry.cbegin(), m_lines_carry.cend());
+  m_lines_carry.clear();
+
+  while (m_has_more_input) {
+    read_chunk();
+    if (!m_has_more_input) {
+      break;
+    }
+
+    const auto last_new_line_pos = m_buffer_view.rfind('\n');
+    if (last_new_line_pos == std::string_view::npos) {
+      lines.insert(lines.end(), m_buffer_view.cbegin(), m_buffer_view.cend());
+      continue;
+    }
+
+    const auto lines_end = std::next(m_buffer_view.cbegin(), last_new_line_pos + 1u);
+    lines.insert(lines.end(), m_buffer_view.cbegin(), lines_end);
+    m_lines_carry.assign(lines_end, m_buffer_view.cend());
+    break;
+  }
+
+  const auto text_size = lines.size();
+  lines.resize(text_size + k_text_sha1_length_for_simd, '\0');
+  return text_size;
+}
+
 template <typename DataStorage>
 bool original_file_reader<DataStorage>::is_open() const
 {
   return m_storage.is_open();
 }
 
+template <typename DataStorage>
+uint64_t original_file_reader<DataStorage>::bytes_read() const
+{
+  return m_bytes_read.load(std::memory_order_relaxed);
+}
+
+template <typename DataStorage>
+std::chrono::nanoseconds original_file_reader<DataStorage>::reading_stall_time() const
+{
+  return m_buffers.storing_stall_time();
+}
+
+template <typename DataStorage>
+std::chrono::nanoseconds original_file_reader<DataStorage>::parsing_stall_time() const
+{
+  return m_buffers.processing_stall_time();
+}
+
 template <typename DataStorage>
 std::optional<std::string_view> original_file_reader<DataStorage>::read_split_sha1()
 {
@@ -135,13 +219,18 @@ void original_file_reader<DataStorage>::advance_till_next_sha1()
 
   advance_view(new_line_pos + 1u);
 }
+
 template <typename DataStorage>
 void original_file_reader<DataStorage>::start_reader_thread()
 {
   const auto fun = [this] {
     while (true) {
       const auto buffer_index = m_buffers.take_for_data_storing();
-      auto& buffer = m_buffers.access_buffer(buffer_index);
+      if (!buffer_index) {
+        return;
+      }
+
+      auto& buffer = m_buffers.access_buffer(*buffer_index);
 
       const auto read_size = m_storage.read(&buffer[0], m_size_to_read_from_storage);
       if (read_size == 0u) {
@@ -149,6 +238,8 @@ void original_file_reader<DataStorage>::start_reader_thread()
         return;
       }
 
+      m_bytes_read.fetch_add(read_size, std::memory_order_relaxed);
+
       if (read_size < m_size_to_read_from_storage) {
         const auto new_size = read_size + k_text_sha1_length_for_simd;
         buffer.resize(new_size);
@@ -158,6 +249,6 @@ void original_file_reader<DataStorage>::start_reader_thread()
     }
   };
 
-  std::thread{ fun }.detach();
+  m_reader_thread = std::thread{ fun };
 }
 }
@@ -0,0 +1,228 @@
+#include "prepare_checkpoint.hpp"
+
+#include "input_stream.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <tuple>
+
+namespace okon {
+namespace {
+constexpr uint32_t k_checkpoint_marker{ 0x6B636B6Fu };
+constexpr uint32_t k_checkpoint_version{ 1u };
+
+// Reads values of the checkpoint and remembers if any of them was past the end of the data.
+class checkpoint_reader
+{
+public:
+  checkpoint_reader(const uint8_t* data, uint64_t size)
+    : m_in{ data }
+    , m_end{ data + size }
+  {
+  }
+
+  template <typename T>
+  T value()
+  {
+    T value{};
+    if (static_cast<uint64_t>(m_end - m_in) < sizeof(value)) {
+      m_is_valid = false;
+      return value;
+    }
+
+    std::memcpy(&value, m_in, sizeof(value));
+    m_in += sizeof(value);
+    return value;
+  }
+
+  std::string string()
+  {
+    const auto length = value<uint32_t>();
+    if (static_cast<uint64_t>(m_end - m_in) < length) {
+      m_is_valid = false;
+      return {};
+    }
+
+    std::string result{ reinterpret_cast<const char*>(m_in), length };
+    m_in += length;
+    return result;
+  }
+
+  // Values are read one by one, so a corrupted count doesn't allocate more than the data holds.
+  std::vector<uint64_t> values()
+  {
+    const auto count = value<uint32_t>();
+    std::vector<uint64_t> result;
+    for (auto i = 0u; i < count && m_is_valid; ++i) {
+      result.push_back(value<uint64_t>());
+    }
+    return result;
+  }
+
+  bool is_valid() const
+  {
+    return m_is_valid && m_in == m_end;
+  }
+
+private:
+  const uint8_t* m_in;
+  const uint8_t* m_end;
+  bool m_is_valid{ true };
+};
+}
+
+bool prepare_identity::operator==(const prepare_identity& other) const
+{
+  const auto fields = [](const prepare_identity& identity) {
+    return std::tie(identity.input_path, identity.input_size, identity.input_write_time,
+                    identity.output_path, identity.format, identity.compression,
+                    identity.record_size, identity.btree_node_size, identity.shards_count,
+                    identity.filter_bits_per_key, identity.has_merged_keys,
+                    identity.merged_keys_count);
+  };
+  return fields(*this) == fields(other);
+}
+
+std::optional<prepare_checkpoint> prepare_checkpoint::load(const std::string& path)
+{
+  std::ifstream file{ path, std::ios::binary };
+  if (!file.is_open()) {
+    return std::nullopt;
+  }
+
+  const std::vector<uint8_t> data{ std::istreambuf_iterator<char>{ file },
+                                   std::istreambuf_iterator<char>{} };
+  return from_memory(data.data(), data.size());
+}
+
+bool prepare_checkpoint::save(const std::string& path) const
+{
+  const auto data = serialize();
+  const auto temporary_path = path + ".tmp";
+  {
+    std::ofstream file{ temporary_path, std::ios::binary | std::ios::trunc };
+    file.write(reinterpret_cast<const char*>(data.data()),
+               static_cast<std::streamsize>(data.size()));
+    file.flush();
+    if (!file.good()) {
+      return false;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(temporary_path, path, error);
+  return !error;
+}
+
+std::optional<prepare_checkpoint> prepare_checkpoint::from_memory(const uint8_t* data,
+                                                                  uint64_t size)
+{
+  if (data == nullptr) {
+    return std::nullopt;
+  }
+
+  checkpoint_reader in{ data, size };
+  if (in.value<uint32_t>() != k_checkpoint_marker ||
+      in.value<uint32_t>() != k_checkpoint_version) {
+    return std::nullopt;
+  }
+
+  prepare_checkpoint checkpoint;
+  auto& identity = checkpoint.identity;
+  identity.input_path = in.string();
+  identity.input_size = in.value<uint64_t>();
+  identity.input_write_time = in.value<int64_t>();
+  identity.output_path = in.string();
+  identity.format = in.value<uint32_t>();
+  identity.compression = in.value<uint32_t>();
+  identity.record_size = in.value<uint32_t>();
+  identity.btree_node_size = in.value<uint32_t>();
+  identity.shards_count = in.value<uint32_t>();
+  identity.filter_bits_per_key = in.value<uint32_t>();
+  identity.has_merged_keys = in.value<uint32_t>();
+  identity.merged_keys_count = in.value<uint64_t>();
+
+  checkpoint.parsed = in.value<uint32_t>() != 0u;
+  checkpoint.parsed_bytes = in.value<uint64_t>();
+  checkpoint.records_counts = in.values();
+  checkpoint.written_shards_keys_counts = in.values();
+
+  if (!in.is_valid()) {
+    return std::nullopt;
+  }
+
+  return checkpoint;
+}
+
+std::vector<uint8_t> prepare_checkpoint::serialize() const
+{
+  std::vector<uint8_t> data;
+
+  const auto append = [&data](const auto& value) {
+    const auto* const bytes = reinterpret_cast<const uint8_t*>(&value);
+    data.insert(data.end(), bytes, bytes + sizeof(value));
+  };
+
+  const auto append_string = [&data, &append](const std::string& text) {
+    append(static_cast<uint32_t>(text.size()));
+    data.insert(data.end(), text.begin(), text.end());
+  };
+
+  const auto append_values = [&append](const std::vector<uint64_t>& values) {
+    append(static_cast<uint32_t>(values.size()));
+    for (const auto value : values) {
+      append(value);
+    }
+  };
+
+  append(k_checkpoint_marker);
+  append(k_checkpoint_version);
+
+  append_string(identity.input_path);
+  append(identity.input_size);
+  append(identity.input_write_time);
+  append_string(identity.output_path);
+  append(identity.format);
+  append(identity.compression);
+  append(identity.record_size);
+  append(identity.btree_node_size);
+  append(identity.shards_count);
+  append(identity.filter_bits_per_key);
+  append(identity.has_merged_keys);
+  append(identity.merged_keys_count);
+
+  append(uint32_t{ parsed });
+  append(parsed_bytes);
+  append_values(records_counts);
+  append_values(written_shards_keys_counts);
+
+  return data;
+}
+
+std::optional<prepare_identity> input_identity(std::string_view input_path)
+{
+  const std::filesystem::path path{ input_path };
+
+  std::error_code error;
+  if (input_path == k_standard_input_path || !std::filesystem::is_regular_file(path, error)) {
+    return std::nullopt;
+  }
+
+  prepare_identity identity;
+  identity.input_path = std::string{ input_path };
+  identity.input_size = std::filesystem::file_size(path, error);
+  if (error) {
+    return std::nullopt;
+  }
+
+  const auto write_time = std::filesystem::last_write_time(path, error);
+  if (error) {
+    return std::nullopt;
+  }
+  identity.input_write_time = write_time.time_since_epoch().count();
+
+  return identity;
+}
+}
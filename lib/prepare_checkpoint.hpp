@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace okon {
+// What a preparation prepares. A checkpoint is resumed only by a preparation of the same input
+// file, not modified since, into the same output and with the same options.
+struct prepare_identity
+{
+  std::string input_path;
+  uint64_t input_size{ 0u };
+  int64_t input_write_time{ 0 };
+  std::string output_path;
+  uint32_t format{ 0u };
+  uint32_t compression{ 0u };
+  uint32_t record_size{ 0u };
+  uint32_t btree_node_size{ 0u };
+  uint32_t shards_count{ 0u };
+  uint32_t filter_bits_per_key{ 0u };
+  uint32_t has_merged_keys{ 0u };
+  uint64_t merged_keys_count{ 0u };
+
+  bool operator==(const prepare_identity& other) const;
+};
+
+// Progress of a preparation saved in its working directory, so the preparation can be resumed
+// after a failure, e.g. a full disk or a killed process, instead of starting over.
+//
+// File layout:
+// k_checkpoint_marker | version | identity | parsed | parsed_bytes (64-bit) |
+// records_counts_count | records_counts[records_counts_count] (64-bit each) |
+// written_shards_count | written_shards_keys_counts[written_shards_count] (64-bit each)
+// Strings of the identity are stored as their length (32-bit) followed by their characters.
+struct prepare_checkpoint
+{
+  prepare_identity identity;
+
+  // Whether all the input is parsed. Otherwise, parsed_bytes of it are.
+  bool parsed{ false };
+
+  // Bytes of the input, after decompressing, whose hashes are all in the intermediate files. They
+  // always end with a new line, or with the end of the input.
+  uint64_t parsed_bytes{ 0u };
+
+  // Numbers of records of the intermediate files, in order of the files. The files may be longer,
+  // e.g. if the preparation failed after the checkpoint, their records past these are dropped.
+  std::vector<uint64_t> records_counts;
+
+  // Numbers of keys of the shards that are written already, in order of the shards. The last shard
+  // is never there, the preparation is done after writing it.
+  std::vector<uint64_t> written_shards_keys_counts;
+
+  // Returns std::nullopt if the file can't be read or doesn't contain a valid checkpoint.
+  static std::optional<prepare_checkpoint> load(const std::string& path);
+
+  // The checkpoint is written next to `path` and renamed to it, so a failure while writing never
+  // leaves a partial checkpoint behind.
+  bool save(const std::string& path) const;
+
+  static std::optional<prepare_checkpoint> from_memory(const uint8_t* data, uint64_t size);
+  std::vector<uint8_t> serialize() const;
+};
+
+// Identity of the regular file at `input_path`, with its size and time of the last write. Returns
+// std::nullopt for anything else, e.g. the standard input, which can't be read again.
+std::optional<prepare_identity> input_identity(std::string_view input_path);
+}
@@ -0,0 +1,157 @@
+#include "prepare_progress.hpp"
+
+#include <algorithm>
+
+namespace okon {
+double process_cpu_seconds()
+{
+  return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+}
+
+prepare_progress_reporter::prepare_progress_reporter(
+  progress_callback_t progress_callback, phase_progress_callback_t phase_progress_callback)
+  : m_progress_callback{ std::move(progress_callback) }
+  , m_phase_progress_callback{ std::move(phase_progress_callback) }
+{
+}
+
+void prepare_progress_reporter::start()
+{
+  std::lock_guard lock{ m_mtx };
+  report_overall(k_progress_unknown);
+}
+
+void prepare_progress_reporter::finish()
+{
+  std::lock_guard lock{ m_mtx };
+  report_overall(100);
+}
+
+void prepare_progress_reporter::start_phase(prepare_phase phase, uint64_t total_keys,
+                                            uint64_t total_bytes)
+{
+  std::lock_guard lock{ m_mtx };
+
+  auto& state = m_phases[static_cast<unsigned>(phase)];
+  state = phase_state{};
+  state.total_keys = total_keys;
+  state.total_bytes = total_bytes;
+  state.start_time = clock_t::now();
+  state.start_cpu_seconds = process_cpu_seconds();
+
+  report_phase(phase, /*force=*/true);
+}
+
+void prepare_progress_reporter::advance(prepare_phase phase, uint64_t keys, uint64_t bytes)
+{
+  std::lock_guard lock{ m_mtx };
+
+  auto& state = m_phases[static_cast<unsigned>(phase)];
+  state.keys += keys;
+  state.bytes += bytes;
+
+  report_phase(phase, /*force=*/false);
+
+  // Overall progress is the progress of writing, the other phases are not measured up front.
+  if (phase == prepare_phase::write) {
+    const auto progress = progress_of(state);
+    if (progress != k_progress_unknown) {
+      report_overall(progress);
+    }
+  }
+}
+
+void prepare_progress_reporter::finish_phase(prepare_phase phase)
+{
+  std::lock_guard lock{ m_mtx };
+
+  auto& state = m_phases[static_cast<unsigned>(phase)];
+  state.is_finished = true;
+  state.finish_time = clock_t::now();
+  state.finish_cpu_seconds = process_cpu_seconds();
+
+  report_phase(phase, /*force=*/true);
+}
+
+prepare_phase_stats prepare_progress_reporter::phase_stats(prepare_phase phase)
+{
+  std::lock_guard lock{ m_mtx };
+
+  const auto& state = m_phases[static_cast<unsigned>(phase)];
+  const auto finish_time = state.is_finished ? state.finish_time : clock_t::now();
+  const auto finish_cpu_seconds =
+    state.is_finished ? state.finish_cpu_seconds : process_cpu_seconds();
+
+  prepare_phase_stats stats;
+  stats.wall_seconds = std::chrono::duration<double>{ finish_time - state.start_time }.count();
+  stats.cpu_seconds = finish_cpu_seconds - state.start_cpu_seconds;
+  stats.keys = state.keys;
+  stats.bytes = state.bytes;
+  if (stats.wall_seconds > 0.) {
+    stats.keys_per_second = static_cast<double>(state.keys) / stats.wall_seconds;
+  }
+  return stats;
+}
+
+void prepare_progress_reporter::report_phase(prepare_phase phase, bool force)
+{
+  if (!m_phase_progress_callback) {
+    return;
+  }
+
+  auto& state = m_phases[static_cast<unsigned>(phase)];
+  const auto now = clock_t::now();
+  const auto progress = progress_of(state);
+
+  const auto is_due = now - state.last_report_time >= k_phase_report_interval;
+  if (!force && progress == state.last_reported_progress && !is_due) {
+    return;
+  }
+
+  state.last_report_time = now;
+  state.last_reported_progress = progress;
+
+  const auto seconds = std::chrono::duration<double>{ now - state.start_time }.count();
+
+  prepare_phase_progress phase_progress;
+  phase_progress.phase = phase;
+  phase_progress.progress = progress;
+  phase_progress.keys = state.keys;
+  phase_progress.bytes = state.bytes;
+  if (seconds > 0.) {
+    phase_progress.keys_per_second = static_cast<double>(state.keys) / seconds;
+    phase_progress.bytes_per_second = static_cast<double>(state.bytes) / seconds;
+  }
+
+  m_phase_progress_callback(phase_progress);
+}
+
+void prepare_progress_reporter::report_overall(int progress)
+{
+  if (!m_progress_callback || m_last_reported_progress == progress) {
+    return;
+  }
+
+  m_progress_callback(progress);
+  m_last_reported_progress = progress;
+}
+
+int prepare_progress_reporter::progress_of(const phase_state& state)
+{
+  const auto percents = [](uint64_t done, uint64_t total) {
+    return static_cast<int>(std::min<uint64_t>(100u, 100u * done / total));
+  };
+
+  if (state.is_finished) {
+    return 100;
+  }
+  if (state.total_keys > 0u) {
+    return percents(state.keys, state.total_keys);
+  }
+  if (state.total_bytes > 0u) {
+    return percents(state.bytes, state.total_bytes);
+  }
+
+  return k_progress_unknown;
+}
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <mutex>
+
+namespace okon {
+// Phases of the preparer. Sorting and writing overlap: files are written as soon as they're
+// sorted.
+enum class prepare_phase
+{
+  parse,
+  sort,
+  write
+};
+
+constexpr auto k_prepare_phases_count{ 3u };
+
+struct prepare_phase_progress
+{
+  prepare_phase phase{ prepare_phase::parse };
+
+  // In percents, or prepare_progress_reporter::k_progress_unknown if the size of the phase is not
+  // known, e.g. while a pipe is parsed.
+  int progress{ 0 };
+
+  // Processed in the phase so far.
+  uint64_t keys{ 0u };
+  uint64_t bytes{ 0u };
+
+  // Since the start of the phase.
+  double keys_per_second{ 0. };
+  double bytes_per_second{ 0. };
+};
+
+// Time and work of a finished phase.
+struct prepare_phase_stats
+{
+  double wall_seconds{ 0. };
+
+  // CPU time of the whole process while the phase lasted, of all its threads. Sorting and writing
+  // overlap, so they share it.
+  double cpu_seconds{ 0. };
+
+  uint64_t keys{ 0u };
+  uint64_t bytes{ 0u };
+  double keys_per_second{ 0. };
+};
+
+// Profile of a preparation, to find out what bounds it.
+struct prepare_stats
+{
+  std::array<prepare_phase_stats, k_prepare_phases_count> phases;
+
+  double wall_seconds{ 0. };
+  double cpu_seconds{ 0. };
+
+  uint64_t input_bytes_read{ 0u };
+  uint64_t intermediate_bytes_written{ 0u };
+  uint64_t intermediate_bytes_read{ 0u };
+  uint64_t output_bytes_written{ 0u };
+
+  // Time the reader of the input waited for the parsing, and the parsing for the reader.
+  double reader_stall_seconds{ 0. };
+  double parser_stall_seconds{ 0. };
+
+  // Time of finishing the output after its last key, e.g. of rebalancing a B-tree built by
+  // btree_sorted_keys_inserter.
+  double finalize_seconds{ 0. };
+};
+
+// Seconds of CPU time used by all the threads of the process so far.
+double process_cpu_seconds();
+
+// Reports progress of the preparer. Work is reported in batches, e.g. a bucket or a few thousand
+// keys, so callbacks are not called from the hot loops. Phases can be advanced from different
+// threads. Callbacks are called one at a time.
+class prepare_progress_reporter
+{
+public:
+  // Overall progress in percents or one of the special values below. Kept in sync with
+  // okon_prepare_progress_special_value from okon.h.
+  using progress_callback_t = std::function<void(int)>;
+  using phase_progress_callback_t = std::function<void(const prepare_phase_progress&)>;
+
+  static constexpr auto k_progress_unknown{ -1 };
+  static constexpr auto k_progress_never_reported{ -2 };
+
+  // Phase progress is reported at least that often, when the phase advances.
+  static constexpr std::chrono::milliseconds k_phase_report_interval{ 250 };
+
+  explicit prepare_progress_reporter(progress_callback_t progress_callback,
+                                     phase_progress_callback_t phase_progress_callback);
+
+  // Starts the overall progress as unknown. It's known once the writing starts.
+  void start();
+  void finish();
+
+  // Size of the phase is the number of keys if it's not 0, or the number of bytes if it's not 0.
+  // If both are 0, the progress is unknown.
+  void start_phase(prepare_phase phase, uint64_t total_keys, uint64_t total_bytes);
+  void advance(prepare_phase phase, uint64_t keys, uint64_t bytes);
+  void finish_phase(prepare_phase phase);
+
+  // Time and work of the phase so far, or till it has been finished.
+  prepare_phase_stats phase_stats(prepare_phase phase);
+
+private:
+  using clock_t = std::chrono::steady_clock;
+
+  struct phase_state
+  {
+    uint64_t total_keys{ 0u };
+    uint64_t total_bytes{ 0u };
+    uint64_t keys{ 0u };
+    uint64_t bytes{ 0u };
+    clock_t::time_point start_time;
+    clock_t::time_point finish_time;
+    double start_cpu_seconds{ 0. };
+    double finish_cpu_seconds{ 0. };
+    clock_t::time_point last_report_time;
+    int last_reported_progress{ k_progress_never_reported };
+    bool is_finished{ false };
+  };
+
+  void report_phase(prepare_phase phase, bool force);
+  void report_overall(int progress);
+  static int progress_of(const phase_state& state);
+
+private:
+  std::mutex m_mtx;
+  progress_callback_t m_progress_callback;
+  phase_progress_callback_t m_phase_progress_callback;
+  std::array<phase_state, k_prepare_phases_count> m_phases;
+  int m_last_reported_progress{ k_progress_never_reported };
+};
+}
@@ -1,172 +1,947 @@
 #include "preparer.hpp"
 
+#include "blocked_bloom_filter_writer.hpp"
+#include "btree_bulk_loader.hpp"
+#include "btree_packing_loader.hpp"
+#include "btree_sorted_keys_inserter.hpp"
+#include "btree_spooling_bulk_loader.hpp"
+#include "flat_sorted_file_writer.hpp"
+#include "new_line_scanner.hpp"
+#include "sha1_radix_sort.hpp"
+#include "static_tree_writer.hpp"
+#include "text_sha1_decoder.hpp"
+
 #include <algorithm>
 #include <atomic>
+#include <cassert>
 #include <cstring>
+#include <filesystem>
 #include <string>
 #include <thread>
+#include <type_traits>
 #include <vector>
 
 namespace {
-constexpr auto k_sha1_buffer_max_size{ 1024u * 100u };
-constexpr auto k_file_chunk_size_to_read{ 1024u * 1024u };
-constexpr auto k_sorting_threads{ 3u };
+// Shared between all the parsing slots.
+constexpr auto k_sha1_buffers_max_size{ 1024u * 100u };
+constexpr auto k_sha1_buffer_min_size{ 1024u * 4u };
+constexpr auto k_default_file_chunk_size_to_read{ 1024u * 1024u };
+
+// Hashes of this many lines are decoded with one call of the decoder.
+constexpr std::size_t k_parse_batch_size{ 256u };
+
+// Progress of writing is reported every this many keys.
+constexpr std::size_t k_write_progress_step{ 64u * 1024u };
+
+unsigned resolve_input_chunk_size(const okon::preparer_options& options)
+{
+  return options.input_chunk_size > 0u ? options.input_chunk_size
+                                       : k_default_file_chunk_size_to_read;
+}
+
+unsigned resolve_input_buffers_count(const okon::preparer_options& options, unsigned threads)
+{
+  // The parsing keeps one buffer while it takes the next one, so it needs two at least.
+  return options.input_buffers_count > 0u ? std::max(2u, options.input_buffers_count)
+                                          : std::max(4u, 2u * threads);
+}
+
+template <typename Record>
+constexpr bool k_has_counts{ std::is_same_v<Record, okon::counted_sha1> };
+
+template <typename Record>
+Record make_record(const okon::sha1_t& sha1, const char* line, const char* line_end)
+{
+  if constexpr (k_has_counts<Record>) {
+    return { sha1, okon::parse_count(line + okon::k_text_sha1_length, line_end) };
+  } else {
+    return sha1;
+  }
+}
+
+// All records of a file share the first byte.
+void sort_file_records(okon::sha1_t* records, std::size_t count)
+{
+  okon::radix_sort_sha1(records, count, /*first_byte=*/1u);
+}
+
+void sort_file_records(okon::counted_sha1* records, std::size_t count)
+{
+  okon::radix_sort_counted_sha1(records, count, /*first_byte=*/1u);
+}
+
+std::string checkpoint_path(std::string_view working_directory_path)
+{
+  return std::string{ working_directory_path } + "checkpoint";
+}
+
+bool has_at_least(const std::string& path, uint64_t size)
+{
+  std::error_code error;
+  const auto file_size = std::filesystem::file_size(path, error);
+  return error ? size == 0u : file_size >= size;
+}
+
+// Whether the files the checkpoint refers to are still there, as big as they were.
+bool is_resumable(const okon::prepare_checkpoint& checkpoint,
+                  std::string_view working_directory_path)
+{
+  const auto& identity = checkpoint.identity;
+  if (checkpoint.records_counts.size() != okon::k_intermediate_files_count ||
+      checkpoint.parsed_bytes > identity.input_size) {
+    return false;
+  }
+
+  for (auto i = 0u; i < okon::k_intermediate_files_count; ++i) {
+    const auto path = okon::splitted_files::file_path(working_directory_path, i);
+    if (!has_at_least(path, checkpoint.records_counts[i] * identity.record_size)) {
+      return false;
+    }
+  }
+
+  const auto& written_shards = checkpoint.written_shards_keys_counts;
+  if (written_shards.empty()) {
+    return true;
+  }
+
+  if (!checkpoint.parsed || written_shards.size() >= identity.shards_count) {
+    return false;
+  }
+
+  const auto manifest =
+    okon::shards_manifest::split(identity.output_path, identity.shards_count);
+  for (auto i = 0u; i < written_shards.size(); ++i) {
+    if (!has_at_least(manifest.shards()[i].path, 1u)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Checkpoint left in the working directory by a failed preparation of the same identity, or a new
+// one. std::nullopt if checkpoints aren't saved.
+template <typename Record>
+std::optional<okon::prepare_checkpoint> load_checkpoint(std::string_view input_file_path,
+                                                        std::string_view working_directory_path,
+                                                        std::string_view output_file_path,
+                                                        const okon::preparer_options& options)
+{
+  if (options.checkpoint_interval == 0u) {
+    return std::nullopt;
+  }
+
+  auto identity = okon::input_identity(input_file_path);
+  if (!identity) {
+    return std::nullopt;
+  }
+
+  identity->output_path = std::string{ output_file_path };
+  identity->format = static_cast<uint32_t>(options.format);
+  identity->compression = static_cast<uint32_t>(
+    okon::resolve_input_compression(input_file_path, options.compression));
+  identity->record_size = sizeof(Record);
+  identity->btree_node_size = options.btree_node_size;
+  identity->shards_count = options.shards_count > 1u ? options.shards_count : 0u;
+  identity->filter_bits_per_key = options.filter_bits_per_key;
+  identity->has_merged_keys = options.merged_keys ? 1u : 0u;
+  identity->merged_keys_count = options.merged_keys_count;
+
+  auto checkpoint = okon::prepare_checkpoint::load(checkpoint_path(working_directory_path));
+  if (checkpoint && checkpoint->identity == *identity &&
+      is_resumable(*checkpoint, working_directory_path)) {
+    return checkpoint;
+  }
+
+  checkpoint.emplace();
+  checkpoint->identity = std::move(*identity);
+  checkpoint->records_counts.assign(okon::k_intermediate_files_count, 0u);
+  return checkpoint;
+}
+
+std::unique_ptr<okon::input_stream> open_input(std::string_view input_file_path,
+                                               okon::input_compression compression,
+                                               const std::optional<okon::prepare_checkpoint>&
+                                                 checkpoint)
+{
+  auto input = okon::open_input_stream(input_file_path, compression);
+
+  // Parsed input isn't read at all.
+  if (input->is_open() && checkpoint && !checkpoint->parsed) {
+    input->skip(checkpoint->parsed_bytes);
+  }
+
+  return input;
+}
 }
 
 namespace okon {
-preparer::preparer(std::string_view input_file_path, std::string_view working_directory_path,
-                   std::string_view output_file_path, progress_callback_t progress_callback)
-  : m_input_file_wrapper{ input_file_path }
-  , m_input_reader{ m_input_file_wrapper,
-                    /*buffer_size=*/k_file_chunk_size_to_read + k_text_sha1_length_for_simd,
-                    /*size_to_read_from_storage=*/k_file_chunk_size_to_read,
-                    /*number_of_buffers=*/4u }
-  , m_intermediate_files{ working_directory_path, std::ios::in | std::ios::out | std::ios::trunc }
-  , m_output_file_wrapper{ output_file_path }
-  , m_btree{ m_output_file_wrapper, /*order=*/1024u }
-  , m_sha1_buffers{ 256u }
+template <typename Record>
+basic_preparer<Record>::basic_preparer(std::string_view input_file_path,
+                                       std::string_view working_directory_path,
+                                       std::string_view output_file_path,
+                                       progress_callback_t progress_callback,
+                                       const preparer_options& options,
+                                       phase_progress_callback_t phase_progress_callback)
+  : m_checkpoint{ load_checkpoint<Record>(input_file_path, working_directory_path,
+                                           output_file_path, options) }
+  , m_input{ open_input(input_file_path, options.compression, m_checkpoint) }
+  , m_thread_pool{ resolve_threads_count(options.threads) }
+  , m_input_reader{
+    *m_input,
+    /*buffer_size=*/resolve_input_chunk_size(options) + k_text_sha1_length_for_simd,
+    /*size_to_read_from_storage=*/resolve_input_chunk_size(options),
+    /*number_of_buffers=*/resolve_input_buffers_count(options, m_thread_pool.threads_count())
+  }
+  , m_working_directory_path{ working_directory_path }
+  , m_checkpoint_path{ checkpoint_path(working_directory_path) }
+  , m_output_file_path{ output_file_path }
+  , m_options{ options }
+  , m_parsing_slots{ m_thread_pool.threads_count() }
+  , m_sha1_buffer_max_size{ std::max<std::size_t>(
+      k_sha1_buffer_min_size, k_sha1_buffers_max_size / m_thread_pool.threads_count()) }
+  , m_progress{ std::move(progress_callback), std::move(phase_progress_callback) }
+  , m_sorted_files_ahead_of_writing{ std::max(2u, 2u * m_thread_pool.threads_count()) }
   , m_sorted_files_ready_state{}
-  , m_progress_callback{ std::move(progress_callback) }
 {
   m_sorted_files_ready_state.fill(false);
 
-  for (auto& buffer : m_sha1_buffers) {
-    buffer.reserve(k_sha1_buffer_max_size);
+  // Shards are created here, the output is created by the caller.
+  if (m_options.shards_count > 1u) {
+    m_manifest = shards_manifest::split(m_output_file_path, m_options.shards_count);
+  }
+
+  if (m_checkpoint) {
+    resume_checkpoint();
+  }
+
+  if (m_manifest) {
+    m_output = std::make_unique<output>(m_manifest->shards()[m_current_shard].path,
+                                        std::ios::in | std::ios::out | std::ios::trunc);
+  } else {
+    m_output = std::make_unique<output>(m_output_file_path, std::ios::in | std::ios::out);
+  }
+
+  if constexpr (k_has_counts<Record>) {
+    m_counts_file_wrapper.emplace(m_working_directory_path + "counts",
+                                  std::ios::in | std::ios::out | std::ios::trunc);
+  }
+
+  if (m_options.format == file_format::btree_v3 && m_options.merged_keys) {
+    m_spool_file_wrapper.emplace(m_working_directory_path + "keys",
+                                 std::ios::in | std::ios::out | std::ios::trunc);
+  }
+
+  for (auto& slot : m_parsing_slots) {
+    slot.sha1_buffers.resize(k_intermediate_files_count);
+    for (auto& buffer : slot.sha1_buffers) {
+      buffer.reserve(m_sha1_buffer_max_size);
+    }
   }
 }
 
-preparer::result preparer::prepare()
+template <typename Record>
+typename basic_preparer<Record>::result basic_preparer<Record>::prepare()
 {
   if (!m_input_reader.is_open()) {
     return result::could_not_open_input_file;
   }
 
-  if (!m_intermediate_files.are_all_open()) {
+  // Without the memory budget all the hashes go to the intermediate files, so they're needed
+  // from the start.
+  if (m_options.memory_budget == 0u && !open_intermediate_files()) {
     return result::could_not_open_intermediate_files;
   }
 
-  if (!m_output_file_wrapper.is_open()) {
+  if (!m_output->file.is_open()) {
     return result::could_not_open_output;
   }
 
-  report_progress(k_progress_unknown);
+  if (m_counts_file_wrapper && !m_counts_file_wrapper->is_open()) {
+    return result::could_not_open_intermediate_files;
+  }
 
-  while (const auto sha1 = m_input_reader.next_sha1()) {
-    add_sha1_to_file(*sha1);
-    ++m_total_sha1_count;
+  if (m_spool_file_wrapper && !m_spool_file_wrapper->is_open()) {
+    return result::could_not_open_intermediate_files;
   }
 
-  for (auto i = 0u; i < m_sha1_buffers.size(); ++i) {
-    write_sha1_buffer(i);
+  const auto start_time = std::chrono::steady_clock::now();
+  const auto start_cpu_seconds = process_cpu_seconds();
+  m_progress.start();
+
+  // Only the input after the checkpoint is parsed.
+  const auto input_size = m_input->size().value_or(0u);
+  m_progress.start_phase(prepare_phase::parse, /*total_keys=*/0u,
+                         /*total_bytes=*/input_size - std::min(input_size, m_parsed_bytes));
+  if (!m_checkpoint || !m_checkpoint->parsed) {
+    parse_input();
   }
+  m_progress.finish_phase(prepare_phase::parse);
 
+  if (m_could_not_open_intermediate_files) {
+    return result::could_not_open_intermediate_files;
+  }
+
+  // Output of the input up to the error would silently miss the rest of the keys.
+  if (m_input->has_error()) {
+    return result::could_not_read_input_file;
+  }
+
+  if (m_manifest) {
+    const auto& shard = m_manifest->shards()[m_current_shard];
+    m_first_file_to_write = shard.first_byte;
+    m_written_files_count = shard.first_byte;
+    m_output_writer = create_output_writer(files_records_count(shard.first_byte, shard.last_byte));
+  } else {
+    m_output_writer = create_output_writer(m_total_sha1_count);
+  }
+
+  const auto keys_to_write = files_records_count(m_first_file_to_write, 0xffu);
+  m_progress.start_phase(prepare_phase::sort, keys_to_write, /*total_bytes=*/0u);
+  m_progress.start_phase(prepare_phase::write, keys_to_write, /*total_bytes=*/0u);
   start_writing_sorted_files_thread();
   sort_files();
+  m_progress.finish_phase(prepare_phase::sort);
   m_writing_sorted_files_thread.join();
+  m_progress.finish_phase(prepare_phase::write);
+
+  m_progress.finish();
 
-  report_progress(100);
+  if (m_could_not_open_output) {
+    return result::could_not_open_output;
+  }
+
+  collect_stats(start_time, start_cpu_seconds);
+
+  if (m_checkpoint) {
+    std::error_code error;
+    std::filesystem::remove(m_checkpoint_path, error);
+  }
 
   return result::success;
 }
 
-void preparer::add_sha1_to_file(std::string_view sha1)
+template <typename Record>
+unsigned long long basic_preparer<Record>::output_keys_count() const
+{
+  return m_output_keys_count;
+}
+
+template <typename Record>
+std::vector<shard_info> basic_preparer<Record>::output_shards() const
 {
-  const auto index = two_first_chars_to_byte(sha1.data());
-  m_sha1_buffers[index].emplace_back(text_sha1_to_binary(sha1.data()));
+  return m_manifest ? m_manifest->shards() : std::vector<shard_info>{};
+}
+
+template <typename Record>
+const prepare_stats& basic_preparer<Record>::stats() const
+{
+  return m_stats;
+}
 
-  if (m_sha1_buffers[index].size() >= k_sha1_buffer_max_size) {
-    write_sha1_buffer(index);
-    m_sha1_buffers[index].clear();
+template <typename Record>
+void basic_preparer<Record>::collect_stats(std::chrono::steady_clock::time_point start_time,
+                                           double start_cpu_seconds)
+{
+  for (auto i = 0u; i < k_prepare_phases_count; ++i) {
+    m_stats.phases[i] = m_progress.phase_stats(static_cast<prepare_phase>(i));
   }
+
+  m_stats.wall_seconds =
+    std::chrono::duration<double>{ std::chrono::steady_clock::now() - start_time }.count();
+  m_stats.cpu_seconds = process_cpu_seconds() - start_cpu_seconds;
+
+  m_stats.input_bytes_read = m_input_reader.bytes_read();
+  m_stats.intermediate_bytes_written = m_intermediate_bytes_written;
+  m_stats.intermediate_bytes_read = m_intermediate_bytes_read;
+
+  using seconds_t = std::chrono::duration<double>;
+  m_stats.reader_stall_seconds = seconds_t{ m_input_reader.reading_stall_time() }.count();
+  m_stats.parser_stall_seconds = seconds_t{ m_input_reader.parsing_stall_time() }.count();
 }
 
-void preparer::sort_files()
+template <typename Record>
+bool basic_preparer<Record>::open_intermediate_files()
 {
-  const auto sort_pred = [](const sha1_t& lhs, const sha1_t& rhs) {
-    return std::memcmp(lhs.data(), rhs.data(), sizeof(sha1_t)) < 0;
-  };
+  std::lock_guard lock{ m_intermediate_files_mtx };
 
-  auto sorter = [sort_pred, this](unsigned start_index) {
-    std::vector<sha1_t> sha1s;
+  if (!m_intermediate_files) {
+    // Records of the checkpoint are kept, the files are appended to.
+    if (m_checkpoint && !truncate_intermediate_files()) {
+      m_could_not_open_intermediate_files = true;
+      return false;
+    }
 
-    for (auto i = start_index; i < k_intermediate_files_count; i += k_sorting_threads) {
-      auto& file = *(std::next(m_intermediate_files.begin(), i));
-      const std::streamsize file_size = file.tellp();
-      const auto sha1_count = file_size / sizeof(sha1_t);
-      sha1s.resize(sha1_count);
-      file.seekg(0);
-      file.read(reinterpret_cast<char*>(&sha1s[0]), file_size);
+    const auto mode = m_checkpoint ? std::ios::in | std::ios::out
+                                   : std::ios::in | std::ios::out | std::ios::trunc;
+    m_intermediate_files = std::make_unique<splitted_files>(m_working_directory_path, mode);
 
-      std::sort(std::begin(sha1s), std::end(sha1s), sort_pred);
+    if (m_checkpoint && m_intermediate_files->are_all_open()) {
+      for (auto i = 0u; i < k_intermediate_files_count; ++i) {
+        (*m_intermediate_files)[i].seekp(
+          static_cast<std::streamoff>(m_checkpoint->records_counts[i] * sizeof(Record)));
+      }
+    }
+  }
 
-      file.seekp(0);
-      file.write(reinterpret_cast<char*>(&sha1s[0]), file_size);
+  if (!m_intermediate_files->are_all_open()) {
+    m_could_not_open_intermediate_files = true;
+    return false;
+  }
 
-      std::lock_guard lock{ m_processing_sorted_files_mtx };
-      m_sorted_files_ready_state[i] = true;
-      m_sorted_files_cvs[i].notify_one();
+  return true;
+}
+
+template <typename Record>
+bool basic_preparer<Record>::truncate_intermediate_files()
+{
+  for (auto i = 0u; i < k_intermediate_files_count; ++i) {
+    const auto path = splitted_files::file_path(m_working_directory_path, i);
+
+    // Creates the file if it doesn't exist, without truncating it.
+    std::ofstream{ path, std::ios::app };
+
+    std::error_code error;
+    std::filesystem::resize_file(path, m_checkpoint->records_counts[i] * sizeof(Record), error);
+    if (error) {
+      return false;
     }
-  };
+  }
+
+  return true;
+}
+
+template <typename Record>
+void basic_preparer<Record>::resume_checkpoint()
+{
+  // The files are read back, so nothing can be kept in memory only.
+  m_options.memory_budget = 0u;
 
-  std::vector<std::thread> threads;
-  threads.reserve(k_sorting_threads);
+  m_parsed_bytes = m_checkpoint->parsed_bytes;
+  m_checkpointed_bytes = m_parsed_bytes;
 
-  for (auto i = 0u; i < k_sorting_threads; ++i) {
-    threads.emplace_back(sorter, i);
+  for (auto i = 0u; i < k_intermediate_files_count; ++i) {
+    auto& bucket = m_buckets[i];
+    bucket.records_count = m_checkpoint->records_counts[i];
+    bucket.spilled = bucket.records_count > 0u;
+    m_total_sha1_count += bucket.records_count;
   }
 
-  for (auto& t : threads) {
-    t.join();
+  if (!m_manifest) {
+    return;
   }
+
+  // Writing continues with the first shard that isn't written.
+  for (const auto keys_count : m_checkpoint->written_shards_keys_counts) {
+    m_manifest->shards()[m_current_shard++].keys_count = keys_count;
+    m_output_keys_count += keys_count;
+  }
+  m_shard_first_key_index = m_output_keys_count;
 }
 
-void preparer::start_writing_sorted_files_thread()
+template <typename Record>
+void basic_preparer<Record>::checkpoint_parsing(bool parsed)
 {
-  m_writing_sorted_files_thread = std::thread{ [this] {
-    std::vector<sha1_t> sha1s;
+  for (auto& slot : m_parsing_slots) {
+    for (auto i = 0u; i < k_intermediate_files_count; ++i) {
+      write_sha1_buffer(slot, i);
+    }
+  }
+
+  // A checkpoint of a failed write, e.g. to a full disk, would be resumed with missing records.
+  if (m_could_not_open_intermediate_files || !m_intermediate_files) {
+    return;
+  }
+  for (auto& file : *m_intermediate_files) {
+    if (!file.flush().good()) {
+      return;
+    }
+  }
+
+  m_checkpoint->parsed = parsed;
+  m_checkpoint->parsed_bytes = m_parsed_bytes;
+  for (auto i = 0u; i < k_intermediate_files_count; ++i) {
+    m_checkpoint->records_counts[i] = m_buckets[i].records_count;
+  }
+  save_checkpoint();
+  m_checkpointed_bytes = m_parsed_bytes;
+}
+
+template <typename Record>
+void basic_preparer<Record>::save_checkpoint()
+{
+  // Without the checkpoint the preparation still succeeds, it's just resumed from an earlier one.
+  m_checkpoint->save(m_checkpoint_path);
+}
+
+template <typename Record>
+void basic_preparer<Record>::parse_input()
+{
+  // The reader thread keeps reading ahead while a batch of parts is being parsed.
+  auto has_more_input = true;
+  while (has_more_input) {
+    auto slots_to_parse = 0u;
+    for (auto& slot : m_parsing_slots) {
+      slot.lines_size = m_input_reader.next_lines(slot.lines);
+      if (slot.lines_size == 0u) {
+        has_more_input = false;
+        break;
+      }
+      ++slots_to_parse;
+    }
 
+    unsigned long long sha1_count_before{ 0u };
+    for (auto& slot : m_parsing_slots) {
+      sha1_count_before += slot.sha1_count;
+    }
+
+    m_thread_pool.parallel_for(slots_to_parse,
+                               [this](std::size_t index) { parse_lines(m_parsing_slots[index]); });
+
+    unsigned long long sha1_count_after{ 0u };
+    unsigned long long parsed_bytes{ 0u };
+    for (auto i = 0u; i < m_parsing_slots.size(); ++i) {
+      sha1_count_after += m_parsing_slots[i].sha1_count;
+      parsed_bytes += i < slots_to_parse ? m_parsing_slots[i].lines_size : 0u;
+    }
+    m_progress.advance(prepare_phase::parse, sha1_count_after - sha1_count_before, parsed_bytes);
+
+    m_parsed_bytes += parsed_bytes;
+    if (m_checkpoint && m_parsed_bytes - m_checkpointed_bytes >= m_options.checkpoint_interval) {
+      checkpoint_parsing(/*parsed=*/false);
+    }
+  }
+
+  for (auto& slot : m_parsing_slots) {
     for (auto i = 0u; i < k_intermediate_files_count; ++i) {
+      write_sha1_buffer(slot, i);
+    }
+    m_total_sha1_count += slot.sha1_count;
+  }
+
+  // After an error, the input is parsed again from the last checkpoint.
+  if (m_checkpoint && !m_input->has_error()) {
+    checkpoint_parsing(/*parsed=*/true);
+  }
+}
+
+template <typename Record>
+void basic_preparer<Record>::parse_lines(parsing_slot& slot)
+{
+  const auto* const text = slot.lines.data();
+  const auto* const end = text + slot.lines_size;
+
+  // All new lines of the part are found in one pass, so the lines are then cut without scanning.
+  slot.new_lines.clear();
+  find_new_lines(text, slot.lines_size, slot.new_lines);
+
+  std::array<const char*, k_parse_batch_size> lines;
+  std::array<const char*, k_parse_batch_size> lines_ends;
+  std::array<sha1_t, k_parse_batch_size> sha1s;
+  std::size_t lines_count{ 0u };
+
+  const auto add_batch = [&] {
+    text_sha1s_to_binary(lines.data(), lines_count, sha1s.data());
+    for (std::size_t i = 0u; i < lines_count; ++i) {
+      add_sha1_to_buffer(slot, sha1s[i], lines[i], lines_ends[i]);
+    }
+    lines_count = 0u;
+  };
+
+  const auto add_line = [&](const char* line, const char* line_end) {
+    // Shorter lines, e.g. empty ones, can't contain a hash.
+    if (line_end - line < static_cast<std::ptrdiff_t>(k_text_sha1_length)) {
+      return;
+    }
+
+    lines[lines_count] = line;
+    lines_ends[lines_count] = line_end;
+    if (++lines_count == k_parse_batch_size) {
+      add_batch();
+    }
+  };
+
+  const auto* line = text;
+  for (const auto new_line_offset : slot.new_lines) {
+    const auto* const line_end = text + new_line_offset;
+    add_line(line, line_end);
+    line = line_end + 1;
+  }
+
+  // Only the end of the input may be not followed by a new line.
+  add_line(line, end);
+  add_batch();
+}
+
+template <typename Record>
+void basic_preparer<Record>::add_sha1_to_buffer(parsing_slot& slot, const sha1_t& sha1,
+                                                const char* line, const char* line_end)
+{
+  // The first byte of the hash selects its intermediate file.
+  const auto index = sha1[0];
+  auto& buffer = slot.sha1_buffers[index];
+  buffer.emplace_back(make_record<Record>(sha1, line, line_end));
+  ++slot.sha1_count;
+
+  if (buffer.size() >= m_sha1_buffer_max_size) {
+    write_sha1_buffer(slot, index);
+  }
+}
+
+template <typename Record>
+std::unique_ptr<sorted_keys_writer> basic_preparer<Record>::create_output_writer(
+  unsigned long long keys_count)
+{
+  constexpr auto k_default_btree_order{ 1024u };
+  auto* const counts_storage = m_counts_file_wrapper ? &*m_counts_file_wrapper : nullptr;
+
+  const auto create_btree_writer =
+    [this, k_default_btree_order, keys_count](
+      btree_format_version version) -> std::unique_ptr<sorted_keys_writer> {
+    // With the node size given, leaves are as big as it and nodes are aligned to it. v1 files can't
+    // store the alignment, so only the order is derived from the size.
+    const auto node_size = m_options.btree_node_size;
+    const auto order = node_size > 0u ? btree_node_layout::max_order_for_size(version, node_size)
+                                      : k_default_btree_order;
+    const auto node_alignment = version == btree_format_version::v1 ? 0u : node_size;
+
+    // Number of the output keys is known, unless keys present in both the input and the merged
+    // keys are written once.
+    if (!m_options.merged_keys) {
+      return std::make_unique<sorted_keys_writer_adapter<btree_bulk_loader<fstream_wrapper>>>(
+        m_output->file, order, keys_count, version, node_alignment);
+    }
+
+    // Compact leaves are placed after all the inner nodes, which only the bulk loader does.
+    if (m_spool_file_wrapper) {
+      return std::make_unique<
+        sorted_keys_writer_adapter<btree_spooling_bulk_loader<fstream_wrapper>>>(
+        m_output->file, *m_spool_file_wrapper, order, version, node_alignment);
+    }
+
+    return std::make_unique<sorted_keys_writer_adapter<
+      btree_sorted_keys_inserter<write_combining_storage<fstream_wrapper>>>>(
+      m_output->storage, order, version, node_alignment);
+  };
+
+  switch (m_options.format) {
+    case file_format::btree_v1:
+      return create_btree_writer(btree_format_version::v1);
+    case file_format::btree_v2:
+      return create_btree_writer(btree_format_version::v2);
+    case file_format::btree_v3:
+      return create_btree_writer(btree_format_version::v3);
+    case file_format::btree_v4: {
+      // Nodes are packed as the keys come, so merges don't need to know the number of keys. They
+      // are always aligned to their size, the format is new.
+      const auto node_size = m_options.btree_node_size > 0u
+        ? m_options.btree_node_size
+        : btree_packing_loader<fstream_wrapper>::k_default_node_size;
+      return std::make_unique<
+        sorted_keys_writer_adapter<btree_packing_loader<fstream_wrapper>>>(
+        m_output->file, node_size, node_size);
+    }
+    case file_format::static_tree:
+      return std::make_unique<sorted_keys_writer_adapter<static_tree_writer<fstream_wrapper>>>(
+        m_output->file, static_tree_geometry::k_default_leaf_block_keys,
+        static_tree_geometry::k_default_internal_block_keys, counts_storage);
+    case file_format::flat_sorted:
+      return std::make_unique<
+        sorted_keys_writer_adapter<flat_sorted_file_writer<fstream_wrapper>>>(
+        m_output->file, flat_file_layout::k_default_directory_bits, counts_storage);
+    case file_format::blocked_bloom_filter:
+      return std::make_unique<
+        sorted_keys_writer_adapter<blocked_bloom_filter_writer<fstream_wrapper>>>(
+        m_output->file, keys_count + m_options.merged_keys_count,
+        m_options.filter_bits_per_key);
+    case file_format::shards_manifest:
+      // Sharded output is written as files of the shards' format, see m_manifest.
+      assert(false && "a manifest is never a writer format");
+      break;
+  }
+
+  return nullptr;
+}
+
+template <typename Record>
+void basic_preparer<Record>::sort_files()
+{
+  // Pool threads take files one by one, in the order the writing thread consumes them, so a big
+  // file delays only the thread that sorts it.
+  m_thread_pool.parallel_for(k_intermediate_files_count, [this](std::size_t i) {
+    // Keys of these files are in the shards written before the checkpoint.
+    if (i < m_first_file_to_write) {
+      return;
+    }
+
+    auto& bucket = m_buckets[i];
+
+    if (bucket.spilled) {
+      // Spilled files are loaded only a few files ahead of the writing, so memory for them stays
+      // bounded. Files in memory are sorted right away, their memory is already used.
       {
         std::unique_lock lock{ m_processing_sorted_files_mtx };
-        m_sorted_files_cvs[i].wait(lock, [i, this] { return m_sorted_files_ready_state[i]; });
+        m_written_files_cv.wait(lock, [i, this] {
+          return i < m_written_files_count + m_sorted_files_ahead_of_writing;
+        });
       }
 
-      auto& file = m_intermediate_files[i];
-
-      file.seekp(0, std::ios::end);
+      auto& file = (*m_intermediate_files)[static_cast<unsigned>(i)];
       const std::streamsize file_size = file.tellp();
-      const auto sha1_count = file_size / sizeof(sha1_t);
-      sha1s.resize(sha1_count);
+      bucket.sha1s.resize(file_size / sizeof(Record));
       file.seekg(0);
-      file.read(reinterpret_cast<char*>(&sha1s[0]), file_size);
+      file.read(reinterpret_cast<char*>(bucket.sha1s.data()), file_size);
+      m_intermediate_bytes_read += static_cast<uint64_t>(file_size);
+    }
+
+    sort_file_records(bucket.sha1s.data(), bucket.sha1s.size());
+    m_progress.advance(prepare_phase::sort, bucket.sha1s.size(),
+                       bucket.sha1s.size() * sizeof(Record));
 
-      for (const auto& sha1 : sha1s) {
-        m_btree.insert_sorted(sha1);
+    // Sorted hashes are handed over to the writing thread in memory.
+    std::lock_guard lock{ m_processing_sorted_files_mtx };
+    m_sorted_files_ready_state[i] = true;
+    m_sorted_files_cv.notify_one();
+  });
+}
+
+template <typename Record>
+void basic_preparer<Record>::start_writing_sorted_files_thread()
+{
+  m_writing_sorted_files_thread = std::thread{ [this] {
+    if (m_options.merged_keys) {
+      m_next_merged_key = m_options.merged_keys->next();
 
-        ++m_sha1_written_to_tree_count;
-        const auto progress = 100 * m_sha1_written_to_tree_count / m_total_sha1_count;
-        report_progress(progress);
+      // Like the files, merged keys of the shards written before the checkpoint are skipped.
+      while (m_next_merged_key && (*m_next_merged_key)[0] < m_first_file_to_write) {
+        m_next_merged_key = m_options.merged_keys->next();
       }
     }
 
-    m_btree.finalize_inserting();
+    for (auto i = m_first_file_to_write; i < k_intermediate_files_count; ++i) {
+      {
+        std::unique_lock lock{ m_processing_sorted_files_mtx };
+        m_sorted_files_cv.wait(lock, [i, this] { return m_sorted_files_ready_state[i]; });
+      }
+
+      if (m_manifest && !m_could_not_open_output) {
+        start_shard_of_file(i);
+      }
+
+      // After a shard fails to open, the files are still taken, so the sorting doesn't wait for
+      // them forever, but nothing is written.
+      auto& bucket = m_buckets[i];
+      if (!m_could_not_open_output) {
+        write_sorted_sha1s(bucket.sha1s);
+      }
+      bucket.sha1s = std::vector<Record>{};
+
+      std::lock_guard lock{ m_processing_sorted_files_mtx };
+      ++m_written_files_count;
+      m_written_files_cv.notify_all();
+    }
+
+    if (m_could_not_open_output) {
+      return;
+    }
+
+    write_merged_keys_less_than(nullptr);
+    finish_output();
+
+    if (m_manifest) {
+      write_manifest();
+    }
   } };
 }
 
-void preparer::write_sha1_buffer(unsigned buffer_index)
+template <typename Record>
+unsigned long long basic_preparer<Record>::files_records_count(unsigned first_byte,
+                                                               unsigned last_byte) const
+{
+  unsigned long long count{ 0u };
+  for (auto i = first_byte; i <= last_byte; ++i) {
+    count += m_buckets[i].records_count;
+  }
+  return count;
+}
+
+template <typename Record>
+void basic_preparer<Record>::start_shard_of_file(unsigned file_index)
+{
+  // Shards without keys are written too, so every shard of the manifest can be opened.
+  auto& shards = m_manifest->shards();
+  while (shards[m_current_shard].last_byte < file_index) {
+    // Merged keys less than the first key of the next shard belong to the current one.
+    sha1_t next_shard_first_key{};
+    next_shard_first_key[0] = shards[m_current_shard + 1u].first_byte;
+    write_merged_keys_less_than(&next_shard_first_key);
+    finish_output();
+
+    if (m_checkpoint) {
+      m_checkpoint->written_shards_keys_counts.push_back(shards[m_current_shard].keys_count);
+      save_checkpoint();
+    }
+
+    const auto& shard = shards[++m_current_shard];
+    m_output_writer.reset();
+    m_output = std::make_unique<output>(shard.path,
+                                        std::ios::in | std::ios::out | std::ios::trunc);
+    if (!m_output->file.is_open()) {
+      m_could_not_open_output = true;
+      return;
+    }
+
+    m_output_writer =
+      create_output_writer(files_records_count(shard.first_byte, shard.last_byte));
+  }
+}
+
+template <typename Record>
+void basic_preparer<Record>::finish_output()
+{
+  const auto start_time = std::chrono::steady_clock::now();
+  m_output_writer->finalize_inserting();
+  m_output->storage.flush();
+  m_output->file.flush();
+  m_stats.finalize_seconds +=
+    std::chrono::duration<double>{ std::chrono::steady_clock::now() - start_time }.count();
+
+  const auto& path =
+    m_manifest ? m_manifest->shards()[m_current_shard].path : m_output_file_path;
+  std::error_code error;
+  const auto size = std::filesystem::file_size(path, error);
+  if (!error) {
+    m_stats.output_bytes_written += size;
+  }
+
+  if (m_manifest) {
+    m_manifest->shards()[m_current_shard].keys_count =
+      m_output_keys_count - m_shard_first_key_index;
+    m_shard_first_key_index = m_output_keys_count;
+  }
+}
+
+template <typename Record>
+void basic_preparer<Record>::write_manifest()
+{
+  fstream_wrapper manifest_file{ m_output_file_path, std::ios::out | std::ios::trunc };
+  if (!manifest_file.is_open()) {
+    m_could_not_open_output = true;
+    return;
+  }
+
+  m_manifest->write(manifest_file);
+  m_stats.output_bytes_written += static_cast<uint64_t>(manifest_file.tell_out());
+}
+
+template <typename Record>
+void basic_preparer<Record>::write_sorted_sha1s(const std::vector<Record>& sha1s)
+{
+  // Progress is reported once per step, not per key.
+  for (std::size_t begin = 0u; begin < sha1s.size(); begin += k_write_progress_step) {
+    const auto end = std::min(sha1s.size(), begin + k_write_progress_step);
+
+    for (auto i = begin; i < end; ++i) {
+      const auto& sha1 = key_of(sha1s[i]);
+      auto count = count_of(sha1s[i]);
+
+      if (m_next_merged_key) {
+        write_merged_keys_less_than(&sha1);
+        if (m_next_merged_key == sha1) {
+          count = add_counts(count, m_options.merged_keys->count());
+          m_next_merged_key = m_options.merged_keys->next();
+        }
+      }
+
+      write_to_output(sha1, count);
+    }
+
+    m_progress.advance(prepare_phase::write, end - begin, (end - begin) * sizeof(sha1_t));
+  }
+}
+
+template <typename Record>
+void basic_preparer<Record>::write_merged_keys_less_than(const sha1_t* sha1)
 {
-  auto& file = m_intermediate_files[buffer_index];
-  file.write(reinterpret_cast<const char*>(m_sha1_buffers[buffer_index][0].data()),
-             sizeof(sha1_t) * m_sha1_buffers[buffer_index].size());
+  // nullptr means all the remaining keys.
+  while (m_next_merged_key && (sha1 == nullptr || *m_next_merged_key < *sha1)) {
+    write_to_output(*m_next_merged_key, m_options.merged_keys->count());
+    m_next_merged_key = m_options.merged_keys->next();
+  }
 }
 
-void preparer::report_progress(int progress)
+template <typename Record>
+void basic_preparer<Record>::write_to_output(const sha1_t& sha1, uint32_t count)
 {
-  if (m_last_reported_progress == progress) {
+  ++m_output_keys_count;
+
+  if constexpr (k_has_counts<Record>) {
+    m_output_writer->insert_sorted(sha1, count);
+  } else {
+    m_output_writer->insert_sorted(sha1);
+  }
+}
+
+template <typename Record>
+void basic_preparer<Record>::write_sha1_buffer(parsing_slot& slot, unsigned buffer_index)
+{
+  auto& buffer = slot.sha1_buffers[buffer_index];
+  if (buffer.empty()) {
     return;
   }
 
-  m_progress_callback(progress);
-  m_last_reported_progress = progress;
+  {
+    auto& bucket = m_buckets[buffer_index];
+    std::lock_guard lock{ bucket.mtx };
+
+    if (!bucket.spilled && !keep_in_memory(bucket, buffer)) {
+      spill(bucket, buffer_index);
+    }
+
+    bucket.records_count += buffer.size();
+
+    if (bucket.spilled && !m_could_not_open_intermediate_files) {
+      auto& file = (*m_intermediate_files)[buffer_index];
+      file.write(reinterpret_cast<const char*>(buffer.data()), sizeof(Record) * buffer.size());
+      m_intermediate_bytes_written += sizeof(Record) * buffer.size();
+    }
+  }
+
+  buffer.clear();
+}
+
+template <typename Record>
+bool basic_preparer<Record>::keep_in_memory(intermediate_bucket& bucket,
+                                            const std::vector<Record>& buffer)
+{
+  const auto size = buffer.size() * sizeof(Record);
+  if (m_memory_used.fetch_add(size) + size > m_options.memory_budget) {
+    m_memory_used.fetch_sub(size);
+    return false;
+  }
+
+  bucket.sha1s.insert(bucket.sha1s.end(), buffer.cbegin(), buffer.cend());
+  return true;
+}
+
+template <typename Record>
+void basic_preparer<Record>::spill(intermediate_bucket& bucket, unsigned bucket_index)
+{
+  bucket.spilled = true;
+
+  if (!open_intermediate_files()) {
+    return;
+  }
+
+  auto& file = (*m_intermediate_files)[bucket_index];
+  file.write(reinterpret_cast<const char*>(bucket.sha1s.data()),
+             sizeof(Record) * bucket.sha1s.size());
+  m_intermediate_bytes_written += sizeof(Record) * bucket.sha1s.size();
+
+  m_memory_used.fetch_sub(bucket.sha1s.size() * sizeof(Record));
+  bucket.sha1s = std::vector<Record>{};
 }
+
+template class basic_preparer<sha1_t>;
+template class basic_preparer<counted_sha1>;
 }
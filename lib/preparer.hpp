@@ -1,69 +1,255 @@
 #pragma once
 
-#include "btree_sorted_keys_inserter.hpp"
+#include "file_format.hpp"
 #include "fstream_wrapper.hpp"
+#include "input_stream.hpp"
+#include "key_counts.hpp"
 #include "original_file_reader.hpp"
+#include "prepare_checkpoint.hpp"
+#include "prepare_progress.hpp"
 #include "sha1_utils.hpp"
+#include "shards_manifest.hpp"
+#include "sorted_keys_reader.hpp"
+#include "sorted_keys_writer.hpp"
 #include "splitted_files.hpp"
+#include "thread_pool.hpp"
+#include "write_combining_storage.hpp"
 
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <fstream>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <string>
 #include <string_view>
+#include <vector>
 
 namespace okon {
 constexpr auto k_intermediate_files_count{ 256u };
 
-class preparer
+struct preparer_options
+{
+  file_format format{ file_format::btree_v2 };
+
+  // 0 means hardware concurrency.
+  unsigned threads{ 0u };
+
+  // Bytes of binary hashes that can be kept in memory instead of the intermediate files.
+  unsigned long long memory_budget{ 0u };
+
+  // If set, keys of this reader are merged into the output, e.g. keys of a previously prepared
+  // file. Keys present in both the reader and the input are written once.
+  sorted_keys_reader* merged_keys{ nullptr };
+
+  // Number of keys of `merged_keys`. Needed only by formats sized up front, i.e. the filter.
+  unsigned long long merged_keys_count{ 0u };
+
+  // Size of the filter, if the output format is file_format::blocked_bloom_filter.
+  uint32_t filter_bits_per_key{ 12u };
+
+  // Compression of the input, see open_input_stream().
+  input_compression compression{ input_compression::detect };
+
+  // Bytes of the input read at once. 0 means the default, 1 MiB.
+  unsigned input_chunk_size{ 0u };
+
+  // Number of chunks that can be read ahead of the parsing. 0 means twice the number of threads,
+  // but at least four. At least two are used.
+  unsigned input_buffers_count{ 0u };
+
+  // Bytes of a node of B-tree formats, nodes are aligned to it. 0 means the default: order 1024
+  // and unaligned nodes, or 16 KiB nodes for file_format::btree_v4.
+  uint32_t btree_node_size{ 0u };
+
+  // If greater than 1, the output is split by the first byte of the keys into this many shards,
+  // every one prepared in `format`, and a shards_manifest of them is written to the output path.
+  // At most shards_manifest::k_max_shards_count. Not supported by the filter format, which is
+  // sized for all the keys up front.
+  unsigned shards_count{ 0u };
+
+  // If not 0, progress is saved to a prepare_checkpoint in the working directory every this many
+  // bytes of the parsed input, after the parsing and after every shard but the last one. A
+  // checkpoint left there by a failed preparation of the same identity is resumed. Hashes are never
+  // kept in memory then, so `memory_budget` is ignored. Needs an input that is a regular file.
+  unsigned long long checkpoint_interval{ 0u };
+};
+
+enum class preparer_result
+{
+  success,
+  could_not_open_input_file,
+  could_not_open_intermediate_files,
+  could_not_open_output,
+  could_not_read_input_file
+};
+
+// Parses the input, sorts it through the intermediate files and writes the output. Record is the
+// type of parsed lines: sha1_t, or counted_sha1 to store counts of the keys in the output. Counts
+// of the same key, e.g. of a merged key, are summed up.
+template <typename Record>
+class basic_preparer
 {
 public:
-  enum class result
+  using result = preparer_result;
+  using progress_callback_t = prepare_progress_reporter::progress_callback_t;
+  using phase_progress_callback_t = prepare_progress_reporter::phase_progress_callback_t;
+
+  explicit basic_preparer(std::string_view input_file_path,
+                          std::string_view working_directory_path,
+                          std::string_view output_file_path, progress_callback_t progress_callback,
+                          const preparer_options& options = preparer_options{},
+                          phase_progress_callback_t phase_progress_callback = nullptr);
+
+  result prepare();
+
+  // Number of keys written to the output by prepare().
+  unsigned long long output_keys_count() const;
+
+  // Shards written by prepare(), with their numbers of keys. Empty if the output isn't sharded.
+  std::vector<shard_info> output_shards() const;
+
+  // Profile of prepare(), filled when it succeeds.
+  const prepare_stats& stats() const;
+
+private:
+  // Part of the input parsed by one task, with the hashes scattered to per-file buffers. Every
+  // parsing task has its own slot, so no synchronization is needed till a buffer is written.
+  struct parsing_slot
   {
-    success,
-    could_not_open_input_file,
-    could_not_open_intermediate_files,
-    could_not_open_output
+    std::vector<char> lines;
+    std::size_t lines_size{ 0u };
+    std::vector<std::size_t> new_lines;
+    std::vector<std::vector<Record>> sha1_buffers;
+    unsigned long long sha1_count{ 0u };
   };
 
-  using progress_callback_t = std::function<void(int)>;
+  // Hashes of one intermediate file. They are kept in memory, till they don't fit in the memory
+  // budget. Then they are spilled to the intermediate file, together with all the next ones.
+  struct intermediate_bucket
+  {
+    std::mutex mtx;
+    std::vector<Record> sha1s;
+    bool spilled{ false };
+    unsigned long long records_count{ 0u };
+  };
 
-  explicit preparer(std::string_view input_file_path, std::string_view working_directory_path,
-                    std::string_view output_file_path, progress_callback_t progress_callback);
+  // File the output writer writes to, i.e. the output or its current shard.
+  struct output
+  {
+    explicit output(std::string_view path, std::ios::openmode mode)
+      : file{ path, mode }
+      , storage{ file }
+    {
+    }
 
-  result prepare();
+    fstream_wrapper file;
 
-private:
-  void add_sha1_to_file(std::string_view sha1);
+    // Output of the writers that write it node by node.
+    write_combining_storage<fstream_wrapper> storage;
+  };
+
+  bool open_intermediate_files();
+
+  // Drops records of the intermediate files past the checkpoint.
+  bool truncate_intermediate_files();
+  void resume_checkpoint();
+
+  // Writes all the parsed hashes to the intermediate files and saves the checkpoint, unless a
+  // write has failed.
+  void checkpoint_parsing(bool parsed);
+  void save_checkpoint();
+
+  void parse_input();
+  void parse_lines(parsing_slot& slot);
+  void add_sha1_to_buffer(parsing_slot& slot, const sha1_t& sha1, const char* line,
+                          const char* line_end);
+
+  // `keys_count` is the number of keys of the output, or of the shard, without the merged keys.
+  std::unique_ptr<sorted_keys_writer> create_output_writer(unsigned long long keys_count);
+
+  // Number of keys of the intermediate files of the first bytes from `first_byte` to `last_byte`.
+  unsigned long long files_records_count(unsigned first_byte, unsigned last_byte) const;
+  void start_shard_of_file(unsigned file_index);
+  void finish_output();
+  void write_manifest();
+  void collect_stats(std::chrono::steady_clock::time_point start_time, double start_cpu_seconds);
 
   void sort_files();
   void start_writing_sorted_files_thread();
 
-  void write_sha1_buffer(unsigned buffer_index);
+  void write_sha1_buffer(parsing_slot& slot, unsigned buffer_index);
+  bool keep_in_memory(intermediate_bucket& bucket, const std::vector<Record>& buffer);
+  void spill(intermediate_bucket& bucket, unsigned bucket_index);
 
-  void report_progress(int progress);
+  void write_sorted_sha1s(const std::vector<Record>& sha1s);
+  void write_merged_keys_less_than(const sha1_t* sha1);
+  void write_to_output(const sha1_t& sha1, uint32_t count);
 
 private:
-  fstream_wrapper m_input_file_wrapper;
-  original_file_reader<fstream_wrapper> m_input_reader;
-  splitted_files m_intermediate_files;
-  fstream_wrapper m_output_file_wrapper;
-  btree_sorted_keys_inserter<fstream_wrapper> m_btree;
-  std::vector<std::vector<sha1_t>> m_sha1_buffers;
-
-  // This value should be kept in sync with okon_prepare_progress_special_value from okon.h
-  static constexpr auto k_progress_unknown{ -1 };
-  static constexpr auto k_progress_never_reported{ -2 };
-  progress_callback_t m_progress_callback;
-  int m_last_reported_progress{ k_progress_never_reported };
+  // Set if checkpoints are saved. Loaded from the working directory, if it has a checkpoint to
+  // resume, before the input is opened, so the parsed part of the input is skipped.
+  std::optional<prepare_checkpoint> m_checkpoint;
+  std::unique_ptr<input_stream> m_input;
+  thread_pool m_thread_pool;
+  original_file_reader<input_stream> m_input_reader;
+  std::string m_working_directory_path;
+  std::string m_checkpoint_path;
+  std::mutex m_intermediate_files_mtx;
+  std::unique_ptr<splitted_files> m_intermediate_files;
+  std::atomic<bool> m_could_not_open_intermediate_files{ false };
+  std::array<intermediate_bucket, k_intermediate_files_count> m_buckets;
+  std::atomic<unsigned long long> m_memory_used{ 0u };
+  std::string m_output_file_path;
+  std::unique_ptr<output> m_output;
+  std::atomic<bool> m_could_not_open_output{ false };
+
+  // Set if the output is sharded. Shards are written one after another.
+  std::optional<shards_manifest> m_manifest;
+  unsigned m_current_shard{ 0u };
+  unsigned long long m_shard_first_key_index{ 0u };
+
+  // Counts of the output keys, till they're appended to the output. Opened for counted records
+  // only.
+  std::optional<fstream_wrapper> m_counts_file_wrapper;
+
+  // Keys of a merge into file_format::btree_v3, till they're counted.
+  std::optional<fstream_wrapper> m_spool_file_wrapper;
+  preparer_options m_options;
+  std::unique_ptr<sorted_keys_writer> m_output_writer;
+  std::optional<sha1_t> m_next_merged_key;
+  std::vector<parsing_slot> m_parsing_slots;
+  std::size_t m_sha1_buffer_max_size;
+
+  prepare_progress_reporter m_progress;
+  prepare_stats m_stats;
+  std::atomic<uint64_t> m_intermediate_bytes_written{ 0u };
+  std::atomic<uint64_t> m_intermediate_bytes_read{ 0u };
 
   unsigned long long m_total_sha1_count{};
-  unsigned long long m_sha1_written_to_tree_count{};
+  unsigned long long m_output_keys_count{};
+
+  // Bytes of the input parsed so far and till the last checkpoint.
+  uint64_t m_parsed_bytes{ 0u };
+  uint64_t m_checkpointed_bytes{ 0u };
 
+  // Files of the first bytes less than this one are in the shards written before the checkpoint.
+  unsigned m_first_file_to_write{ 0u };
+
+  // Sorted files are passed to the writing thread in memory. Spilled files are loaded and sorted
+  // at most this many files ahead of the file that is being written.
+  unsigned m_sorted_files_ahead_of_writing;
   std::mutex m_processing_sorted_files_mtx;
-  std::array<std::condition_variable, k_intermediate_files_count> m_sorted_files_cvs;
+  std::condition_variable m_sorted_files_cv;
+  std::condition_variable m_written_files_cv;
   std::array<bool, k_intermediate_files_count> m_sorted_files_ready_state;
+  unsigned m_written_files_count{ 0u };
   std::thread m_writing_sorted_files_thread;
 };
+
+using preparer = basic_preparer<sha1_t>;
+using counting_preparer = basic_preparer<counted_sha1>;
 }
@@ -0,0 +1,168 @@
+#include "sha1_digest.hpp"
+
+#include <array>
+#include <cstring>
+
+#ifdef OKON_SHA1_DIGEST_DISPATCH
+#  include <cpuid.h>
+#endif
+
+namespace okon {
+namespace details {
+namespace {
+constexpr std::size_t k_block_size{ 64u };
+
+uint32_t rotate_left(uint32_t value, unsigned bits)
+{
+  return (value << bits) | (value >> (32u - bits));
+}
+
+uint32_t load_big_endian(const uint8_t* bytes)
+{
+  return uint32_t{ bytes[0] } << 24u | uint32_t{ bytes[1] } << 16u | uint32_t{ bytes[2] } << 8u |
+    uint32_t{ bytes[3] };
+}
+}
+
+void sha1_compress_scalar(uint32_t* state, const uint8_t* blocks, std::size_t blocks_count)
+{
+  std::array<uint32_t, 80u> w;
+
+  for (std::size_t block = 0u; block < blocks_count; ++block) {
+    const auto* const bytes = blocks + block * k_block_size;
+    for (auto i = 0u; i < 16u; ++i) {
+      w[i] = load_big_endian(bytes + i * 4u);
+    }
+    for (auto i = 16u; i < 80u; ++i) {
+      w[i] = rotate_left(w[i - 3u] ^ w[i - 8u] ^ w[i - 14u] ^ w[i - 16u], 1u);
+    }
+
+    auto a = state[0];
+    auto b = state[1];
+    auto c = state[2];
+    auto d = state[3];
+    auto e = state[4];
+
+    for (auto i = 0u; i < 80u; ++i) {
+      uint32_t f;
+      uint32_t k;
+      if (i < 20u) {
+        f = (b & c) | (~b & d);
+        k = 0x5A827999u;
+      } else if (i < 40u) {
+        f = b ^ c ^ d;
+        k = 0x6ED9EBA1u;
+      } else if (i < 60u) {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8F1BBCDCu;
+      } else {
+        f = b ^ c ^ d;
+        k = 0xCA62C1D6u;
+      }
+
+      const auto temp = rotate_left(a, 5u) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = rotate_left(b, 30u);
+      b = a;
+      a = temp;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+  }
+}
+
+#ifdef OKON_SHA1_DIGEST_DISPATCH
+sha1_compress_t sha1_compress_shani;
+#endif
+
+sha1_digest_t sha1_digest_with(sha1_compress_t* compress, const void* message, std::size_t size)
+{
+  uint32_t state[5] = { 0x67452301u, 0xEFCDAB89u, 0x98BADCFEu, 0x10325476u, 0xC3D2E1F0u };
+
+  const auto* const bytes = static_cast<const uint8_t*>(message);
+  const auto full_blocks = size / k_block_size;
+  compress(state, bytes, full_blocks);
+
+  // The rest of the message, 0x80, zeros and the length in bits take one or two blocks.
+  std::array<uint8_t, 2u * k_block_size> tail{};
+  const auto rest = size % k_block_size;
+  std::memcpy(tail.data(), bytes + full_blocks * k_block_size, rest);
+  tail[rest] = 0x80u;
+
+  const auto tail_blocks = rest + 1u + sizeof(uint64_t) > k_block_size ? 2u : 1u;
+  const uint64_t bits = uint64_t{ size } * 8u;
+  for (auto i = 0u; i < sizeof(bits); ++i) {
+    tail[tail_blocks * k_block_size - 1u - i] = static_cast<uint8_t>(bits >> (8u * i));
+  }
+  compress(state, tail.data(), tail_blocks);
+
+  sha1_digest_t digest;
+  for (auto i = 0u; i < 5u; ++i) {
+    for (auto j = 0u; j < 4u; ++j) {
+      digest[i * 4u + j] = static_cast<uint8_t>(state[i] >> (24u - 8u * j));
+    }
+  }
+  return digest;
+}
+
+namespace {
+struct sha1_compressor
+{
+  sha1_compress_t* compress;
+  const char* name;
+};
+
+sha1_compressor select_compressor()
+{
+#ifdef OKON_SHA1_DIGEST_DISPATCH
+  // The SHA extensions are used together with SSSE3 and SSE4.1 shuffles and extracts.
+  unsigned eax{};
+  unsigned ebx{};
+  unsigned ecx{};
+  unsigned edx{};
+  if (__get_cpuid(1u, &eax, &ebx, &ecx, &edx)) {
+    const auto has_ssse3_and_sse41 = (ecx & bit_SSSE3) != 0u && (ecx & bit_SSE4_1) != 0u;
+    if (has_ssse3_and_sse41 && __get_cpuid_count(7u, 0u, &eax, &ebx, &ecx, &edx) &&
+        (ebx & bit_SHA) != 0u) {
+      return { &sha1_compress_shani, "sha-ni" };
+    }
+  }
+#endif
+
+  return { &sha1_compress_scalar, "scalar" };
+}
+
+const sha1_compressor& compressor()
+{
+  static const auto selected = select_compressor();
+  return selected;
+}
+}
+}
+
+void sha1_digests(const void* const* messages, const std::size_t* sizes, std::size_t count,
+                  sha1_digest_t* digests)
+{
+  const auto compress = details::compressor().compress;
+  for (std::size_t i = 0u; i < count; ++i) {
+    digests[i] = details::sha1_digest_with(compress, messages[i], sizes[i]);
+  }
+}
+
+sha1_digest_t sha1_digest(const void* message, std::size_t size)
+{
+  sha1_digest_t digest;
+  sha1_digests(&message, &size, 1u, &digest);
+  return digest;
+}
+
+const char* sha1_digest_name()
+{
+  return details::compressor().name;
+}
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "sha1_utils.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace okon {
+// Digest is a key only if the library is built for SHA-1 keys, see OKON_KEY_SIZE.
+using sha1_digest_t = std::array<uint8_t, k_sha1_key_size>;
+
+// Computes SHA-1 digests of `count` messages: messages[i] has sizes[i] bytes. The fastest
+// implementation supported by the CPU, i.e. the SHA extensions if it has them, is selected at
+// runtime.
+void sha1_digests(const void* const* messages, const std::size_t* sizes, std::size_t count,
+                  sha1_digest_t* digests);
+
+// Same as above, for a single message.
+sha1_digest_t sha1_digest(const void* message, std::size_t size);
+
+// Name of the implementation selected by sha1_digests(), e.g. "sha-ni".
+const char* sha1_digest_name();
+
+namespace details {
+// Compresses `blocks_count` blocks of 64 bytes into `state`.
+using sha1_compress_t = void(uint32_t* state, const uint8_t* blocks, std::size_t blocks_count);
+
+// Digest computed with `compress`, e.g. to compare implementations.
+sha1_digest_t sha1_digest_with(sha1_compress_t* compress, const void* message, std::size_t size);
+
+sha1_compress_t sha1_compress_scalar;
+}
+}
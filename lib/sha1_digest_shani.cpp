@@ -0,0 +1,76 @@
+#include "sha1_digest.hpp"
+
+#include <immintrin.h>
+
+#include <utility>
+
+namespace okon::details {
+namespace {
+// Four rounds of every of the 20 groups. Words of the message schedule are computed in the four
+// `messages` registers: a group starts the words of the group three ahead with sha1msg1, and the
+// next two groups finish them with a xor and sha1msg2.
+template <int Group>
+void rounds(__m128i& abcd, __m128i (&e)[2], __m128i (&messages)[4], const uint8_t* block)
+{
+  auto& message = messages[Group % 4];
+  if constexpr (Group < 4) {
+    const auto mask = _mm_set_epi64x(0x0001020304050607ll, 0x08090a0b0c0d0e0fll);
+    message =
+      _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + Group * 16)), mask);
+  }
+
+  auto& group_e = e[Group % 2];
+  if constexpr (Group == 0) {
+    group_e = _mm_add_epi32(group_e, message);
+  } else {
+    group_e = _mm_sha1nexte_epu32(group_e, message);
+  }
+  e[(Group + 1) % 2] = abcd;
+
+  if constexpr (Group >= 3 && Group <= 18) {
+    auto& next = messages[(Group + 1) % 4];
+    next = _mm_sha1msg2_epu32(next, message);
+  }
+
+  abcd = _mm_sha1rnds4_epu32(abcd, group_e, Group / 5);
+
+  if constexpr (Group >= 1 && Group <= 16) {
+    auto& previous = messages[(Group + 3) % 4];
+    previous = _mm_sha1msg1_epu32(previous, message);
+  }
+  if constexpr (Group >= 2 && Group <= 17) {
+    auto& after_next = messages[(Group + 2) % 4];
+    after_next = _mm_xor_si128(after_next, message);
+  }
+}
+
+template <int... Groups>
+void all_rounds(__m128i& abcd, __m128i (&e)[2], __m128i (&messages)[4], const uint8_t* block,
+                std::integer_sequence<int, Groups...>)
+{
+  (rounds<Groups>(abcd, e, messages, block), ...);
+}
+}
+
+void sha1_compress_shani(uint32_t* state, const uint8_t* blocks, std::size_t blocks_count)
+{
+  // The registers keep A in the highest lane, E alone in the highest lane of its own.
+  auto abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0x1B);
+  auto e0 = _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+
+  for (std::size_t block = 0u; block < blocks_count; ++block) {
+    const auto abcd_before = abcd;
+    const auto e_before = e0;
+
+    __m128i e[2] = { e0, _mm_setzero_si128() };
+    __m128i messages[4];
+    all_rounds(abcd, e, messages, blocks + block * 64u, std::make_integer_sequence<int, 20>{});
+
+    e0 = _mm_sha1nexte_epu32(e[0], e_before);
+    abcd = _mm_add_epi32(abcd, abcd_before);
+  }
+
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_shuffle_epi32(abcd, 0x1B));
+  state[4] = static_cast<uint32_t>(_mm_extract_epi32(e0, 3));
+}
+}
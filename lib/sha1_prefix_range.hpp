@@ -0,0 +1,60 @@
+#pragma once
+
+#include "sha1_utils.hpp"
+
+#include <cctype>
+#include <cstddef>
+#include <optional>
+
+namespace okon {
+// All the hashes whose text form starts with a given prefix of hex characters.
+class sha1_prefix_range
+{
+public:
+  // Returns std::nullopt if `prefix` is longer than a text hash or contains non-hex characters.
+  static std::optional<sha1_prefix_range> from_text(const char* prefix, std::size_t length)
+  {
+    if (length > k_text_sha1_length) {
+      return std::nullopt;
+    }
+
+    sha1_prefix_range range;
+    range.m_nibbles_count = length;
+
+    for (std::size_t i = 0u; i < length; ++i) {
+      if (!std::isxdigit(static_cast<unsigned char>(prefix[i]))) {
+        return std::nullopt;
+      }
+
+      const auto nibble = char_to_index(prefix[i]);
+      range.m_first[i / 2u] |= (i % 2u == 0u) ? static_cast<uint8_t>(nibble << 4u) : nibble;
+    }
+
+    return range;
+  }
+
+  // The smallest hash in the range.
+  const sha1_t& first() const
+  {
+    return m_first;
+  }
+
+  bool contains(const sha1_t& sha1) const
+  {
+    const auto full_bytes = m_nibbles_count / 2u;
+    for (std::size_t i = 0u; i < full_bytes; ++i) {
+      if (sha1[i] != m_first[i]) {
+        return false;
+      }
+    }
+
+    return m_nibbles_count % 2u == 0u || (sha1[full_bytes] & 0xF0u) == m_first[full_bytes];
+  }
+
+private:
+  sha1_prefix_range() = default;
+
+  sha1_t m_first{};
+  std::size_t m_nibbles_count{ 0u };
+};
+}
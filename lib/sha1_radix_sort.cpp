@@ -0,0 +1,82 @@
+#include "sha1_radix_sort.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <utility>
+
+namespace okon {
+namespace {
+// Ranges up to this size are sorted by comparisons, radix passes don't pay off for them.
+constexpr std::size_t k_comparison_sort_threshold{ 64u };
+
+constexpr auto k_radix{ 256u };
+
+template <typename Record>
+void comparison_sort(Record* keys, std::size_t count, unsigned byte)
+{
+  const auto remaining_size = sizeof(sha1_t) - byte;
+  std::sort(keys, keys + count, [byte, remaining_size](const Record& lhs, const Record& rhs) {
+    return std::memcmp(key_of(lhs).data() + byte, key_of(rhs).data() + byte, remaining_size) < 0;
+  });
+}
+
+template <typename Record>
+void sort_by_byte(Record* keys, std::size_t count, unsigned byte)
+{
+  if (byte == sizeof(sha1_t)) {
+    return;
+  }
+
+  if (count <= k_comparison_sort_threshold) {
+    comparison_sort(keys, count, byte);
+    return;
+  }
+
+  std::array<std::size_t, k_radix> counts{};
+  for (std::size_t i = 0u; i < count; ++i) {
+    ++counts[key_of(keys[i])[byte]];
+  }
+
+  std::array<std::size_t, k_radix> heads;
+  std::array<std::size_t, k_radix> ends;
+  std::size_t offset{ 0u };
+  for (auto digit = 0u; digit < k_radix; ++digit) {
+    heads[digit] = offset;
+    offset += counts[digit];
+    ends[digit] = offset;
+  }
+
+  // Every key is swapped straight to the next free place of its bucket, till the current place gets
+  // a key that belongs there.
+  for (auto digit = 0u; digit < k_radix; ++digit) {
+    while (heads[digit] < ends[digit]) {
+      auto& key = keys[heads[digit]];
+      const auto key_digit = key_of(key)[byte];
+
+      if (key_digit == digit) {
+        ++heads[digit];
+      } else {
+        std::swap(key, keys[heads[key_digit]++]);
+      }
+    }
+  }
+
+  std::size_t bucket_begin{ 0u };
+  for (auto digit = 0u; digit < k_radix; ++digit) {
+    sort_by_byte(keys + bucket_begin, counts[digit], byte + 1u);
+    bucket_begin += counts[digit];
+  }
+}
+}
+
+void radix_sort_sha1(sha1_t* keys, std::size_t count, unsigned first_byte)
+{
+  sort_by_byte(keys, count, first_byte);
+}
+
+void radix_sort_counted_sha1(counted_sha1* keys, std::size_t count, unsigned first_byte)
+{
+  sort_by_byte(keys, count, first_byte);
+}
+}
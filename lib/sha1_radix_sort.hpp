@@ -0,0 +1,16 @@
+#pragma once
+
+#include "key_counts.hpp"
+#include "sha1_utils.hpp"
+
+#include <cstddef>
+
+namespace okon {
+// Sorts keys in ascending order with an in-place MSD radix sort (American flag sort). Keys are
+// assumed to have bytes [0, first_byte) equal, e.g. keys of one intermediate file share their
+// first byte, so sorting starts at `first_byte`.
+void radix_sort_sha1(sha1_t* keys, std::size_t count, unsigned first_byte = 0u);
+
+// Same as above, for keys with counts. Order of counted keys with equal hashes is unspecified.
+void radix_sort_counted_sha1(counted_sha1* keys, std::size_t count, unsigned first_byte = 0u);
+}
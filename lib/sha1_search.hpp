@@ -0,0 +1,223 @@
+#pragma once
+
+#include "sha1_utils.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+namespace okon {
+constexpr auto k_sha1_prefix_size{ sizeof(uint64_t) };
+constexpr auto k_sha1_suffix_size{ sizeof(sha1_t) - k_sha1_prefix_size };
+
+namespace details {
+// Keys ranges of up to this size are searched linearly, with SIMD if available.
+constexpr auto k_sha1_linear_search_threshold{ 16u };
+
+// Eight bytes as a big-endian number, so comparing prefixes as integers gives the same order as
+// comparing the bytes.
+inline uint64_t load_big_endian_prefix(const uint8_t* bytes)
+{
+  uint64_t prefix;
+  std::memcpy(&prefix, bytes, sizeof(prefix));
+
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  return __builtin_bswap64(prefix);
+#elif defined(__GNUC__)
+  return prefix;
+#else
+  uint64_t result{ 0u };
+  for (auto i = 0u; i < sizeof(prefix); ++i) {
+    result = (result << 8u) | bytes[i];
+  }
+  return result;
+#endif
+}
+
+inline uint64_t sha1_prefix(const sha1_t& sha1)
+{
+  return load_big_endian_prefix(sha1.data());
+}
+
+// Keys stored as whole sha1_t records.
+class sha1_array_keys
+{
+public:
+  explicit sha1_array_keys(const sha1_t* keys)
+    : m_keys{ keys }
+  {
+  }
+
+  uint64_t prefix(uint32_t index) const
+  {
+    return sha1_prefix(m_keys[index]);
+  }
+
+  const uint8_t* suffix(uint32_t index) const
+  {
+    return m_keys[index].data() + k_sha1_prefix_size;
+  }
+
+private:
+  const sha1_t* m_keys;
+};
+
+// Keys stored as a dense array of numeric prefixes and a separate array of the remaining bytes.
+class split_sha1_keys
+{
+public:
+  explicit split_sha1_keys(const uint8_t* prefixes, const uint8_t* suffixes)
+    : m_prefixes{ prefixes }
+    , m_suffixes{ suffixes }
+  {
+  }
+
+  uint64_t prefix(uint32_t index) const
+  {
+    uint64_t value;
+    std::memcpy(&value, m_prefixes + index * sizeof(uint64_t), sizeof(value));
+    return value;
+  }
+
+  const uint8_t* suffix(uint32_t index) const
+  {
+    return m_suffixes + index * k_sha1_suffix_size;
+  }
+
+private:
+  const uint8_t* m_prefixes;
+  const uint8_t* m_suffixes;
+};
+
+template <typename Keys>
+bool sha1_less(const Keys& keys, uint32_t index, const sha1_t& sha1, uint64_t sha1_prefix_value)
+{
+  const auto key_prefix = keys.prefix(index);
+  if (key_prefix != sha1_prefix_value) {
+    return key_prefix < sha1_prefix_value;
+  }
+
+  return std::memcmp(keys.suffix(index), sha1.data() + k_sha1_prefix_size, k_sha1_suffix_size) < 0;
+}
+
+inline bool sha1_less(const sha1_t& key, const sha1_t& sha1, uint64_t sha1_prefix_value)
+{
+  return sha1_less(sha1_array_keys{ &key }, 0u, sha1, sha1_prefix_value);
+}
+
+template <typename Keys>
+uint32_t scalar_count_less(const Keys& keys, uint32_t begin, uint32_t count, const sha1_t& sha1,
+                           uint64_t sha1_prefix_value)
+{
+  uint32_t result{ 0u };
+  for (auto i = begin; i < begin + count; ++i) {
+    result += sha1_less(keys, i, sha1, sha1_prefix_value) ? 1u : 0u;
+  }
+  return result;
+}
+
+#ifdef OKON_USE_SIMD
+// Counts keys less than `sha1` comparing prefixes of four keys at once. Keys are compared fully
+// only if some prefix is equal to the searched one. `count` must not be greater than
+// k_sha1_linear_search_threshold.
+template <typename Keys>
+uint32_t simd_count_less(const Keys& keys, uint32_t begin, uint32_t count, const sha1_t& sha1,
+                         uint64_t sha1_prefix_value)
+{
+  constexpr auto lanes{ 4u };
+
+  alignas(32) std::array<uint64_t, k_sha1_linear_search_threshold> prefixes;
+  prefixes.fill(~uint64_t{ 0u });
+  for (auto i = 0u; i < count; ++i) {
+    prefixes[i] = keys.prefix(begin + i);
+  }
+
+  const auto searched = vcl::Vec4uq{ sha1_prefix_value };
+  auto less_count{ 0 };
+  auto equal_count{ 0 };
+
+  for (auto i = 0u; i < count; i += lanes) {
+    vcl::Vec4uq v;
+    v.load_a(&prefixes[i]);
+    less_count += vcl::horizontal_count(v < searched);
+    equal_count += vcl::horizontal_count(v == searched);
+  }
+
+  if (equal_count == 0) {
+    return static_cast<uint32_t>(less_count);
+  }
+
+  return scalar_count_less(keys, begin, count, sha1, sha1_prefix_value);
+}
+#endif
+
+// Returns index of the first of sorted keys [0, count) that is not less than `sha1`, the same as
+// std::lower_bound. The range is narrowed with a branchless binary search over the key prefixes
+// and the last few keys are counted linearly.
+template <typename Keys>
+uint32_t lower_bound_sha1(const Keys& keys, uint32_t count, const sha1_t& sha1)
+{
+  const auto prefix = sha1_prefix(sha1);
+
+  uint32_t base{ 0u };
+  auto length = count;
+
+  while (length > k_sha1_linear_search_threshold) {
+    const auto half = length / 2u;
+    base = sha1_less(keys, base + half, sha1, prefix) ? base + half : base;
+    length -= half;
+  }
+
+#ifdef OKON_USE_SIMD
+  return base + simd_count_less(keys, base, length, sha1, prefix);
+#else
+  return base + scalar_count_less(keys, base, length, sha1, prefix);
+#endif
+}
+
+// Step of lower_bound_sha1_in_capacity() narrowing [base, base + Length).
+template <uint32_t Length, typename Keys>
+uint32_t narrow_in_capacity(const Keys& keys, uint32_t count, const sha1_t& sha1, uint64_t prefix,
+                            uint32_t base)
+{
+  if constexpr (Length <= k_sha1_linear_search_threshold) {
+    const auto length = std::min(Length, count - base);
+#ifdef OKON_USE_SIMD
+    return base + simd_count_less(keys, base, length, sha1, prefix);
+#else
+    return base + scalar_count_less(keys, base, length, sha1, prefix);
+#endif
+  } else {
+    constexpr auto half = Length / 2u;
+
+    // Keys past `count` are readable, they're treated as greater than any key.
+    const auto probe = base + half;
+    const auto is_less = sha1_less(keys, probe, sha1, prefix);
+    base = (probe < count && is_less) ? probe : base;
+    return narrow_in_capacity<Length - half>(keys, count, sha1, prefix, base);
+  }
+}
+
+// Same as lower_bound_sha1(), for the first `count` keys of `Capacity` readable ones, like the keys
+// of a node. Steps of the binary search depend on Capacity only, so they're unrolled.
+template <uint32_t Capacity, typename Keys>
+uint32_t lower_bound_sha1_in_capacity(const Keys& keys, uint32_t count, const sha1_t& sha1)
+{
+  return narrow_in_capacity<Capacity>(keys, count, sha1, sha1_prefix(sha1), 0u);
+}
+}
+
+inline uint32_t lower_bound_sha1(const sha1_t* keys, uint32_t count, const sha1_t& sha1)
+{
+  return details::lower_bound_sha1(details::sha1_array_keys{ keys }, count, sha1);
+}
+
+// Same as above, for keys split into `prefixes` (native uint64_t values of big-endian prefixes)
+// and `suffixes` (remaining k_sha1_suffix_size bytes of every key).
+inline uint32_t lower_bound_split_sha1(const uint8_t* prefixes, const uint8_t* suffixes,
+                                       uint32_t count, const sha1_t& sha1)
+{
+  return details::lower_bound_sha1(details::split_sha1_keys{ prefixes, suffixes }, count, sha1);
+}
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <okon/okon.h>
+
 #include <array>
 #include <cassert>
 #include <cstdint>
@@ -13,8 +15,14 @@
 #endif
 
 namespace okon {
-using sha1_t = std::array<uint8_t, 20u>;
-constexpr auto k_text_sha1_length{ 40u };
+// Hashes are SHA-1 ones unless okon is built with another OKON_KEY_SIZE, e.g. NTLM ones. The names
+// say SHA-1 either way.
+constexpr auto k_sha1_key_size{ 20u };
+constexpr auto k_key_size{ unsigned{ OKON_KEY_SIZE } };
+static_assert(k_key_size == k_sha1_key_size || k_key_size == 16u);
+
+using sha1_t = std::array<uint8_t, k_key_size>;
+constexpr auto k_text_sha1_length{ 2u * k_key_size };
 constexpr auto k_text_sha1_length_for_simd{ 64u };
 
 inline constexpr uint8_t char_to_index(char c)
@@ -54,7 +62,7 @@ inline sha1_t string_sha1_to_binary(const char* sha1_text)
 {
   okon::sha1_t sha1;
 
-  for (auto i = 0; i < 40; i += 2) {
+  for (auto i = 0u; i < k_text_sha1_length; i += 2u) {
     sha1[i / 2] = two_first_chars_to_byte(sha1_text + i);
   }
 
@@ -100,15 +108,6 @@ inline sha1_t simd_string_sha1_to_binary(const void* text)
 #endif
 }
 
-inline sha1_t text_sha1_to_binary(const char* sha1_text)
-{
-#ifdef OKON_USE_SIMD
-  return details::simd_string_sha1_to_binary(sha1_text);
-#else
-  return details::string_sha1_to_binary(sha1_text);
-#endif
-}
-
 inline std::string binary_sha1_to_string(const sha1_t& sha1)
 {
   std::string result;
@@ -0,0 +1,133 @@
+#include "shards_manifest.hpp"
+
+#include <cstring>
+#include <filesystem>
+
+namespace okon {
+namespace {
+constexpr auto k_shard_header_size{ 16u };
+
+template <typename T>
+T read_value(const uint8_t*& in)
+{
+  T value;
+  std::memcpy(&value, in, sizeof(value));
+  in += sizeof(value);
+  return value;
+}
+}
+
+shards_manifest shards_manifest::split(std::string_view manifest_path, unsigned shards_count)
+{
+  shards_manifest manifest;
+  for (auto i = 0u; i < shards_count; ++i) {
+    shard_info shard;
+    shard.first_byte = static_cast<uint8_t>(i * 256u / shards_count);
+    shard.last_byte = static_cast<uint8_t>((i + 1u) * 256u / shards_count - 1u);
+    shard.path = std::string{ manifest_path } + ".shard" + std::to_string(i);
+    manifest.m_shards.push_back(std::move(shard));
+  }
+
+  return manifest;
+}
+
+std::optional<shards_manifest> shards_manifest::from_memory(const uint8_t* data, uint64_t size,
+                                                            std::string_view manifest_path)
+{
+  if (data == nullptr || size < k_extended_header_size) {
+    return std::nullopt;
+  }
+
+  const auto* in = data;
+  const auto marker = read_value<uint32_t>(in);
+  const auto format = read_value<uint32_t>(in);
+  const auto shards_count = read_value<uint32_t>(in);
+  if (marker != k_extended_header_marker ||
+      format != static_cast<uint32_t>(file_format::shards_manifest) || shards_count == 0u ||
+      shards_count > k_max_shards_count) {
+    return std::nullopt;
+  }
+
+  const auto directory = std::filesystem::path{ manifest_path }.parent_path();
+  const auto* const end = data + size;
+  in = data + k_extended_header_size;
+
+  shards_manifest manifest;
+  for (auto i = 0u; i < shards_count; ++i) {
+    if (end - in < k_shard_header_size) {
+      return std::nullopt;
+    }
+
+    shard_info shard;
+    shard.first_byte = read_value<uint8_t>(in);
+    shard.last_byte = read_value<uint8_t>(in);
+    const auto path_length = read_value<uint16_t>(in);
+    read_value<uint32_t>(in);
+    shard.keys_count = read_value<uint64_t>(in);
+
+    if (end - in < path_length) {
+      return std::nullopt;
+    }
+
+    const std::filesystem::path path{ std::string{ reinterpret_cast<const char*>(in),
+                                                   path_length } };
+    in += path_length;
+    shard.path = (path.is_relative() ? directory / path : path).string();
+
+    // Every first byte belongs to exactly one shard.
+    const auto expected_first_byte = i == 0u ? 0u : manifest.m_shards.back().last_byte + 1u;
+    if (shard.first_byte != expected_first_byte || shard.last_byte < shard.first_byte) {
+      return std::nullopt;
+    }
+
+    manifest.m_shards.push_back(std::move(shard));
+  }
+
+  if (manifest.m_shards.back().last_byte != 0xffu) {
+    return std::nullopt;
+  }
+
+  return manifest;
+}
+
+const std::vector<shard_info>& shards_manifest::shards() const
+{
+  return m_shards;
+}
+
+std::vector<shard_info>& shards_manifest::shards()
+{
+  return m_shards;
+}
+
+std::vector<uint8_t> shards_manifest::serialize() const
+{
+  std::vector<uint8_t> data(k_extended_header_size, uint8_t{ 0u });
+
+  const auto append = [&data](const void* value, std::size_t size) {
+    const auto* const bytes = static_cast<const uint8_t*>(value);
+    data.insert(data.end(), bytes, bytes + size);
+  };
+
+  const auto header = { k_extended_header_marker,
+                        static_cast<uint32_t>(file_format::shards_manifest),
+                        static_cast<uint32_t>(m_shards.size()) };
+  std::memcpy(data.data(), header.begin(), header.size() * sizeof(uint32_t));
+
+  for (const auto& shard : m_shards) {
+    const auto file_name = std::filesystem::path{ shard.path }.filename().string();
+    const auto path_length = static_cast<uint16_t>(file_name.size());
+    const uint32_t zeros{ 0u };
+    const uint64_t keys_count{ shard.keys_count };
+
+    append(&shard.first_byte, sizeof(shard.first_byte));
+    append(&shard.last_byte, sizeof(shard.last_byte));
+    append(&path_length, sizeof(path_length));
+    append(&zeros, sizeof(zeros));
+    append(&keys_count, sizeof(keys_count));
+    append(file_name.data(), path_length);
+  }
+
+  return data;
+}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "file_format.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace okon {
+// Shard of a database split by the first byte of the keys. Every shard is a file prepared on its
+// own, that can be opened alone too, and it stores keys of the first bytes from first_byte to
+// last_byte.
+struct shard_info
+{
+  uint8_t first_byte{ 0u };
+  uint8_t last_byte{ 0u };
+  unsigned long long keys_count{ 0u };
+  std::string path;
+};
+
+// List of the shards of a database, written in place of the prepared file. Shards cover all the
+// first bytes, in ascending order, so a lookup is routed to its shard by the first byte of the key.
+//
+// File layout:
+// header | shards[shards_count]
+// header: k_extended_header_marker | file_format::shards_manifest | shards_count (32-bit) |
+//         zeros till k_extended_header_size
+// shard: first_byte (8-bit) | last_byte (8-bit) | path_length (16-bit) | zeros (32-bit) |
+//        keys_count (64-bit) | path[path_length]
+// path: of the shard file. Relative paths are relative to the directory of the manifest, so the
+//       shards can be moved together with it, or replaced by symbolic links to other disks.
+class shards_manifest
+{
+public:
+  static constexpr unsigned k_max_shards_count{ 256u };
+
+  // Splits the first bytes into `shards_count` ranges of about the same size. Shard files are
+  // placed next to the manifest: manifest_path + ".shard0", ".shard1" and so on.
+  static shards_manifest split(std::string_view manifest_path, unsigned shards_count);
+
+  // Returns std::nullopt if `data` doesn't contain a valid manifest. Paths of the shards are
+  // resolved against the directory of `manifest_path`.
+  static std::optional<shards_manifest> from_memory(const uint8_t* data, uint64_t size,
+                                                    std::string_view manifest_path);
+
+  const std::vector<shard_info>& shards() const;
+  std::vector<shard_info>& shards();
+
+  // Writes file names of the shards only, so the shards have to be next to the manifest.
+  template <typename DataStorage>
+  void write(DataStorage& storage) const;
+
+private:
+  std::vector<uint8_t> serialize() const;
+
+private:
+  std::vector<shard_info> m_shards;
+};
+
+template <typename DataStorage>
+void shards_manifest::write(DataStorage& storage) const
+{
+  const auto data = serialize();
+  storage.seek_out(0u);
+  storage.write(data.data(), data.size());
+}
+}
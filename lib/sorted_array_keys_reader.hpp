@@ -0,0 +1,96 @@
+#pragma once
+
+#include "sha1_utils.hpp"
+#include "storage_reader.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <optional>
+
+namespace okon {
+// Reads `keys_count` sorted keys stored one after another from `keys_offset`, e.g. leaves of a
+// static tree or keys of a flat sorted file, starting from the key with index `first_key`. Keys
+// are read in chunks. If `counts_offset` is given, counts of the keys are stored from there, in
+// the same order.
+template <typename DataStorage>
+class sorted_array_keys_reader
+{
+public:
+  explicit sorted_array_keys_reader(DataStorage& storage, uint64_t keys_offset,
+                                    uint64_t keys_count, uint64_t first_key = 0u,
+                                    std::optional<uint64_t> counts_offset = std::nullopt);
+
+  std::optional<sha1_t> next();
+  uint32_t count() const;
+
+private:
+  static constexpr uint64_t k_chunk_keys_count{ 1024u * 4u };
+
+  storage_reader<DataStorage> m_reader;
+  uint64_t m_keys_offset;
+  uint64_t m_keys_count;
+  uint64_t m_next_key{ 0u };
+
+  // Counts are read by a separate reader, so chunks of keys and counts are valid at the same time.
+  storage_reader<DataStorage> m_counts_reader;
+  std::optional<uint64_t> m_counts_offset;
+  const uint8_t* m_counts_chunk{ nullptr };
+
+  const uint8_t* m_chunk{ nullptr };
+  uint64_t m_chunk_begin{ 0u };
+  uint64_t m_chunk_end{ 0u };
+};
+
+template <typename DataStorage>
+sorted_array_keys_reader<DataStorage>::sorted_array_keys_reader(
+  DataStorage& storage, uint64_t keys_offset, uint64_t keys_count, uint64_t first_key,
+  std::optional<uint64_t> counts_offset)
+  : m_reader{ storage }
+  , m_keys_offset{ keys_offset }
+  , m_keys_count{ keys_count }
+  , m_next_key{ first_key }
+  , m_counts_reader{ storage }
+  , m_counts_offset{ counts_offset }
+  , m_chunk_begin{ first_key }
+  , m_chunk_end{ first_key }
+{
+}
+
+template <typename DataStorage>
+std::optional<sha1_t> sorted_array_keys_reader<DataStorage>::next()
+{
+  if (m_next_key == m_keys_count) {
+    return std::nullopt;
+  }
+
+  if (m_next_key == m_chunk_end) {
+    m_chunk_begin = m_next_key;
+    m_chunk_end = std::min(m_keys_count, m_chunk_begin + k_chunk_keys_count);
+    m_chunk = m_reader.read(m_keys_offset + m_chunk_begin * sizeof(sha1_t),
+                            (m_chunk_end - m_chunk_begin) * sizeof(sha1_t));
+    if (m_counts_offset) {
+      m_counts_chunk = m_counts_reader.read(*m_counts_offset + m_chunk_begin * sizeof(uint32_t),
+                                            (m_chunk_end - m_chunk_begin) * sizeof(uint32_t));
+    }
+  }
+
+  sha1_t key;
+  std::memcpy(key.data(), m_chunk + (m_next_key - m_chunk_begin) * sizeof(sha1_t), sizeof(key));
+  ++m_next_key;
+
+  return key;
+}
+
+template <typename DataStorage>
+uint32_t sorted_array_keys_reader<DataStorage>::count() const
+{
+  if (!m_counts_offset) {
+    return 1u;
+  }
+
+  uint32_t count;
+  std::memcpy(&count, m_counts_chunk + (m_next_key - 1u - m_chunk_begin) * sizeof(uint32_t),
+              sizeof(count));
+  return count;
+}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "sha1_utils.hpp"
+
+#include <optional>
+#include <utility>
+
+namespace okon {
+// Reads keys of a prepared file in ascending order.
+class sorted_keys_reader
+{
+public:
+  virtual ~sorted_keys_reader() = default;
+
+  // Returns the next key, or std::nullopt after the last one.
+  virtual std::optional<sha1_t> next() = 0;
+
+  // Returns number of occurrences of the key returned by the last next(). It's 1 for every key of
+  // a file without counts.
+  virtual uint32_t count() const = 0;
+};
+
+// Adapts any class with next(), e.g. btree_keys_reader or sorted_array_keys_reader, to
+// sorted_keys_reader.
+template <typename Reader>
+class sorted_keys_reader_adapter final : public sorted_keys_reader
+{
+public:
+  template <typename... Args>
+  explicit sorted_keys_reader_adapter(Args&&... args)
+    : m_reader{ std::forward<Args>(args)... }
+  {
+  }
+
+  std::optional<sha1_t> next() override
+  {
+    return m_reader.next();
+  }
+
+  uint32_t count() const override
+  {
+    return m_reader.count();
+  }
+
+private:
+  Reader m_reader;
+};
+}
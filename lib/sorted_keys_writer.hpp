@@ -0,0 +1,73 @@
+#pragma once
+
+#include "sha1_utils.hpp"
+
+#include <type_traits>
+#include <utility>
+
+namespace okon {
+// Output of the preparer. Receives all keys in ascending order, then finalize_inserting() once.
+class sorted_keys_writer
+{
+public:
+  virtual ~sorted_keys_writer() = default;
+
+  virtual void insert_sorted(const sha1_t& sha1) = 0;
+
+  // Same as above, with number of occurrences of the key. Writers of formats without counts
+  // ignore it.
+  virtual void insert_sorted(const sha1_t& sha1, uint32_t count) = 0;
+
+  virtual void finalize_inserting() = 0;
+};
+
+namespace details {
+template <typename Writer, typename = void>
+struct writes_counts : std::false_type
+{
+};
+
+template <typename Writer>
+struct writes_counts<Writer,
+                     std::void_t<decltype(std::declval<Writer&>().insert_sorted(
+                       std::declval<const sha1_t&>(), std::declval<uint32_t>()))>>
+  : std::true_type
+{
+};
+}
+
+// Adapts any class with insert_sorted() and finalize_inserting(), e.g.
+// btree_sorted_keys_inserter or static_tree_writer, to sorted_keys_writer.
+template <typename Writer>
+class sorted_keys_writer_adapter final : public sorted_keys_writer
+{
+public:
+  template <typename... Args>
+  explicit sorted_keys_writer_adapter(Args&&... args)
+    : m_writer{ std::forward<Args>(args)... }
+  {
+  }
+
+  void insert_sorted(const sha1_t& sha1) override
+  {
+    m_writer.insert_sorted(sha1);
+  }
+
+  void insert_sorted(const sha1_t& sha1, uint32_t count) override
+  {
+    if constexpr (details::writes_counts<Writer>::value) {
+      m_writer.insert_sorted(sha1, count);
+    } else {
+      m_writer.insert_sorted(sha1);
+    }
+  }
+
+  void finalize_inserting() override
+  {
+    m_writer.finalize_inserting();
+  }
+
+private:
+  Writer m_writer;
+};
+}
@@ -42,6 +42,12 @@ void splitted_files::increment_name(std::string& current_name) const
   }
 }
 
+std::string splitted_files::file_path(std::string_view path, unsigned index)
+{
+  constexpr std::string_view k_digits{ "0123456789ABCDEF" };
+  return std::string{ path } + k_digits[index / 16u % 16u] + k_digits[index % 16u];
+}
+
 bool splitted_files::are_all_open() const
 {
   return std::all_of(std::cbegin(m_files), std::cend(m_files),
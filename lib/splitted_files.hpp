@@ -30,6 +30,9 @@ public:
 
   bool are_all_open() const;
 
+  // Path of the file of `index`, 00 to FF in `path`.
+  static std::string file_path(std::string_view path, unsigned index);
+
 private:
   void increment_name(std::string& current_name) const;
 
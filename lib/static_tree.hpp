@@ -0,0 +1,301 @@
+#pragma once
+
+#include "file_format.hpp"
+#include "memory_hints.hpp"
+#include "sha1_search.hpp"
+#include "sha1_utils.hpp"
+#include "static_tree_geometry.hpp"
+#include "storage_reader.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace okon {
+namespace details {
+// Number of batched queries descending the tree together. While one query's block is searched,
+// blocks of the other ones are being fetched from memory.
+constexpr auto k_static_tree_prefetch_group_size{ 16u };
+
+struct static_tree_header
+{
+  uint64_t keys_count;
+  uint32_t leaf_block_keys;
+  uint32_t internal_block_keys;
+  bool has_counts;
+};
+
+template <typename DataStorage>
+static_tree_header read_static_tree_header(DataStorage& storage)
+{
+  struct
+  {
+    uint32_t marker;
+    uint32_t format;
+    uint64_t keys_count;
+    uint32_t leaf_block_keys;
+    uint32_t internal_block_keys;
+    uint32_t has_counts;
+  } header{};
+
+  storage.seek_in(0u);
+  storage.read(&header.marker, sizeof(header.marker));
+  storage.read(&header.format, sizeof(header.format));
+  storage.read(&header.keys_count, sizeof(header.keys_count));
+  storage.read(&header.leaf_block_keys, sizeof(header.leaf_block_keys));
+  storage.read(&header.internal_block_keys, sizeof(header.internal_block_keys));
+  storage.read(&header.has_counts, sizeof(header.has_counts));
+
+  return static_tree_header{ header.keys_count, header.leaf_block_keys,
+                             header.internal_block_keys, header.has_counts != 0u };
+}
+
+template <typename DataStorage>
+static_tree_geometry read_static_tree_geometry(DataStorage& storage)
+{
+  const auto header = read_static_tree_header(storage);
+  return static_tree_geometry{ header.keys_count, header.leaf_block_keys,
+                               header.internal_block_keys, header.has_counts };
+}
+}
+
+// Reads files written by static_tree_writer. See static_tree_geometry for the layout.
+template <typename DataStorage>
+class static_tree
+{
+public:
+  explicit static_tree(DataStorage& storage);
+
+  // Whether the header of `storage`, of `size` bytes, describes a tree that fits in it. Header
+  // of a corrupt file may hold any values, e.g. blocks of no keys, that the geometry can't be
+  // computed for, so it's checked before the tree is constructed.
+  static bool is_valid(DataStorage& storage, uint64_t size);
+
+  bool contains(const sha1_t& sha1) const;
+
+  // Returns number of occurrences of `sha1`, 0 if it's not in the tree. Every key of a tree
+  // without counts occurs once.
+  uint32_t count(const sha1_t& sha1) const;
+
+  // Returns index of the first key not less than `sha1`, keys_count() if there is no such key.
+  uint64_t lower_bound(const sha1_t& sha1) const;
+
+  // Looks up keys[sorted_queries[i]] for i in [0, count) and stores 1 or 0 in the corresponding
+  // results. The queries have to be sorted by their keys. Safe to call concurrently if the storage
+  // has direct access.
+  void contains_sorted_batch(const sha1_t* keys, const std::size_t* sorted_queries,
+                             std::size_t count, uint8_t* results) const;
+
+  const static_tree_geometry& geometry() const;
+
+private:
+  struct descent
+  {
+    uint64_t block{ 0u };
+    bool found{ false };
+
+    // Index of the found separator in the sorted keys.
+    uint64_t found_key_index{ 0u };
+  };
+
+  const uint8_t* internal_block(unsigned layer, uint64_t block) const;
+
+  // Moves `state` one layer down. Returns true if the key has been found among separators.
+  bool descend(unsigned layer, const sha1_t& sha1, descent& state) const;
+  bool leaf_block_contains(uint64_t leaf_block, const sha1_t& sha1) const;
+
+private:
+  storage_reader<DataStorage> m_reader;
+  static_tree_geometry m_geometry;
+};
+
+template <typename DataStorage>
+static_tree<DataStorage>::static_tree(DataStorage& storage)
+  : m_reader{ storage }
+  , m_geometry{ details::read_static_tree_geometry(storage) }
+{
+}
+
+template <typename DataStorage>
+bool static_tree<DataStorage>::is_valid(DataStorage& storage, uint64_t size)
+{
+  const auto header = details::read_static_tree_header(storage);
+  const auto is_block_size_valid = [](uint32_t block_keys) {
+    return block_keys > 0u && block_keys <= static_tree_geometry::k_max_block_keys;
+  };
+  if (!is_block_size_valid(header.leaf_block_keys) ||
+      !is_block_size_valid(header.internal_block_keys) ||
+      header.keys_count > size / sizeof(sha1_t)) {
+    return false;
+  }
+
+  const static_tree_geometry geometry{ header.keys_count, header.leaf_block_keys,
+                                       header.internal_block_keys, header.has_counts };
+  return geometry.file_size() <= size;
+}
+
+template <typename DataStorage>
+bool static_tree<DataStorage>::contains(const sha1_t& sha1) const
+{
+  if (m_geometry.keys_count() == 0u) {
+    return false;
+  }
+
+  descent state;
+  for (auto layer = m_geometry.layers_count(); layer >= 1u; --layer) {
+    if (descend(layer, sha1, state)) {
+      return true;
+    }
+  }
+
+  return leaf_block_contains(state.block, sha1);
+}
+
+template <typename DataStorage>
+uint32_t static_tree<DataStorage>::count(const sha1_t& sha1) const
+{
+  const auto index = lower_bound(sha1);
+  if (index == m_geometry.keys_count()) {
+    return 0u;
+  }
+
+  sha1_t key;
+  std::memcpy(key.data(),
+              m_reader.read(m_geometry.keys_offset() + index * sizeof(sha1_t), sizeof(key)),
+              sizeof(key));
+  if (key != sha1) {
+    return 0u;
+  }
+
+  if (!m_geometry.has_counts()) {
+    return 1u;
+  }
+
+  uint32_t count;
+  std::memcpy(&count,
+              m_reader.read(m_geometry.counts_offset() + index * sizeof(uint32_t), sizeof(count)),
+              sizeof(count));
+  return count;
+}
+
+template <typename DataStorage>
+uint64_t static_tree<DataStorage>::lower_bound(const sha1_t& sha1) const
+{
+  if (m_geometry.keys_count() == 0u) {
+    return 0u;
+  }
+
+  descent state;
+  for (auto layer = m_geometry.layers_count(); layer >= 1u; --layer) {
+    if (descend(layer, sha1, state)) {
+      return state.found_key_index;
+    }
+  }
+
+  // Keys of the leaf block are not less than the separator on the left of it, so the lower bound
+  // is in this block or right after it.
+  const auto keys_count = m_geometry.leaf_block_size(state.block);
+  const auto first_key = m_geometry.leaf_block_first_key(state.block);
+  const auto* keys = reinterpret_cast<const sha1_t*>(m_reader.read(
+    m_geometry.keys_offset() + first_key * sizeof(sha1_t), keys_count * sizeof(sha1_t)));
+
+  return first_key + lower_bound_sha1(keys, keys_count, sha1);
+}
+
+template <typename DataStorage>
+void static_tree<DataStorage>::contains_sorted_batch(const sha1_t* keys,
+                                                     const std::size_t* sorted_queries,
+                                                     std::size_t count, uint8_t* results) const
+{
+  // Without direct access a pointer to a block is valid only till the next read, so there is
+  // nothing to prefetch.
+  if (!storage_reader<DataStorage>::has_direct_access() || m_geometry.keys_count() == 0u) {
+    for (auto i = 0u; i < count; ++i) {
+      const auto query = sorted_queries[i];
+      results[query] = contains(keys[query]) ? 1u : 0u;
+    }
+    return;
+  }
+
+  constexpr auto group_size = details::k_static_tree_prefetch_group_size;
+  descent states[group_size];
+
+  for (std::size_t group_begin = 0u; group_begin < count; group_begin += group_size) {
+    const auto group_count =
+      static_cast<unsigned>(std::min<std::size_t>(group_size, count - group_begin));
+    const auto* group_queries = sorted_queries + group_begin;
+
+    std::fill(states, states + group_count, descent{});
+
+    for (auto layer = m_geometry.layers_count(); layer >= 1u; --layer) {
+      for (auto i = 0u; i < group_count; ++i) {
+        auto& state = states[i];
+        if (state.found) {
+          continue;
+        }
+
+        state.found = descend(layer, keys[group_queries[i]], state);
+
+        if (!state.found && layer > 1u) {
+          details::prefetch(internal_block(layer - 1u, state.block));
+        }
+      }
+    }
+
+    for (auto i = 0u; i < group_count; ++i) {
+      const auto query = group_queries[i];
+      const auto found = states[i].found || leaf_block_contains(states[i].block, keys[query]);
+      results[query] = found ? 1u : 0u;
+    }
+  }
+}
+
+template <typename DataStorage>
+const static_tree_geometry& static_tree<DataStorage>::geometry() const
+{
+  return m_geometry;
+}
+
+template <typename DataStorage>
+const uint8_t* static_tree<DataStorage>::internal_block(unsigned layer, uint64_t block) const
+{
+  return m_reader.read(m_geometry.internal_block_offset(layer, block),
+                       m_geometry.internal_block_size());
+}
+
+template <typename DataStorage>
+bool static_tree<DataStorage>::descend(unsigned layer, const sha1_t& sha1, descent& state) const
+{
+  const auto separators_count = m_geometry.separators_count(layer, state.block);
+  const auto* prefixes = internal_block(layer, state.block);
+  const auto* suffixes = prefixes + m_geometry.internal_block_keys() * k_sha1_prefix_size;
+
+  const auto place = lower_bound_split_sha1(prefixes, suffixes, separators_count, sha1);
+
+  if (place < separators_count) {
+    const auto key_prefix = details::split_sha1_keys{ prefixes, suffixes }.prefix(place);
+    if (key_prefix == details::sha1_prefix(sha1) &&
+        std::memcmp(suffixes + place * k_sha1_suffix_size, sha1.data() + k_sha1_prefix_size,
+                    k_sha1_suffix_size) == 0) {
+      state.found_key_index = m_geometry.separator_key_index(layer, state.block, place);
+      return true;
+    }
+  }
+
+  state.block = m_geometry.child_block(state.block, place);
+  return false;
+}
+
+template <typename DataStorage>
+bool static_tree<DataStorage>::leaf_block_contains(uint64_t leaf_block, const sha1_t& sha1) const
+{
+  const auto keys_count = m_geometry.leaf_block_size(leaf_block);
+  const auto offset =
+    m_geometry.keys_offset() + m_geometry.leaf_block_first_key(leaf_block) * sizeof(sha1_t);
+  const auto* keys =
+    reinterpret_cast<const sha1_t*>(m_reader.read(offset, keys_count * sizeof(sha1_t)));
+
+  const auto place = lower_bound_sha1(keys, keys_count, sha1);
+  return place < keys_count && keys[place] == sha1;
+}
+}
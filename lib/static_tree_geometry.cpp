@@ -0,0 +1,145 @@
+#include "static_tree_geometry.hpp"
+
+#include "file_format.hpp"
+#include "sha1_utils.hpp"
+
+#include <algorithm>
+
+namespace okon {
+namespace {
+constexpr uint64_t k_internal_layers_alignment{ 64u };
+
+uint64_t div_ceil(uint64_t value, uint64_t divisor)
+{
+  return (value + divisor - 1u) / divisor;
+}
+}
+
+static_tree_geometry::static_tree_geometry(uint64_t keys_count, uint32_t leaf_block_keys,
+                                           uint32_t internal_block_keys, bool has_counts)
+  : m_keys_count{ keys_count }
+  , m_leaf_block_keys{ leaf_block_keys }
+  , m_internal_block_keys{ internal_block_keys }
+  , m_has_counts{ has_counts }
+{
+  const uint64_t fanout = m_internal_block_keys + 1u;
+
+  m_blocks_count.push_back(div_ceil(m_keys_count, m_leaf_block_keys));
+  m_keys_per_child.push_back(1u);
+
+  uint64_t keys_per_child = m_leaf_block_keys;
+  while (m_blocks_count.back() > 1u) {
+    m_blocks_count.push_back(div_ceil(m_blocks_count.back(), fanout));
+    m_keys_per_child.push_back(keys_per_child);
+    keys_per_child *= fanout;
+  }
+
+  // Layers are stored from the root down.
+  m_layer_offsets.resize(m_blocks_count.size(), 0u);
+  auto offset = internal_layers_offset();
+  for (auto layer = layers_count(); layer >= 1u; --layer) {
+    m_layer_offsets[layer] = offset;
+    offset += m_blocks_count[layer] * internal_block_size();
+  }
+}
+
+uint64_t static_tree_geometry::keys_count() const
+{
+  return m_keys_count;
+}
+
+uint32_t static_tree_geometry::leaf_block_keys() const
+{
+  return m_leaf_block_keys;
+}
+
+uint32_t static_tree_geometry::internal_block_keys() const
+{
+  return m_internal_block_keys;
+}
+
+bool static_tree_geometry::has_counts() const
+{
+  return m_has_counts;
+}
+
+unsigned static_tree_geometry::layers_count() const
+{
+  return static_cast<unsigned>(m_blocks_count.size() - 1u);
+}
+
+uint64_t static_tree_geometry::blocks_count(unsigned layer) const
+{
+  return m_blocks_count[layer];
+}
+
+uint32_t static_tree_geometry::separators_count(unsigned layer, uint64_t block) const
+{
+  // Separator i is valid if its child exists.
+  const auto children = m_blocks_count[layer - 1u];
+  const auto first_separator_child = block * (m_internal_block_keys + 1u) + 1u;
+  if (first_separator_child >= children) {
+    return 0u;
+  }
+
+  return static_cast<uint32_t>(
+    std::min<uint64_t>(m_internal_block_keys, children - first_separator_child));
+}
+
+uint64_t static_tree_geometry::separator_key_index(unsigned layer, uint64_t block,
+                                                   uint32_t separator) const
+{
+  return m_keys_per_child[layer] * child_block(block, separator + 1u);
+}
+
+uint64_t static_tree_geometry::child_block(uint64_t block, uint32_t place) const
+{
+  return block * (m_internal_block_keys + 1u) + place;
+}
+
+uint64_t static_tree_geometry::keys_offset() const
+{
+  return k_extended_header_size;
+}
+
+uint64_t static_tree_geometry::internal_block_size() const
+{
+  return uint64_t{ m_internal_block_keys } * sizeof(sha1_t);
+}
+
+uint64_t static_tree_geometry::internal_layers_offset() const
+{
+  const auto keys_end = keys_offset() + m_keys_count * sizeof(sha1_t);
+  return div_ceil(keys_end, k_internal_layers_alignment) * k_internal_layers_alignment;
+}
+
+uint64_t static_tree_geometry::internal_block_offset(unsigned layer, uint64_t block) const
+{
+  return m_layer_offsets[layer] + block * internal_block_size();
+}
+
+uint64_t static_tree_geometry::leaf_block_first_key(uint64_t leaf_block) const
+{
+  return leaf_block * m_leaf_block_keys;
+}
+
+uint32_t static_tree_geometry::leaf_block_size(uint64_t leaf_block) const
+{
+  const auto first = leaf_block_first_key(leaf_block);
+  return static_cast<uint32_t>(std::min<uint64_t>(m_leaf_block_keys, m_keys_count - first));
+}
+
+uint64_t static_tree_geometry::counts_offset() const
+{
+  if (layers_count() == 0u) {
+    return internal_layers_offset();
+  }
+
+  return internal_block_offset(1u, m_blocks_count[1]);
+}
+
+uint64_t static_tree_geometry::file_size() const
+{
+  return counts_offset() + (m_has_counts ? m_keys_count * sizeof(uint32_t) : 0u);
+}
+}
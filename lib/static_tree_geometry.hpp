@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace okon {
+// Shape of a static search tree (S+ tree). Keys are stored as one sorted array, divided into leaf
+// blocks of leaf_block_keys keys. Every internal layer consists of blocks of internal_block_keys
+// separators. Block k of layer h has children k * (internal_block_keys + 1) + c of layer h - 1,
+// where layer 0 are the leaf blocks. Separator i of block k of layer h is the smallest key of its
+// child k * (internal_block_keys + 1) + i + 1, so no pointers need to be stored.
+//
+// File layout:
+// header | keys[keys_count] | padding to 64 bytes | layer H | layer H - 1 | ... | layer 1 |
+// counts[keys_count] if has_counts
+// header: k_extended_header_marker | file_format::static_tree | keys_count (64-bit) |
+//         leaf_block_keys | internal_block_keys | has_counts | zeros till key_size |
+//         key_size (32-bit)
+// internal block: prefixes[internal_block_keys] (8 bytes each) | suffixes[internal_block_keys]
+// counts[i]: 32-bit number of occurrences of keys[i].
+class static_tree_geometry
+{
+public:
+  static constexpr uint32_t k_default_leaf_block_keys{ 256u };
+  static constexpr uint32_t k_default_internal_block_keys{ 16u };
+
+  // Bound of block sizes in headers of opened files, writers use much smaller blocks.
+  static constexpr uint32_t k_max_block_keys{ 1u << 16u };
+
+  explicit static_tree_geometry(uint64_t keys_count,
+                                uint32_t leaf_block_keys = k_default_leaf_block_keys,
+                                uint32_t internal_block_keys = k_default_internal_block_keys,
+                                bool has_counts = false);
+
+  uint64_t keys_count() const;
+  uint32_t leaf_block_keys() const;
+  uint32_t internal_block_keys() const;
+  bool has_counts() const;
+
+  // Number of internal layers. Layer number layers_count() is the root layer, having one block.
+  unsigned layers_count() const;
+  uint64_t blocks_count(unsigned layer) const;
+
+  // Number of valid separators in a block. The last blocks of a layer might not be full.
+  uint32_t separators_count(unsigned layer, uint64_t block) const;
+
+  // Index of the separator, in the sorted keys array.
+  uint64_t separator_key_index(unsigned layer, uint64_t block, uint32_t separator) const;
+
+  uint64_t child_block(uint64_t block, uint32_t place) const;
+
+  uint64_t keys_offset() const;
+  uint64_t internal_block_size() const;
+  uint64_t internal_layers_offset() const;
+  uint64_t internal_block_offset(unsigned layer, uint64_t block) const;
+
+  uint64_t leaf_block_first_key(uint64_t leaf_block) const;
+  uint32_t leaf_block_size(uint64_t leaf_block) const;
+
+  uint64_t counts_offset() const;
+  uint64_t file_size() const;
+
+private:
+  uint64_t m_keys_count;
+  uint32_t m_leaf_block_keys;
+  uint32_t m_internal_block_keys;
+  bool m_has_counts;
+
+  // Index 0 describes leaf blocks, index h describes layer h.
+  std::vector<uint64_t> m_blocks_count;
+  std::vector<uint64_t> m_keys_per_child;
+  std::vector<uint64_t> m_layer_offsets;
+};
+}
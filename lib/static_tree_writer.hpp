@@ -0,0 +1,198 @@
+#pragma once
+
+#include "file_format.hpp"
+#include "key_counts.hpp"
+#include "sha1_search.hpp"
+#include "sha1_utils.hpp"
+#include "static_tree_geometry.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <optional>
+#include <vector>
+
+namespace okon {
+// Writes sorted keys as a static search tree. Keys are written to the storage as they come.
+// Separators of internal layers are collected in memory, because they take only about
+// 1 / leaf_block_keys of the keys, and are written by finalize_inserting(). Layer of a separator
+// depends only on its index, so the number of keys doesn't need to be known up front.
+// If `counts_scratch_storage` is given, the tree has counts of the keys, see key_counts_writer.
+template <typename DataStorage>
+class static_tree_writer
+{
+public:
+  explicit static_tree_writer(
+    DataStorage& storage,
+    uint32_t leaf_block_keys = static_tree_geometry::k_default_leaf_block_keys,
+    uint32_t internal_block_keys = static_tree_geometry::k_default_internal_block_keys,
+    DataStorage* counts_scratch_storage = nullptr);
+
+  void insert_sorted(const sha1_t& sha1);
+  void insert_sorted(const sha1_t& sha1, uint32_t count);
+  void finalize_inserting();
+
+private:
+  void collect_separator(const sha1_t& sha1);
+  void flush_keys_buffer();
+  void write_internal_blocks(unsigned layer);
+  void write_header();
+
+private:
+  static constexpr auto k_keys_buffer_size{ 1024u * 64u };
+
+  DataStorage& m_storage;
+  static_tree_geometry m_geometry;
+  uint64_t m_inserted_count{ 0u };
+  std::vector<sha1_t> m_keys_buffer;
+  std::optional<key_counts_writer<DataStorage>> m_counts;
+
+  // Index h - 1 keeps separators of layer h, in order, skipping the absent ones.
+  std::vector<std::vector<sha1_t>> m_separators;
+};
+
+template <typename DataStorage>
+static_tree_writer<DataStorage>::static_tree_writer(DataStorage& storage,
+                                                    uint32_t leaf_block_keys,
+                                                    uint32_t internal_block_keys,
+                                                    DataStorage* counts_scratch_storage)
+  : m_storage{ storage }
+  , m_geometry{ 0u, leaf_block_keys, internal_block_keys, counts_scratch_storage != nullptr }
+{
+  m_keys_buffer.reserve(k_keys_buffer_size);
+  if (counts_scratch_storage) {
+    m_counts.emplace(*counts_scratch_storage);
+  }
+  m_storage.seek_out(m_geometry.keys_offset());
+}
+
+template <typename DataStorage>
+void static_tree_writer<DataStorage>::insert_sorted(const sha1_t& sha1)
+{
+  if (m_inserted_count % m_geometry.leaf_block_keys() == 0u) {
+    collect_separator(sha1);
+  }
+
+  m_keys_buffer.push_back(sha1);
+  if (m_keys_buffer.size() == k_keys_buffer_size) {
+    flush_keys_buffer();
+  }
+
+  ++m_inserted_count;
+}
+
+template <typename DataStorage>
+void static_tree_writer<DataStorage>::insert_sorted(const sha1_t& sha1, uint32_t count)
+{
+  insert_sorted(sha1);
+  if (m_counts) {
+    m_counts->add(count);
+  }
+}
+
+template <typename DataStorage>
+void static_tree_writer<DataStorage>::finalize_inserting()
+{
+  flush_keys_buffer();
+
+  m_geometry = static_tree_geometry{ m_inserted_count, m_geometry.leaf_block_keys(),
+                                     m_geometry.internal_block_keys(), m_geometry.has_counts() };
+  assert(m_separators.size() <= m_geometry.layers_count());
+  m_separators.resize(m_geometry.layers_count());
+
+  for (auto layer = m_geometry.layers_count(); layer >= 1u; --layer) {
+    write_internal_blocks(layer);
+  }
+
+  if (m_counts) {
+    m_counts->append_to(m_storage, m_geometry.counts_offset());
+  }
+
+  write_header();
+}
+
+template <typename DataStorage>
+void static_tree_writer<DataStorage>::collect_separator(const sha1_t& sha1)
+{
+  // `sha1` is the first key of a leaf block. It's a separator of the lowest layer whose separator
+  // points to a subtree starting with this leaf block, if any.
+  const uint64_t fanout = m_geometry.internal_block_keys() + 1u;
+  auto child = m_inserted_count / m_geometry.leaf_block_keys();
+
+  for (auto layer = 1u; child != 0u; ++layer) {
+    if (child % fanout != 0u) {
+      if (m_separators.size() < layer) {
+        m_separators.resize(layer);
+      }
+
+      m_separators[layer - 1u].push_back(sha1);
+      return;
+    }
+
+    child /= fanout;
+  }
+}
+
+template <typename DataStorage>
+void static_tree_writer<DataStorage>::flush_keys_buffer()
+{
+  if (m_keys_buffer.empty()) {
+    return;
+  }
+
+  m_storage.write(m_keys_buffer.data(), m_keys_buffer.size() * sizeof(sha1_t));
+  m_keys_buffer.clear();
+}
+
+template <typename DataStorage>
+void static_tree_writer<DataStorage>::write_internal_blocks(unsigned layer)
+{
+  const auto block_keys = m_geometry.internal_block_keys();
+  std::vector<uint8_t> block(m_geometry.internal_block_size());
+  auto* const prefixes = block.data();
+  auto* const suffixes = block.data() + block_keys * k_sha1_prefix_size;
+
+  const auto& separators = m_separators[layer - 1u];
+  auto next_separator = separators.cbegin();
+
+  m_storage.seek_out(m_geometry.internal_block_offset(layer, 0u));
+
+  for (uint64_t block_index = 0u; block_index < m_geometry.blocks_count(layer); ++block_index) {
+    std::fill(block.begin(), block.end(), uint8_t{ 0u });
+
+    const auto count = m_geometry.separators_count(layer, block_index);
+    for (auto i = 0u; i < count; ++i, ++next_separator) {
+      const auto prefix = details::sha1_prefix(*next_separator);
+      std::memcpy(prefixes + i * k_sha1_prefix_size, &prefix, sizeof(prefix));
+      std::memcpy(suffixes + i * k_sha1_suffix_size, next_separator->data() + k_sha1_prefix_size,
+                  k_sha1_suffix_size);
+    }
+
+    m_storage.write(block.data(), block.size());
+  }
+
+  assert(next_separator == separators.cend());
+}
+
+template <typename DataStorage>
+void static_tree_writer<DataStorage>::write_header()
+{
+  std::vector<uint8_t> header(k_extended_header_size, uint8_t{ 0u });
+  auto* out = header.data();
+
+  const auto append = [&out](const auto& value) {
+    std::memcpy(out, &value, sizeof(value));
+    out += sizeof(value);
+  };
+
+  append(k_extended_header_marker);
+  append(static_cast<uint32_t>(file_format::static_tree));
+  append(uint64_t{ m_geometry.keys_count() });
+  append(m_geometry.leaf_block_keys());
+  append(m_geometry.internal_block_keys());
+  append(uint32_t{ m_geometry.has_counts() });
+  write_key_size(header.data(), k_key_size);
+
+  m_storage.seek_out(0u);
+  m_storage.write(header.data(), header.size());
+}
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "memory_hints.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace okon {
+namespace details {
+// Storages that expose their bytes through data() (e.g. mmap_storage) are read without copying.
+// They have size() too, so reads past the end are caught.
+template <typename DataStorage, typename = void>
+struct has_direct_access : std::false_type
+{
+};
+
+template <typename DataStorage>
+struct has_direct_access<DataStorage,
+                         std::void_t<decltype(std::declval<const DataStorage&>().data())>>
+  : std::true_type
+{
+};
+
+template <typename DataStorage, typename = void>
+struct has_advise : std::false_type
+{
+};
+
+template <typename DataStorage>
+struct has_advise<DataStorage,
+                  std::void_t<decltype(std::declval<const DataStorage&>().advise(
+                    0u, 0u, access_pattern::normal))>> : std::true_type
+{
+};
+}
+
+// Gives access to ranges of bytes of a storage. Storages with direct access are read in place.
+// Other storages are read into a buffer, reused between the reads.
+template <typename DataStorage>
+class storage_reader
+{
+public:
+  explicit storage_reader(DataStorage& storage)
+    : m_storage{ storage }
+  {
+  }
+
+  static constexpr bool has_direct_access()
+  {
+    return details::has_direct_access<DataStorage>::value;
+  }
+
+  // Returned pointer is valid until the next read(), unless the storage has direct access and the
+  // range is in the storage. Bytes past the end of the storage, e.g. of a truncated or corrupt
+  // file, are read as zeros.
+  const uint8_t* read(uint64_t offset, uint64_t size) const
+  {
+    if constexpr (has_direct_access()) {
+      if (contains(offset, size)) {
+        return m_storage.data() + offset;
+      }
+
+      // Lookups read the storage from many threads at the same time.
+      static thread_local std::vector<uint8_t> outside_buffer;
+      outside_buffer.assign(size, 0u);
+      if (offset < m_storage.size()) {
+        const auto size_inside = std::min<uint64_t>(size, m_storage.size() - offset);
+        std::memcpy(outside_buffer.data(), m_storage.data() + offset, size_inside);
+      }
+      return outside_buffer.data();
+    } else {
+      m_buffer.assign(size, 0u);
+      m_storage.seek_in(offset);
+      m_storage.read(m_buffer.data(), size);
+      return m_buffer.data();
+    }
+  }
+
+  // Whether the whole range is in the storage. Storages without direct access are the ones being
+  // written, everything read from them has been written before.
+  bool contains(uint64_t offset, uint64_t size) const
+  {
+    if constexpr (has_direct_access()) {
+      return offset <= m_storage.size() && size <= m_storage.size() - offset;
+    } else {
+      return true;
+    }
+  }
+
+  // Hints how the range is going to be read, if the storage takes hints.
+  void advise(uint64_t offset, uint64_t size, access_pattern pattern) const
+  {
+    if constexpr (details::has_advise<DataStorage>::value) {
+      m_storage.advise(offset, size, pattern);
+    }
+  }
+
+private:
+  DataStorage& m_storage;
+  mutable std::vector<uint8_t> m_buffer;
+};
+}
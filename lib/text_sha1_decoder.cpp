@@ -0,0 +1,79 @@
+#include "text_sha1_decoder.hpp"
+
+#include <cstring>
+
+#ifdef OKON_TEXT_SHA1_DECODER_DISPATCH
+#  define VCL_NAMESPACE vcl
+#  include <vcl/instrset.h>
+#endif
+
+namespace okon {
+namespace details {
+using text_sha1s_decoder_t = void(const char* const* texts, std::size_t count, uint8_t* sha1s);
+
+void decode_text_sha1s_scalar(const char* const* texts, std::size_t count, uint8_t* sha1s)
+{
+  for (std::size_t i = 0u; i < count; ++i) {
+    const auto sha1 = string_sha1_to_binary(texts[i]);
+    std::memcpy(sha1s + i * sizeof(sha1_t), sha1.data(), sizeof(sha1_t));
+  }
+}
+
+#ifdef OKON_TEXT_SHA1_DECODER_DISPATCH
+text_sha1s_decoder_t decode_text_sha1s_sse2;
+text_sha1s_decoder_t decode_text_sha1s_avx2;
+text_sha1s_decoder_t decode_text_sha1s_avx512;
+#endif
+
+namespace {
+struct text_sha1s_decoder
+{
+  text_sha1s_decoder_t* decode;
+  const char* name;
+};
+
+text_sha1s_decoder select_decoder()
+{
+#ifdef OKON_TEXT_SHA1_DECODER_DISPATCH
+  // Levels of vcl::instrset_detect(): 10 is AVX-512 with BW, DQ and VL, 8 is AVX2.
+  const auto instruction_set = vcl::instrset_detect();
+  if (instruction_set >= 10) {
+    return { &decode_text_sha1s_avx512, "avx512" };
+  }
+  if (instruction_set >= 8) {
+    return { &decode_text_sha1s_avx2, "avx2" };
+  }
+  if (instruction_set >= 2) {
+    return { &decode_text_sha1s_sse2, "sse2" };
+  }
+#endif
+
+  return { &decode_text_sha1s_scalar, "scalar" };
+}
+
+const text_sha1s_decoder& decoder()
+{
+  static const auto selected = select_decoder();
+  return selected;
+}
+}
+}
+
+void text_sha1s_to_binary(const char* const* texts, std::size_t count, sha1_t* sha1s)
+{
+  // sha1_t is an array of bytes, so the hashes are decoded in place.
+  details::decoder().decode(texts, count, reinterpret_cast<uint8_t*>(sha1s));
+}
+
+sha1_t text_sha1_to_binary(const char* text)
+{
+  sha1_t sha1;
+  text_sha1s_to_binary(&text, 1u, &sha1);
+  return sha1;
+}
+
+const char* text_sha1_decoder_name()
+{
+  return details::decoder().name;
+}
+}
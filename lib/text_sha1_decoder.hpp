@@ -0,0 +1,18 @@
+#pragma once
+
+#include "sha1_utils.hpp"
+
+#include <cstddef>
+
+namespace okon {
+// Decodes `count` text hashes to binary. texts[i] points to 40 hex characters of the i-th hash,
+// characters after them are not read. The fastest implementation supported by the CPU is selected
+// at runtime.
+void text_sha1s_to_binary(const char* const* texts, std::size_t count, sha1_t* sha1s);
+
+// Same as above, for a single hash.
+sha1_t text_sha1_to_binary(const char* text);
+
+// Name of the implementation selected by text_sha1s_to_binary(), e.g. "avx2".
+const char* text_sha1_decoder_name();
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+// Batch decoder of text hashes, included by the text_sha1_decoder_<instruction set>.cpp files.
+// Each of them is compiled for its own instruction set, with its own VCL_NAMESPACE and
+// OKON_TEXT_SHA1_DECODER_KERNEL name, so inline functions of the vector classes compiled for
+// different instruction sets are never merged by the linker. For the same reason, nothing else
+// with inline functions may be included here.
+
+#include <okon/okon.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <stdlib.h>
+
+// Vector overloads of abs() declared in VCL_NAMESPACE hide ::abs(int), which the AVX-512 headers
+// call unqualified.
+namespace VCL_NAMESPACE {
+using ::abs;
+}
+
+#include <vcl/vectorclass.h>
+
+namespace okon::details {
+namespace {
+using namespace VCL_NAMESPACE;
+
+// Digits have bit 6 clear. Letters, upper and lower case, have it set and their low nibble is
+// 1 for 'A', 2 for 'B' and so on.
+template <typename Chars>
+Chars hex_values(Chars chars)
+{
+  const auto values = chars & Chars{ 0x0Fu };
+  return if_add((chars & Chars{ 0x40u }) != Chars{ 0u }, values, Chars{ 9u });
+}
+
+// Every 16-bit lane holds values of two hex digits, the first one in its low byte. The low byte of
+// the result lane is the decoded byte.
+template <typename Pairs>
+Pairs pack_pairs(Pairs pairs)
+{
+  return (pairs << 4u) | (pairs >> 8u);
+}
+
+#if INSTRSET >= 10
+void decode_text_sha1(const char* text, uint8_t* sha1)
+{
+  // With AVX-512 all characters fit in one vector. Partial load doesn't touch bytes after them.
+  Vec64uc chars;
+  chars.load_partial(2 * OKON_KEY_SIZE, text);
+
+  const auto bytes = compress(pack_pairs(Vec32us{ hex_values(chars) }));
+  bytes.store_partial(OKON_KEY_SIZE, sha1);
+}
+#else
+Vec16uc decode_32_chars(const char* text)
+{
+  Vec32uc chars;
+  chars.load(text);
+  return compress(pack_pairs(Vec16us{ hex_values(chars) }));
+}
+
+void decode_text_sha1(const char* text, uint8_t* sha1)
+{
+  // Characters [0, 32) give bytes [0, 16). For SHA-1, characters [8, 40) give bytes [4, 20). The
+  // overlapping bytes are equal, so nothing after the 40 characters is read.
+  decode_32_chars(text).store(sha1);
+  if constexpr (OKON_KEY_SIZE > 16) {
+    constexpr auto k_last_bytes_offset{ OKON_KEY_SIZE - 16 };
+    decode_32_chars(text + 2 * k_last_bytes_offset).store(sha1 + k_last_bytes_offset);
+  }
+}
+#endif
+}
+
+void OKON_TEXT_SHA1_DECODER_KERNEL(const char* const* texts, std::size_t count, uint8_t* sha1s)
+{
+  for (std::size_t i = 0u; i < count; ++i) {
+    decode_text_sha1(texts[i], sha1s + i * OKON_KEY_SIZE);
+  }
+}
+}
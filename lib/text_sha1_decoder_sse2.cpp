@@ -0,0 +1,4 @@
+#define VCL_NAMESPACE vcl_sse2
+#define OKON_TEXT_SHA1_DECODER_KERNEL decode_text_sha1s_sse2
+
+#include "text_sha1_decoder_kernel.hpp"
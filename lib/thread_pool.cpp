@@ -0,0 +1,85 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+namespace okon {
+thread_pool::thread_pool(unsigned threads_count)
+{
+  m_threads.reserve(threads_count);
+  for (auto i = 0u; i < threads_count; ++i) {
+    m_threads.emplace_back([this] { worker(); });
+  }
+}
+
+thread_pool::~thread_pool()
+{
+  {
+    std::lock_guard lock{ m_mtx };
+    m_stopping = true;
+  }
+  m_cv.notify_all();
+
+  for (auto& thread : m_threads) {
+    thread.join();
+  }
+}
+
+void thread_pool::parallel_for(std::size_t count, const std::function<void(std::size_t)>& task)
+{
+  std::mutex done_mtx;
+  std::condition_variable done_cv;
+  std::size_t done_count{ 0u };
+
+  {
+    std::lock_guard lock{ m_mtx };
+    for (std::size_t i = 0u; i < count; ++i) {
+      m_tasks.push([&, i] {
+        task(i);
+
+        std::lock_guard done_lock{ done_mtx };
+        ++done_count;
+        done_cv.notify_one();
+      });
+    }
+  }
+  m_cv.notify_all();
+
+  std::unique_lock done_lock{ done_mtx };
+  done_cv.wait(done_lock, [&] { return done_count == count; });
+}
+
+unsigned thread_pool::threads_count() const
+{
+  return static_cast<unsigned>(m_threads.size());
+}
+
+void thread_pool::worker()
+{
+  while (true) {
+    std::function<void()> task;
+
+    {
+      std::unique_lock lock{ m_mtx };
+      m_cv.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+
+      if (m_tasks.empty()) {
+        return;
+      }
+
+      task = std::move(m_tasks.front());
+      m_tasks.pop();
+    }
+
+    task();
+  }
+}
+
+unsigned resolve_threads_count(unsigned threads_count)
+{
+  if (threads_count != 0u) {
+    return threads_count;
+  }
+
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+}
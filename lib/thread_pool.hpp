@@ -0,0 +1,39 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace okon {
+class thread_pool
+{
+public:
+  explicit thread_pool(unsigned threads_count);
+  ~thread_pool();
+
+  thread_pool(const thread_pool&) = delete;
+  thread_pool& operator=(const thread_pool&) = delete;
+
+  // Runs task(i) for every i in [0, count) on the pool threads and waits till all of them are done.
+  void parallel_for(std::size_t count, const std::function<void(std::size_t)>& task);
+
+  unsigned threads_count() const;
+
+private:
+  void worker();
+
+private:
+  std::vector<std::thread> m_threads;
+  std::mutex m_mtx;
+  std::condition_variable m_cv;
+  std::queue<std::function<void()>> m_tasks;
+  bool m_stopping{ false };
+};
+
+// Returns `threads_count`, or hardware concurrency if `threads_count` is 0.
+unsigned resolve_threads_count(unsigned threads_count);
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace okon {
+// Storage that collects consecutive writes to another storage and passes them on as one big
+// write. Writers that write their output almost sequentially, e.g. nodes of a B-tree with
+// increasing pointers, do a few big writes instead of a seek and a small write per node.
+//
+// Buffered data is written when a write doesn't continue the previous one, when the buffer is
+// full, before every read and on flush(). Reads always see the data written before them.
+template <typename DataStorage>
+class write_combining_storage
+{
+public:
+  using size_type_t = typename DataStorage::size_type_t;
+
+  static constexpr std::size_t k_default_buffer_size{ 8u * 1024u * 1024u };
+
+  explicit write_combining_storage(DataStorage& storage,
+                                   std::size_t buffer_size = k_default_buffer_size)
+    : m_storage{ storage }
+    , m_buffer_size{ buffer_size }
+  {
+    m_buffer.reserve(m_buffer_size);
+  }
+
+  ~write_combining_storage()
+  {
+    flush();
+  }
+
+  write_combining_storage(const write_combining_storage&) = delete;
+  write_combining_storage& operator=(const write_combining_storage&) = delete;
+
+  void write(const void* ptr, uint64_t size)
+  {
+    if (!m_buffer.empty() && m_out_pos != m_buffer_offset + m_buffer.size()) {
+      flush();
+    }
+
+    if (m_buffer.empty()) {
+      m_buffer_offset = m_out_pos;
+    }
+
+    const auto offset = m_buffer.size();
+    m_buffer.resize(offset + size);
+    std::memcpy(m_buffer.data() + offset, ptr, size);
+    m_out_pos += size;
+
+    if (m_buffer.size() >= m_buffer_size) {
+      flush();
+    }
+  }
+
+  size_type_t read(void* ptr, uint64_t size)
+  {
+    flush();
+
+    // Seeked only now, as some storages (e.g. std::fstream) share one position of reads and
+    // writes.
+    m_storage.seek_in(m_in_pos);
+    const auto read_size = m_storage.read(ptr, size);
+    m_in_pos += read_size;
+    return read_size;
+  }
+
+  void seek_in(uint64_t pos)
+  {
+    m_in_pos = pos;
+  }
+
+  void seek_out(uint64_t pos)
+  {
+    m_out_pos = pos;
+  }
+
+  uint64_t tell_in()
+  {
+    return m_in_pos;
+  }
+
+  uint64_t tell_out()
+  {
+    return m_out_pos;
+  }
+
+  // Writes the buffered data to the underlying storage.
+  void flush()
+  {
+    if (m_buffer.empty()) {
+      return;
+    }
+
+    m_storage.seek_out(m_buffer_offset);
+    m_storage.write(m_buffer.data(), m_buffer.size());
+    m_buffer.clear();
+  }
+
+private:
+  DataStorage& m_storage;
+  std::size_t m_buffer_size;
+  std::vector<uint8_t> m_buffer;
+
+  // Offset of the first buffered byte in the underlying storage.
+  uint64_t m_buffer_offset{ 0u };
+  uint64_t m_in_pos{ 0u };
+  uint64_t m_out_pos{ 0u };
+};
+}
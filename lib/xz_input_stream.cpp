@@ -0,0 +1,63 @@
+#include "xz_input_stream.hpp"
+
+#include <cstdint>
+
+namespace {
+constexpr auto k_compressed_chunk_size{ 1024u * 1024u };
+}
+
+namespace okon {
+xz_input_stream::xz_input_stream(std::unique_ptr<input_stream> source)
+  : m_source{ std::move(source) }
+  , m_input(k_compressed_chunk_size)
+{
+  m_is_initialized =
+    ::lzma_stream_decoder(&m_stream, UINT64_MAX, LZMA_CONCATENATED) == LZMA_OK;
+}
+
+xz_input_stream::~xz_input_stream()
+{
+  ::lzma_end(&m_stream);
+}
+
+xz_input_stream::size_type_t xz_input_stream::read(void* ptr, size_type_t size)
+{
+  if (!is_open()) {
+    return 0u;
+  }
+
+  m_stream.next_out = static_cast<uint8_t*>(ptr);
+  m_stream.avail_out = static_cast<std::size_t>(size);
+
+  while (m_stream.avail_out > 0u && !m_is_at_end) {
+    if (m_stream.avail_in == 0u && !m_is_source_at_end) {
+      const auto read_size = m_source->read(m_input.data(), m_input.size());
+      m_stream.next_in = m_input.data();
+      m_stream.avail_in = static_cast<std::size_t>(read_size);
+      m_is_source_at_end = read_size < m_input.size();
+    }
+
+    // With LZMA_CONCATENATED, the decoder knows that the last stream ended only after
+    // LZMA_FINISH.
+    const auto result = ::lzma_code(&m_stream, m_is_source_at_end ? LZMA_FINISH : LZMA_RUN);
+
+    // Any error, e.g. truncated input, ends the stream with what was decompressed so far.
+    if (result != LZMA_OK) {
+      m_has_error = result != LZMA_STREAM_END;
+      m_is_at_end = true;
+    }
+  }
+
+  return size - m_stream.avail_out;
+}
+
+bool xz_input_stream::is_open() const
+{
+  return m_is_initialized && m_source->is_open();
+}
+
+bool xz_input_stream::has_error() const
+{
+  return m_has_error || m_source->has_error();
+}
+}
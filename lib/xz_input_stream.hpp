@@ -0,0 +1,37 @@
+#pragma once
+
+#include "input_stream.hpp"
+
+#include <memory>
+#include <vector>
+
+#include <lzma.h>
+
+namespace okon {
+// Decompresses xz data of another stream. Concatenated xz streams are decompressed one after
+// another.
+class xz_input_stream : public input_stream
+{
+public:
+  explicit xz_input_stream(std::unique_ptr<input_stream> source);
+  ~xz_input_stream() override;
+
+  xz_input_stream(const xz_input_stream&) = delete;
+  xz_input_stream& operator=(const xz_input_stream&) = delete;
+
+  size_type_t read(void* ptr, size_type_t size) override;
+  bool is_open() const override;
+
+  // Whether the compressed data is corrupt or truncated, or the source has an error.
+  bool has_error() const override;
+
+private:
+  std::unique_ptr<input_stream> m_source;
+  std::vector<uint8_t> m_input;
+  lzma_stream m_stream = LZMA_STREAM_INIT;
+  bool m_is_initialized{ false };
+  bool m_is_source_at_end{ false };
+  bool m_is_at_end{ false };
+  bool m_has_error{ false };
+};
+}
@@ -0,0 +1,63 @@
+#include "hash_lines.hpp"
+
+#include "text_sha1_decoder.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+namespace {
+using okon::k_text_sha1_length;
+
+bool is_hash_line(std::string_view line)
+{
+  return line.size() >= k_text_sha1_length &&
+    (line.size() == k_text_sha1_length || line[k_text_sha1_length] == ':') &&
+    std::all_of(line.begin(), line.begin() + k_text_sha1_length,
+                [](unsigned char c) { return std::isxdigit(c); });
+}
+}
+
+void parse_hash_lines(std::string_view text, hash_lines& result)
+{
+  result.lines.clear();
+
+  std::vector<const char*> hashes;
+  for (std::size_t begin = 0u;;) {
+    const auto end = text.find('\n', begin);
+
+    auto line = text.substr(begin, end == std::string_view::npos ? end : end - begin);
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1u);
+    }
+
+    const auto is_hash = is_hash_line(line);
+    result.lines.push_back({ line, is_hash });
+    if (is_hash) {
+      hashes.push_back(line.data());
+    }
+
+    if (end == std::string_view::npos) {
+      break;
+    }
+    begin = end + 1u;
+  }
+
+  result.sha1s.resize(hashes.size());
+  okon::text_sha1s_to_binary(hashes.data(), hashes.size(), result.sha1s.data());
+}
+
+bool write_all(int fd, std::string_view data)
+{
+  for (std::size_t written = 0u; written < data.size();) {
+    const auto result = ::write(fd, data.data() + written, data.size() - written);
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result <= 0) {
+      return false;
+    }
+    written += static_cast<std::size_t>(result);
+  }
+
+  return true;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "sha1_utils.hpp"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Lines of text hashes, read a batch at a time, and binary hashes of them.
+struct hash_lines
+{
+  struct line
+  {
+    std::string_view text;
+    bool is_hash{ false };
+  };
+
+  std::vector<line> lines;
+
+  // Hashes of the lines that are hashes, in the order of the lines.
+  std::vector<okon::sha1_t> sha1s;
+};
+
+// Splits `text` into lines and decodes the hashes of all of them at once. The last line isn't
+// followed by a new line. A line is a hash if it starts with okon::k_text_sha1_length hex digits
+// followed by nothing, or by a colon, like lines of the prepared files. Carriage returns before new
+// lines are dropped.
+void parse_hash_lines(std::string_view text, hash_lines& result);
+
+// Writes all of `data`, returns false if the file is closed or fails.
+bool write_all(int fd, std::string_view data);
+
+// Reads `fd` till its end and calls `on_lines` with the complete lines of every read, without the
+// new line that ends the last of them. Lines longer than `read_size` are passed in parts. Stops
+// when `on_lines` returns false.
+template <typename OnLines>
+void read_line_batches(int fd, std::size_t read_size, OnLines&& on_lines)
+{
+  std::string pending;
+  std::vector<char> chunk(read_size);
+
+  while (true) {
+    const auto result = ::read(fd, chunk.data(), chunk.size());
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result <= 0) {
+      break;
+    }
+
+    pending.append(chunk.data(), static_cast<std::size_t>(result));
+
+    const auto last_new_line = pending.rfind('\n');
+    const auto has_new_line = last_new_line != std::string::npos;
+    if (!has_new_line && pending.size() < read_size) {
+      continue;
+    }
+
+    const auto lines_size = has_new_line ? last_new_line : pending.size();
+    if (!on_lines(std::string_view{ pending.data(), lines_size })) {
+      return;
+    }
+    pending.erase(0u, has_new_line ? last_new_line + 1u : pending.size());
+  }
+
+  // The input may end without a new line.
+  if (!pending.empty()) {
+    on_lines(std::string_view{ pending });
+  }
+}
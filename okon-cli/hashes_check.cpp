@@ -0,0 +1,88 @@
+#include "hashes_check.hpp"
+
+#include "hash_lines.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+// Big batches are split between the lookup threads of the handle.
+constexpr std::size_t k_read_size{ 1024u * 1024u };
+using okon::k_text_sha1_length;
+}
+
+std::optional<hashes_report> parse_hashes_report(std::string_view name)
+{
+  if (name == "bitmap") {
+    return hashes_report::bitmap;
+  }
+  if (name == "matching") {
+    return hashes_report::matching;
+  }
+  if (name == "counts") {
+    return hashes_report::counts;
+  }
+  return std::nullopt;
+}
+
+hashes_check_summary check_hashes(okon_handle* handle, int in_fd, int out_fd,
+                                  hashes_report report)
+{
+  hashes_check_summary summary;
+  hash_lines batch;
+  std::vector<uint8_t> results;
+  std::string output;
+
+  // Bits of the bitmap that don't fill a byte yet.
+  uint8_t bitmap_byte{ 0u };
+
+  read_line_batches(in_fd, k_read_size, [&](std::string_view text) {
+    parse_hash_lines(text, batch);
+    results.resize(batch.sha1s.size());
+    okon_exists_batch(handle, batch.sha1s.data(), batch.sha1s.size(), results.data());
+
+    output.clear();
+    auto result = results.cbegin();
+    for (const auto& line : batch.lines) {
+      const auto found = line.is_hash && *result++ != 0u;
+      summary.hashes += line.is_hash ? 1u : 0u;
+      summary.found += found ? 1u : 0u;
+
+      switch (report) {
+        case hashes_report::bitmap: {
+          const auto bit = summary.lines % 8u;
+          bitmap_byte |= static_cast<uint8_t>((found ? 1u : 0u) << bit);
+          if (bit == 7u) {
+            output += static_cast<char>(bitmap_byte);
+            bitmap_byte = 0u;
+          }
+        } break;
+        case hashes_report::matching:
+          if (found) {
+            output.append(line.text);
+            output += '\n';
+          }
+          break;
+        case hashes_report::counts:
+          if (found) {
+            output.append(line.text.substr(0u, k_text_sha1_length));
+            output += ':';
+            output += std::to_string(okon_lookup_count(handle, line.text.data()));
+            output += '\n';
+          }
+          break;
+      }
+
+      ++summary.lines;
+    }
+
+    return write_all(out_fd, output);
+  });
+
+  if (report == hashes_report::bitmap && summary.lines % 8u != 0u) {
+    write_all(out_fd, std::string(1u, static_cast<char>(bitmap_byte)));
+  }
+
+  return summary;
+}
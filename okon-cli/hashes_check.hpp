@@ -0,0 +1,35 @@
+#pragma once
+
+#include <okon/okon.h>
+
+#include <optional>
+#include <string_view>
+
+// What check_hashes() writes about the looked up hashes.
+enum class hashes_report
+{
+  // Bit i of the output, counting from the lowest bit of the first byte, is set if the i-th line
+  // is a present hash.
+  bitmap,
+
+  // Lines of the present hashes, as they are in the input.
+  matching,
+
+  // Present hashes with their counts, hash:count, see okon_lookup_count().
+  counts
+};
+
+// Parses "bitmap", "matching" or "counts".
+std::optional<hashes_report> parse_hashes_report(std::string_view name);
+
+struct hashes_check_summary
+{
+  unsigned long long lines{ 0u };
+  unsigned long long hashes{ 0u };
+  unsigned long long found{ 0u };
+};
+
+// Looks up newline-delimited text hashes of `in_fd`, in big batches, and writes `report` to
+// `out_fd`. Lines that aren't hashes are counted as not found.
+hashes_check_summary check_hashes(okon_handle* handle, int in_fd, int out_fd,
+                                  hashes_report report);
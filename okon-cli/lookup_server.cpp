@@ -0,0 +1,145 @@
+#include "lookup_server.hpp"
+
+#include "hash_lines.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+constexpr std::size_t k_read_size{ 64u * 1024u };
+
+int listen_on_unix_socket(const std::string& path)
+{
+  sockaddr_un address{};
+  if (path.size() >= sizeof(address.sun_path)) {
+    std::cerr << "socket path is too long: " << path << '\n';
+    return -1;
+  }
+
+  address.sun_family = AF_UNIX;
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1u);
+
+  const auto fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+
+  // A socket left by a previous server would make bind() fail.
+  ::unlink(path.c_str());
+  if (::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+      ::listen(fd, SOMAXCONN) != 0) {
+    ::close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+int listen_on_tcp_port(unsigned port)
+{
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(static_cast<uint16_t>(port));
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  const auto fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+
+  const int reuse_address{ 1 };
+  ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse_address, sizeof(reuse_address));
+  if (::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+      ::listen(fd, SOMAXCONN) != 0) {
+    ::close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+}
+
+void answer_hashes(okon_handle* handle, int in_fd, int out_fd)
+{
+  hash_lines batch;
+  std::vector<uint8_t> results;
+  std::string answers;
+
+  read_line_batches(in_fd, k_read_size, [&](std::string_view text) {
+    parse_hash_lines(text, batch);
+    results.resize(batch.sha1s.size());
+    okon_exists_batch(handle, batch.sha1s.data(), batch.sha1s.size(), results.data());
+
+    answers.clear();
+    auto result = results.cbegin();
+    for (const auto& line : batch.lines) {
+      if (!line.is_hash) {
+        answers += "error\n";
+        continue;
+      }
+      answers += *result++ ? "1\n" : "0\n";
+    }
+
+    return write_all(out_fd, answers);
+  });
+}
+
+int serve(okon_handle* handle, const lookup_server_options& options)
+{
+  // Clients that disconnect before reading their answers make writes fail, instead of killing the
+  // server.
+  ::signal(SIGPIPE, SIG_IGN);
+
+  if (options.socket_path.empty() && options.port == 0u) {
+    answer_hashes(handle, STDIN_FILENO, STDOUT_FILENO);
+    return 0;
+  }
+
+  const auto listening_fd = options.socket_path.empty()
+    ? listen_on_tcp_port(options.port)
+    : listen_on_unix_socket(options.socket_path);
+  if (listening_fd < 0) {
+    std::cerr << "could not listen: " << std::strerror(errno) << '\n';
+    return 1;
+  }
+
+  const auto workers_count =
+    options.workers > 0u ? options.workers : std::max(1u, std::thread::hardware_concurrency());
+
+  std::vector<std::thread> workers;
+  for (auto i = 0u; i < workers_count; ++i) {
+    workers.emplace_back([handle, listening_fd] {
+      while (true) {
+        const auto fd = ::accept(listening_fd, nullptr, nullptr);
+        if (fd < 0) {
+          if (errno == EINTR || errno == ECONNABORTED) {
+            continue;
+          }
+          return;
+        }
+
+        answer_hashes(handle, fd, fd);
+        ::close(fd);
+      }
+    });
+  }
+
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  ::close(listening_fd);
+  return 1;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <okon/okon.h>
+
+#include <string>
+
+struct lookup_server_options
+{
+  // Path of a UNIX socket to listen on. Empty means no socket.
+  std::string socket_path;
+
+  // TCP port to listen on, on the loopback interface only. 0 means no port.
+  unsigned port{ 0u };
+
+  // Number of connections served at the same time. 0 means hardware concurrency.
+  unsigned workers{ 0u };
+};
+
+// Answers newline-delimited text hashes read from `in_fd` till the end of the input, a line per
+// hash written to `out_fd`: "1" if the hash exists, "0" if it doesn't and "error" if the line isn't
+// a hash. All the complete lines of a read are looked up as one batch, so clients that send many
+// hashes without waiting for the answers get them faster.
+void answer_hashes(okon_handle* handle, int in_fd, int out_fd);
+
+// Answers hashes of the connections to the UNIX socket or to the TCP port of `options`, or of the
+// standard input if none of them is set. Connections are served by a pool of workers, each of them
+// waits for its next connection. Listening on a socket never ends, reading the standard input ends
+// with the input. Returns a non-zero exit code if the socket can't be listened on.
+int serve(okon_handle* handle, const lookup_server_options& options);
@@ -1,11 +1,23 @@
 #include <okon/okon.h>
 
+#include "hashes_check.hpp"
+#include "lookup_server.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <cstdint>
+#include <charconv>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <optional>
+#include <tuple>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 using parsed_args_t = std::unordered_map<std::string_view, std::string_view>;
@@ -22,7 +34,12 @@ std::optional<parsed_args_t> parse_args(const std::vector<std::string_view>& arg
 
   const auto accepted_args = { arg_metadata{ "--path" },    arg_metadata{ "--hash" },
                                arg_metadata{ "--prepare" }, arg_metadata{ "--wd" },
-                               arg_metadata{ "--output" },  arg_metadata{ "--help", 0u } };
+                               arg_metadata{ "--output" },  arg_metadata{ "--serve", 0u },
+                               arg_metadata{ "--socket" },  arg_metadata{ "--port" },
+                               arg_metadata{ "--workers" }, arg_metadata{ "--hashes-file" },
+                               arg_metadata{ "--report" },  arg_metadata{ "--stats", 0u },
+                               arg_metadata{ "--resumable", 0u }, arg_metadata{ "--resident", 0u },
+                               arg_metadata{ "--help", 0u } };
 
   const auto find_argument =
     [&accepted_args](std::string_view passed_argument) -> std::optional<arg_metadata> {
@@ -54,6 +71,35 @@ std::optional<parsed_args_t> parse_args(const std::vector<std::string_view>& arg
   return result;
 }
 
+void print_prepare_stats(const okon_prepare_stats& stats)
+{
+  constexpr auto k_mib{ 1024. * 1024. };
+  const auto print_time = [](std::string_view name, double wall_seconds, double cpu_seconds) {
+    std::cout << std::left << std::setw(10) << name << std::right << " wall " << std::setw(10)
+              << wall_seconds << " s, CPU " << std::setw(10) << cpu_seconds << " s";
+  };
+
+  std::cout << std::fixed << std::setprecision(3);
+
+  const char* const phase_names[] = { "parse", "sort", "write" };
+  for (auto i = 0u; i < std::size(phase_names); ++i) {
+    const auto& phase = stats.phases[i];
+    print_time(phase_names[i], phase.wall_seconds, phase.cpu_seconds);
+    std::cout << ", " << phase.hashes << " hashes, " << std::setprecision(0)
+              << phase.hashes_per_second << " hashes/s" << std::setprecision(3) << '\n';
+  }
+  print_time("total", stats.wall_seconds, stats.cpu_seconds);
+  std::cout << '\n';
+
+  std::cout << "input read:           " << stats.input_bytes_read / k_mib << " MiB\n"
+            << "intermediate written: " << stats.intermediate_bytes_written / k_mib << " MiB\n"
+            << "intermediate read:    " << stats.intermediate_bytes_read / k_mib << " MiB\n"
+            << "output written:       " << stats.output_bytes_written / k_mib << " MiB\n"
+            << "reader stalled:       " << stats.reader_stall_seconds << " s\n"
+            << "parser stalled:       " << stats.parser_stall_seconds << " s\n"
+            << "finalizing:           " << stats.finalize_seconds << " s\n";
+}
+
 okon_prepare_result handle_prepare(const parsed_args_t& args)
 {
   const auto found_prepare = args.find("--prepare");
@@ -93,8 +139,28 @@ okon_prepare_result handle_prepare(const parsed_args_t& args)
     }
   };
 
-  return okon_prepare(input_file_path.data(), working_directory_path.data(),
-                      output_file_directory.data(), progress, nullptr);
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.progress_callback = progress;
+
+  // A checkpoint takes a flush of the intermediate files, once per 1 GiB of the input is cheap.
+  if (args.find("--resumable") != std::cend(args)) {
+    options.checkpoint_interval = 1024ull * 1024ull * 1024ull;
+  }
+
+  okon_prepare_stats stats;
+  const auto with_stats = args.find("--stats") != std::cend(args);
+  if (with_stats) {
+    options.stats = &stats;
+  }
+
+  const auto result = okon_prepare_ex(input_file_path.data(), working_directory_path.data(),
+                                      output_file_directory.data(), &options);
+  if (with_stats && result == okon_prepare_result_success) {
+    print_prepare_stats(stats);
+  }
+
+  return result;
 }
 
 int handle_check(const parsed_args_t& args)
@@ -116,19 +182,140 @@ int handle_check(const parsed_args_t& args)
   return okon_exists_text(hash.data(), file_path.data());
 }
 
+std::optional<unsigned> parse_unsigned(std::string_view text)
+{
+  unsigned value{};
+  const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+  if (error != std::errc{} || end != text.data() + text.size()) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+int handle_serve(const parsed_args_t& args)
+{
+  const auto found_path = args.find("--path");
+  if (found_path == std::cend(args)) {
+    std::cerr << "expected --path argument";
+    return okon_exists_result ::okon_prepare_result_could_not_open_file;
+  }
+
+  lookup_server_options options;
+
+  const auto found_socket = args.find("--socket");
+  if (found_socket != std::cend(args)) {
+    options.socket_path = found_socket->second;
+  }
+
+  // Ports are 16-bit, a bigger one would be truncated to another port.
+  for (const auto& [name, value, max_value] :
+       { std::tuple{ "--port", &options.port, unsigned{ std::numeric_limits<uint16_t>::max() } },
+         std::tuple{ "--workers", &options.workers, std::numeric_limits<unsigned>::max() } }) {
+    const auto found = args.find(name);
+    if (found == std::cend(args)) {
+      continue;
+    }
+
+    const auto parsed = parse_unsigned(found->second);
+    if (!parsed || *parsed > max_value) {
+      std::cerr << "expected a number after: " << name << '\n';
+      return 2;
+    }
+    *value = *parsed;
+  }
+
+  okon_open_options open_options;
+  okon_open_options_init(&open_options);
+  open_options.resident = args.find("--resident") != std::cend(args) ? 1 : 0;
+
+  auto handle = okon_open_ex(found_path->second.data(), &open_options);
+  if (!handle) {
+    std::cerr << "could not open: " << found_path->second.data() << '\n';
+    return okon_exists_result ::okon_prepare_result_could_not_open_file;
+  }
+
+  const auto result = serve(handle, options);
+  okon_close(handle);
+  return result;
+}
+
+int handle_hashes_file(const parsed_args_t& args)
+{
+  const auto found_path = args.find("--path");
+  if (found_path == std::cend(args)) {
+    std::cerr << "expected --path argument";
+    return okon_exists_result ::okon_prepare_result_could_not_open_file;
+  }
+
+  auto report = hashes_report::bitmap;
+  const auto found_report = args.find("--report");
+  if (found_report != std::cend(args)) {
+    const auto parsed = parse_hashes_report(found_report->second);
+    if (!parsed) {
+      std::cerr << "unknown report: " << found_report->second.data() << '\n';
+      return 2;
+    }
+    report = *parsed;
+  }
+
+  const auto hashes_file_path = args.find("--hashes-file")->second;
+  const auto in_fd =
+    hashes_file_path == "-" ? STDIN_FILENO : ::open(hashes_file_path.data(), O_RDONLY);
+  if (in_fd < 0) {
+    std::cerr << "could not open: " << hashes_file_path.data() << '\n';
+    return okon_exists_result ::okon_prepare_result_could_not_open_file;
+  }
+
+  auto handle = okon_open(found_path->second.data());
+  if (!handle) {
+    std::cerr << "could not open: " << found_path->second.data() << '\n';
+    return okon_exists_result ::okon_prepare_result_could_not_open_file;
+  }
+
+  const auto summary = check_hashes(handle, in_fd, STDOUT_FILENO, report);
+  std::cerr << "found " << summary.found << " of " << summary.hashes << " hashes, "
+            << summary.lines - summary.hashes << " lines are not hashes\n";
+
+  okon_close(handle);
+  if (in_fd != STDIN_FILENO) {
+    ::close(in_fd);
+  }
+  return 0;
+}
+
 void print_help()
 {
   std::cout
     << "To prepare a downloaded database:\n"
        "okon-cli --prepare path/to/downloaded/file.txt --wd path/to/working_directory "
-       "--output path/to/prepared/file.okon\n"
+       "--output path/to/prepared/file.okon [--stats] [--resumable]\n"
+       "With --stats, time, CPU time and throughput of every phase, bytes read and written, and "
+       "time the input reading and the parsing waited for each other are written after "
+       "preparing.\n"
+       "With --resumable, progress is saved to the working directory, so if preparing fails, "
+       "running the same command again continues from where it was.\n"
        "In case of an error, exit value is set to the error value.\n\n"
        "To check whether a hash exists:\n"
        "okon-cli --path path/to/prepared/file.okon --hash "
        "0000000000000000000000000000000000000000\n"
        "If the hash is present `okon-cli` will write `1` to stdout and set exit code to 1.\n"
        "If the hash is NOT present `okon-cli` will write `0` to stdout and set exit code to 0.\n"
-       "In case of an error, exit value is set to the error value.";
+       "In case of an error, exit value is set to the error value.\n\n"
+       "To answer many hashes with the file kept open:\n"
+       "okon-cli --serve --path path/to/prepared/file.okon [--socket path/to/socket | --port "
+       "port] [--workers count] [--resident]\n"
+       "Hashes are read one per line, from the standard input or from connections to the UNIX "
+       "socket or to the TCP port on localhost. A line is answered for every line: `1` if the hash "
+       "is present, `0` if it's not, `error` if the line is not a hash.\n"
+       "With --resident, the file is loaded into memory backed by huge pages before serving, so "
+       "lookups never wait for the disk. The file has to fit in memory.\n\n"
+       "To check all hashes of a file, or of the standard input if it's `-`:\n"
+       "okon-cli --path path/to/prepared/file.okon --hashes-file path/to/hashes.txt [--report "
+       "bitmap|matching|counts]\n"
+       "Hashes are read one per line, optionally followed by `:` and anything. bitmap (the "
+       "default) writes a bit for every line, lowest bits first, set if the hash is present. "
+       "matching writes the lines of the present hashes, counts writes the present hashes with "
+       "their counts, as hash:count. The number of found hashes is written to stderr.";
 }
 
 int main(int argc, const char* argv[])
@@ -152,6 +339,14 @@ int main(int argc, const char* argv[])
     }
   }
 
+  if (parsed_args->find("--serve") != std::cend(*parsed_args)) {
+    return handle_serve(*parsed_args);
+  }
+
+  if (parsed_args->find("--hashes-file") != std::cend(*parsed_args)) {
+    return handle_hashes_file(*parsed_args);
+  }
+
   for (std::string_view argument : { "--prepare", "--wd", "--output" }) {
     if (parsed_args->find(argument) != std::cend(*parsed_args)) {
       return handle_prepare(*parsed_args);
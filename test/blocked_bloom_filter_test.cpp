@@ -0,0 +1,91 @@
+#include "blocked_bloom_filter.hpp"
+#include "memory_storage.hpp"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+namespace okon::test {
+namespace {
+std::vector<sha1_t> make_random_sha1s(std::size_t count, unsigned seed)
+{
+  std::mt19937 generator{ seed };
+  std::uniform_int_distribution<unsigned> byte_distribution{ 0u, 255u };
+
+  std::vector<sha1_t> sha1s(count);
+  for (auto& sha1 : sha1s) {
+    for (auto& byte : sha1) {
+      byte = static_cast<uint8_t>(byte_distribution(generator));
+    }
+  }
+  return sha1s;
+}
+
+memory_storage make_filter_storage(const std::vector<sha1_t>& keys, uint32_t bits_per_key)
+{
+  blocked_bloom_filter_builder builder{ keys.size(), bits_per_key, /*prepared_file_size=*/123u };
+  for (const auto& key : keys) {
+    builder.add(key);
+  }
+
+  memory_storage storage;
+  builder.write(storage);
+  return storage;
+}
+}
+
+TEST(BlockedBloomFilter, MayContain_AddedKeys_AreAlwaysReported)
+{
+  for (const auto keys_count : { 0u, 1u, 100u, 10000u }) {
+    const auto keys = make_random_sha1s(keys_count, keys_count);
+    const auto storage = make_filter_storage(keys, 8u);
+
+    const auto filter =
+      blocked_bloom_filter::from_memory(storage.m_storage.data(), storage.m_storage.size());
+    ASSERT_TRUE(filter.has_value());
+    EXPECT_EQ(filter->keys_count(), keys_count);
+    EXPECT_EQ(filter->prepared_file_size(), 123u);
+
+    for (const auto& key : keys) {
+      EXPECT_TRUE(filter->may_contain(key));
+    }
+  }
+}
+
+TEST(BlockedBloomFilter, MayContain_MissingKeys_FalsePositiveRateDependsOnBitsPerKey)
+{
+  const auto keys = make_random_sha1s(100000u, 1u);
+  const auto missing_keys = make_random_sha1s(100000u, 2u);
+
+  const std::pair<uint32_t, double> max_rates[] = { { 8u, 0.03 }, { 12u, 0.006 } };
+  for (const auto& [bits_per_key, max_rate] : max_rates) {
+    const auto storage = make_filter_storage(keys, bits_per_key);
+    const auto filter =
+      blocked_bloom_filter::from_memory(storage.m_storage.data(), storage.m_storage.size());
+    ASSERT_TRUE(filter.has_value());
+
+    auto false_positives = 0u;
+    for (const auto& key : missing_keys) {
+      false_positives += filter->may_contain(key) ? 1u : 0u;
+    }
+
+    const auto rate = static_cast<double>(false_positives) / missing_keys.size();
+    EXPECT_LT(rate, max_rate) << "bits per key " << bits_per_key;
+  }
+}
+
+TEST(BlockedBloomFilter, FromMemory_NotAFilter_ReturnsNullopt)
+{
+  const auto storage = make_filter_storage(make_random_sha1s(100u, 1u), 8u);
+
+  auto corrupted = storage.m_storage;
+  corrupted[4] = 0x01u;
+  EXPECT_FALSE(blocked_bloom_filter::from_memory(corrupted.data(), corrupted.size()));
+
+  EXPECT_FALSE(blocked_bloom_filter::from_memory(storage.m_storage.data(), 63u));
+  EXPECT_FALSE(blocked_bloom_filter::from_memory(storage.m_storage.data(),
+                                                 storage.m_storage.size() - 1u));
+  EXPECT_FALSE(blocked_bloom_filter::from_memory(nullptr, 0u));
+}
+}
@@ -0,0 +1,155 @@
+#include "btree_bulk_loader.hpp"
+#include "btree.hpp"
+#include "btree_keys_reader.hpp"
+#include "btree_sorted_keys_inserter.hpp"
+#include "memory_storage.hpp"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace okon::test {
+namespace {
+sha1_t make_sha1(unsigned value)
+{
+  sha1_t sha1{};
+  sha1[0] = static_cast<uint8_t>(value >> 8u);
+  sha1[1] = static_cast<uint8_t>(value);
+  return sha1;
+}
+
+// Even values only, so odd ones can be used as missing keys.
+memory_storage make_tree_storage(unsigned keys_count, btree_node::order_t order,
+                                 btree_format_version version)
+{
+  memory_storage storage;
+  btree_bulk_loader loader{ storage, order, keys_count, version };
+  for (auto i = 0u; i < keys_count; ++i) {
+    loader.insert_sorted(make_sha1(i * 2u));
+  }
+  loader.finalize_inserting();
+
+  return storage;
+}
+
+std::vector<sha1_t> read_all(const btree<memory_storage>& tree)
+{
+  std::vector<sha1_t> keys;
+  btree_keys_reader reader{ tree };
+  while (const auto key = reader.next()) {
+    keys.push_back(*key);
+  }
+  return keys;
+}
+}
+
+TEST(BtreeBulkLoader, Contains_FindsOnlyInsertedKeys)
+{
+  for (const auto version :
+       { btree_format_version::v1, btree_format_version::v2, btree_format_version::v3 }) {
+    for (const auto order : { 2u, 3u, 4u, 5u, 40u }) {
+      for (const auto keys_count : { 0u, 1u, 2u, 3u, 5u, 6u, 7u, 24u, 25u, 26u, 200u, 1000u }) {
+        auto storage = make_tree_storage(keys_count, order, version);
+        btree tree{ storage };
+
+        for (auto i = 0u; i < 2u * keys_count + 2u; ++i) {
+          EXPECT_EQ(tree.contains(make_sha1(i)), i % 2u == 0u && i < 2u * keys_count)
+            << "order " << order << ", keys count " << keys_count << ", key " << i;
+        }
+      }
+    }
+  }
+}
+
+TEST(BtreeBulkLoader, KeysReader_ReturnsAllKeysInOrder)
+{
+  for (const auto version :
+       { btree_format_version::v1, btree_format_version::v2, btree_format_version::v3 }) {
+    for (const auto order : { 2u, 3u, 40u }) {
+      for (const auto keys_count : { 0u, 1u, 40u, 41u, 200u, 1000u }) {
+        auto storage = make_tree_storage(keys_count, order, version);
+        btree tree{ storage };
+
+        std::vector<sha1_t> expected;
+        for (auto i = 0u; i < keys_count; ++i) {
+          expected.push_back(make_sha1(i * 2u));
+        }
+
+        EXPECT_EQ(read_all(tree), expected) << "order " << order << ", keys count " << keys_count;
+      }
+    }
+  }
+}
+
+TEST(BtreeBulkLoader, Contains_AlignedNodes_FindsOnlyInsertedKeys)
+{
+  constexpr auto keys_count{ 5000u };
+  constexpr auto node_alignment{ 4096u };
+
+  for (const auto version : { btree_format_version::v2, btree_format_version::v3 }) {
+    // One node takes a page, the other takes three.
+    for (const auto node_size : { node_alignment, 3u * node_alignment - 100u }) {
+      const auto order = btree_node_layout::max_order_for_size(version, node_size);
+      ASSERT_LE(btree_node_layout(version, order, /*is_leaf_layout=*/true).size(), node_size);
+
+      memory_storage storage;
+      btree_bulk_loader loader{ storage, order, keys_count, version, node_alignment };
+      for (auto i = 0u; i < keys_count; ++i) {
+        loader.insert_sorted(make_sha1(i * 2u));
+      }
+      loader.finalize_inserting();
+
+      EXPECT_EQ(storage.m_storage.size() % node_alignment, 0u) << "node size " << node_size;
+
+      btree tree{ storage };
+      for (auto i = 0u; i < 2u * keys_count + 2u; ++i) {
+        EXPECT_EQ(tree.contains(make_sha1(i)), i % 2u == 0u && i < 2u * keys_count)
+          << "node size " << node_size << ", key " << i;
+      }
+    }
+  }
+}
+
+TEST(BtreeBulkLoader, KeysReader_NodesOfManyWriteBuffers_ReturnsAllKeysInOrder)
+{
+  constexpr auto keys_count{ 50000u };
+  auto storage = make_tree_storage(keys_count, /*order=*/1024u, btree_format_version::v2);
+  btree tree{ storage };
+
+  const auto keys = read_all(tree);
+  ASSERT_EQ(keys.size(), keys_count);
+  for (auto i = 0u; i < keys_count; ++i) {
+    EXPECT_EQ(keys[i], make_sha1(i * 2u));
+  }
+}
+
+TEST(BtreeBulkLoader, CompactLeaves_FileIsSmallerThanWithFullLeaves)
+{
+  constexpr auto keys_count{ 5000u };
+  const auto full = make_tree_storage(keys_count, /*order=*/40u, btree_format_version::v2);
+  const auto compact = make_tree_storage(keys_count, /*order=*/40u, btree_format_version::v3);
+
+  const btree_node_layout full_layout{ btree_format_version::v2, 40u };
+  const btree_node_layout leaf_layout{ btree_format_version::v3, 40u, /*is_leaf_layout=*/true };
+  const auto leaves_count = (keys_count + 41u) / 41u;
+  EXPECT_EQ(full.m_storage.size() - compact.m_storage.size(),
+            leaves_count * (full_layout.size() - leaf_layout.size()));
+}
+
+TEST(BtreeBulkLoader, File_IsNotBiggerThanInsertedOne)
+{
+  for (const auto keys_count : { 1u, 100u, 1000u, 5000u }) {
+    const auto bulk_loaded = make_tree_storage(keys_count, /*order=*/5u, btree_format_version::v2);
+
+    memory_storage inserted;
+    btree_sorted_keys_inserter inserter{ inserted, /*order=*/5u, btree_format_version::v2 };
+    for (auto i = 0u; i < keys_count; ++i) {
+      inserter.insert_sorted(make_sha1(i * 2u));
+    }
+    inserter.finalize_inserting();
+
+    EXPECT_LE(bulk_loaded.m_storage.size(), inserted.m_storage.size())
+      << "keys count " << keys_count;
+  }
+}
+}
@@ -0,0 +1,102 @@
+#include "btree_keys_reader.hpp"
+#include "btree_sorted_keys_inserter.hpp"
+#include "memory_storage.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace okon::test {
+namespace {
+sha1_t make_sha1(unsigned value)
+{
+  sha1_t sha1{};
+  sha1[0] = static_cast<uint8_t>(value >> 8u);
+  sha1[1] = static_cast<uint8_t>(value);
+  return sha1;
+}
+
+std::vector<sha1_t> read_all(const btree<memory_storage>& tree)
+{
+  std::vector<sha1_t> keys;
+  btree_keys_reader reader{ tree };
+  while (const auto key = reader.next()) {
+    keys.push_back(*key);
+  }
+  return keys;
+}
+}
+
+TEST(BtreeKeysReader, Next_ReturnsAllKeysInOrder)
+{
+  for (const auto version : { btree_format_version::v1, btree_format_version::v2 }) {
+    for (const auto order : { 3u, 40u }) {
+      for (const auto keys_count : { 1u, 2u, 40u, 200u }) {
+        memory_storage storage;
+        std::vector<sha1_t> expected;
+
+        {
+          btree_sorted_keys_inserter inserter{ storage, order, version };
+          for (auto i = 0u; i < keys_count; ++i) {
+            expected.push_back(make_sha1(i * 3u));
+            inserter.insert_sorted(expected.back());
+          }
+          inserter.finalize_inserting();
+        }
+
+        btree tree{ storage };
+        EXPECT_EQ(read_all(tree), expected)
+          << "order " << order << ", keys count " << keys_count;
+      }
+    }
+  }
+}
+
+TEST(BtreeKeysReader, Next_EmptyTree_ReturnsNullopt)
+{
+  memory_storage storage;
+  {
+    btree_sorted_keys_inserter inserter{ storage, /*order=*/3u };
+    inserter.finalize_inserting();
+  }
+
+  btree tree{ storage };
+  btree_keys_reader reader{ tree };
+  EXPECT_EQ(reader.next(), std::nullopt);
+}
+
+TEST(BtreeKeysReader, NextFromFirst_ReturnsKeysNotLessThanFirst)
+{
+  for (const auto order : { 3u, 40u }) {
+    memory_storage storage;
+    std::vector<sha1_t> keys;
+
+    {
+      btree_sorted_keys_inserter inserter{ storage, order, btree_format_version::v2 };
+      for (auto i = 0u; i < 200u; ++i) {
+        keys.push_back(make_sha1(i * 3u));
+        inserter.insert_sorted(keys.back());
+      }
+      inserter.finalize_inserting();
+    }
+
+    btree tree{ storage };
+
+    // Present keys, missing keys between them, and keys before and after all of them.
+    for (auto value = 0u; value < 603u; ++value) {
+      const auto first = make_sha1(value);
+      const auto expected_begin = std::lower_bound(keys.cbegin(), keys.cend(), first);
+
+      btree_keys_reader reader{ tree, first };
+      std::vector<sha1_t> result;
+      while (const auto key = reader.next()) {
+        result.push_back(*key);
+      }
+
+      EXPECT_EQ(result, std::vector<sha1_t>(expected_begin, keys.cend()))
+        << "order " << order << ", first " << value;
+    }
+  }
+}
+}
@@ -0,0 +1,51 @@
+#include "btree_node_pool.hpp"
+
+#include <gmock/gmock.h>
+
+namespace okon::test {
+using ::testing::Eq;
+
+TEST(BtreeNodePool, Take_ReleasedNode_ReusesItsBuffers)
+{
+  btree_node_pool pool{ 4u };
+
+  auto node = pool.take(btree_node::k_unused_pointer);
+  const auto* keys = node.keys.data();
+  const auto* pointers = node.pointers.data();
+  pool.release(std::move(node));
+
+  const auto reused = pool.take(btree_node::k_unused_pointer);
+  EXPECT_THAT(reused.keys.data(), Eq(keys));
+  EXPECT_THAT(reused.pointers.data(), Eq(pointers));
+}
+
+TEST(BtreeNodePool, Take_ReleasedNode_IsClearedLikeNewNode)
+{
+  btree_node_pool pool{ 4u };
+
+  auto node = pool.take(btree_node::k_unused_pointer);
+  node.is_leaf = true;
+  node.this_pointer = 7u;
+  node.pointers[0] = 3u;
+  node.push_back(sha1_t{ 1u, 2u, 3u });
+  pool.release(std::move(node));
+
+  const auto reused = pool.take(/*parent_ptr=*/5u);
+  const btree_node expected{ 4u, 5u };
+  EXPECT_THAT(reused.is_leaf, Eq(expected.is_leaf));
+  EXPECT_THAT(reused.keys_count, Eq(expected.keys_count));
+  EXPECT_THAT(reused.pointers, Eq(expected.pointers));
+  EXPECT_THAT(reused.keys, Eq(expected.keys));
+  EXPECT_THAT(reused.parent_pointer, Eq(expected.parent_pointer));
+  EXPECT_THAT(reused.this_pointer, Eq(expected.this_pointer));
+}
+
+TEST(BtreeNodePool, TakeForOverwrite_EmptyPool_ReturnsNodeOfOrder)
+{
+  btree_node_pool pool{ 4u };
+
+  const auto node = pool.take_for_overwrite();
+  EXPECT_THAT(node.order(), Eq(4u));
+  EXPECT_THAT(node.pointers.size(), Eq(5u));
+}
+}
@@ -0,0 +1,69 @@
+#include "btree_node_view.hpp"
+
+#include "btree_tests_utils.hpp"
+
+#include <gmock/gmock.h>
+
+namespace okon::test {
+using ::testing::Eq;
+
+namespace {
+std::vector<uint8_t> node_storage()
+{
+  const std::vector<btree_node> nodes = { make_node(
+    /*is_leaf=*/false, /*keys_count=*/2u, { 5u, 6u, 7u },
+    { "1000000000000000000000000000000000000000", "3000000000000000000000000000000000000000" },
+    btree_node::k_unused_pointer) };
+
+  return to_storage(k_test_order_value, 0u, nodes);
+}
+}
+
+TEST(BtreeNodeView, ReadsNodeFields)
+{
+  const auto storage = node_storage();
+  const btree_node_layout layout{ btree_format_version::v1, k_test_order_value };
+  const btree_node_view view{ &storage[k_file_metadata_size], layout };
+
+  EXPECT_FALSE(view.is_leaf());
+  EXPECT_THAT(view.keys_count(), Eq(2u));
+  EXPECT_THAT(view.pointer(0u), Eq(5u));
+  EXPECT_THAT(view.pointer(1u), Eq(6u));
+  EXPECT_THAT(view.pointer(2u), Eq(7u));
+  EXPECT_THAT(view.key(1u),
+              Eq(details::string_sha1_to_binary("3000000000000000000000000000000000000000")));
+}
+
+TEST(BtreeNodeView, PlaceFor_ReturnsIndexOfFirstNotLessKey)
+{
+  const auto storage = node_storage();
+  const btree_node_layout layout{ btree_format_version::v1, k_test_order_value };
+  const btree_node_view view{ &storage[k_file_metadata_size], layout };
+
+  const auto place_for = [&view](const char* text) {
+    return view.place_for(details::string_sha1_to_binary(text));
+  };
+
+  EXPECT_THAT(place_for("0000000000000000000000000000000000000000"), Eq(0u));
+  EXPECT_THAT(place_for("1000000000000000000000000000000000000000"), Eq(0u));
+  EXPECT_THAT(place_for("2000000000000000000000000000000000000000"), Eq(1u));
+  EXPECT_THAT(place_for("3000000000000000000000000000000000000000"), Eq(1u));
+  EXPECT_THAT(place_for("4000000000000000000000000000000000000000"), Eq(2u));
+}
+
+TEST(BtreeNodeView, Contains_OnlyKeysInNode)
+{
+  const auto storage = node_storage();
+  const btree_node_layout layout{ btree_format_version::v1, k_test_order_value };
+  const btree_node_view view{ &storage[k_file_metadata_size], layout };
+
+  const auto contains = [&view](const char* text) {
+    return view.contains(details::string_sha1_to_binary(text));
+  };
+
+  EXPECT_TRUE(contains("1000000000000000000000000000000000000000"));
+  EXPECT_TRUE(contains("3000000000000000000000000000000000000000"));
+  EXPECT_FALSE(contains("2000000000000000000000000000000000000000"));
+  EXPECT_FALSE(contains("4000000000000000000000000000000000000000"));
+}
+}
@@ -0,0 +1,120 @@
+#include "btree_packing_loader.hpp"
+#include "btree.hpp"
+#include "btree_bulk_loader.hpp"
+#include "btree_keys_reader.hpp"
+#include "memory_storage.hpp"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace okon::test {
+namespace {
+sha1_t make_sha1(unsigned value)
+{
+  sha1_t sha1{};
+  sha1[0] = static_cast<uint8_t>(value >> 16u);
+  sha1[1] = static_cast<uint8_t>(value >> 8u);
+  sha1[2] = static_cast<uint8_t>(value);
+
+  // Keys differ in the last bytes too, so suffixes are not all zeros.
+  sha1[19] = static_cast<uint8_t>(value * 7u);
+  return sha1;
+}
+
+// Even values only, so odd ones can be used as missing keys.
+memory_storage make_tree_storage(unsigned keys_count, btree_node::order_t node_size)
+{
+  memory_storage storage;
+  btree_packing_loader loader{ storage, node_size };
+  for (auto i = 0u; i < keys_count; ++i) {
+    loader.insert_sorted(make_sha1(i * 2u));
+  }
+  loader.finalize_inserting();
+
+  return storage;
+}
+}
+
+TEST(BtreePackingLoader, Contains_FindsOnlyInsertedKeys)
+{
+  // Small nodes make trees of a few levels.
+  for (const auto node_size : { 64u, 256u, 1024u, 16u * 1024u }) {
+    for (const auto keys_count : { 0u, 1u, 2u, 3u, 10u, 11u, 12u, 200u, 1000u, 10000u }) {
+      auto storage = make_tree_storage(keys_count, node_size);
+      btree tree{ storage };
+
+      for (auto i = 0u; i < 2u * keys_count + 2u; ++i) {
+        EXPECT_EQ(tree.contains(make_sha1(i)), i % 2u == 0u && i < 2u * keys_count)
+          << "node size " << node_size << ", keys count " << keys_count << ", key " << i;
+      }
+    }
+  }
+}
+
+TEST(BtreePackingLoader, KeysReader_ReadsAllKeysInOrder)
+{
+  for (const auto node_size : { 64u, 256u, 16u * 1024u }) {
+    constexpr auto keys_count{ 5000u };
+    auto storage = make_tree_storage(keys_count, node_size);
+    btree tree{ storage };
+
+    std::vector<sha1_t> keys;
+    btree_keys_reader reader{ tree };
+    while (const auto key = reader.next()) {
+      keys.push_back(*key);
+    }
+
+    ASSERT_EQ(keys.size(), keys_count) << "node size " << node_size;
+    for (auto i = 0u; i < keys_count; ++i) {
+      EXPECT_EQ(keys[i], make_sha1(i * 2u)) << "node size " << node_size << ", key " << i;
+    }
+  }
+}
+
+TEST(BtreePackingLoader, Contains_KeysWithLongCommonPrefix_AreFound)
+{
+  // All the keys share 17 bytes, so the nodes store 3 bytes of every key.
+  memory_storage storage;
+  btree_packing_loader loader{ storage, /*node_size=*/256u };
+  for (auto i = 0u; i < 3000u; ++i) {
+    sha1_t sha1{};
+    sha1.fill(0xabu);
+    sha1[17] = static_cast<uint8_t>(i >> 8u);
+    sha1[18] = static_cast<uint8_t>(i);
+    sha1[19] = 0u;
+    loader.insert_sorted(sha1);
+  }
+  loader.finalize_inserting();
+
+  btree tree{ storage };
+  for (auto i = 0u; i < 3000u; ++i) {
+    sha1_t sha1{};
+    sha1.fill(0xabu);
+    sha1[17] = static_cast<uint8_t>(i >> 8u);
+    sha1[18] = static_cast<uint8_t>(i);
+    sha1[19] = 0u;
+    EXPECT_TRUE(tree.contains(sha1)) << "key " << i;
+
+    sha1[19] = 1u;
+    EXPECT_FALSE(tree.contains(sha1)) << "key " << i;
+  }
+}
+
+TEST(BtreePackingLoader, Size_IsSmallerThanBulkLoadedV2)
+{
+  constexpr auto keys_count{ 100000u };
+  const auto packed =
+    make_tree_storage(keys_count, btree_packing_loader<memory_storage>::k_default_node_size);
+
+  memory_storage bulk_loaded;
+  btree_bulk_loader bulk_loader{ bulk_loaded, /*order=*/1024u, keys_count,
+                                 btree_format_version::v2 };
+  for (auto i = 0u; i < keys_count; ++i) {
+    bulk_loader.insert_sorted(make_sha1(i * 2u));
+  }
+  bulk_loader.finalize_inserting();
+
+  EXPECT_LT(packed.m_storage.size(), bulk_loaded.m_storage.size() * 4u / 5u);
+}
+}
@@ -0,0 +1,62 @@
+#include "btree_spooling_bulk_loader.hpp"
+#include "btree.hpp"
+#include "btree_bulk_loader.hpp"
+#include "memory_storage.hpp"
+
+#include <gtest/gtest.h>
+
+namespace okon::test {
+namespace {
+sha1_t make_sha1(unsigned value)
+{
+  sha1_t sha1{};
+  sha1[0] = static_cast<uint8_t>(value >> 16u);
+  sha1[1] = static_cast<uint8_t>(value >> 8u);
+  sha1[2] = static_cast<uint8_t>(value);
+  return sha1;
+}
+
+template <typename Loader>
+void insert_keys(Loader& loader, unsigned keys_count)
+{
+  for (auto i = 0u; i < keys_count; ++i) {
+    loader.insert_sorted(make_sha1(i * 2u));
+  }
+  loader.finalize_inserting();
+}
+}
+
+TEST(BtreeSpoolingBulkLoader, WritesSameTreeAsBulkLoader)
+{
+  for (const auto version : { btree_format_version::v2, btree_format_version::v3 }) {
+    // More keys than fit in the keys buffer.
+    for (const auto keys_count : { 0u, 1u, 1000u, 100000u }) {
+      memory_storage bulk_loaded;
+      btree_bulk_loader bulk_loader{ bulk_loaded, /*order=*/40u, keys_count, version };
+      insert_keys(bulk_loader, keys_count);
+
+      memory_storage spooled;
+      memory_storage spool;
+      btree_spooling_bulk_loader spooling_loader{ spooled, spool, /*order=*/40u, version };
+      insert_keys(spooling_loader, keys_count);
+
+      EXPECT_EQ(spooled.m_storage, bulk_loaded.m_storage) << "keys count " << keys_count;
+    }
+  }
+}
+
+TEST(BtreeSpoolingBulkLoader, Contains_FindsOnlyInsertedKeys)
+{
+  constexpr auto keys_count{ 3000u };
+
+  memory_storage storage;
+  memory_storage spool;
+  btree_spooling_bulk_loader loader{ storage, spool, /*order=*/40u, btree_format_version::v3 };
+  insert_keys(loader, keys_count);
+
+  btree tree{ storage };
+  for (auto i = 0u; i < 2u * keys_count + 2u; ++i) {
+    EXPECT_EQ(tree.contains(make_sha1(i)), i % 2u == 0u && i < 2u * keys_count) << "key " << i;
+  }
+}
+}
@@ -1,4 +1,6 @@
 #include "btree.hpp"
+#include "btree_bulk_loader.hpp"
+#include "btree_sorted_keys_inserter.hpp"
 #include "btree_tests_utils.hpp"
 #include "memory_storage.hpp"
 
@@ -181,4 +183,93 @@ TEST(Btree, Contains_KeyInNonLeafChildOfRoot_ReturnsTrue)
     tree.contains(details::string_sha1_to_binary("E000000000000000000000000000000000000000"));
   EXPECT_TRUE(result);
 }
+
+namespace {
+sha1_t make_sha1(unsigned value)
+{
+  sha1_t sha1{};
+  sha1[0] = static_cast<uint8_t>(value >> 8u);
+  sha1[1] = static_cast<uint8_t>(value);
+  return sha1;
+}
+
+memory_storage make_tree_storage(unsigned keys_count, btree_node::order_t order,
+                                 btree_format_version version = btree_format_version::v1)
+{
+  memory_storage storage;
+  btree_sorted_keys_inserter inserter{ storage, order, version };
+
+  // Even values only, so odd ones can be used as missing keys.
+  for (auto i = 0u; i < keys_count; ++i) {
+    inserter.insert_sorted(make_sha1(i * 2u));
+  }
+  inserter.finalize_inserting();
+
+  return storage;
+}
+}
+
+TEST(Btree, ContainsBatch_MatchesContains)
+{
+  auto storage = make_tree_storage(/*keys_count=*/200u, /*order=*/3u);
+  btree tree{ storage };
+
+  // Unsorted queries with duplicates.
+  std::vector<sha1_t> queries;
+  for (auto i = 0u; i < 450u; ++i) {
+    queries.push_back(make_sha1((i * 7919u) % 450u));
+  }
+  queries.push_back(queries.front());
+
+  std::vector<uint8_t> results(queries.size(), 0xFFu);
+  tree.contains_batch(queries.data(), queries.size(), results.data());
+
+  for (auto i = 0u; i < queries.size(); ++i) {
+    EXPECT_EQ(results[i], tree.contains(queries[i]) ? 1u : 0u) << "query " << i;
+  }
+}
+
+TEST(Btree, ContainsBatch_Empty_DoesNothing)
+{
+  auto storage = make_tree_storage(/*keys_count=*/10u, /*order=*/3u);
+  btree tree{ storage };
+
+  tree.contains_batch(nullptr, 0u, nullptr);
+}
+
+TEST(Btree, Contains_FormatV2_FindsOnlyInsertedKeys)
+{
+  for (const auto order : { 3u, 40u }) {
+    auto storage = make_tree_storage(/*keys_count=*/200u, order, btree_format_version::v2);
+    btree tree{ storage };
+
+    for (auto i = 0u; i < 400u; ++i) {
+      EXPECT_EQ(tree.contains(make_sha1(i)), i % 2u == 0u) << "order " << order << ", key " << i;
+    }
+  }
+}
+
+TEST(Btree, Contains_FixedOrders_FindsOnlyInsertedKeys)
+{
+  // Lookups of these orders are specialized for the order, see btree_fixed_order_node.
+  constexpr auto keys_count{ 20000u };
+  for (const auto version : { btree_format_version::v2, btree_format_version::v3 }) {
+    for (const auto order : { 64u, 170u, 204u, 256u, 1024u }) {
+      memory_storage storage;
+      {
+        btree_bulk_loader loader{ storage, order, keys_count, version };
+        for (auto i = 0u; i < keys_count; ++i) {
+          loader.insert_sorted(make_sha1(i * 2u));
+        }
+        loader.finalize_inserting();
+      }
+      btree tree{ storage };
+
+      for (auto i = 0u; i < 2u * keys_count + 2u; ++i) {
+        ASSERT_EQ(tree.contains(make_sha1(i)), i % 2u == 0u && i < 2u * keys_count)
+          << "version " << static_cast<unsigned>(version) << ", order " << order << ", key " << i;
+      }
+    }
+  }
+}
 }
@@ -0,0 +1,139 @@
+#include "direct_input_file.hpp"
+
+#include <gmock/gmock.h>
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace okon::test {
+using ::testing::ContainerEq;
+using ::testing::Eq;
+using ::testing::IsEmpty;
+
+namespace {
+constexpr auto k_block_size{ 4096u };
+
+class DirectInputFile : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    const auto* test_info = ::testing::UnitTest::GetInstance()->current_test_info();
+    m_path = std::filesystem::temp_directory_path() /
+             (std::string{ "okon_direct_input_file_test_" } + test_info->name());
+  }
+
+  void TearDown() override
+  {
+    std::filesystem::remove(m_path);
+  }
+
+  std::vector<uint8_t> write_file(std::size_t size)
+  {
+    std::mt19937 generator{ static_cast<unsigned>(size) };
+    std::uniform_int_distribution<unsigned> byte_distribution{ 0u, 255u };
+
+    std::vector<uint8_t> content(size);
+    for (auto& byte : content) {
+      byte = static_cast<uint8_t>(byte_distribution(generator));
+    }
+
+    std::ofstream file{ m_path, std::ios::binary };
+    file.write(reinterpret_cast<const char*>(content.data()), content.size());
+    return content;
+  }
+
+  // Reads the whole file in reads of increasing sizes, so they are not aligned to the blocks.
+  std::vector<uint8_t> read_file()
+  {
+    direct_input_file file{ m_path.string(), k_block_size, /*blocks_in_flight=*/3u };
+    EXPECT_TRUE(file.is_open());
+
+    std::vector<uint8_t> content;
+    for (auto read_size = 1u;; read_size = read_size * 2u + 1u) {
+      std::vector<uint8_t> buffer(read_size);
+      const auto size = file.read(buffer.data(), buffer.size());
+      content.insert(content.end(), buffer.begin(), std::next(buffer.begin(), size));
+
+      if (size < read_size) {
+        EXPECT_THAT(file.read(buffer.data(), buffer.size()), Eq(0u));
+        return content;
+      }
+    }
+  }
+
+  std::filesystem::path m_path;
+};
+}
+
+TEST_F(DirectInputFile, NotExistingFile_IsNotOpen)
+{
+  direct_input_file file{ m_path.string() };
+  EXPECT_FALSE(file.is_open());
+}
+
+TEST_F(DirectInputFile, EmptyFile_ReadsNothing)
+{
+  write_file(0u);
+  EXPECT_THAT(read_file(), IsEmpty());
+}
+
+TEST_F(DirectInputFile, FileOfWholeBlocks_ReadsWholeFile)
+{
+  const auto content = write_file(10u * k_block_size);
+  EXPECT_THAT(read_file(), ContainerEq(content));
+}
+
+TEST_F(DirectInputFile, FileWithPartialLastBlock_ReadsWholeFile)
+{
+  const auto content = write_file(10u * k_block_size + 123u);
+  EXPECT_THAT(read_file(), ContainerEq(content));
+}
+
+TEST_F(DirectInputFile, DestroyedBeforeEndOfFile_DoesntWaitForWholeFile)
+{
+  write_file(100u * k_block_size);
+
+  direct_input_file file{ m_path.string(), k_block_size, /*blocks_in_flight=*/3u };
+  std::vector<uint8_t> buffer(10u);
+  EXPECT_THAT(file.read(buffer.data(), buffer.size()), Eq(buffer.size()));
+}
+
+TEST_F(DirectInputFile, Skip_NotAlignedSizes_ReadsRestOfFile)
+{
+  const auto content = write_file(10u * k_block_size + 123u);
+
+  direct_input_file file{ m_path.string(), k_block_size, /*blocks_in_flight=*/3u };
+  std::vector<uint8_t> buffer(100u);
+  ASSERT_THAT(file.read(buffer.data(), buffer.size()), Eq(buffer.size()));
+
+  // Skips to the middle of a block that isn't in flight, then to a block that is.
+  EXPECT_THAT(file.skip(5u * k_block_size + 7u), Eq(5u * k_block_size + 7u));
+  ASSERT_THAT(file.read(buffer.data(), buffer.size()), Eq(buffer.size()));
+  const auto first_offset = 100u + 5u * k_block_size + 7u;
+  EXPECT_THAT(buffer, ContainerEq(std::vector<uint8_t>(
+                        std::next(content.begin(), first_offset),
+                        std::next(content.begin(), first_offset + buffer.size()))));
+
+  EXPECT_THAT(file.skip(k_block_size), Eq(k_block_size));
+  std::vector<uint8_t> rest(content.size());
+  const auto rest_offset = first_offset + buffer.size() + k_block_size;
+  rest.resize(file.read(rest.data(), rest.size()));
+  EXPECT_THAT(rest, ContainerEq(std::vector<uint8_t>(std::next(content.begin(), rest_offset),
+                                                     content.end())));
+}
+
+TEST_F(DirectInputFile, Skip_PastEndOfFile_SkipsToEnd)
+{
+  const auto content = write_file(3u * k_block_size + 5u);
+
+  direct_input_file file{ m_path.string(), k_block_size, /*blocks_in_flight=*/2u };
+  EXPECT_THAT(file.skip(10u * k_block_size), Eq(content.size()));
+
+  std::vector<uint8_t> buffer(10u);
+  EXPECT_THAT(file.read(buffer.data(), buffer.size()), Eq(0u));
+}
+}
@@ -0,0 +1,162 @@
+#include "flat_sorted_file.hpp"
+#include "flat_sorted_file_writer.hpp"
+#include "memory_storage.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <numeric>
+
+namespace okon::test {
+namespace {
+// Spreads consecutive values over the whole keys space, like real SHA-1 values.
+sha1_t make_uniform_sha1(unsigned value, uint8_t last_byte = 0x00u)
+{
+  const auto spread = static_cast<uint32_t>(value * 2654435761u);
+
+  sha1_t sha1{};
+  sha1[0] = static_cast<uint8_t>(spread >> 24u);
+  sha1[1] = static_cast<uint8_t>(spread >> 16u);
+  sha1[2] = static_cast<uint8_t>(spread >> 8u);
+  sha1[3] = static_cast<uint8_t>(spread);
+  sha1[19] = last_byte;
+  return sha1;
+}
+
+memory_storage make_flat_file_storage(std::vector<sha1_t> keys, uint32_t directory_bits)
+{
+  std::sort(keys.begin(), keys.end());
+
+  memory_storage storage;
+  flat_sorted_file_writer writer{ storage, directory_bits };
+  for (const auto& key : keys) {
+    writer.insert_sorted(key);
+  }
+  writer.finalize_inserting();
+
+  return storage;
+}
+}
+
+TEST(FlatSortedFile, Contains_FindsOnlyInsertedKeys)
+{
+  for (const auto directory_bits : { 0u, 4u, 16u }) {
+    for (const auto keys_count : { 0u, 1u, 33u, 5000u }) {
+      std::vector<sha1_t> keys;
+      for (auto i = 0u; i < keys_count; ++i) {
+        keys.push_back(make_uniform_sha1(i));
+      }
+
+      auto storage = make_flat_file_storage(keys, directory_bits);
+      flat_sorted_file file{ storage };
+      ASSERT_EQ(file.layout().keys_count(), keys_count);
+
+      for (auto i = 0u; i < keys_count + 10u; ++i) {
+        EXPECT_EQ(file.contains(make_uniform_sha1(i)), i < keys_count)
+          << "directory bits " << directory_bits << ", keys count " << keys_count << ", key "
+          << i;
+        EXPECT_FALSE(file.contains(make_uniform_sha1(i, 0x01u)));
+      }
+    }
+  }
+}
+
+TEST(FlatSortedFile, Contains_KeysWithEqualPrefixes_FindsOnlyInsertedKeys)
+{
+  std::vector<sha1_t> keys;
+  for (auto i = 0u; i < 100u; ++i) {
+    keys.push_back(make_uniform_sha1(7u, static_cast<uint8_t>(i * 2u)));
+  }
+
+  auto storage = make_flat_file_storage(keys, /*directory_bits=*/4u);
+  flat_sorted_file file{ storage };
+
+  for (auto i = 0u; i < 200u; ++i) {
+    EXPECT_EQ(file.contains(make_uniform_sha1(7u, static_cast<uint8_t>(i))), i % 2u == 0u)
+      << "key " << i;
+  }
+}
+
+TEST(FlatSortedFile, ContainsSortedBatch_MatchesContains)
+{
+  std::vector<sha1_t> keys;
+  for (auto i = 0u; i < 1000u; ++i) {
+    keys.push_back(make_uniform_sha1(i * 2u));
+  }
+
+  auto storage = make_flat_file_storage(keys, /*directory_bits=*/8u);
+  flat_sorted_file file{ storage };
+
+  std::vector<sha1_t> queries;
+  for (auto i = 0u; i < 2000u; ++i) {
+    queries.push_back(make_uniform_sha1(i));
+  }
+  std::sort(queries.begin(), queries.end());
+
+  std::vector<std::size_t> sorted_queries(queries.size());
+  std::iota(sorted_queries.begin(), sorted_queries.end(), 0u);
+
+  std::vector<uint8_t> results(queries.size(), 0xFFu);
+  file.contains_sorted_batch(queries.data(), sorted_queries.data(), sorted_queries.size(),
+                             results.data());
+
+  for (auto i = 0u; i < queries.size(); ++i) {
+    EXPECT_EQ(results[i], file.contains(queries[i]) ? 1u : 0u) << "query " << i;
+  }
+}
+
+TEST(FlatSortedFile, LowerBound_ReturnsIndexOfFirstKeyNotLessThanSearched)
+{
+  std::vector<sha1_t> keys;
+  for (auto i = 0u; i < 5000u; ++i) {
+    keys.push_back(make_uniform_sha1(i, 0x10u));
+  }
+  std::sort(keys.begin(), keys.end());
+
+  auto storage = make_flat_file_storage(keys, /*directory_bits=*/8u);
+  flat_sorted_file file{ storage };
+
+  for (auto i = 0u; i < 6000u; ++i) {
+    for (const auto last_byte : { 0x00u, 0x10u, 0x20u }) {
+      const auto sha1 = make_uniform_sha1(i, static_cast<uint8_t>(last_byte));
+      const auto expected = std::lower_bound(keys.cbegin(), keys.cend(), sha1) - keys.cbegin();
+      EXPECT_EQ(file.lower_bound(sha1), static_cast<uint64_t>(expected)) << "key " << i;
+    }
+  }
+}
+
+TEST(FlatSortedFile, Count_WithCounts_ReturnsCountsOfKeys)
+{
+  std::vector<sha1_t> keys;
+  for (auto i = 0u; i < 5000u; ++i) {
+    keys.push_back(make_uniform_sha1(i));
+  }
+  std::sort(keys.begin(), keys.end());
+
+  memory_storage storage;
+  memory_storage counts_storage;
+  flat_sorted_file_writer writer{ storage, 4u, &counts_storage };
+  for (auto i = 0u; i < keys.size(); ++i) {
+    writer.insert_sorted(keys[i], i * 3u);
+  }
+  writer.finalize_inserting();
+
+  flat_sorted_file file{ storage };
+  ASSERT_TRUE(file.layout().has_counts());
+
+  for (auto i = 0u; i < keys.size(); ++i) {
+    EXPECT_EQ(file.count(keys[i]), i * 3u) << "key " << i;
+  }
+  EXPECT_EQ(file.count(make_uniform_sha1(1u, 0x01u)), 0u);
+}
+
+TEST(FlatSortedFile, Count_WithoutCounts_ReturnsOneForInsertedKeys)
+{
+  auto storage = make_flat_file_storage({ make_uniform_sha1(1u), make_uniform_sha1(2u) }, 4u);
+  flat_sorted_file file{ storage };
+  ASSERT_FALSE(file.layout().has_counts());
+
+  EXPECT_EQ(file.count(make_uniform_sha1(2u)), 1u);
+  EXPECT_EQ(file.count(make_uniform_sha1(3u)), 0u);
+}
+}
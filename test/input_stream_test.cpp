@@ -0,0 +1,252 @@
+#include "input_stream.hpp"
+
+#ifdef OKON_WITH_ZLIB
+#  include <zlib.h>
+#endif
+
+#ifdef OKON_WITH_LZMA
+#  include <lzma.h>
+#endif
+
+#include <gmock/gmock.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+namespace okon::test {
+using ::testing::Eq;
+
+namespace {
+class InputStream : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    const auto* test_info = ::testing::UnitTest::GetInstance()->current_test_info();
+    m_wd = std::filesystem::temp_directory_path() / "okon_input_stream_test" / test_info->name();
+    std::filesystem::remove_all(m_wd);
+    std::filesystem::create_directories(m_wd);
+
+    for (auto i = 0u; i < 20000u; ++i) {
+      m_text += std::to_string(i) + '\n';
+    }
+  }
+
+  void TearDown() override
+  {
+    std::filesystem::remove_all(m_wd);
+  }
+
+  std::string write_file(const std::string& name, const std::string& content)
+  {
+    const auto path = (m_wd / name).string();
+    std::ofstream file{ path, std::ios::binary };
+    file << content;
+    return path;
+  }
+
+  // Reads whole stream in parts of various sizes.
+  static std::string read_all(input_stream& stream)
+  {
+    std::string result;
+    for (auto read_size = 1u;; read_size = read_size * 3u + 1u) {
+      std::string part(read_size, '\0');
+      const auto size = stream.read(part.data(), part.size());
+      result.append(part, 0u, size);
+
+      if (size < read_size) {
+        return result;
+      }
+    }
+  }
+
+  std::filesystem::path m_wd;
+  std::string m_text;
+};
+
+#ifdef OKON_WITH_ZLIB
+std::string gzip(const std::string& text)
+{
+  z_stream stream{};
+  // 16 added to the window bits selects gzip header.
+  deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+
+  std::string result(deflateBound(&stream, text.size()), '\0');
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(text.data()));
+  stream.avail_in = text.size();
+  stream.next_out = reinterpret_cast<Bytef*>(result.data());
+  stream.avail_out = result.size();
+  deflate(&stream, Z_FINISH);
+
+  result.resize(stream.total_out);
+  deflateEnd(&stream);
+  return result;
+}
+#endif
+
+#ifdef OKON_WITH_LZMA
+std::string xz(const std::string& text)
+{
+  std::string result(lzma_stream_buffer_bound(text.size()), '\0');
+  std::size_t result_size{ 0u };
+  lzma_easy_buffer_encode(6u, LZMA_CHECK_CRC64, nullptr,
+                          reinterpret_cast<const uint8_t*>(text.data()), text.size(),
+                          reinterpret_cast<uint8_t*>(result.data()), &result_size, result.size());
+  result.resize(result_size);
+  return result;
+}
+#endif
+}
+
+TEST_F(InputStream, NotExistingFile_IsNotOpen)
+{
+  const auto stream =
+    open_input_stream((m_wd / "not_existing").string(), input_compression::detect);
+  EXPECT_FALSE(stream->is_open());
+}
+
+TEST_F(InputStream, PlainFile_ReadsText)
+{
+  const auto path = write_file("input.txt", m_text);
+  const auto stream = open_input_stream(path, input_compression::detect);
+  ASSERT_TRUE(stream->is_open());
+  EXPECT_THAT(read_all(*stream), Eq(m_text));
+  EXPECT_FALSE(stream->has_error());
+}
+
+TEST_F(InputStream, Directory_HasError)
+{
+  // A directory opens, but can't be read.
+  const auto stream = open_input_stream(m_wd.string(), input_compression::none);
+  ASSERT_TRUE(stream->is_open());
+  EXPECT_THAT(read_all(*stream), Eq(""));
+  EXPECT_TRUE(stream->has_error());
+}
+
+TEST_F(InputStream, PlainFile_Skip_ReadsRestOfText)
+{
+  const auto path = write_file("input.txt", m_text);
+  const auto stream = open_input_stream(path, input_compression::detect);
+  ASSERT_TRUE(stream->is_open());
+
+  EXPECT_THAT(stream->skip(1000u), Eq(1000u));
+  EXPECT_THAT(read_all(*stream), Eq(m_text.substr(1000u)));
+}
+
+TEST_F(InputStream, Pipe_ReadsText)
+{
+  int fds[2];
+  ASSERT_THAT(::pipe(fds), Eq(0));
+
+  // Small writes, so the stream gets the text in many reads of the pipe.
+  std::thread writer{ [this, write_fd = fds[1]] {
+    for (std::size_t i = 0u; i < m_text.size(); i += 1000u) {
+      const auto size = std::min<std::size_t>(1000u, m_text.size() - i);
+      static_cast<void>(::write(write_fd, m_text.data() + i, size));
+    }
+    ::close(write_fd);
+  } };
+
+  const auto stream =
+    open_input_stream("/dev/fd/" + std::to_string(fds[0]), input_compression::detect);
+  ASSERT_TRUE(stream->is_open());
+  EXPECT_THAT(read_all(*stream), Eq(m_text));
+
+  writer.join();
+  ::close(fds[0]);
+}
+
+TEST_F(InputStream, DetectCompression_UsesExtension)
+{
+  EXPECT_THAT(resolve_input_compression("a.gz", input_compression::detect),
+              Eq(input_compression::gzip));
+  EXPECT_THAT(resolve_input_compression("a.xz", input_compression::detect),
+              Eq(input_compression::xz));
+  EXPECT_THAT(resolve_input_compression("a.txt", input_compression::detect),
+              Eq(input_compression::none));
+  EXPECT_THAT(resolve_input_compression("-", input_compression::detect),
+              Eq(input_compression::none));
+  EXPECT_THAT(resolve_input_compression("a.gz", input_compression::none),
+              Eq(input_compression::none));
+}
+
+#ifdef OKON_WITH_ZLIB
+TEST_F(InputStream, GzipFile_ReadsDecompressedText)
+{
+  const auto path = write_file("input.gz", gzip(m_text));
+  const auto stream = open_input_stream(path, input_compression::detect);
+  ASSERT_TRUE(stream->is_open());
+  EXPECT_THAT(read_all(*stream), Eq(m_text));
+  EXPECT_FALSE(stream->has_error());
+}
+
+TEST_F(InputStream, GzipFile_Skip_ReadsRestOfDecompressedText)
+{
+  const auto path = write_file("input.txt.gz", gzip(m_text));
+  const auto stream = open_input_stream(path, input_compression::detect);
+
+  // Skipped bytes are of the decompressed text.
+  EXPECT_THAT(stream->skip(m_text.size() - 10u), Eq(m_text.size() - 10u));
+  EXPECT_THAT(read_all(*stream), Eq(m_text.substr(m_text.size() - 10u)));
+  EXPECT_THAT(stream->skip(100u), Eq(0u));
+}
+
+TEST_F(InputStream, ConcatenatedGzipMembers_ReadsAllOfThem)
+{
+  const auto path = write_file("input", gzip(m_text) + gzip("end\n"));
+  const auto stream = open_input_stream(path, input_compression::gzip);
+  EXPECT_THAT(read_all(*stream), Eq(m_text + "end\n"));
+}
+
+TEST_F(InputStream, TruncatedGzip_ReadsTextDecompressedSoFar)
+{
+  const auto compressed = gzip(m_text);
+  const auto path = write_file("input.gz", compressed.substr(0u, compressed.size() / 2u));
+  const auto stream = open_input_stream(path, input_compression::detect);
+
+  const auto text = read_all(*stream);
+  EXPECT_THAT(text, Eq(m_text.substr(0u, text.size())));
+  EXPECT_TRUE(stream->has_error());
+}
+
+TEST_F(InputStream, CorruptGzip_HasError)
+{
+  auto compressed = gzip(m_text);
+  for (auto i = compressed.size() / 2u; i < compressed.size() / 2u + 64u; ++i) {
+    compressed[i] = static_cast<char>(~compressed[i]);
+  }
+  const auto path = write_file("input.gz", compressed);
+  const auto stream = open_input_stream(path, input_compression::detect);
+
+  read_all(*stream);
+  EXPECT_TRUE(stream->has_error());
+}
+#endif
+
+#ifdef OKON_WITH_LZMA
+TEST_F(InputStream, XzFile_ReadsDecompressedText)
+{
+  const auto path = write_file("input.xz", xz(m_text) + xz("end\n"));
+  const auto stream = open_input_stream(path, input_compression::detect);
+  ASSERT_TRUE(stream->is_open());
+  EXPECT_THAT(read_all(*stream), Eq(m_text + "end\n"));
+  EXPECT_FALSE(stream->has_error());
+}
+
+TEST_F(InputStream, TruncatedXz_HasError)
+{
+  const auto compressed = xz(m_text);
+  const auto path = write_file("input.xz", compressed.substr(0u, compressed.size() / 2u));
+  const auto stream = open_input_stream(path, input_compression::detect);
+
+  const auto text = read_all(*stream);
+  EXPECT_THAT(text, Eq(m_text.substr(0u, text.size())));
+  EXPECT_TRUE(stream->has_error());
+}
+#endif
+}
@@ -0,0 +1,76 @@
+#include "new_line_scanner.hpp"
+
+#include <gmock/gmock.h>
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace okon::test {
+using ::testing::ContainerEq;
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+
+namespace {
+std::vector<std::size_t> find_new_lines(const std::string& text)
+{
+  std::vector<std::size_t> offsets;
+  okon::find_new_lines(text.data(), text.size(), offsets);
+  return offsets;
+}
+}
+
+TEST(NewLineScanner, NoNewLines_FindsNothing)
+{
+  EXPECT_THAT(find_new_lines(""), IsEmpty());
+  EXPECT_THAT(find_new_lines(std::string(100u, 'a')), IsEmpty());
+}
+
+TEST(NewLineScanner, NewLinesInFirstBlock_FindsThem)
+{
+  EXPECT_THAT(find_new_lines("\nab\n\ncd\n"), ElementsAre(0u, 3u, 4u, 7u));
+}
+
+TEST(NewLineScanner, NewLinesAtBlocksBoundariesAndInTail_FindsThem)
+{
+  std::string text(70u, 'a');
+  text[31u] = '\n';
+  text[32u] = '\n';
+  text[63u] = '\n';
+  text[69u] = '\n';
+
+  EXPECT_THAT(find_new_lines(text), ElementsAre(31u, 32u, 63u, 69u));
+}
+
+TEST(NewLineScanner, RandomText_FindsSameNewLinesAsScalarSearch)
+{
+  std::mt19937 generator{ 42u };
+  std::uniform_int_distribution<int> char_distribution{ 0, 15 };
+
+  std::string text(10000u, '\0');
+  std::vector<std::size_t> expected;
+  for (auto i = 0u; i < text.size(); ++i) {
+    text[i] = char_distribution(generator) == 0 ? '\n' : 'x';
+    if (text[i] == '\n') {
+      expected.push_back(i);
+    }
+  }
+
+  EXPECT_THAT(find_new_lines(text), ContainerEq(expected));
+}
+
+TEST(NewLineScanner, DoesntReadAfterText)
+{
+  // Text at the very end of its allocation, so an overread is caught by a sanitizer.
+  constexpr auto size{ 45u };
+  const auto text = std::make_unique<char[]>(size);
+  std::fill_n(text.get(), size, 'a');
+  text[size - 1u] = '\n';
+
+  std::vector<std::size_t> offsets;
+  okon::find_new_lines(text.get(), size, offsets);
+
+  EXPECT_THAT(offsets, ElementsAre(size - 1u));
+}
+}
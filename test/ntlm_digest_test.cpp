@@ -0,0 +1,55 @@
+#include "ntlm_digest.hpp"
+
+#include <gmock/gmock.h>
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+namespace okon::test {
+using namespace std::literals;
+using ::testing::Eq;
+
+namespace {
+std::string to_hex(const ntlm_digest_t& digest)
+{
+  std::string hex;
+  for (const auto byte : digest) {
+    char digits[3];
+    std::snprintf(digits, sizeof(digits), "%02X", byte);
+    hex += digits;
+  }
+  return hex;
+}
+
+struct NtlmDigestState
+{
+  std::string password;
+  std::string_view expected;
+};
+
+const NtlmDigestState values[] = {
+  { "", "31D6CFE0D16AE931B73C59D7E0C089C0"sv },
+  { "password", "8846F7EAEE8FB117AD06BDD830B7586C"sv },
+  // 100 characters, 200 bytes of UTF-16LE take more than one block.
+  { std::string(100u, 'a'), "47626139153AD114EF8B3A9902501F88"sv },
+  // Two bytes sequences.
+  { "p\xC3\xA4ssw\xC3\xB6rd", "0553152250AC01ADB4213CB9938663E4"sv },
+  // Four bytes sequence, encoded as a surrogate pair.
+  { "\xF0\x9F\x98\x80x", "4239D4DCD7148A5EA8F750B376CFDBD6"sv },
+  // Invalid byte, encoded as U+FFFD.
+  { "\xFFx", "708C1FB289BC641BB5779C2317027018"sv },
+  { "\xEF\xBF\xBDx", "708C1FB289BC641BB5779C2317027018"sv }
+};
+}
+
+using NtlmDigestTest = ::testing::TestWithParam<NtlmDigestState>;
+
+TEST_P(NtlmDigestTest, Digest_IsCorrect)
+{
+  const auto& [password, expected] = GetParam();
+  EXPECT_THAT(to_hex(ntlm_digest(password.data(), password.size())), Eq(expected));
+}
+
+INSTANTIATE_TEST_SUITE_P(NtlmDigest, NtlmDigestTest, ::testing::ValuesIn(values));
+}
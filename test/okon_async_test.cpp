@@ -0,0 +1,273 @@
+#include <okon/okon.h>
+#include <okon/okon_async.hpp>
+
+#include "sha1_utils.hpp"
+
+#include <gmock/gmock.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <vector>
+
+namespace okon::test {
+using ::testing::Eq;
+
+namespace {
+sha1_t make_sha1(unsigned value)
+{
+  sha1_t sha1{};
+  sha1[0] = static_cast<uint8_t>(value * 37u);
+  for (auto i = 0u; i < sizeof(value); ++i) {
+    sha1[i + 1u] = static_cast<uint8_t>(value >> (8u * (sizeof(value) - 1u - i)));
+  }
+  return sha1;
+}
+
+// Counts answered lookups, so a test can wait for all of them.
+class completions
+{
+public:
+  void add()
+  {
+    std::lock_guard lock{ m_mtx };
+    ++m_count;
+    m_cv.notify_all();
+  }
+
+  void wait_for(unsigned count)
+  {
+    std::unique_lock lock{ m_mtx };
+    m_cv.wait(lock, [this, count] { return m_count >= count; });
+  }
+
+  unsigned count()
+  {
+    std::lock_guard lock{ m_mtx };
+    return m_count;
+  }
+
+private:
+  std::mutex m_mtx;
+  std::condition_variable m_cv;
+  unsigned m_count{ 0u };
+};
+
+struct async_lookup
+{
+  okon_exists_result result{ okon_exists_result_doesnt_exist };
+  completions* done{ nullptr };
+};
+
+void store_result(void* user_data, okon_exists_result result)
+{
+  auto& lookup = *static_cast<async_lookup*>(user_data);
+  lookup.result = result;
+  lookup.done->add();
+}
+
+// Coroutine that starts right away and destroys itself when it's done.
+struct detached_task
+{
+  struct promise_type
+  {
+    detached_task get_return_object()
+    {
+      return {};
+    }
+    std::suspend_never initial_suspend() noexcept
+    {
+      return {};
+    }
+    std::suspend_never final_suspend() noexcept
+    {
+      return {};
+    }
+    void return_void()
+    {
+    }
+    void unhandled_exception()
+    {
+      std::terminate();
+    }
+  };
+};
+
+// Looks up `first` and, if it exists, `second`.
+detached_task look_up_both(okon_handle* handle, sha1_t first, sha1_t second,
+                           std::atomic<unsigned>& found, completions& done)
+{
+  const auto first_result = co_await okon::exists_async(handle, first.data());
+  if (first_result == okon_exists_result_exists) {
+    const auto second_result = co_await okon::exists_async(handle, second.data());
+    if (second_result == okon_exists_result_exists) {
+      ++found;
+    }
+  }
+  done.add();
+}
+
+class OkonAsync : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    m_wd = std::filesystem::temp_directory_path() / "okon_async_test";
+    std::filesystem::remove_all(m_wd);
+    std::filesystem::create_directories(m_wd);
+
+    // Even hashes below 2 * k_hashes_count.
+    const auto input_path = (m_wd / "input.txt").string();
+    {
+      std::ofstream input{ input_path };
+      for (auto i = 0u; i < k_hashes_count; ++i) {
+        input << binary_sha1_to_string(make_sha1(i * 2u)) << ":1\n";
+      }
+    }
+
+    m_path = (m_wd / "output.okon").string();
+    const auto wd = m_wd.string() + '/';
+    ASSERT_THAT(okon_prepare_ex(input_path.c_str(), wd.c_str(), m_path.c_str(), nullptr),
+                Eq(okon_prepare_result_success));
+  }
+
+  void TearDown() override
+  {
+    std::filesystem::remove_all(m_wd);
+  }
+
+  static constexpr auto k_hashes_count{ 5000u };
+
+  std::filesystem::path m_wd;
+  std::string m_path;
+};
+}
+
+TEST_F(OkonAsync, ExistsAsync_ManyLookups_MatchExistsBinary)
+{
+  auto handle = okon_open(m_path.c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  completions done;
+  std::vector<async_lookup> lookups(2u * k_hashes_count + 2u);
+  for (auto i = 0u; i < lookups.size(); ++i) {
+    lookups[i].done = &done;
+    okon_exists_async(handle, make_sha1(i).data(), &store_result, &lookups[i]);
+  }
+
+  done.wait_for(static_cast<unsigned>(lookups.size()));
+
+  for (auto i = 0u; i < lookups.size(); ++i) {
+    EXPECT_THAT(lookups[i].result, Eq(okon_handle_exists_binary(handle, make_sha1(i).data())))
+      << "hash " << i;
+  }
+
+  okon_close(handle);
+}
+
+TEST_F(OkonAsync, Close_PendingLookups_CallsAllCallbacks)
+{
+  okon_open_options options;
+  okon_open_options_init(&options);
+  options.async_threads = 1u;
+
+  auto handle = okon_open_ex(m_path.c_str(), &options);
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  completions done;
+  std::vector<async_lookup> lookups(k_hashes_count);
+  for (auto i = 0u; i < lookups.size(); ++i) {
+    lookups[i].done = &done;
+    okon_exists_async(handle, make_sha1(i * 2u).data(), &store_result, &lookups[i]);
+  }
+
+  okon_close(handle);
+
+  EXPECT_THAT(done.count(), Eq(k_hashes_count));
+  for (const auto& lookup : lookups) {
+    EXPECT_THAT(lookup.result, Eq(okon_exists_result_exists));
+  }
+}
+
+TEST_F(OkonAsync, ExistsAsync_LookupsWaitingTogether_AreAnsweredInOrderOfSubmitting)
+{
+  okon_open_options options;
+  okon_open_options_init(&options);
+  options.async_threads = 1u;
+
+  auto handle = okon_open_ex(m_path.c_str(), &options);
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  // The only worker is held in the callback of the first lookup, till all the others wait for it.
+  struct ordered_lookups
+  {
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool all_submitted{ false };
+    std::vector<unsigned> answered;
+    completions done;
+  } state;
+
+  struct ordered_lookup
+  {
+    ordered_lookups* state;
+    unsigned index;
+  };
+
+  const auto answer = [](void* user_data, okon_exists_result) {
+    auto& lookup = *static_cast<ordered_lookup*>(user_data);
+    auto& state = *lookup.state;
+    {
+      std::unique_lock lock{ state.mtx };
+      state.cv.wait(lock, [&state] { return state.all_submitted; });
+      state.answered.push_back(lookup.index);
+    }
+    state.done.add();
+  };
+
+  // More lookups than a worker takes at once.
+  std::vector<ordered_lookup> lookups(3u * 4096u + 1u);
+  for (auto i = 0u; i < lookups.size(); ++i) {
+    lookups[i] = { &state, i };
+    okon_exists_async(handle, make_sha1(i).data(), answer, &lookups[i]);
+  }
+
+  {
+    std::lock_guard lock{ state.mtx };
+    state.all_submitted = true;
+  }
+  state.cv.notify_all();
+  state.done.wait_for(static_cast<unsigned>(lookups.size()));
+
+  std::vector<unsigned> expected(lookups.size());
+  std::iota(expected.begin(), expected.end(), 0u);
+  EXPECT_THAT(state.answered, Eq(expected));
+
+  okon_close(handle);
+}
+
+TEST_F(OkonAsync, CoAwait_LookupsInCoroutines_AreAnswered)
+{
+  auto handle = okon_open(m_path.c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  // Even hashes exist, so both of them exist for every fourth coroutine.
+  constexpr auto coroutines_count{ 1000u };
+  std::atomic<unsigned> found{ 0u };
+  completions done;
+  for (auto i = 0u; i < coroutines_count; ++i) {
+    const auto second = i % 4u == 0u ? i + 2u : i + 1u;
+    look_up_both(handle, make_sha1(i), make_sha1(second), found, done);
+  }
+
+  done.wait_for(coroutines_count);
+  EXPECT_THAT(found.load(), Eq(coroutines_count / 4u));
+
+  okon_close(handle);
+}
+}
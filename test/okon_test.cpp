@@ -0,0 +1,1771 @@
+#include <okon/okon.h>
+
+#include "sha1_utils.hpp"
+#include "text_sha1_decoder.hpp"
+
+#include <gmock/gmock.h>
+
+#ifdef OKON_WITH_ZLIB
+#  include <zlib.h>
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace okon::test {
+using ::testing::Eq;
+
+namespace {
+std::string make_hash(unsigned value)
+{
+  // Spread hashes over all the intermediate files, keeping them unique.
+  sha1_t sha1{};
+  sha1[0] = static_cast<uint8_t>(value * 37u);
+  for (auto i = 0u; i < sizeof(value); ++i) {
+    sha1[i + 1u] = static_cast<uint8_t>(value >> (8u * (sizeof(value) - 1u - i)));
+  }
+  sha1[k_key_size - 1u] = 0xAB;
+  return binary_sha1_to_string(sha1);
+}
+
+// Of `formats`, the ones this build prepares. v1 files can't store the key size, so they're of
+// SHA-1 keys only.
+std::vector<okon_format> supported_formats(std::initializer_list<okon_format> formats)
+{
+  std::vector<okon_format> supported;
+  std::copy_if(formats.begin(), formats.end(), std::back_inserter(supported),
+               [](okon_format format) {
+                 return format != okon_format_btree_v1 || k_key_size == k_sha1_key_size;
+               });
+  return supported;
+}
+
+int collect_range_hash(void* user_data, const void* sha1)
+{
+  auto& hashes = *static_cast<std::vector<std::string>*>(user_data);
+  sha1_t binary;
+  std::copy_n(static_cast<const uint8_t*>(sha1), binary.size(), binary.begin());
+  hashes.push_back(binary_sha1_to_string(binary));
+  return 1;
+}
+
+int stop_range(void* user_data, const void*)
+{
+  ++*static_cast<unsigned*>(user_data);
+  return 0;
+}
+
+struct reported_progress
+{
+  std::vector<int> progress;
+  std::vector<okon_prepare_phase_progress> phases_progress;
+};
+
+void collect_progress(void* user_data, int progress)
+{
+  static_cast<reported_progress*>(user_data)->progress.push_back(progress);
+}
+
+void collect_phase_progress(void* user_data, const okon_prepare_phase_progress* progress)
+{
+  static_cast<reported_progress*>(user_data)->phases_progress.push_back(*progress);
+}
+
+class OkonFileFixture : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    const auto* test_info = ::testing::UnitTest::GetInstance()->current_test_info();
+    m_wd = std::filesystem::temp_directory_path() / "okon_test" / test_info->name();
+    std::filesystem::remove_all(m_wd);
+    std::filesystem::create_directories(m_wd);
+  }
+
+  void TearDown() override
+  {
+    std::filesystem::remove_all(m_wd);
+  }
+
+  std::string prepare(const std::vector<std::string>& hashes,
+                      const okon_prepare_options* options = nullptr)
+  {
+    std::string input;
+    for (const auto& hash : hashes) {
+      input += hash + ":1\n";
+    }
+
+    return prepare_input(input, options);
+  }
+
+  std::string prepare_input(const std::string& input, const okon_prepare_options* options,
+                            okon_prepare_result expected_result = okon_prepare_result_success)
+  {
+    const auto input_path = (m_wd / "input.txt").string();
+    const auto output_path = (m_wd / "output.okon").string();
+
+    std::ofstream{ input_path } << input;
+
+    const auto wd = m_wd.string() + '/';
+    const auto result =
+      okon_prepare_ex(input_path.c_str(), wd.c_str(), output_path.c_str(), options);
+    EXPECT_THAT(result, Eq(expected_result));
+
+    return output_path;
+  }
+
+  std::vector<std::string> make_hashes(unsigned count, unsigned step = 2u)
+  {
+    std::vector<std::string> hashes;
+    for (auto i = 0u; i < count; ++i) {
+      hashes.push_back(make_hash(i * step));
+    }
+    return hashes;
+  }
+
+  const std::filesystem::path& wd() const
+  {
+    return m_wd;
+  }
+
+private:
+  std::filesystem::path m_wd;
+};
+}
+
+TEST(Okon, Open_NotExistingFile_ReturnsNull)
+{
+  EXPECT_THAT(okon_open("/not/existing/file.okon"), Eq(nullptr));
+}
+
+TEST(Okon, Close_Null_DoesNothing)
+{
+  okon_close(nullptr);
+}
+
+using OkonFile = OkonFileFixture;
+
+TEST_F(OkonFile, HandleExistsText_PreparedHashes_AreFound)
+{
+  const auto hashes = make_hashes(5000u);
+  const auto path = prepare(hashes);
+
+  auto handle = okon_open(path.c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  for (const auto& hash : hashes) {
+    EXPECT_THAT(okon_handle_exists_text(handle, hash.c_str()), Eq(okon_exists_result_exists));
+  }
+
+  okon_close(handle);
+}
+
+#if OKON_KEY_SIZE == 20
+TEST_F(OkonFile, HandleExistsText_FormatV1_PreparedHashesAreFound)
+{
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.format = okon_format_btree_v1;
+
+  const auto hashes = make_hashes(5000u);
+  const auto path = prepare(hashes, &options);
+
+  auto handle = okon_open(path.c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  for (auto i = 0u; i < 10000u; ++i) {
+    const auto expected =
+      (i % 2u == 0u) ? okon_exists_result_exists : okon_exists_result_doesnt_exist;
+    EXPECT_THAT(okon_handle_exists_text(handle, make_hash(i).c_str()), Eq(expected));
+  }
+
+  okon_close(handle);
+}
+#else
+TEST_F(OkonFile, Prepare_FormatV1_ReturnsInvalidOptions)
+{
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.format = okon_format_btree_v1;
+
+  prepare_input(make_hash(0u) + "\n", &options, okon_prepare_result_invalid_options);
+}
+#endif
+
+TEST_F(OkonFile, Open_FormatV1File_OpensOnlyWithSha1Keys)
+{
+  // order | root_ptr | nodes. The header of v1 files is just the first two.
+  const auto path = (wd() / "v1.okon").string();
+  {
+    std::ofstream file{ path, std::ios::binary };
+    const uint32_t header[] = { 1024u, 8u };
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    const std::string nodes(64u * 1024u, '\0');
+    file.write(nodes.data(), static_cast<std::streamsize>(nodes.size()));
+  }
+
+  auto handle = okon_open(path.c_str());
+  EXPECT_THAT(handle != nullptr, Eq(k_key_size == k_sha1_key_size));
+  okon_close(handle);
+}
+
+TEST_F(OkonFile, Prepare_LegacyEntryPoint_WritesFileOfOldReaders)
+{
+  const auto input_path = (wd() / "input.txt").string();
+  const auto output_path = (wd() / "output.okon").string();
+  {
+    std::ofstream input{ input_path };
+    for (const auto& hash : make_hashes(1000u)) {
+      input << hash << ":1\n";
+    }
+  }
+
+  const auto working_directory = wd().string() + '/';
+  ASSERT_THAT(okon_prepare(input_path.c_str(), working_directory.c_str(), output_path.c_str(),
+                           nullptr, nullptr),
+              Eq(okon_prepare_result_success));
+
+  // v1 files start with the order, files of the other formats with the extended header marker.
+  uint32_t first_field{ 0u };
+  std::ifstream{ output_path, std::ios::binary }.read(reinterpret_cast<char*>(&first_field),
+                                                      sizeof(first_field));
+  EXPECT_THAT(first_field != 0u, Eq(k_key_size == k_sha1_key_size));
+
+  auto handle = okon_open(output_path.c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+  for (auto i = 0u; i < 2000u; ++i) {
+    const auto expected =
+      (i % 2u == 0u) ? okon_exists_result_exists : okon_exists_result_doesnt_exist;
+    EXPECT_THAT(okon_handle_exists_text(handle, make_hash(i).c_str()), Eq(expected));
+  }
+  okon_close(handle);
+}
+
+TEST_F(OkonFile, HandleExistsText_FormatV3_PreparedHashesAreFound)
+{
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.format = okon_format_btree_v3;
+
+  // Enough for a tree of two levels.
+  const auto hashes = make_hashes(5000u);
+  const auto path = prepare(hashes, &options);
+
+  for (const auto pinned_levels : { 0u, 1u, 2u }) {
+    okon_open_options open_options;
+    okon_open_options_init(&open_options);
+    open_options.pinned_levels = pinned_levels;
+
+    auto handle = okon_open_ex(path.c_str(), &open_options);
+    ASSERT_THAT(handle, ::testing::NotNull());
+
+    for (auto i = 0u; i < 10000u; ++i) {
+      const auto expected =
+        (i % 2u == 0u) ? okon_exists_result_exists : okon_exists_result_doesnt_exist;
+      EXPECT_THAT(okon_handle_exists_text(handle, make_hash(i).c_str()), Eq(expected))
+        << "pinned levels " << pinned_levels << ", hash " << i;
+    }
+
+    okon_close(handle);
+  }
+}
+
+TEST_F(OkonFile, Prepare_FormatV3_IsSmallerThanV2)
+{
+  const auto hashes = make_hashes(20000u);
+
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.format = okon_format_btree_v2;
+  const auto v2_size = std::filesystem::file_size(prepare(hashes, &options));
+
+  options.format = okon_format_btree_v3;
+  const auto v3_size = std::filesystem::file_size(prepare(hashes, &options));
+
+  EXPECT_THAT(v3_size, ::testing::Lt(v2_size * 6u / 7u));
+}
+
+TEST_F(OkonFile, HandleExistsText_FormatV4_PreparedHashesAreFound)
+{
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.format = okon_format_btree_v4;
+
+  // Enough for a tree of two levels.
+  const auto hashes = make_hashes(20000u);
+  const auto path = prepare(hashes, &options);
+
+  for (const auto pinned_levels : { 0u, 1u, 2u }) {
+    okon_open_options open_options;
+    okon_open_options_init(&open_options);
+    open_options.pinned_levels = pinned_levels;
+
+    auto handle = okon_open_ex(path.c_str(), &open_options);
+    ASSERT_THAT(handle, ::testing::NotNull());
+
+    for (auto i = 0u; i < 40000u; ++i) {
+      const auto expected =
+        (i % 2u == 0u) ? okon_exists_result_exists : okon_exists_result_doesnt_exist;
+      EXPECT_THAT(okon_handle_exists_text(handle, make_hash(i).c_str()), Eq(expected))
+        << "pinned levels " << pinned_levels << ", hash " << i;
+    }
+
+    okon_close(handle);
+  }
+}
+
+TEST_F(OkonFile, HandleExistsText_BtreeNodeSize_PreparedHashesAreFound)
+{
+  for (const auto format : supported_formats({ okon_format_btree_v1, okon_format_btree_v2,
+                                               okon_format_btree_v3, okon_format_btree_v4 })) {
+    for (const auto node_size : { 512u, 4096u }) {
+      okon_prepare_options options;
+      okon_prepare_options_init(&options);
+      options.format = format;
+      options.btree_node_size = node_size;
+
+      const auto path = prepare(make_hashes(5000u), &options);
+
+      // Nodes are padded to the node size, except in v1 files.
+      if (format != okon_format_btree_v1) {
+        EXPECT_THAT(std::filesystem::file_size(path) % node_size, Eq(0u))
+          << "format " << format << ", node size " << node_size;
+      }
+
+      auto handle = okon_open(path.c_str());
+      ASSERT_THAT(handle, ::testing::NotNull());
+
+      for (auto i = 0u; i < 10002u; ++i) {
+        const auto expected = (i % 2u == 0u && i < 10000u) ? okon_exists_result_exists
+                                                           : okon_exists_result_doesnt_exist;
+        EXPECT_THAT(okon_handle_exists_text(handle, make_hash(i).c_str()), Eq(expected))
+          << "format " << format << ", node size " << node_size << ", hash " << i;
+      }
+
+      okon_close(handle);
+    }
+  }
+}
+
+TEST_F(OkonFile, Merge_BtreeNodeSize_AllHashesAreFound)
+{
+  for (const auto format : { okon_format_btree_v2, okon_format_btree_v3, okon_format_btree_v4 }) {
+    okon_prepare_options options;
+    okon_prepare_options_init(&options);
+    options.format = format;
+    options.btree_node_size = 1024u;
+
+    const auto prepared_path = prepare(make_hashes(3000u), &options);
+    const auto prepared_copy_path = (wd() / "prepared.okon").string();
+    std::filesystem::copy_file(prepared_path, prepared_copy_path,
+                               std::filesystem::copy_options::overwrite_existing);
+
+    const auto delta_path = (wd() / "delta.txt").string();
+    {
+      std::ofstream delta_file{ delta_path };
+      for (auto i = 0u; i < 3000u; ++i) {
+        delta_file << make_hash(i * 2u + 1u) << ":1\n";
+      }
+    }
+
+    const auto merged_path = (wd() / "merged.okon").string();
+    const auto wd_path = wd().string() + '/';
+    ASSERT_THAT(okon_merge(prepared_copy_path.c_str(), delta_path.c_str(), wd_path.c_str(),
+                           merged_path.c_str(), &options),
+                Eq(okon_prepare_result_success));
+
+    auto handle = okon_open(merged_path.c_str());
+    ASSERT_THAT(handle, ::testing::NotNull());
+
+    for (auto i = 0u; i < 6002u; ++i) {
+      const auto expected =
+        i < 6000u ? okon_exists_result_exists : okon_exists_result_doesnt_exist;
+      EXPECT_THAT(okon_handle_exists_text(handle, make_hash(i).c_str()), Eq(expected))
+        << "format " << format << ", hash " << i;
+    }
+
+    okon_close(handle);
+  }
+}
+
+TEST_F(OkonFile, Prepare_InvalidBtreeNodeSize_ReturnsInvalidOptions)
+{
+  for (const auto node_size : { 256u, 1000u, 2u * 1024u * 1024u }) {
+    okon_prepare_options options;
+    okon_prepare_options_init(&options);
+    options.btree_node_size = node_size;
+
+    prepare_input(make_hash(1u) + ":1\n", &options, okon_prepare_result_invalid_options);
+  }
+}
+
+TEST_F(OkonFile, HandleExistsText_Sharded_PreparedHashesAreFound)
+{
+  for (const auto format :
+       { okon_format_btree_v2, okon_format_btree_v4, okon_format_flat_sorted }) {
+    for (const auto shards_count : { 2u, 7u, 256u }) {
+      okon_prepare_options options;
+      okon_prepare_options_init(&options);
+      options.format = format;
+      options.shards_count = shards_count;
+
+      auto hashes = make_hashes(5000u);
+      const auto path = prepare(hashes, &options);
+      std::sort(hashes.begin(), hashes.end());
+
+      auto handle = okon_open(path.c_str());
+      ASSERT_THAT(handle, ::testing::NotNull());
+
+      std::vector<sha1_t> sha1s;
+      for (auto i = 0u; i < 10002u; ++i) {
+        const auto expected = (i % 2u == 0u && i < 10000u) ? okon_exists_result_exists
+                                                           : okon_exists_result_doesnt_exist;
+        EXPECT_THAT(okon_handle_exists_text(handle, make_hash(i).c_str()), Eq(expected))
+          << "format " << format << ", shards " << shards_count << ", hash " << i;
+        sha1s.push_back(details::string_sha1_to_binary(make_hash(i).c_str()));
+      }
+
+      std::vector<uint8_t> results(sha1s.size());
+      okon_exists_batch(handle, sha1s.data(), sha1s.size(), results.data());
+      for (auto i = 0u; i < sha1s.size(); ++i) {
+        EXPECT_THAT(results[i], Eq(i % 2u == 0u && i < 10000u ? 1u : 0u))
+          << "format " << format << ", shards " << shards_count << ", hash " << i;
+      }
+
+      // Keys of all the shards are read in order.
+      std::vector<std::string> all_hashes;
+      EXPECT_THAT(okon_range(handle, "", 0u, &collect_range_hash, &all_hashes),
+                  Eq(okon_range_result_success));
+      EXPECT_THAT(all_hashes, Eq(hashes)) << "format " << format << ", shards " << shards_count;
+
+      // A range query may start in any shard.
+      for (const auto& probe : { hashes[1234], hashes[4321] }) {
+        const auto prefix = probe.substr(0u, 3u);
+        std::vector<std::string> expected;
+        std::copy_if(
+          hashes.begin(), hashes.end(), std::back_inserter(expected),
+          [&prefix](const auto& hash) { return hash.compare(0u, prefix.size(), prefix) == 0; });
+
+        std::vector<std::string> result;
+        EXPECT_THAT(
+          okon_range(handle, prefix.c_str(), prefix.size(), &collect_range_hash, &result),
+          Eq(okon_range_result_success));
+        EXPECT_THAT(result, Eq(expected)) << "format " << format << ", prefix " << prefix;
+      }
+
+      okon_close(handle);
+    }
+  }
+}
+
+TEST_F(OkonFile, HandleExistsText_Shard_OpensAlone)
+{
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.shards_count = 4u;
+
+  const auto path = prepare(make_hashes(2000u), &options);
+
+  // The second shard has hashes of the first bytes from 0x40 to 0x7F.
+  auto handle = okon_open((path + ".shard1").c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  for (auto i = 0u; i < 4000u; ++i) {
+    const auto hash = make_hash(i);
+    const auto first_byte = details::string_sha1_to_binary(hash.c_str())[0];
+    const auto expected = (i % 2u == 0u && first_byte >= 0x40u && first_byte < 0x80u)
+      ? okon_exists_result_exists
+      : okon_exists_result_doesnt_exist;
+    EXPECT_THAT(okon_handle_exists_text(handle, hash.c_str()), Eq(expected)) << "hash " << i;
+  }
+
+  okon_close(handle);
+}
+
+TEST_F(OkonFile, Open_ShardedWithMissingShard_ReturnsNull)
+{
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.shards_count = 4u;
+
+  const auto path = prepare(make_hashes(100u), &options);
+  std::filesystem::remove(path + ".shard2");
+
+  EXPECT_THAT(okon_open(path.c_str()), ::testing::IsNull());
+}
+
+TEST_F(OkonFile, HandleExistsText_ShardsMovedWithManifest_AreFound)
+{
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.shards_count = 3u;
+
+  const auto path = prepare(make_hashes(1000u), &options);
+
+  // Shards are found relative to the manifest.
+  const auto moved_directory = wd() / "moved";
+  std::filesystem::create_directories(moved_directory);
+  for (const auto& suffix : { "", ".shard0", ".shard1", ".shard2" }) {
+    std::filesystem::rename(path + suffix,
+                            moved_directory / ("output.okon" + std::string{ suffix }));
+  }
+
+  auto handle = okon_open((moved_directory / "output.okon").string().c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  for (auto i = 0u; i < 2000u; ++i) {
+    const auto expected =
+      (i % 2u == 0u) ? okon_exists_result_exists : okon_exists_result_doesnt_exist;
+    EXPECT_THAT(okon_handle_exists_text(handle, make_hash(i).c_str()), Eq(expected))
+      << "hash " << i;
+  }
+
+  okon_close(handle);
+}
+
+TEST_F(OkonFile, Merge_ShardedIntoSharded_AllHashesAreFound)
+{
+  for (const auto format :
+       { okon_format_btree_v2, okon_format_btree_v3, okon_format_flat_sorted }) {
+    okon_prepare_options options;
+    okon_prepare_options_init(&options);
+    options.format = format;
+    options.shards_count = 5u;
+
+    // Prepared file has even hashes below 6000, delta adds odd ones below 6000.
+    prepare(make_hashes(3000u), &options);
+
+    const auto delta_path = (wd() / "delta.txt").string();
+    {
+      std::ofstream delta_file{ delta_path };
+      for (auto i = 0u; i < 3000u; ++i) {
+        delta_file << make_hash(i * 2u + 1u) << ":1\n";
+      }
+    }
+
+    // A different number of shards, so the merged keys are routed to other shards.
+    options.shards_count = 3u;
+    const auto prepared_path = (wd() / "output.okon").string();
+    const auto merged_path = (wd() / "merged.okon").string();
+    const auto wd_path = wd().string() + '/';
+    ASSERT_THAT(okon_merge(prepared_path.c_str(), delta_path.c_str(), wd_path.c_str(),
+                           merged_path.c_str(), &options),
+                Eq(okon_prepare_result_success));
+
+    auto handle = okon_open(merged_path.c_str());
+    ASSERT_THAT(handle, ::testing::NotNull());
+
+    for (auto i = 0u; i < 6002u; ++i) {
+      const auto expected =
+        i < 6000u ? okon_exists_result_exists : okon_exists_result_doesnt_exist;
+      EXPECT_THAT(okon_handle_exists_text(handle, make_hash(i).c_str()), Eq(expected))
+        << "format " << format << ", hash " << i;
+    }
+
+    okon_close(handle);
+  }
+}
+
+TEST_F(OkonFile, HandleExistsText_ShardedWithFilter_FindsSameHashes)
+{
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.shards_count = 4u;
+  options.filter_bits_per_key = 8u;
+
+  const auto path = prepare(make_hashes(5000u), &options);
+  for (const auto& suffix : { ".shard0", ".shard1", ".shard2", ".shard3" }) {
+    EXPECT_TRUE(std::filesystem::exists(path + suffix + ".filter")) << suffix;
+  }
+
+  auto handle = okon_open(path.c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  for (auto i = 0u; i < 10002u; ++i) {
+    const auto expected = i % 2u == 0u && i < 10000u ? okon_exists_result_exists
+                                                     : okon_exists_result_doesnt_exist;
+    EXPECT_THAT(okon_handle_exists_text(handle, make_hash(i).c_str()), Eq(expected))
+      << "hash " << i;
+  }
+
+  okon_close(handle);
+}
+
+TEST_F(OkonFile, Prepare_InvalidShardsCount_ReturnsInvalidOptions)
+{
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.shards_count = 257u;
+  prepare_input(make_hash(1u) + ":1\n", &options, okon_prepare_result_invalid_options);
+
+  // The filter format is sized for all the hashes.
+  options.shards_count = 2u;
+  options.format = okon_format_bloom_filter;
+  prepare_input(make_hash(1u) + ":1\n", &options, okon_prepare_result_invalid_options);
+}
+
+TEST_F(OkonFile, HandleExistsText_FormatStaticTree_PreparedHashesAreFound)
+{
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.format = okon_format_static_tree;
+
+  const auto hashes = make_hashes(20000u);
+  const auto path = prepare(hashes, &options);
+
+  auto handle = okon_open(path.c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  std::vector<uint8_t> binary_hashes;
+  for (auto i = 0u; i < 40000u; ++i) {
+    const auto hash = make_hash(i);
+    const auto expected =
+      (i % 2u == 0u) ? okon_exists_result_exists : okon_exists_result_doesnt_exist;
+    EXPECT_THAT(okon_handle_exists_text(handle, hash.c_str()), Eq(expected));
+
+    const auto binary = okon::text_sha1_to_binary(hash.c_str());
+    binary_hashes.insert(binary_hashes.end(), binary.begin(), binary.end());
+  }
+
+  std::vector<uint8_t> results(40000u, 0xFFu);
+  okon_exists_batch(handle, binary_hashes.data(), results.size(), results.data());
+  for (auto i = 0u; i < results.size(); ++i) {
+    EXPECT_THAT(results[i], Eq(i % 2u == 0u ? 1u : 0u)) << "hash " << i;
+  }
+
+  okon_close(handle);
+}
+
+TEST_F(OkonFile, HandleExistsText_FormatFlatSorted_PreparedHashesAreFound)
+{
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.format = okon_format_flat_sorted;
+
+  const auto hashes = make_hashes(20000u);
+  const auto path = prepare(hashes, &options);
+
+  auto handle = okon_open(path.c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  for (auto i = 0u; i < 40000u; ++i) {
+    const auto expected =
+      (i % 2u == 0u) ? okon_exists_result_exists : okon_exists_result_doesnt_exist;
+    EXPECT_THAT(okon_handle_exists_text(handle, make_hash(i).c_str()), Eq(expected));
+  }
+
+  okon_close(handle);
+}
+
+TEST_F(OkonFile, Open_OtherKeySize_ReturnsNull)
+{
+  const auto hashes = make_hashes(1000u);
+
+  for (const auto format : { okon_format_btree_v2, okon_format_btree_v3, okon_format_btree_v4,
+                             okon_format_static_tree, okon_format_flat_sorted,
+                             okon_format_bloom_filter }) {
+    okon_prepare_options options;
+    okon_prepare_options_init(&options);
+    options.format = format;
+    const auto path = prepare(hashes, &options);
+
+    // Key size is the last field of the 64 bytes of the header, 0 for SHA-1 keys.
+    const uint32_t key_size{ k_key_size == k_sha1_key_size ? 16u : k_sha1_key_size };
+    {
+      std::fstream file{ path, std::ios::in | std::ios::out | std::ios::binary };
+      file.seekg(60);
+      uint32_t stored{ 1u };
+      file.read(reinterpret_cast<char*>(&stored), sizeof(stored));
+      EXPECT_THAT(stored, Eq(k_key_size == k_sha1_key_size ? 0u : k_key_size))
+        << "format " << format;
+      file.seekp(60);
+      file.write(reinterpret_cast<const char*>(&key_size), sizeof(key_size));
+    }
+
+    EXPECT_THAT(okon_open(path.c_str()), Eq(nullptr)) << "format " << format;
+  }
+}
+
+TEST_F(OkonFile, Open_CorruptStaticTreeOrFlatSortedHeader_ReturnsNull)
+{
+  const auto hashes = make_hashes(1000u);
+
+  // Header fields after the marker and the format: keys count (64-bit) at 8, then leaf and
+  // internal block keys of static trees or directory bits of flat sorted files at 16 and 20.
+  struct corruption
+  {
+    okon_format format;
+    std::streamoff offset;
+    uint64_t value;
+    std::size_t size;
+  };
+  const corruption corruptions[] = {
+    { okon_format_static_tree, 8, uint64_t{ 1u } << 60u, sizeof(uint64_t) },
+    { okon_format_static_tree, 8, 1000000u, sizeof(uint64_t) },
+    { okon_format_static_tree, 16, 0u, sizeof(uint32_t) },
+    { okon_format_static_tree, 20, 0u, sizeof(uint32_t) },
+    { okon_format_static_tree, 20, 0xFFFFFFFFu, sizeof(uint32_t) },
+    { okon_format_flat_sorted, 8, uint64_t{ 1u } << 60u, sizeof(uint64_t) },
+    { okon_format_flat_sorted, 16, 64u, sizeof(uint32_t) },
+    { okon_format_flat_sorted, 16, 40u, sizeof(uint32_t) },
+  };
+
+  for (const auto& c : corruptions) {
+    okon_prepare_options options;
+    okon_prepare_options_init(&options);
+    options.format = c.format;
+    const auto path = prepare(hashes, &options);
+    {
+      std::fstream file{ path, std::ios::in | std::ios::out | std::ios::binary };
+      file.seekp(c.offset);
+      file.write(reinterpret_cast<const char*>(&c.value), c.size);
+    }
+
+    EXPECT_THAT(okon_open(path.c_str()), Eq(nullptr))
+      << "format " << c.format << ", offset " << c.offset << ", value " << c.value;
+  }
+}
+
+TEST_F(OkonFile, HandleExistsText_TruncatedOrCorruptBtree_DoesntReadPastNodes)
+{
+  const auto hashes = make_hashes(5000u);
+
+  for (const auto format : supported_formats({ okon_format_btree_v1, okon_format_btree_v2,
+                                               okon_format_btree_v3, okon_format_btree_v4 })) {
+    okon_prepare_options options;
+    okon_prepare_options_init(&options);
+    options.format = format;
+    options.btree_node_size = 1024u;
+    const auto path = prepare(hashes, &options);
+    const auto size = std::filesystem::file_size(path);
+
+    // The header is kept, so the file is still opened. Past it, node pointers and keys counts are
+    // all 0xFF bytes, pointing past the end of the file and counting more keys than nodes have.
+    {
+      std::fstream file{ path, std::ios::in | std::ios::out | std::ios::binary };
+      file.seekp(64);
+      const std::string garbage(size / 2u - 64u, '\xFF');
+      file.write(garbage.data(), static_cast<std::streamsize>(garbage.size()));
+    }
+    std::filesystem::resize_file(path, size / 2u + 7u);
+
+    auto handle = okon_open(path.c_str());
+    ASSERT_THAT(handle, ::testing::NotNull()) << "format " << format;
+
+    // Answers are whatever the garbage gives, the lookups just have to end without reading past
+    // the nodes and the file.
+    std::vector<sha1_t> sha1s;
+    for (auto i = 0u; i < 1000u; ++i) {
+      const auto hash = make_hash(i);
+      okon_handle_exists_text(handle, hash.c_str());
+      sha1s.push_back(details::string_sha1_to_binary(hash.c_str()));
+    }
+
+    std::vector<uint8_t> results(sha1s.size());
+    okon_exists_batch(handle, sha1s.data(), sha1s.size(), results.data());
+
+    okon_close(handle);
+  }
+}
+
+TEST_F(OkonFile, HandleExistsText_PreparedWithManyThreads_PreparedHashesAreFound)
+{
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.threads = 4u;
+
+  // Bigger than one read chunk, so the input is parsed in a few parts.
+  const auto hashes = make_hashes(30000u);
+  const auto path = prepare(hashes, &options);
+
+  auto handle = okon_open(path.c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  for (auto i = 0u; i < 60000u; ++i) {
+    const auto expected =
+      (i % 2u == 0u) ? okon_exists_result_exists : okon_exists_result_doesnt_exist;
+    EXPECT_THAT(okon_handle_exists_text(handle, make_hash(i).c_str()), Eq(expected));
+  }
+
+  okon_close(handle);
+}
+
+TEST_F(OkonFile, HandleExistsText_SmallInputChunks_PreparedHashesAreFound)
+{
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.threads = 2u;
+  options.input_chunk_size = 1000u;
+  options.input_buffers_count = 2u;
+
+  // Chunks hold only a few lines, so many lines are split between two of them.
+  const auto hashes = make_hashes(3000u);
+  const auto path = prepare(hashes, &options);
+
+  auto handle = okon_open(path.c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  for (auto i = 0u; i < 6000u; ++i) {
+    const auto expected =
+      (i % 2u == 0u) ? okon_exists_result_exists : okon_exists_result_doesnt_exist;
+    EXPECT_THAT(okon_handle_exists_text(handle, make_hash(i).c_str()), Eq(expected));
+  }
+
+  okon_close(handle);
+}
+
+#ifdef OKON_WITH_ZLIB
+TEST_F(OkonFile, HandleExistsText_GzipInput_PreparedHashesAreFound)
+{
+  const auto hashes = make_hashes(3000u);
+  const auto input_path = (wd() / "input.txt.gz").string();
+  const auto output_path = (wd() / "output.okon").string();
+
+  const auto file = gzopen(input_path.c_str(), "wb");
+  for (const auto& hash : hashes) {
+    gzputs(file, (hash + ":1\n").c_str());
+  }
+  gzclose(file);
+
+  const auto working_directory = wd().string() + '/';
+  ASSERT_THAT(
+    okon_prepare_ex(input_path.c_str(), working_directory.c_str(), output_path.c_str(), nullptr),
+    Eq(okon_prepare_result_success));
+
+  auto handle = okon_open(output_path.c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  for (auto i = 0u; i < 6000u; ++i) {
+    const auto expected =
+      (i % 2u == 0u) ? okon_exists_result_exists : okon_exists_result_doesnt_exist;
+    EXPECT_THAT(okon_handle_exists_text(handle, make_hash(i).c_str()), Eq(expected));
+  }
+
+  okon_close(handle);
+}
+
+TEST_F(OkonFile, Prepare_TruncatedOrCorruptGzipInput_ReturnsCouldNotReadInputFile)
+{
+  const auto input_path = (wd() / "input.txt.gz").string();
+  const auto output_path = (wd() / "output.okon").string();
+  const auto working_directory = wd().string() + '/';
+
+  const auto write_input = [&] {
+    const auto file = gzopen(input_path.c_str(), "wb");
+    for (const auto& hash : make_hashes(3000u)) {
+      gzputs(file, (hash + ":1\n").c_str());
+    }
+    gzclose(file);
+  };
+
+  write_input();
+  std::filesystem::resize_file(input_path, std::filesystem::file_size(input_path) / 2u);
+  EXPECT_THAT(
+    okon_prepare_ex(input_path.c_str(), working_directory.c_str(), output_path.c_str(), nullptr),
+    Eq(okon_prepare_result_could_not_read_input_file));
+
+  // Past the header, the deflate data is overwritten.
+  write_input();
+  {
+    std::fstream file{ input_path, std::ios::in | std::ios::out | std::ios::binary };
+    file.seekp(32);
+    const std::string garbage(64u, '\xA5');
+    file.write(garbage.data(), static_cast<std::streamsize>(garbage.size()));
+  }
+  EXPECT_THAT(
+    okon_prepare_ex(input_path.c_str(), working_directory.c_str(), output_path.c_str(), nullptr),
+    Eq(okon_prepare_result_could_not_read_input_file));
+}
+#endif
+
+TEST_F(OkonFile, Prepare_InputCantBeRead_ReturnsCouldNotReadInputFile)
+{
+  // A directory opens, but its reads fail, which must not be taken for the end of the input.
+  const auto input_path = (wd() / "input").string();
+  const auto output_path = (wd() / "output.okon").string();
+  std::filesystem::create_directories(input_path);
+
+  const auto working_directory = wd().string() + '/';
+  EXPECT_THAT(
+    okon_prepare_ex(input_path.c_str(), working_directory.c_str(), output_path.c_str(), nullptr),
+    Eq(okon_prepare_result_could_not_read_input_file));
+}
+
+TEST_F(OkonFile, Prepare_HashesFitInMemoryBudget_DoesntCreateIntermediateFiles)
+{
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.memory_budget = 1024u * 1024u;
+
+  const auto path = prepare(make_hashes(5000u), &options);
+
+  EXPECT_FALSE(std::filesystem::exists(wd() / "00"));
+
+  auto handle = okon_open(path.c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  for (auto i = 0u; i < 10000u; ++i) {
+    const auto expected =
+      (i % 2u == 0u) ? okon_exists_result_exists : okon_exists_result_doesnt_exist;
+    EXPECT_THAT(okon_handle_exists_text(handle, make_hash(i).c_str()), Eq(expected));
+  }
+
+  okon_close(handle);
+}
+
+TEST_F(OkonFile, Prepare_ProgressCallback_ReportsUnknownThenGrowingPercentsTill100)
+{
+  reported_progress reported;
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.progress_callback = collect_progress;
+  options.progress_callback_user_data = &reported;
+
+  prepare(make_hashes(5000u), &options);
+
+  ASSERT_THAT(reported.progress.size(), ::testing::Ge(2u));
+  EXPECT_THAT(reported.progress.front(), Eq(okon_prepare_progress_special_value_unknown));
+  EXPECT_THAT(reported.progress.back(), Eq(100));
+  EXPECT_TRUE(std::is_sorted(std::next(reported.progress.begin()), reported.progress.end()));
+}
+
+TEST_F(OkonFile, Prepare_PhaseProgressCallback_ReportsEveryPhaseTill100)
+{
+  reported_progress reported;
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.phase_progress_callback = collect_phase_progress;
+  options.progress_callback_user_data = &reported;
+
+  constexpr auto hashes_count{ 5000u };
+  prepare(make_hashes(hashes_count), &options);
+
+  for (const auto phase :
+       { okon_prepare_phase_parse, okon_prepare_phase_sort, okon_prepare_phase_write }) {
+    const auto last = std::find_if(
+      reported.phases_progress.rbegin(), reported.phases_progress.rend(),
+      [phase](const okon_prepare_phase_progress& progress) { return progress.phase == phase; });
+    ASSERT_THAT(last, ::testing::Ne(reported.phases_progress.rend())) << phase;
+
+    EXPECT_THAT(last->progress, Eq(100)) << phase;
+    EXPECT_THAT(last->hashes, Eq(hashes_count)) << phase;
+    EXPECT_THAT(last->bytes_per_second, ::testing::Ge(0.)) << phase;
+  }
+
+  // Every line is a hash, a colon, a count and a new line.
+  const auto parse_last = std::find_if(
+    reported.phases_progress.rbegin(), reported.phases_progress.rend(),
+    [](const auto& progress) { return progress.phase == okon_prepare_phase_parse; });
+  EXPECT_THAT(parse_last->bytes, Eq(hashes_count * (k_text_sha1_length + 3u)));
+}
+
+TEST_F(OkonFile, Prepare_Stats_CountWorkOfEveryPhase)
+{
+  okon_prepare_stats stats;
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.stats = &stats;
+  options.filter_bits_per_key = 8u;
+
+  constexpr auto hashes_count{ 5000u };
+  const auto path = prepare(make_hashes(hashes_count), &options);
+
+  for (const auto phase :
+       { okon_prepare_phase_parse, okon_prepare_phase_sort, okon_prepare_phase_write }) {
+    EXPECT_THAT(stats.phases[phase].hashes, Eq(hashes_count)) << phase;
+    EXPECT_THAT(stats.phases[phase].wall_seconds, ::testing::Ge(0.)) << phase;
+    EXPECT_THAT(stats.phases[phase].wall_seconds, ::testing::Le(stats.wall_seconds)) << phase;
+  }
+
+  // Without the memory budget all the hashes go through the intermediate files.
+  const auto input_size = hashes_count * (k_text_sha1_length + 3u);
+  EXPECT_THAT(stats.input_bytes_read, Eq(input_size));
+  EXPECT_THAT(stats.intermediate_bytes_written, Eq(hashes_count * sizeof(sha1_t)));
+  EXPECT_THAT(stats.intermediate_bytes_read, Eq(hashes_count * sizeof(sha1_t)));
+
+  const auto output_size = std::filesystem::file_size(path) +
+    std::filesystem::file_size(path + ".filter");
+  EXPECT_THAT(stats.output_bytes_written, Eq(output_size));
+}
+
+TEST_F(OkonFile, HandleExistsText_HashesExceedMemoryBudget_PreparedHashesAreFound)
+{
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.memory_budget = 30000u * sizeof(sha1_t) / 2u;
+
+  const auto path = prepare(make_hashes(30000u), &options);
+
+  EXPECT_TRUE(std::filesystem::exists(wd() / "00"));
+
+  auto handle = okon_open(path.c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  for (auto i = 0u; i < 60000u; ++i) {
+    const auto expected =
+      (i % 2u == 0u) ? okon_exists_result_exists : okon_exists_result_doesnt_exist;
+    EXPECT_THAT(okon_handle_exists_text(handle, make_hash(i).c_str()), Eq(expected));
+  }
+
+  okon_close(handle);
+}
+
+TEST_F(OkonFile, Merge_DeltaWithNewAndDuplicatedHashes_AllHashesAreFound)
+{
+  for (const auto format : supported_formats({ okon_format_btree_v1, okon_format_btree_v2,
+                                               okon_format_btree_v3, okon_format_btree_v4,
+                                               okon_format_static_tree,
+                                               okon_format_flat_sorted })) {
+    okon_prepare_options options;
+    okon_prepare_options_init(&options);
+    options.format = format;
+
+    // Prepared file has even hashes below 6000. Delta adds odd ones below 3000 and repeats some
+    // of the prepared ones.
+    const auto prepared_path = prepare(make_hashes(3000u), &options);
+    const auto prepared_copy_path = (wd() / "prepared.okon").string();
+    std::filesystem::copy_file(prepared_path, prepared_copy_path,
+                               std::filesystem::copy_options::overwrite_existing);
+
+    std::vector<std::string> delta = make_hashes(1500u, /*step=*/2u);
+    for (auto i = 0u; i < 1500u; ++i) {
+      delta.push_back(make_hash(i * 2u + 1u));
+    }
+
+    const auto delta_path = (wd() / "delta.txt").string();
+    {
+      std::ofstream delta_file{ delta_path };
+      for (const auto& hash : delta) {
+        delta_file << hash << ":1\n";
+      }
+    }
+
+    const auto merged_path = (wd() / "merged.okon").string();
+    const auto wd_path = wd().string() + '/';
+    ASSERT_THAT(okon_merge(prepared_copy_path.c_str(), delta_path.c_str(), wd_path.c_str(),
+                           merged_path.c_str(), &options),
+                Eq(okon_prepare_result_success));
+
+    auto handle = okon_open(merged_path.c_str());
+    ASSERT_THAT(handle, ::testing::NotNull());
+
+    for (auto i = 0u; i < 6002u; ++i) {
+      const auto expected = (i % 2u == 0u && i < 6000u) || (i % 2u == 1u && i < 3000u)
+        ? okon_exists_result_exists
+        : okon_exists_result_doesnt_exist;
+      EXPECT_THAT(okon_handle_exists_text(handle, make_hash(i).c_str()), Eq(expected))
+        << "format " << format << ", hash " << i;
+    }
+
+    okon_close(handle);
+  }
+}
+
+TEST_F(OkonFile, Merge_NotExistingPreparedFile_ReturnsError)
+{
+  const auto wd_path = wd().string() + '/';
+  const auto output_path = (wd() / "merged.okon").string();
+
+  EXPECT_THAT(okon_merge("/not/existing/file.okon", "/not/existing/delta.txt", wd_path.c_str(),
+                         output_path.c_str(), nullptr),
+              Eq(okon_prepare_result_could_not_open_prepared_file));
+}
+
+TEST_F(OkonFile, Merge_OutputOverwritesPreparedFile_ReturnsInvalidOptions)
+{
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.filter_bits_per_key = 10u;
+  const auto prepared_path = prepare(make_hashes(1000u), &options);
+  const auto prepared_size = std::filesystem::file_size(prepared_path);
+
+  const auto delta_path = (wd() / "delta.txt").string();
+  std::ofstream{ delta_path } << make_hash(1u) << ":1\n";
+
+  const auto wd_path = wd().string() + '/';
+  // The same file through another path, and the filter of the prepared file.
+  const auto same_file_path = (wd() / "." / "output.okon").string();
+  const auto filter_path = prepared_path + ".filter";
+  for (const auto& output_path : { same_file_path, filter_path }) {
+    EXPECT_THAT(okon_merge(prepared_path.c_str(), delta_path.c_str(), wd_path.c_str(),
+                           output_path.c_str(), nullptr),
+                Eq(okon_prepare_result_invalid_options))
+      << output_path;
+  }
+
+  // An output whose filter is the prepared file.
+  const auto output_path = (wd() / "merged.okon").string();
+  const auto prepared_as_filter_path = output_path + ".filter";
+  std::filesystem::copy_file(prepared_path, prepared_as_filter_path);
+  EXPECT_THAT(okon_merge(prepared_as_filter_path.c_str(), delta_path.c_str(), wd_path.c_str(),
+                         output_path.c_str(), nullptr),
+              Eq(okon_prepare_result_invalid_options));
+  EXPECT_THAT(std::filesystem::file_size(prepared_as_filter_path), Eq(prepared_size));
+
+  // Nothing was truncated.
+  EXPECT_THAT(std::filesystem::file_size(prepared_path), Eq(prepared_size));
+  auto handle = okon_open(prepared_path.c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+  EXPECT_THAT(okon_handle_exists_text(handle, make_hash(0u).c_str()),
+              Eq(okon_exists_result_exists));
+  okon_close(handle);
+}
+
+TEST_F(OkonFile, HandleExistsText_NotPreparedHashes_AreNotFound)
+{
+  const auto path = prepare(make_hashes(5000u));
+
+  auto handle = okon_open(path.c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  for (auto i = 0u; i < 5000u; ++i) {
+    const auto hash = make_hash(i * 2u + 1u);
+    EXPECT_THAT(okon_handle_exists_text(handle, hash.c_str()),
+                Eq(okon_exists_result_doesnt_exist));
+  }
+
+  okon_close(handle);
+}
+
+TEST_F(OkonFile, HandleExistsBinary_MatchesExistsText)
+{
+  const auto hashes = make_hashes(100u, 3u);
+  const auto path = prepare(hashes);
+
+  auto handle = okon_open(path.c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  for (auto i = 0u; i < 300u; ++i) {
+    const auto hash = make_hash(i);
+    const auto binary = details::string_sha1_to_binary(hash.c_str());
+    EXPECT_THAT(okon_handle_exists_binary(handle, binary.data()),
+                Eq(okon_exists_text(hash.c_str(), path.c_str())));
+  }
+
+  okon_close(handle);
+}
+
+TEST_F(OkonFile, HandleExistsText_PinnedLevels_FindsSameHashes)
+{
+  const auto hashes = make_hashes(5000u);
+  const auto path = prepare(hashes);
+
+  for (const auto budget : { 0ull, 30000ull }) {
+    okon_open_options options;
+    okon_open_options_init(&options);
+    options.pinned_levels = 2u;
+    options.pinned_bytes_budget = budget;
+
+    auto handle = okon_open_ex(path.c_str(), &options);
+    ASSERT_THAT(handle, ::testing::NotNull());
+
+    for (auto i = 0u; i < 10000u; ++i) {
+      const auto hash = make_hash(i);
+      const auto expected =
+        (i % 2u == 0u) ? okon_exists_result_exists : okon_exists_result_doesnt_exist;
+      EXPECT_THAT(okon_handle_exists_text(handle, hash.c_str()), Eq(expected));
+    }
+
+    okon_close(handle);
+  }
+}
+
+TEST_F(OkonFile, HandleExistsText_Resident_FindsSameHashes)
+{
+  for (const auto format : supported_formats({ okon_format_btree_v1, okon_format_btree_v4,
+                                               okon_format_static_tree,
+                                               okon_format_flat_sorted })) {
+    okon_prepare_options prepare_options;
+    okon_prepare_options_init(&prepare_options);
+    prepare_options.format = format;
+    prepare_options.filter_bits_per_key = 8u;
+    const auto path = prepare(make_hashes(5000u), &prepare_options);
+
+    // Reserved huge pages are rarely there, transparent ones are used instead.
+    for (const auto huge_page_size : { 0ull, 2ull << 20u, 1ull << 30u }) {
+      okon_open_options options;
+      okon_open_options_init(&options);
+      options.resident = 1;
+      options.huge_page_size = huge_page_size;
+
+      auto handle = okon_open_ex(path.c_str(), &options);
+      ASSERT_THAT(handle, ::testing::NotNull());
+
+      for (auto i = 0u; i < 10000u; ++i) {
+        const auto hash = make_hash(i);
+        const auto expected =
+          (i % 2u == 0u) ? okon_exists_result_exists : okon_exists_result_doesnt_exist;
+        EXPECT_THAT(okon_handle_exists_text(handle, hash.c_str()), Eq(expected))
+          << "format " << format << ", huge pages " << huge_page_size << ", hash " << i;
+      }
+
+      okon_close(handle);
+    }
+  }
+}
+
+TEST_F(OkonFile, HandleExistsText_ResidentSharded_FindsSameHashes)
+{
+  okon_prepare_options prepare_options;
+  okon_prepare_options_init(&prepare_options);
+  prepare_options.shards_count = 7u;
+  const auto path = prepare(make_hashes(5000u), &prepare_options);
+
+  okon_open_options options;
+  okon_open_options_init(&options);
+  options.resident = 1;
+
+  auto handle = okon_open_ex(path.c_str(), &options);
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  for (auto i = 0u; i < 10000u; ++i) {
+    const auto expected =
+      (i % 2u == 0u) ? okon_exists_result_exists : okon_exists_result_doesnt_exist;
+    EXPECT_THAT(okon_handle_exists_text(handle, make_hash(i).c_str()), Eq(expected)) << i;
+  }
+
+  okon_close(handle);
+}
+
+TEST(Okon, OpenEx_ResidentNotExistingFile_ReturnsNull)
+{
+  okon_open_options options;
+  okon_open_options_init(&options);
+  options.resident = 1;
+
+  EXPECT_THAT(okon_open_ex("/not/existing/file.okon", &options), ::testing::IsNull());
+}
+
+TEST_F(OkonFile, ExistsBatch_MatchesHandleExistsBinary)
+{
+  const auto path = prepare(make_hashes(5000u));
+
+  auto handle = okon_open(path.c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  std::vector<sha1_t> sha1s;
+  for (auto i = 0u; i < 10000u; ++i) {
+    sha1s.push_back(details::string_sha1_to_binary(make_hash((i * 7919u) % 10000u).c_str()));
+  }
+
+  std::vector<uint8_t> results(sha1s.size());
+  okon_exists_batch(handle, sha1s.data(), sha1s.size(), results.data());
+
+  for (auto i = 0u; i < sha1s.size(); ++i) {
+    const auto expected = okon_handle_exists_binary(handle, sha1s[i].data());
+    EXPECT_THAT(results[i], Eq(expected == okon_exists_result_exists ? 1u : 0u));
+  }
+
+  okon_close(handle);
+}
+
+TEST_F(OkonFile, ExistsPassword_HashesOfPasswords_AreFound)
+{
+#if OKON_KEY_SIZE == 20
+  // SHA-1 of "password", "abc" and of the empty password.
+  const auto path = prepare({ "5BAA61E4C9B93F3F0682250B6CF8331B7EE68FD8",
+                              "A9993E364706816ABA3E25717850C26C9CD0D89D",
+                              "DA39A3EE5E6B4B0D3255BFEF95601890AFD80709" });
+#else
+  // NTLM of "password", "abc" and of the empty password.
+  const auto path = prepare({ "8846F7EAEE8FB117AD06BDD830B7586C",
+                              "E0FBA38268D0EC66EF1CB452D5885E53",
+                              "31D6CFE0D16AE931B73C59D7E0C089C0" });
+#endif
+
+  auto handle = okon_open(path.c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  const std::vector<std::string> passwords{ "password", "abc", "", "Password", "abcd" };
+  for (auto i = 0u; i < passwords.size(); ++i) {
+    const auto expected = i < 3u ? okon_exists_result_exists : okon_exists_result_doesnt_exist;
+    EXPECT_THAT(okon_exists_password(handle, passwords[i].data(), passwords[i].size()),
+                Eq(expected))
+      << passwords[i];
+  }
+
+  std::vector<const char*> pointers;
+  std::vector<size_t> lengths;
+  for (const auto& password : passwords) {
+    pointers.push_back(password.data());
+    lengths.push_back(password.size());
+  }
+
+  std::vector<uint8_t> results(passwords.size());
+  okon_exists_passwords_batch(handle, pointers.data(), lengths.data(), passwords.size(),
+                              results.data());
+  EXPECT_THAT(results, Eq(std::vector<uint8_t>{ 1u, 1u, 1u, 0u, 0u }));
+
+  okon_close(handle);
+}
+
+TEST_F(OkonFile, ExistsBatch_BtreeFormatsWithPinnedLevels_MatchesHandleExistsBinary)
+{
+  for (const auto format : supported_formats({ okon_format_btree_v1, okon_format_btree_v2,
+                                               okon_format_btree_v3, okon_format_btree_v4 })) {
+    okon_prepare_options options;
+    okon_prepare_options_init(&options);
+    options.format = format;
+    options.btree_node_size = 1024u;
+    const auto path = prepare(make_hashes(5000u), &options);
+
+    okon_open_options open_options;
+    okon_open_options_init(&open_options);
+    open_options.pinned_levels = 1u;
+    auto handle = okon_open_ex(path.c_str(), &open_options);
+    ASSERT_THAT(handle, ::testing::NotNull());
+
+    std::vector<sha1_t> sha1s;
+    for (auto i = 0u; i < 10000u; ++i) {
+      sha1s.push_back(details::string_sha1_to_binary(make_hash((i * 7919u) % 10000u).c_str()));
+    }
+
+    std::vector<uint8_t> results(sha1s.size());
+    okon_exists_batch(handle, sha1s.data(), sha1s.size(), results.data());
+
+    for (auto i = 0u; i < sha1s.size(); ++i) {
+      const auto expected = okon_handle_exists_binary(handle, sha1s[i].data());
+      EXPECT_THAT(results[i], Eq(expected == okon_exists_result_exists ? 1u : 0u))
+        << "format " << format << ", hash " << i;
+    }
+
+    okon_close(handle);
+  }
+}
+
+TEST_F(OkonFile, ExistsBatch_MultipleThreads_MatchesHandleExistsBinary)
+{
+  const auto path = prepare(make_hashes(20000u));
+
+  okon_open_options options;
+  okon_open_options_init(&options);
+  options.threads = 4u;
+
+  auto handle = okon_open_ex(path.c_str(), &options);
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  std::vector<sha1_t> sha1s;
+  for (auto i = 0u; i < 40000u; ++i) {
+    sha1s.push_back(details::string_sha1_to_binary(make_hash((i * 7919u) % 40000u).c_str()));
+  }
+
+  std::vector<uint8_t> results(sha1s.size());
+  okon_exists_batch(handle, sha1s.data(), sha1s.size(), results.data());
+
+  for (auto i = 0u; i < sha1s.size(); ++i) {
+    const auto expected = okon_handle_exists_binary(handle, sha1s[i].data());
+    EXPECT_THAT(results[i], Eq(expected == okon_exists_result_exists ? 1u : 0u));
+  }
+
+  okon_close(handle);
+}
+
+TEST_F(OkonFile, HandleStats_PinnedRoot_CountsLookupsAndNodeReads)
+{
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.btree_node_size = 1024u;
+  const auto path = prepare(make_hashes(5000u), &options);
+
+  okon_open_options open_options;
+  okon_open_options_init(&open_options);
+  open_options.pinned_levels = 1u;
+  open_options.collect_stats = 1;
+  auto handle = okon_open_ex(path.c_str(), &open_options);
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  std::vector<sha1_t> sha1s;
+  for (auto i = 0u; i < 10000u; ++i) {
+    sha1s.push_back(details::string_sha1_to_binary(make_hash(i).c_str()));
+    okon_handle_exists_binary(handle, sha1s.back().data());
+  }
+
+  okon_lookup_stats stats;
+  ASSERT_THAT(okon_handle_stats(handle, &stats), Eq(1));
+  EXPECT_THAT(stats.lookups, Eq(10000u));
+  EXPECT_THAT(stats.hits, Eq(5000u));
+  EXPECT_THAT(stats.misses, Eq(5000u));
+  EXPECT_THAT(stats.pinned_node_reads[0], Eq(10000u));
+  EXPECT_THAT(stats.node_reads[0], Eq(0u));
+  EXPECT_THAT(stats.node_reads[1], ::testing::Gt(0u));
+  EXPECT_THAT(stats.bytes_read, ::testing::Ge(stats.node_reads[1] * options.btree_node_size / 2u));
+
+  unsigned long long latencies_count{ 0u };
+  for (const auto count : stats.latency_histogram) {
+    latencies_count += count;
+  }
+  EXPECT_THAT(latencies_count, Eq(10000u));
+
+  // A batch descends the tree once for all of its hashes.
+  std::vector<uint8_t> results(sha1s.size());
+  okon_exists_batch(handle, sha1s.data(), sha1s.size(), results.data());
+
+  okon_lookup_stats batch_stats;
+  ASSERT_THAT(okon_handle_stats(handle, &batch_stats), Eq(1));
+  EXPECT_THAT(batch_stats.lookups, Eq(20000u));
+  EXPECT_THAT(batch_stats.hits, Eq(10000u));
+  EXPECT_THAT(batch_stats.pinned_node_reads[0], ::testing::Lt(10000u + 100u));
+  EXPECT_THAT(batch_stats.node_reads[1] - stats.node_reads[1],
+              ::testing::Lt(stats.node_reads[1]));
+
+  okon_close(handle);
+}
+
+TEST_F(OkonFile, HandleStats_NotEnabled_ReturnsZero)
+{
+  const auto path = prepare(make_hashes(100u));
+
+  auto handle = okon_open(path.c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  okon_lookup_stats stats;
+  EXPECT_THAT(okon_handle_stats(handle, &stats), Eq(0));
+
+  okon_close(handle);
+}
+
+namespace {
+struct traced_node
+{
+  unsigned level;
+  uint32_t node_pointer;
+  int is_pinned;
+};
+
+void trace_node(void* user_data, unsigned level, uint32_t node_pointer, int is_pinned)
+{
+  static_cast<std::vector<traced_node>*>(user_data)->push_back(
+    traced_node{ level, node_pointer, is_pinned });
+}
+}
+
+TEST_F(OkonFile, TraceCallback_Lookup_TracesPathFromRoot)
+{
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.btree_node_size = 1024u;
+  const auto path = prepare(make_hashes(5000u), &options);
+
+  std::vector<traced_node> traced;
+  okon_open_options open_options;
+  okon_open_options_init(&open_options);
+  open_options.pinned_levels = 1u;
+  open_options.trace_callback = &trace_node;
+  open_options.trace_user_data = &traced;
+  auto handle = okon_open_ex(path.c_str(), &open_options);
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  // Misses go down to the leaves, and every lookup starts at the root.
+  std::vector<uint32_t> roots;
+  for (const auto i : { 1u, 4001u, 9999u }) {
+    traced.clear();
+    EXPECT_THAT(okon_handle_exists_text(handle, make_hash(i).c_str()),
+                Eq(okon_exists_result_doesnt_exist));
+
+    ASSERT_THAT(traced.size(), ::testing::Ge(2u));
+    for (auto level = 0u; level < traced.size(); ++level) {
+      EXPECT_THAT(traced[level].level, Eq(level));
+      EXPECT_THAT(traced[level].is_pinned, Eq(level == 0u ? 1 : 0));
+    }
+    roots.push_back(traced.front().node_pointer);
+  }
+  EXPECT_THAT(roots, ::testing::Each(Eq(roots.front())));
+
+  okon_lookup_stats stats;
+  ASSERT_THAT(okon_handle_stats(handle, &stats), Eq(1));
+  EXPECT_THAT(stats.lookups, Eq(3u));
+
+  okon_close(handle);
+}
+
+TEST_F(OkonFile, Range_Prefixes_ReturnsSortedHashesWithPrefix)
+{
+  for (const auto format : supported_formats({ okon_format_btree_v1, okon_format_btree_v2,
+                                               okon_format_btree_v3, okon_format_btree_v4,
+                                               okon_format_static_tree,
+                                               okon_format_flat_sorted })) {
+    okon_prepare_options options;
+    okon_prepare_options_init(&options);
+    options.format = format;
+
+    auto hashes = make_hashes(5000u);
+    const auto path = prepare(hashes, &options);
+    std::sort(hashes.begin(), hashes.end());
+
+    auto handle = okon_open(path.c_str());
+    ASSERT_THAT(handle, ::testing::NotNull());
+
+    for (const auto& probe : { hashes[0], hashes[1234], hashes.back(), make_hash(1u) }) {
+      for (const auto length : { 0u, 1u, 2u, 3u, 5u, 9u, 40u }) {
+        std::string prefix = probe.substr(0u, length);
+        std::vector<std::string> expected;
+        std::copy_if(
+          hashes.begin(), hashes.end(), std::back_inserter(expected),
+          [&prefix](const auto& hash) { return hash.compare(0u, prefix.size(), prefix) == 0; });
+
+        std::transform(prefix.begin(), prefix.end(), prefix.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+        std::vector<std::string> result;
+        EXPECT_THAT(
+          okon_range(handle, prefix.c_str(), prefix.size(), &collect_range_hash, &result),
+          Eq(okon_range_result_success));
+        EXPECT_THAT(result, Eq(expected)) << "format " << format << ", prefix " << prefix;
+      }
+    }
+
+    okon_close(handle);
+  }
+}
+
+TEST_F(OkonFile, Range_CallbackReturnsZero_StopsQuery)
+{
+  const auto path = prepare(make_hashes(100u));
+  auto handle = okon_open(path.c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  auto calls = 0u;
+  EXPECT_THAT(okon_range(handle, "", 0u, &stop_range, &calls), Eq(okon_range_result_success));
+  EXPECT_THAT(calls, Eq(1u));
+
+  okon_close(handle);
+}
+
+TEST_F(OkonFile, Range_InvalidPrefix_ReturnsError)
+{
+  const auto path = prepare(make_hashes(100u));
+  auto handle = okon_open(path.c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  auto calls = 0u;
+  EXPECT_THAT(okon_range(handle, "12G45", 5u, &stop_range, &calls),
+              Eq(okon_range_result_invalid_prefix));
+
+  const std::string too_long(41u, 'A');
+  EXPECT_THAT(okon_range(handle, too_long.c_str(), too_long.size(), &stop_range, &calls),
+              Eq(okon_range_result_invalid_prefix));
+  EXPECT_THAT(calls, Eq(0u));
+
+  okon_close(handle);
+}
+
+TEST_F(OkonFile, LookupCount_PreparedWithCounts_ReturnsCountsOfHashes)
+{
+  for (const auto format : { okon_format_static_tree, okon_format_flat_sorted }) {
+    okon_prepare_options options;
+    okon_prepare_options_init(&options);
+    options.format = format;
+    options.with_counts = 1;
+
+    std::string input;
+    for (auto i = 0u; i < 5000u; ++i) {
+      input += make_hash(i * 2u) + ':' + std::to_string(i * 1000u) + '\n';
+    }
+    input += make_hash(1u) + ":99999999999\n";
+    input += make_hash(3u) + '\n';
+
+    const auto path = prepare_input(input, &options);
+    auto handle = okon_open(path.c_str());
+    ASSERT_THAT(handle, ::testing::NotNull());
+
+    for (auto i = 0u; i < 5000u; ++i) {
+      EXPECT_THAT(okon_lookup_count(handle, make_hash(i * 2u).c_str()), Eq(i * 1000u))
+        << "format " << format << ", hash " << i;
+    }
+    EXPECT_THAT(okon_lookup_count(handle, make_hash(1u).c_str()), Eq(0xFFFFFFFFu));
+    EXPECT_THAT(okon_lookup_count(handle, make_hash(3u).c_str()), Eq(1u));
+    EXPECT_THAT(okon_lookup_count(handle, make_hash(5u).c_str()), Eq(0u));
+    EXPECT_THAT(okon_handle_exists_text(handle, make_hash(2u).c_str()),
+                Eq(okon_exists_result_exists));
+
+    okon_close(handle);
+  }
+}
+
+TEST_F(OkonFile, LookupCount_PreparedWithoutCounts_ReturnsOneForPreparedHashes)
+{
+  const auto path = prepare(make_hashes(100u));
+  auto handle = okon_open(path.c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  EXPECT_THAT(okon_lookup_count(handle, make_hash(2u).c_str()), Eq(1u));
+  EXPECT_THAT(okon_lookup_count(handle, make_hash(3u).c_str()), Eq(0u));
+
+  okon_close(handle);
+}
+
+TEST_F(OkonFile, Prepare_CountsInBtreeFormat_ReturnsCountsNotSupported)
+{
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.format = okon_format_btree_v2;
+  options.with_counts = 1;
+
+  prepare_input(make_hash(1u) + ":5\n", &options, okon_prepare_result_counts_not_supported);
+}
+
+TEST_F(OkonFile, Merge_WithCounts_SumsCountsOfHashesInBothFiles)
+{
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.format = okon_format_flat_sorted;
+  options.with_counts = 1;
+
+  std::string input;
+  for (auto i = 0u; i < 1000u; ++i) {
+    input += make_hash(i * 2u) + ":10\n";
+  }
+  const auto prepared_path = prepare_input(input, &options);
+
+  const auto delta_path = (wd() / "delta.txt").string();
+  {
+    std::ofstream delta{ delta_path };
+    for (auto i = 0u; i < 1000u; ++i) {
+      delta << make_hash(i) << ":3\n";
+    }
+  }
+
+  const auto merged_path = (wd() / "merged.okon").string();
+  const auto wd_path = wd().string() + '/';
+  ASSERT_THAT(okon_merge(prepared_path.c_str(), delta_path.c_str(), wd_path.c_str(),
+                         merged_path.c_str(), &options),
+              Eq(okon_prepare_result_success));
+
+  auto handle = okon_open(merged_path.c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  for (auto i = 0u; i < 2000u; ++i) {
+    const auto expected = (i % 2u == 0u ? 10u : 0u) + (i < 1000u ? 3u : 0u);
+    EXPECT_THAT(okon_lookup_count(handle, make_hash(i).c_str()), Eq(expected)) << "hash " << i;
+  }
+
+  okon_close(handle);
+}
+
+TEST_F(OkonFile, HandleExistsText_PreparedWithFilter_FindsSameHashes)
+{
+  for (const auto format : { okon_format_btree_v2, okon_format_flat_sorted }) {
+    okon_prepare_options options;
+    okon_prepare_options_init(&options);
+    options.format = format;
+    options.filter_bits_per_key = 8u;
+
+    const auto path = prepare(make_hashes(5000u), &options);
+    ASSERT_TRUE(std::filesystem::exists(path + ".filter"));
+
+    auto handle = okon_open(path.c_str());
+    ASSERT_THAT(handle, ::testing::NotNull());
+
+    std::vector<sha1_t> sha1s;
+    for (auto i = 0u; i < 10002u; ++i) {
+      const auto expected = i % 2u == 0u && i < 10000u ? okon_exists_result_exists
+                                                       : okon_exists_result_doesnt_exist;
+      EXPECT_THAT(okon_handle_exists_text(handle, make_hash(i).c_str()), Eq(expected))
+        << "format " << format << ", hash " << i;
+      sha1s.push_back(details::string_sha1_to_binary(make_hash(i).c_str()));
+    }
+
+    std::vector<uint8_t> results(sha1s.size());
+    okon_exists_batch(handle, sha1s.data(), sha1s.size(), results.data());
+    for (auto i = 0u; i < sha1s.size(); ++i) {
+      EXPECT_THAT(results[i], Eq(i % 2u == 0u && i < 10000u ? 1u : 0u)) << "hash " << i;
+    }
+
+    okon_close(handle);
+  }
+}
+
+TEST_F(OkonFile, Prepare_WithoutFilter_RemovesFilterOfPreviousOutput)
+{
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.filter_bits_per_key = 8u;
+
+  const auto path = prepare(make_hashes(100u), &options);
+  ASSERT_TRUE(std::filesystem::exists(path + ".filter"));
+
+  prepare(make_hashes(200u, 3u));
+  EXPECT_FALSE(std::filesystem::exists(path + ".filter"));
+
+  auto handle = okon_open(path.c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+  EXPECT_THAT(okon_handle_exists_text(handle, make_hash(3u).c_str()),
+              Eq(okon_exists_result_exists));
+  okon_close(handle);
+}
+
+TEST_F(OkonFile, HandleExistsText_FormatBloomFilter_PreparedHashesAreFound)
+{
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.format = okon_format_bloom_filter;
+
+  const auto path = prepare(make_hashes(20000u), &options);
+  EXPECT_LT(std::filesystem::file_size(path), 20000u * 2u);
+
+  auto handle = okon_open(path.c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+
+  auto false_positives = 0u;
+  for (auto i = 0u; i < 40000u; ++i) {
+    const auto result = okon_handle_exists_text(handle, make_hash(i).c_str());
+    if (i % 2u == 0u) {
+      EXPECT_THAT(result, Eq(okon_exists_result_exists)) << "hash " << i;
+    } else {
+      false_positives += result == okon_exists_result_exists ? 1u : 0u;
+    }
+  }
+  EXPECT_LT(false_positives, 20000u / 100u);
+
+  auto calls = 0u;
+  EXPECT_THAT(okon_range(handle, "", 0u, &stop_range, &calls),
+              Eq(okon_range_result_keys_not_stored));
+
+  okon_close(handle);
+}
+
+TEST_F(OkonFile, Merge_IntoBloomFilter_AllHashesAreFound)
+{
+  const auto prepared_path = prepare(make_hashes(1000u));
+  const auto prepared_copy_path = (wd() / "prepared.okon").string();
+  std::filesystem::copy_file(prepared_path, prepared_copy_path);
+
+  const auto delta_path = (wd() / "delta.txt").string();
+  {
+    std::ofstream delta{ delta_path };
+    for (auto i = 0u; i < 1000u; ++i) {
+      delta << make_hash(i * 2u + 1u) << ":1\n";
+    }
+  }
+
+  okon_prepare_options options;
+  okon_prepare_options_init(&options);
+  options.format = okon_format_bloom_filter;
+
+  const auto merged_path = (wd() / "merged.okon").string();
+  const auto wd_path = wd().string() + '/';
+  ASSERT_THAT(okon_merge(prepared_copy_path.c_str(), delta_path.c_str(), wd_path.c_str(),
+                         merged_path.c_str(), &options),
+              Eq(okon_prepare_result_success));
+
+  auto handle = okon_open(merged_path.c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+  for (auto i = 0u; i < 2000u; ++i) {
+    EXPECT_THAT(okon_handle_exists_text(handle, make_hash(i).c_str()),
+                Eq(okon_exists_result_exists))
+      << "hash " << i;
+  }
+  okon_close(handle);
+
+  // A filter doesn't keep the hashes, so it can't be merged further.
+  const auto next_merged_path = (wd() / "next_merged.okon").string();
+  EXPECT_THAT(okon_merge(merged_path.c_str(), delta_path.c_str(), wd_path.c_str(),
+                         next_merged_path.c_str(), &options),
+              Eq(okon_prepare_result_could_not_open_prepared_file));
+}
+}
@@ -170,4 +170,43 @@ TEST(OriginalFileReader, NextSha1_BufferBiggerThanInput_ReturnsHashesAndThenNull
   const auto next_next_result = reader.next_sha1();
   EXPECT_THAT(next_next_result, Eq(std::nullopt));
 }
+
+TEST(OriginalFileReader, NextLines_LinesSplitBetweenBuffers_ReturnsWholeLines)
+{
+  const auto first_line = std::string{ k_zero_hash } + ":1234\n";
+  const auto second_line = std::string{ k_one_hash } + ":1\n";
+  auto storage = to_storage(first_line + second_line + std::string{ k_zero_hash });
+  auto reader = make_original_file_reader(storage, /*buffer_size=*/50u);
+
+  std::vector<char> lines;
+  std::vector<std::string> parts;
+  while (const auto size = reader.next_lines(lines)) {
+    ASSERT_THAT(lines.size(), Eq(size + k_text_sha1_length_for_simd));
+    parts.emplace_back(lines.data(), size);
+  }
+
+  EXPECT_THAT(parts, ::testing::ElementsAre(first_line, second_line, std::string{ k_zero_hash }));
+}
+
+TEST(OriginalFileReader, NextLines_Empty_ReturnsZero)
+{
+  memory_storage storage{};
+  auto reader = make_original_file_reader(storage, /*buffer_size=*/1024u);
+
+  std::vector<char> lines;
+  EXPECT_THAT(reader.next_lines(lines), Eq(0u));
+}
+
+TEST(OriginalFileReader, BytesRead_AllInputRead_IsSizeOfInput)
+{
+  const auto input = std::string{ k_zero_hash } + ":1234\n" + std::string{ k_one_hash } + ":1\n";
+  auto storage = to_storage(input);
+  auto reader = make_original_file_reader(storage, /*buffer_size=*/50u);
+
+  std::vector<char> lines;
+  while (reader.next_lines(lines) > 0u) {
+  }
+
+  EXPECT_THAT(reader.bytes_read(), Eq(input.size()));
+}
 }
@@ -0,0 +1,265 @@
+#include <okon/okon.h>
+
+#include "prepare_checkpoint.hpp"
+#include "sha1_utils.hpp"
+#include "splitted_files.hpp"
+
+#include <gmock/gmock.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace okon::test {
+using ::testing::ElementsAre;
+using ::testing::Eq;
+
+namespace {
+sha1_t make_sha1(unsigned value)
+{
+  // Spread hashes over all the intermediate files, keeping them unique.
+  sha1_t sha1{};
+  sha1[0] = static_cast<uint8_t>(value * 37u);
+  for (auto i = 0u; i < sizeof(value); ++i) {
+    sha1[i + 1u] = static_cast<uint8_t>(value >> (8u * (sizeof(value) - 1u - i)));
+  }
+  return sha1;
+}
+
+std::string read_file(const std::filesystem::path& path)
+{
+  std::ifstream file{ path, std::ios::binary };
+  return { std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+}
+
+prepare_checkpoint make_checkpoint()
+{
+  prepare_checkpoint checkpoint;
+  checkpoint.identity.input_path = "input.txt";
+  checkpoint.identity.input_size = 1234u;
+  checkpoint.identity.input_write_time = -5;
+  checkpoint.identity.output_path = "output.okon";
+  checkpoint.identity.format = 2u;
+  checkpoint.identity.record_size = 20u;
+  checkpoint.identity.shards_count = 4u;
+  checkpoint.identity.merged_keys_count = 7u;
+  checkpoint.parsed = true;
+  checkpoint.parsed_bytes = 1234u;
+  checkpoint.records_counts = { 1u, 2u, 3u };
+  checkpoint.written_shards_keys_counts = { 10u, 20u };
+  return checkpoint;
+}
+
+class PrepareCheckpoint : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    const auto* test_info = ::testing::UnitTest::GetInstance()->current_test_info();
+    m_wd = std::filesystem::temp_directory_path() / "okon_prepare_checkpoint_test" /
+      test_info->name();
+    std::filesystem::remove_all(m_wd);
+    std::filesystem::create_directories(m_wd);
+
+    m_input_path = (m_wd / "input.txt").string();
+    m_output_path = (m_wd / "output.okon").string();
+
+    std::ofstream input{ m_input_path };
+    for (auto i = 0u; i < k_hashes_count; ++i) {
+      input << binary_sha1_to_string(make_sha1(i)) << ":1\n";
+    }
+  }
+
+  void TearDown() override
+  {
+    std::filesystem::remove_all(m_wd);
+  }
+
+  // One thread writes records of every intermediate file in the order of the input. Shard 2 of
+  // the output is a directory, so writing it fails after shards 0 and 1 are written.
+  okon_prepare_options failing_shard_options()
+  {
+    okon_prepare_options options;
+    okon_prepare_options_init(&options);
+    options.threads = 1u;
+    options.shards_count = 4u;
+    options.checkpoint_interval = 1u;
+    std::filesystem::create_directories(m_output_path + ".shard2");
+    return options;
+  }
+
+  okon_prepare_result prepare(const okon_prepare_options& options)
+  {
+    const auto wd = m_wd.string() + '/';
+    return okon_prepare_ex(m_input_path.c_str(), wd.c_str(), m_output_path.c_str(), &options);
+  }
+
+  std::string checkpoint_path() const
+  {
+    return (m_wd / "checkpoint").string();
+  }
+
+  void expect_all_hashes_found()
+  {
+    auto handle = okon_open(m_output_path.c_str());
+    ASSERT_THAT(handle, ::testing::NotNull());
+
+    for (auto i = 0u; i < 2u * k_hashes_count; ++i) {
+      const auto expected =
+        i < k_hashes_count ? okon_exists_result_exists : okon_exists_result_doesnt_exist;
+      EXPECT_THAT(okon_handle_exists_binary(handle, make_sha1(i).data()), Eq(expected))
+        << "hash " << i;
+    }
+
+    okon_close(handle);
+  }
+
+  static constexpr auto k_hashes_count{ 20000u };
+  static constexpr auto k_line_length{ 43u };
+
+  std::filesystem::path m_wd;
+  std::string m_input_path;
+  std::string m_output_path;
+};
+}
+
+TEST(PrepareCheckpointSerialization, Serialize_FromMemory_GivesSameCheckpoint)
+{
+  const auto checkpoint = make_checkpoint();
+  const auto data = checkpoint.serialize();
+
+  const auto read = prepare_checkpoint::from_memory(data.data(), data.size());
+  ASSERT_TRUE(read.has_value());
+  EXPECT_TRUE(read->identity == checkpoint.identity);
+  EXPECT_THAT(read->parsed, Eq(true));
+  EXPECT_THAT(read->parsed_bytes, Eq(1234u));
+  EXPECT_THAT(read->records_counts, ElementsAre(1u, 2u, 3u));
+  EXPECT_THAT(read->written_shards_keys_counts, ElementsAre(10u, 20u));
+}
+
+TEST(PrepareCheckpointSerialization, FromMemory_TruncatedOrCorrupted_ReturnsNullopt)
+{
+  const auto data = make_checkpoint().serialize();
+
+  for (auto size = 0u; size < data.size(); ++size) {
+    EXPECT_FALSE(prepare_checkpoint::from_memory(data.data(), size)) << "size " << size;
+  }
+
+  auto corrupted = data;
+  corrupted[0] ^= 1u;
+  EXPECT_FALSE(prepare_checkpoint::from_memory(corrupted.data(), corrupted.size()));
+
+  auto longer = data;
+  longer.push_back(0u);
+  EXPECT_FALSE(prepare_checkpoint::from_memory(longer.data(), longer.size()));
+}
+
+TEST_F(PrepareCheckpoint, Prepare_FailedShard_LeavesCheckpointOfParsedInputAndWrittenShards)
+{
+  EXPECT_THAT(prepare(failing_shard_options()), Eq(okon_prepare_result_could_not_open_output));
+
+  const auto checkpoint = prepare_checkpoint::load(checkpoint_path());
+  ASSERT_TRUE(checkpoint.has_value());
+  EXPECT_TRUE(checkpoint->parsed);
+  EXPECT_THAT(checkpoint->parsed_bytes, Eq(k_hashes_count * k_line_length));
+
+  unsigned long long records_count{ 0u };
+  for (const auto count : checkpoint->records_counts) {
+    records_count += count;
+  }
+  EXPECT_THAT(records_count, Eq(k_hashes_count));
+
+  // Each of the four shards is a quarter of the first bytes.
+  std::vector<uint64_t> shards_keys_counts(4u, 0u);
+  for (auto i = 0u; i < k_hashes_count; ++i) {
+    ++shards_keys_counts[make_sha1(i)[0] / 64u];
+  }
+  EXPECT_THAT(checkpoint->written_shards_keys_counts,
+              ElementsAre(shards_keys_counts[0], shards_keys_counts[1]));
+}
+
+TEST_F(PrepareCheckpoint, Prepare_AfterFailedShard_DoesntParseNorWriteWrittenShards)
+{
+  auto options = failing_shard_options();
+  ASSERT_THAT(prepare(options), Eq(okon_prepare_result_could_not_open_output));
+
+  // Written shards are left as they are.
+  const auto first_shard_path = m_output_path + ".shard0";
+  const auto first_shard = read_file(first_shard_path);
+  const auto checkpoint = prepare_checkpoint::load(checkpoint_path());
+  ASSERT_TRUE(checkpoint.has_value());
+  const auto written_keys_count =
+    checkpoint->written_shards_keys_counts[0] + checkpoint->written_shards_keys_counts[1];
+  std::filesystem::remove(m_output_path + ".shard2");
+
+  okon_prepare_stats stats;
+  options.stats = &stats;
+  ASSERT_THAT(prepare(options), Eq(okon_prepare_result_success));
+
+  EXPECT_THAT(stats.phases[okon_prepare_phase_parse].hashes, Eq(0u));
+  EXPECT_THAT(stats.phases[okon_prepare_phase_write].hashes,
+              Eq(k_hashes_count - written_keys_count));
+  EXPECT_THAT(read_file(first_shard_path), Eq(first_shard));
+  EXPECT_FALSE(std::filesystem::exists(checkpoint_path()));
+  expect_all_hashes_found();
+}
+
+TEST_F(PrepareCheckpoint, Prepare_CheckpointInTheMiddleOfParsing_ParsesRestOfInput)
+{
+  auto options = failing_shard_options();
+  ASSERT_THAT(prepare(options), Eq(okon_prepare_result_could_not_open_output));
+  std::filesystem::remove(m_output_path + ".shard2");
+
+  // Checkpoint of the first half of the input. The intermediate files have all the records, the
+  // ones of the second half are dropped on resume and parsed again.
+  auto checkpoint = *prepare_checkpoint::load(checkpoint_path());
+  checkpoint.parsed = false;
+  checkpoint.parsed_bytes = k_hashes_count / 2u * k_line_length;
+  checkpoint.written_shards_keys_counts.clear();
+  checkpoint.records_counts.assign(checkpoint.records_counts.size(), 0u);
+  for (auto i = 0u; i < k_hashes_count / 2u; ++i) {
+    ++checkpoint.records_counts[make_sha1(i)[0]];
+  }
+  ASSERT_TRUE(checkpoint.save(checkpoint_path()));
+
+  okon_prepare_stats stats;
+  options.stats = &stats;
+  ASSERT_THAT(prepare(options), Eq(okon_prepare_result_success));
+
+  EXPECT_THAT(stats.phases[okon_prepare_phase_parse].hashes, Eq(k_hashes_count / 2u));
+  EXPECT_THAT(stats.phases[okon_prepare_phase_write].hashes, Eq(k_hashes_count));
+  expect_all_hashes_found();
+}
+
+TEST_F(PrepareCheckpoint, Prepare_InputModifiedAfterFailure_StartsOver)
+{
+  auto options = failing_shard_options();
+  ASSERT_THAT(prepare(options), Eq(okon_prepare_result_could_not_open_output));
+  std::filesystem::remove(m_output_path + ".shard2");
+
+  // Same size, other hashes.
+  {
+    std::ofstream input{ m_input_path };
+    for (auto i = 0u; i < k_hashes_count; ++i) {
+      input << binary_sha1_to_string(make_sha1(k_hashes_count + i)) << ":1\n";
+    }
+  }
+  std::filesystem::last_write_time(
+    m_input_path, std::filesystem::last_write_time(m_input_path) + std::chrono::seconds{ 1 });
+
+  okon_prepare_stats stats;
+  options.stats = &stats;
+  ASSERT_THAT(prepare(options), Eq(okon_prepare_result_success));
+  EXPECT_THAT(stats.phases[okon_prepare_phase_parse].hashes, Eq(k_hashes_count));
+
+  auto handle = okon_open(m_output_path.c_str());
+  ASSERT_THAT(handle, ::testing::NotNull());
+  EXPECT_THAT(okon_handle_exists_binary(handle, make_sha1(0u).data()),
+              Eq(okon_exists_result_doesnt_exist));
+  EXPECT_THAT(okon_handle_exists_binary(handle, make_sha1(k_hashes_count).data()),
+              Eq(okon_exists_result_exists));
+  okon_close(handle);
+}
+}
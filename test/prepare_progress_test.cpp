@@ -0,0 +1,91 @@
+#include "prepare_progress.hpp"
+
+#include <gmock/gmock.h>
+
+#include <vector>
+
+namespace okon::test {
+using ::testing::ElementsAre;
+using ::testing::Eq;
+
+namespace {
+class PrepareProgressReporter : public ::testing::Test
+{
+protected:
+  PrepareProgressReporter()
+    : m_reporter{ [this](int progress) { m_progress.push_back(progress); },
+                  [this](const prepare_phase_progress& progress) {
+                    m_phases_progress.push_back(progress);
+                  } }
+  {
+  }
+
+  std::vector<int> m_progress;
+  std::vector<prepare_phase_progress> m_phases_progress;
+  prepare_progress_reporter m_reporter;
+};
+}
+
+TEST_F(PrepareProgressReporter, Advance_KnownNumberOfKeys_ReportsPercents)
+{
+  m_reporter.start_phase(prepare_phase::sort, /*total_keys=*/200u, /*total_bytes=*/0u);
+  m_reporter.advance(prepare_phase::sort, /*keys=*/50u, /*bytes=*/1000u);
+  m_reporter.advance(prepare_phase::sort, /*keys=*/150u, /*bytes=*/3000u);
+
+  ASSERT_THAT(m_phases_progress.size(), Eq(3u));
+  EXPECT_THAT(m_phases_progress[0].progress, Eq(0));
+  EXPECT_THAT(m_phases_progress[1].progress, Eq(25));
+  EXPECT_THAT(m_phases_progress[1].keys, Eq(50u));
+  EXPECT_THAT(m_phases_progress[2].progress, Eq(100));
+  EXPECT_THAT(m_phases_progress[2].keys, Eq(200u));
+  EXPECT_THAT(m_phases_progress[2].bytes, Eq(4000u));
+}
+
+TEST_F(PrepareProgressReporter, Advance_KnownNumberOfBytes_ReportsPercentsOfBytes)
+{
+  m_reporter.start_phase(prepare_phase::parse, /*total_keys=*/0u, /*total_bytes=*/1000u);
+  m_reporter.advance(prepare_phase::parse, /*keys=*/1u, /*bytes=*/500u);
+
+  ASSERT_THAT(m_phases_progress.size(), Eq(2u));
+  EXPECT_THAT(m_phases_progress[1].progress, Eq(50));
+}
+
+TEST_F(PrepareProgressReporter, Advance_UnknownSize_ReportsUnknownTillFinished)
+{
+  m_reporter.start_phase(prepare_phase::parse, /*total_keys=*/0u, /*total_bytes=*/0u);
+  m_reporter.advance(prepare_phase::parse, /*keys=*/1u, /*bytes=*/500u);
+  m_reporter.finish_phase(prepare_phase::parse);
+
+  ASSERT_FALSE(m_phases_progress.empty());
+  EXPECT_THAT(m_phases_progress.front().progress,
+              Eq(prepare_progress_reporter::k_progress_unknown));
+  EXPECT_THAT(m_phases_progress.back().progress, Eq(100));
+  EXPECT_THAT(m_phases_progress.back().bytes, Eq(500u));
+}
+
+TEST_F(PrepareProgressReporter, Advance_SamePercents_ReportedOnce)
+{
+  m_reporter.start_phase(prepare_phase::write, /*total_keys=*/1000u, /*total_bytes=*/0u);
+  for (auto i = 0u; i < 5u; ++i) {
+    m_reporter.advance(prepare_phase::write, /*keys=*/1u, /*bytes=*/20u);
+  }
+
+  // 0% of the start, then 0% only when the report interval passes.
+  EXPECT_THAT(m_phases_progress.size(), ::testing::Le(2u));
+}
+
+TEST_F(PrepareProgressReporter, OverallProgress_IsProgressOfWriting)
+{
+  m_reporter.start();
+  m_reporter.start_phase(prepare_phase::parse, /*total_keys=*/0u, /*total_bytes=*/100u);
+  m_reporter.advance(prepare_phase::parse, /*keys=*/10u, /*bytes=*/100u);
+  m_reporter.start_phase(prepare_phase::sort, /*total_keys=*/10u, /*total_bytes=*/0u);
+  m_reporter.start_phase(prepare_phase::write, /*total_keys=*/10u, /*total_bytes=*/0u);
+  m_reporter.advance(prepare_phase::sort, /*keys=*/10u, /*bytes=*/200u);
+  m_reporter.advance(prepare_phase::write, /*keys=*/5u, /*bytes=*/100u);
+  m_reporter.advance(prepare_phase::write, /*keys=*/5u, /*bytes=*/100u);
+  m_reporter.finish();
+
+  EXPECT_THAT(m_progress, ElementsAre(prepare_progress_reporter::k_progress_unknown, 50, 100));
+}
+}
@@ -0,0 +1,76 @@
+#include "sha1_digest.hpp"
+#include "sha1_utils.hpp"
+
+#include <gmock/gmock.h>
+
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace okon::test {
+using namespace std::literals;
+using ::testing::Eq;
+
+namespace {
+struct Sha1DigestState
+{
+  std::string message;
+  std::string_view expected;
+};
+
+const Sha1DigestState values[] = {
+  { "", "DA39A3EE5E6B4B0D3255BFEF95601890AFD80709"sv },
+  { "abc", "A9993E364706816ABA3E25717850C26C9CD0D89D"sv },
+  { "password", "5BAA61E4C9B93F3F0682250B6CF8331B7EE68FD8"sv },
+  // 56 bytes, the length doesn't fit in the block of the message.
+  { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+    "84983E441C3BD26EBAAE4AA1F95129E5E54670F1"sv },
+  { std::string(1000000u, 'a'), "34AA973CD4C4DAA4F61EEB2BDBAD27316534016F"sv }
+};
+}
+
+using Sha1DigestTest = ::testing::TestWithParam<Sha1DigestState>;
+
+TEST_P(Sha1DigestTest, Digest_IsCorrect)
+{
+  const auto& [message, expected] = GetParam();
+  EXPECT_THAT(binary_sha1_to_string(sha1_digest(message.data(), message.size())), Eq(expected))
+    << sha1_digest_name();
+  EXPECT_THAT(binary_sha1_to_string(
+                details::sha1_digest_with(&details::sha1_compress_scalar, message.data(),
+                                          message.size())),
+              Eq(expected));
+}
+
+INSTANTIATE_TEST_SUITE_P(Sha1Digest, Sha1DigestTest, ::testing::ValuesIn(values));
+
+TEST(Sha1Digest, Digests_MessagesOfAllLengths_MatchScalar)
+{
+  std::mt19937 generator{ 0u };
+  std::vector<std::string> messages;
+  for (auto size = 0u; size < 300u; ++size) {
+    std::string message(size, '\0');
+    for (auto& byte : message) {
+      byte = static_cast<char>(generator());
+    }
+    messages.push_back(std::move(message));
+  }
+
+  std::vector<const void*> pointers;
+  std::vector<std::size_t> sizes;
+  for (const auto& message : messages) {
+    pointers.push_back(message.data());
+    sizes.push_back(message.size());
+  }
+
+  std::vector<sha1_t> digests(messages.size());
+  sha1_digests(pointers.data(), sizes.data(), messages.size(), digests.data());
+
+  for (auto i = 0u; i < messages.size(); ++i) {
+    EXPECT_THAT(digests[i], Eq(details::sha1_digest_with(&details::sha1_compress_scalar,
+                                                         messages[i].data(), messages[i].size())))
+      << "size " << i << ", " << sha1_digest_name();
+  }
+}
+}
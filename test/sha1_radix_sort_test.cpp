@@ -0,0 +1,69 @@
+#include "sha1_radix_sort.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace okon::test {
+namespace {
+std::vector<sha1_t> make_random_sha1s(std::size_t count, unsigned seed, uint8_t first_byte)
+{
+  std::mt19937 generator{ seed };
+  std::uniform_int_distribution<unsigned> byte_distribution{ 0u, 255u };
+
+  std::vector<sha1_t> sha1s(count);
+  for (auto& sha1 : sha1s) {
+    for (auto& byte : sha1) {
+      byte = static_cast<uint8_t>(byte_distribution(generator));
+    }
+    sha1[0] = first_byte;
+  }
+  return sha1s;
+}
+
+void expect_sorted_like_std_sort(std::vector<sha1_t> sha1s, unsigned first_byte)
+{
+  auto expected = sha1s;
+  std::sort(expected.begin(), expected.end());
+
+  radix_sort_sha1(sha1s.data(), sha1s.size(), first_byte);
+  EXPECT_EQ(sha1s, expected);
+}
+}
+
+TEST(Sha1RadixSort, Empty_DoesNothing)
+{
+  radix_sort_sha1(nullptr, 0u);
+}
+
+TEST(Sha1RadixSort, RandomKeys_SortsLikeStdSort)
+{
+  for (const auto count : { 1u, 10u, 64u, 65u, 1000u, 100000u }) {
+    expect_sorted_like_std_sort(make_random_sha1s(count, count, 0xABu), /*first_byte=*/1u);
+  }
+}
+
+TEST(Sha1RadixSort, FromFirstByte_SortsLikeStdSort)
+{
+  auto sha1s = make_random_sha1s(10000u, 1u, 0x00u);
+  for (auto i = 0u; i < sha1s.size(); ++i) {
+    sha1s[i][0] = static_cast<uint8_t>(i * 7u);
+  }
+
+  expect_sorted_like_std_sort(sha1s, /*first_byte=*/0u);
+}
+
+TEST(Sha1RadixSort, KeysWithLongCommonPrefixesAndDuplicates_SortsLikeStdSort)
+{
+  auto sha1s = make_random_sha1s(5000u, 2u, 0x10u);
+  for (auto i = 0u; i < sha1s.size(); ++i) {
+    // Only the last byte differs, and every value repeats.
+    std::fill(sha1s[i].begin() + 1, sha1s[i].end() - 1, uint8_t{ 0x42u });
+    sha1s[i][19] = static_cast<uint8_t>((i * 31u) % 100u);
+  }
+
+  expect_sorted_like_std_sort(sha1s, /*first_byte=*/1u);
+}
+}
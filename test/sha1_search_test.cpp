@@ -0,0 +1,83 @@
+#include "sha1_search.hpp"
+
+#include <gmock/gmock.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace okon::test {
+using ::testing::Eq;
+
+namespace {
+std::vector<sha1_t> make_sorted_keys(unsigned count, std::mt19937& generator)
+{
+  std::uniform_int_distribution<unsigned> byte_distribution{ 0u, 255u };
+  std::vector<sha1_t> keys(count);
+
+  for (auto& key : keys) {
+    for (auto& byte : key) {
+      byte = static_cast<uint8_t>(byte_distribution(generator));
+    }
+  }
+
+  // Some keys share whole prefix, to exercise comparing the rest of the keys.
+  for (auto i = 1u; i < keys.size(); i += 3u) {
+    std::copy_n(keys[i - 1u].begin(), sizeof(uint64_t), keys[i].begin());
+  }
+
+  std::sort(std::begin(keys), std::end(keys));
+  return keys;
+}
+}
+
+TEST(Sha1Search, SharedPrefix_OrderedAsBytes)
+{
+  const auto lhs = details::string_sha1_to_binary("0102030405060708000000000000000000000000");
+  const auto rhs = details::string_sha1_to_binary("0102030405060708000000000000000000000001");
+
+  EXPECT_TRUE(details::sha1_less(lhs, rhs, details::sha1_prefix(rhs)));
+  EXPECT_FALSE(details::sha1_less(rhs, lhs, details::sha1_prefix(lhs)));
+  EXPECT_FALSE(details::sha1_less(lhs, lhs, details::sha1_prefix(lhs)));
+}
+
+TEST(Sha1Search, LowerBoundSha1_MatchesStdLowerBound)
+{
+  std::mt19937 generator{ 1234u };
+
+  for (const auto count : { 0u, 1u, 2u, 3u, 4u, 5u, 15u, 16u, 17u, 31u, 100u, 1024u }) {
+    const auto keys = make_sorted_keys(count, generator);
+    auto queries = make_sorted_keys(64u, generator);
+    queries.insert(std::end(queries), std::cbegin(keys), std::cend(keys));
+
+    for (const auto& query : queries) {
+      const auto expected = std::distance(
+        std::cbegin(keys), std::lower_bound(std::cbegin(keys), std::cend(keys), query));
+      EXPECT_THAT(lower_bound_sha1(keys.data(), count, query), Eq(expected)) << "count " << count;
+    }
+  }
+}
+
+TEST(Sha1Search, LowerBoundSha1InCapacity_MatchesStdLowerBound)
+{
+  std::mt19937 generator{ 1234u };
+
+  constexpr auto capacity{ 100u };
+  for (const auto count : { 0u, 1u, 2u, 15u, 16u, 17u, 31u, 99u, 100u }) {
+    // Keys past `count` are less than all, to check that they're not taken into account.
+    auto keys = make_sorted_keys(count, generator);
+    keys.resize(capacity, sha1_t{});
+    auto queries = make_sorted_keys(64u, generator);
+    queries.insert(std::end(queries), std::cbegin(keys), std::cbegin(keys) + count);
+
+    for (const auto& query : queries) {
+      const auto expected = std::distance(
+        std::cbegin(keys), std::lower_bound(std::cbegin(keys), std::cbegin(keys) + count, query));
+      EXPECT_THAT(details::lower_bound_sha1_in_capacity<capacity>(
+                    details::sha1_array_keys{ keys.data() }, count, query),
+                  Eq(expected))
+        << "count " << count;
+    }
+  }
+}
+}
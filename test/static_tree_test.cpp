@@ -0,0 +1,165 @@
+#include "memory_storage.hpp"
+#include "static_tree.hpp"
+#include "static_tree_writer.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <numeric>
+
+namespace okon::test {
+namespace {
+// Storage with direct access, so static_tree takes the prefetching batch path.
+class direct_memory_storage : public memory_storage
+{
+public:
+  const uint8_t* data() const
+  {
+    return m_storage.data();
+  }
+
+  uint64_t size() const
+  {
+    return m_storage.size();
+  }
+};
+
+sha1_t make_sha1(unsigned value)
+{
+  sha1_t sha1{};
+  sha1[0] = static_cast<uint8_t>(value >> 16u);
+  sha1[1] = static_cast<uint8_t>(value >> 8u);
+  sha1[2] = static_cast<uint8_t>(value);
+  sha1[19] = 0xABu;
+  return sha1;
+}
+
+template <typename Storage = memory_storage>
+Storage make_static_tree_storage(unsigned keys_count, uint32_t leaf_block_keys,
+                                 uint32_t internal_block_keys)
+{
+  Storage storage;
+  static_tree_writer writer{ storage, leaf_block_keys, internal_block_keys };
+
+  // Even values only, so odd ones can be used as missing keys.
+  for (auto i = 0u; i < keys_count; ++i) {
+    writer.insert_sorted(make_sha1(i * 2u));
+  }
+  writer.finalize_inserting();
+
+  return storage;
+}
+}
+
+TEST(StaticTreeGeometry, LayersCount_DependsOnKeysCount)
+{
+  EXPECT_EQ(static_tree_geometry(0u, 4u, 2u).layers_count(), 0u);
+  EXPECT_EQ(static_tree_geometry(4u, 4u, 2u).layers_count(), 0u);
+  EXPECT_EQ(static_tree_geometry(5u, 4u, 2u).layers_count(), 1u);
+  EXPECT_EQ(static_tree_geometry(12u, 4u, 2u).layers_count(), 1u);
+  EXPECT_EQ(static_tree_geometry(13u, 4u, 2u).layers_count(), 2u);
+}
+
+TEST(StaticTreeGeometry, SeparatorsCount_LastBlockIsNotFull)
+{
+  // 6 leaf blocks, so layer 1 has blocks with children {0, 1, 2} and {3, 4, 5}.
+  const static_tree_geometry geometry{ 24u, 4u, 2u };
+
+  ASSERT_EQ(geometry.layers_count(), 2u);
+  EXPECT_EQ(geometry.separators_count(1u, 0u), 2u);
+  EXPECT_EQ(geometry.separators_count(1u, 1u), 2u);
+  EXPECT_EQ(geometry.separators_count(2u, 0u), 1u);
+  EXPECT_EQ(geometry.separator_key_index(2u, 0u, 0u), 12u);
+}
+
+TEST(StaticTree, Contains_FindsOnlyInsertedKeys)
+{
+  const std::pair<uint32_t, uint32_t> block_sizes[] = { { 4u, 2u }, { 3u, 1u }, { 256u, 16u } };
+
+  for (const auto& [leaf_block_keys, internal_block_keys] : block_sizes) {
+    for (const auto keys_count : { 0u, 1u, 4u, 5u, 12u, 13u, 100u, 1000u }) {
+      auto storage =
+        make_static_tree_storage(keys_count, leaf_block_keys, internal_block_keys);
+      static_tree tree{ storage };
+
+      for (auto i = 0u; i < keys_count * 2u + 2u; ++i) {
+        EXPECT_EQ(tree.contains(make_sha1(i)), i % 2u == 0u && i < keys_count * 2u)
+          << "blocks " << leaf_block_keys << "/" << internal_block_keys << ", keys count "
+          << keys_count << ", key " << i;
+      }
+    }
+  }
+}
+
+TEST(StaticTree, ContainsSortedBatch_MatchesContains)
+{
+  constexpr auto keys_count{ 1000u };
+  auto storage = make_static_tree_storage<direct_memory_storage>(keys_count, 4u, 2u);
+  static_tree tree{ storage };
+
+  std::vector<sha1_t> queries;
+  for (auto i = 0u; i < keys_count * 2u + 10u; ++i) {
+    queries.push_back(make_sha1(i));
+  }
+
+  std::vector<std::size_t> sorted_queries(queries.size());
+  std::iota(sorted_queries.begin(), sorted_queries.end(), 0u);
+
+  std::vector<uint8_t> results(queries.size(), 0xFFu);
+  tree.contains_sorted_batch(queries.data(), sorted_queries.data(), sorted_queries.size(),
+                             results.data());
+
+  for (auto i = 0u; i < queries.size(); ++i) {
+    EXPECT_EQ(results[i], tree.contains(queries[i]) ? 1u : 0u) << "query " << i;
+  }
+}
+
+TEST(StaticTree, LowerBound_ReturnsIndexOfFirstKeyNotLessThanSearched)
+{
+  constexpr auto keys_count{ 1000u };
+
+  for (const auto& [leaf_block_keys, internal_block_keys] :
+       { std::pair{ 4u, 2u }, std::pair{ 256u, 16u } }) {
+    auto storage = make_static_tree_storage(keys_count, leaf_block_keys, internal_block_keys);
+    static_tree tree{ storage };
+
+    // Key with value 2 * i has index i.
+    for (auto i = 0u; i < keys_count * 2u + 2u; ++i) {
+      EXPECT_EQ(tree.lower_bound(make_sha1(i)), std::min((i + 1u) / 2u, keys_count))
+        << "blocks " << leaf_block_keys << "/" << internal_block_keys << ", key " << i;
+    }
+  }
+}
+
+TEST(StaticTree, Count_WithCounts_ReturnsCountsOfKeys)
+{
+  for (const auto keys_count : { 0u, 3u, 100u, 1000u }) {
+    memory_storage storage;
+    memory_storage counts_storage;
+    static_tree_writer writer{ storage, 4u, 2u, &counts_storage };
+    for (auto i = 0u; i < keys_count; ++i) {
+      writer.insert_sorted(make_sha1(i * 2u), i + 7u);
+    }
+    writer.finalize_inserting();
+
+    static_tree tree{ storage };
+    ASSERT_TRUE(tree.geometry().has_counts());
+    EXPECT_EQ(storage.total_size(), tree.geometry().file_size());
+
+    for (auto i = 0u; i < keys_count * 2u + 2u; ++i) {
+      const auto expected = i % 2u == 0u && i < keys_count * 2u ? i / 2u + 7u : 0u;
+      EXPECT_EQ(tree.count(make_sha1(i)), expected) << "keys count " << keys_count << ", key " << i;
+    }
+  }
+}
+
+TEST(StaticTree, Count_WithoutCounts_ReturnsOneForInsertedKeys)
+{
+  auto storage = make_static_tree_storage(100u, 4u, 2u);
+  static_tree tree{ storage };
+  ASSERT_FALSE(tree.geometry().has_counts());
+
+  EXPECT_EQ(tree.count(make_sha1(10u)), 1u);
+  EXPECT_EQ(tree.count(make_sha1(11u)), 0u);
+}
+}
@@ -1,8 +1,11 @@
 #include "sha1_utils.hpp"
+#include "text_sha1_decoder.hpp"
 
 #include <gmock/gmock.h>
 
+#include <memory>
 #include <string_view>
+#include <vector>
 
 namespace okon::test {
 
@@ -47,4 +50,47 @@ TEST_P(SIMDSha1ToBinaryTest, ProducesCorrectBinary)
 }
 
 INSTANTIATE_TEST_SUITE_P(TextSha1ToBinary, SIMDSha1ToBinaryTest, testing::ValuesIn(values));
+
+TEST(TextSha1sToBinary, DecodesAllHashes)
+{
+  std::vector<const char*> texts;
+  std::vector<sha1_t> expected;
+  for (auto i = 0u; i < 10u; ++i) {
+    for (const auto& [text, sha1] : values) {
+      texts.push_back(text.data());
+      expected.push_back(sha1);
+    }
+  }
+
+  std::vector<sha1_t> result(texts.size());
+  text_sha1s_to_binary(texts.data(), texts.size(), result.data());
+
+  EXPECT_THAT(result, ContainerEq(expected));
+}
+
+TEST(TextSha1sToBinary, DoesntReadAfterHash)
+{
+  // Hashes at the very end of their allocations, so an overread is caught by a sanitizer.
+  std::vector<std::unique_ptr<char[]>> buffers;
+  std::vector<const char*> texts;
+  for (const auto& value : values) {
+    auto& buffer = buffers.emplace_back(std::make_unique<char[]>(k_text_sha1_length));
+    std::copy_n(value.text.data(), k_text_sha1_length, buffer.get());
+    texts.push_back(buffer.get());
+  }
+
+  std::vector<sha1_t> result(texts.size());
+  text_sha1s_to_binary(texts.data(), texts.size(), result.data());
+
+  for (auto i = 0u; i < result.size(); ++i) {
+    EXPECT_THAT(result[i], Eq(values[i].expected));
+  }
+}
+
+TEST(TextSha1sToBinary, DecodesSingleHash)
+{
+  const auto& [text, expected] = values[1];
+  EXPECT_THAT(text_sha1_to_binary(text.data()), Eq(expected));
+  EXPECT_THAT(std::string_view{ text_sha1_decoder_name() }, Not(IsEmpty()));
+}
 }
@@ -0,0 +1,180 @@
+#include "write_combining_storage.hpp"
+#include "btree_sorted_keys_inserter.hpp"
+#include "fstream_wrapper.hpp"
+#include "memory_storage.hpp"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace okon::test {
+namespace {
+// Memory storage that counts writes passed to it.
+class counting_storage
+{
+public:
+  using size_type_t = memory_storage::size_type_t;
+
+  counting_storage()
+  {
+    m_storage.seek_in(0u);
+    m_storage.seek_out(0u);
+  }
+
+  void write(const void* ptr, size_type_t size)
+  {
+    ++m_writes_count;
+    m_storage.write(ptr, size);
+  }
+
+  size_type_t read(void* ptr, size_type_t size)
+  {
+    return m_storage.read(ptr, size);
+  }
+
+  void seek_in(size_type_t pos)
+  {
+    m_storage.seek_in(pos);
+  }
+  void seek_out(size_type_t pos)
+  {
+    m_storage.seek_out(pos);
+  }
+
+  size_type_t tell_in()
+  {
+    return m_storage.tell_in();
+  }
+  size_type_t tell_out()
+  {
+    return m_storage.tell_out();
+  }
+
+  memory_storage m_storage;
+  unsigned m_writes_count{ 0u };
+};
+
+sha1_t make_sha1(unsigned value)
+{
+  sha1_t sha1{};
+  sha1[0] = static_cast<uint8_t>(value >> 8u);
+  sha1[1] = static_cast<uint8_t>(value);
+  return sha1;
+}
+
+template <typename DataStorage>
+void insert_keys(DataStorage& storage, unsigned keys_count)
+{
+  btree_sorted_keys_inserter inserter{ storage, /*order=*/5u, btree_format_version::v2 };
+  for (auto i = 0u; i < keys_count; ++i) {
+    inserter.insert_sorted(make_sha1(i));
+  }
+  inserter.finalize_inserting();
+}
+}
+
+TEST(WriteCombiningStorage, ConsecutiveWrites_PassedAsOneWrite)
+{
+  counting_storage storage;
+  write_combining_storage combining{ storage, /*buffer_size=*/1024u };
+
+  const std::vector<uint8_t> data(10u, 7u);
+  combining.seek_out(0u);
+  for (auto i = 0u; i < 10u; ++i) {
+    combining.write(data.data(), data.size());
+  }
+  combining.flush();
+
+  EXPECT_EQ(storage.m_writes_count, 1u);
+  EXPECT_EQ(storage.m_storage.m_storage, std::vector<uint8_t>(100u, 7u));
+}
+
+TEST(WriteCombiningStorage, FullBuffer_WrittenRightAway)
+{
+  counting_storage storage;
+  write_combining_storage combining{ storage, /*buffer_size=*/16u };
+
+  const std::vector<uint8_t> data(8u, 1u);
+  combining.seek_out(0u);
+  for (auto i = 0u; i < 4u; ++i) {
+    combining.write(data.data(), data.size());
+  }
+
+  EXPECT_EQ(storage.m_writes_count, 2u);
+  EXPECT_EQ(storage.m_storage.m_storage.size(), 32u);
+}
+
+TEST(WriteCombiningStorage, WritesAtDifferentOffsets_AllStored)
+{
+  counting_storage storage;
+  write_combining_storage combining{ storage };
+
+  const uint8_t a[] = { 1u, 2u, 3u, 4u };
+  const uint8_t b[] = { 5u, 6u };
+  combining.seek_out(2u);
+  combining.write(a, sizeof(a));
+  combining.seek_out(0u);
+  combining.write(b, sizeof(b));
+  combining.seek_out(3u);
+  combining.write(b, sizeof(b));
+  combining.flush();
+
+  const std::vector<uint8_t> expected = { 5u, 6u, 1u, 5u, 6u, 4u };
+  EXPECT_EQ(storage.m_storage.m_storage, expected);
+}
+
+TEST(WriteCombiningStorage, Read_SeesBufferedWrites)
+{
+  counting_storage storage;
+  write_combining_storage combining{ storage };
+
+  const uint8_t data[] = { 1u, 2u, 3u, 4u };
+  combining.seek_out(0u);
+  combining.write(data, sizeof(data));
+
+  uint8_t read_data[2]{};
+  combining.seek_in(1u);
+  EXPECT_EQ(combining.read(read_data, sizeof(read_data)), 2u);
+  EXPECT_EQ(read_data[0], 2u);
+  EXPECT_EQ(read_data[1], 3u);
+}
+
+TEST(WriteCombiningStorage, Read_StorageWithSharedReadAndWritePosition_SeesBufferedWrites)
+{
+  const auto path = std::filesystem::temp_directory_path() / "okon_write_combining_storage_test";
+  {
+    fstream_wrapper file{ path.string(), std::ios::in | std::ios::out | std::ios::trunc };
+    write_combining_storage combining{ file };
+
+    const uint8_t data[] = { 1u, 2u, 3u, 4u };
+    combining.seek_out(0u);
+    combining.write(data, sizeof(data));
+
+    uint8_t read_data[2]{};
+    combining.seek_in(1u);
+    EXPECT_EQ(combining.read(read_data, sizeof(read_data)), 2);
+    EXPECT_EQ(read_data[0], 2u);
+    EXPECT_EQ(read_data[1], 3u);
+  }
+  std::filesystem::remove(path);
+}
+
+TEST(WriteCombiningStorage, BtreeInserter_WritesSameFileInFewerWrites)
+{
+  constexpr auto keys_count{ 5000u };
+
+  counting_storage direct;
+  insert_keys(direct, keys_count);
+
+  counting_storage combined;
+  {
+    write_combining_storage combining{ combined };
+    insert_keys(combining, keys_count);
+  }
+
+  EXPECT_EQ(combined.m_storage.m_storage, direct.m_storage.m_storage);
+  EXPECT_LT(combined.m_writes_count, direct.m_writes_count);
+}
+}